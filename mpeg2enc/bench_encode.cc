@@ -0,0 +1,414 @@
+/*
+ *  bench_encode.cc:  End-to-end encoder throughput benchmark.  Runs
+ *  the mpeg2enc YUV4MPEGEncoder in-process on a deterministic
+ *  synthetic YUV4MPEG stream for every combination of a matrix of
+ *  interlace mode (-I), thread count (-M) and 4*4 / 2*2 motion search
+ *  reduction (-4 / -2) settings and writes a line of CSV per
+ *  combination: fps, bits coded and the PSNR of the reconstruction.
+ *  With -P the frames are pushed from memory into an MPEG2PushEncoder
+ *  instead, which should code exactly the same bits.
+ *
+ *  The input is identical from run to run and version to version so
+ *  the fps and bits can be compared to catch regressions.  Built by
+ *  "make check", run by "make bench".
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "yuv4mpeg.h"
+#include "mpegconsts.h"
+#include "mpeg2enc.hh"
+#include "encoderparams.hh"
+#include "elemstrmwriter.hh"
+#include "instrumentation.hh"
+#include "pushencoder.hh"
+
+#define DEFAULT_WIDTH 720
+#define DEFAULT_HEIGHT 576
+#define DEFAULT_FRAMES 50
+
+static uint32_t randx = 1;
+
+static int bench_rand( int n )
+{
+    randx = randx * 1103515245 + 12345;
+    return (int)((randx >> 8) % (uint32_t)n);
+}
+
+static uint8_t clip_pel( int v )
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+/*
+ * Frame 'n' of the synthetic stream: a diagonal luma gradient moving
+ * a pel a frame under a texture panned 3 pels right and 1 down a
+ * frame, with low level noise on top.  The chroma gradients drift
+ * in opposite directions.  Some of the texture is beyond the reach
+ * of a reduced motion search and the noise keeps the quantisers
+ * busy, so it is neither trivially easy nor hopeless to code.
+ */
+
+static void make_frame( int n, int width, int height, uint8_t *planes[3] )
+{
+    int x, y;
+    int cw = width/2, ch = height/2;
+
+    for( y = 0; y < height; ++y )
+    {
+        uint8_t *row = planes[0] + y * width;
+        int ty = y - n;
+        for( x = 0; x < width; ++x )
+        {
+            int tx = x - 3*n;
+            int grad = ((x + y + 2*n) * 160 / (width + height)) % 160;
+            int texture = ((tx >> 4) ^ (ty >> 4)) & 1
+                ? 40 + ((tx*tx + ty*ty) >> 6) % 24
+                : 0;
+            row[x] = clip_pel( 16 + grad + texture + bench_rand( 9 ) - 4 );
+        }
+    }
+    for( y = 0; y < ch; ++y )
+    {
+        uint8_t *u = planes[1] + y * cw;
+        uint8_t *v = planes[2] + y * cw;
+        for( x = 0; x < cw; ++x )
+        {
+            u[x] = clip_pel( 64 + ((x + n) * 128 / cw) % 128 );
+            v[x] = clip_pel( 64 + ((y + ch - n % ch) * 128 / ch) % 128 );
+        }
+    }
+}
+
+/* Frames of packed 4:2:0 planes */
+
+typedef std::vector<std::vector<uint8_t> > Video;
+
+static void frame_planes( int width, int height, std::vector<uint8_t> &frame,
+                          uint8_t *planes[3] )
+{
+    planes[0] = &frame[0];
+    planes[1] = planes[0] + width*height;
+    planes[2] = planes[1] + width*height/4;
+}
+
+static void make_video( int width, int height, int frames, Video &video )
+{
+    uint8_t *planes[3];
+
+    video.resize( frames );
+    randx = 1;
+    for( int n = 0; n < frames; ++n )
+    {
+        video[n].resize( width*height*3/2 );
+        frame_planes( width, height, video[n], planes );
+        make_frame( n, width, height, planes );
+    }
+}
+
+static void write_stream( int fd, int width, int height, Video &video )
+{
+    y4m_stream_info_t sinfo;
+    y4m_frame_info_t finfo;
+    uint8_t *planes[3];
+    unsigned int n;
+    int err;
+
+    y4m_init_stream_info( &sinfo );
+    y4m_init_frame_info( &finfo );
+    y4m_si_set_width( &sinfo, width );
+    y4m_si_set_height( &sinfo, height );
+    y4m_si_set_sampleaspect( &sinfo, y4m_sar_PAL_CCIR601 );
+    y4m_si_set_interlace( &sinfo, Y4M_ILACE_NONE );
+    y4m_si_set_framerate( &sinfo, y4m_fps_PAL );
+    y4m_si_set_chroma( &sinfo, Y4M_CHROMA_420JPEG );
+    if( (err = y4m_write_stream_header( fd, &sinfo )) != Y4M_OK )
+        mjpeg_error_exit1( "Write header failed: %s", y4m_strerr(err) );
+
+    for( n = 0; n < video.size(); ++n )
+    {
+        frame_planes( width, height, video[n], planes );
+        if( (err = y4m_write_frame( fd, &sinfo, &finfo, planes )) != Y4M_OK )
+            mjpeg_error_exit1( "Write frame failed: %s", y4m_strerr(err) );
+    }
+    y4m_fini_stream_info( &sinfo );
+    y4m_fini_frame_info( &finfo );
+}
+
+/* The synthetic input, removed however we exit */
+
+static char input[] = "/tmp/bench_encodeXXXXXX";
+
+static void remove_input()
+{
+    unlink( input );
+}
+
+/* A comma separated list of settings for one option */
+
+static std::vector<std::string> parse_list( const char *arg )
+{
+    std::vector<std::string> list;
+    std::string s( arg );
+    std::string::size_type start = 0, comma;
+    do
+    {
+        comma = s.find( ',', start );
+        list.push_back( s.substr( start, comma == std::string::npos
+                                  ? std::string::npos : comma - start ) );
+        start = comma + 1;
+    } while( comma != std::string::npos );
+    return list;
+}
+
+struct BenchResult
+{
+    double seconds;
+    uint64_t bits;
+    double psnr[3];
+};
+
+/*
+ * Push video's frames into an MPEG2PushEncoder, pulling the packets
+ * coded as they appear.  RETURN: bits coded
+ */
+
+static uint64_t push_encode( MPEG2EncOptions &options,
+                             int width, int height, Video &video,
+                             SNRTotals &totals )
+{
+    MPEG2EncInVidParams strm;
+    std::vector<uint8_t> packet;
+    uint8_t *planes[3];
+    int strides[3] = { width, width/2, width/2 };
+    uint64_t bytes = 0;
+
+    strm.horizontal_size = width;
+    strm.vertical_size = height;
+    strm.frame_rate_code = mpeg_framerate_code( y4m_fps_PAL );
+    strm.interlacing_code = Y4M_ILACE_NONE;
+    strm.aspect_ratio_code =
+        mpeg_guess_mpeg_aspect_code( 2, y4m_sar_PAL_CCIR601, width, height );
+
+    MPEG2PushEncoder encoder( options, strm );
+    if( !encoder.Ok() )
+        mjpeg_error_exit1( "Options unusable for MPEG2PushEncoder" );
+    encoder.parms.snr_totals = &totals;
+    for( unsigned int n = 0; n < video.size(); ++n )
+    {
+        frame_planes( width, height, video[n], planes );
+        if( !encoder.PushFrame( planes, strides ) )
+            mjpeg_error_exit1( "Pushing frame %u failed", n );
+        while( encoder.PullPacket( packet, false ) )
+            bytes += packet.size();
+    }
+    if( !encoder.EndOfStream() )
+        mjpeg_error_exit1( "Ending the stream failed" );
+    while( encoder.PullPacket( packet ) )
+        bytes += packet.size();
+    return bytes * 8;
+}
+
+static BenchResult encode( const char *inputname,
+                           const std::vector<std::string> &settings,
+                           const std::vector<std::string> &extra,
+                           int width, int height, Video *push_video )
+{
+    std::vector<std::string> args;
+    static const char *matrix_opts[] = { "-I", "-M", "-4", "-2" };
+    unsigned int i;
+
+    args.push_back( "bench_encode" );
+    args.push_back( "-f" );
+    args.push_back( "3" );
+    args.push_back( "-b" );
+    args.push_back( "6000" );
+    args.push_back( "-v" );
+    args.push_back( "0" );
+    for( i = 0; i < settings.size(); ++i )
+    {
+        args.push_back( matrix_opts[i] );
+        args.push_back( settings[i] );
+    }
+    args.insert( args.end(), extra.begin(), extra.end() );
+    args.push_back( "-o" );
+    args.push_back( "/dev/null" );
+    args.push_back( inputname );
+
+    std::vector<char *> argv;
+    for( i = 0; i < args.size(); ++i )
+        argv.push_back( const_cast<char *>(args[i].c_str()) );
+    argv.push_back( 0 );
+
+    MPEG2EncCmdLineOptions options;
+    optind = 0;                 // Full re-initialisation of getopt
+    if( options.SetFromCmdLine( argv.size() - 1, &argv[0] ) != 0 )
+        mjpeg_error_exit1( "Bad mpeg2enc options" );
+    mjpeg_default_handler_verbosity( 0 );
+
+    SNRTotals totals;
+    BenchResult result;
+    struct timeval start, end;
+    if( push_video != 0 )
+    {
+        gettimeofday( &start, 0 );
+        result.bits = push_encode( options, width, height, *push_video, totals );
+        gettimeofday( &end, 0 );
+    }
+    else
+    {
+        YUV4MPEGEncoder encoder( options );
+        encoder.parms.snr_totals = &totals;
+        gettimeofday( &start, 0 );
+        encoder.Encode();
+        gettimeofday( &end, 0 );
+        result.bits = encoder.writer->BitCount();
+    }
+    close( options.istrm_fd );
+
+    result.seconds = (end.tv_sec - start.tv_sec)
+        + (end.tv_usec - start.tv_usec) * 1e-6;
+    for( i = 0; i < 3; ++i )
+        result.psnr[i] = totals.PSNR( i );
+    return result;
+}
+
+static void Usage( const char *progname )
+{
+    fprintf( stderr,
+             "Usage: %s [options] [-- mpeg2enc options]\n"
+             "  -o file      CSV output file [stdout]\n"
+             "  -n frames    Frames of synthetic input [%d]\n"
+             "  -W width     Frame width [%d]\n"
+             "  -H height    Frame height [%d]\n"
+             "  -I list      Interlace modes (-I) [0,1]\n"
+             "  -M list      Worker thread counts (-M) [0,2]\n"
+             "  -4 list      4*4 motion search reductions (-4) [2]\n"
+             "  -2 list      2*2 motion search reductions (-2) [3]\n"
+             "  -P           Push frames from memory (MPEG2PushEncoder)\n"
+             "Lists are comma separated.  Every combination is encoded\n"
+             "(as MPEG-2 at 6Mbps, -f 3 -b 6000) and a line of CSV\n"
+             "written for each.\n",
+             progname, DEFAULT_FRAMES, DEFAULT_WIDTH, DEFAULT_HEIGHT );
+    exit( 1 );
+}
+
+int main( int argc, char *argv[] )
+{
+    const char *outfilename = 0;
+    int frames = DEFAULT_FRAMES;
+    int width = DEFAULT_WIDTH, height = DEFAULT_HEIGHT;
+    std::vector<std::string> lists[4];
+    std::vector<std::string> extra;
+    bool push = false;
+    Video video;
+    int n;
+
+    lists[0] = parse_list( "0,1" );
+    lists[1] = parse_list( "0,2" );
+    lists[2] = parse_list( "2" );
+    lists[3] = parse_list( "3" );
+
+    while( (n = getopt( argc, argv, "o:n:W:H:I:M:4:2:P" )) != -1 )
+    {
+        switch( n )
+        {
+        case 'o' : outfilename = optarg; break;
+        case 'n' : frames = atoi( optarg ); break;
+        case 'W' : width = atoi( optarg ); break;
+        case 'H' : height = atoi( optarg ); break;
+        case 'I' : lists[0] = parse_list( optarg ); break;
+        case 'M' : lists[1] = parse_list( optarg ); break;
+        case '4' : lists[2] = parse_list( optarg ); break;
+        case '2' : lists[3] = parse_list( optarg ); break;
+        case 'P' : push = true; break;
+        default :
+            Usage( argv[0] );
+        }
+    }
+    for( ; optind < argc; ++optind )
+        extra.push_back( argv[optind] );
+    if( frames <= 0 || width <= 0 || height <= 0
+        || width % 16 != 0 || height % 16 != 0 )
+    {
+        mjpeg_error( "Frame count and size must be positive, "
+                     "the size a multiple of 16" );
+        Usage( argv[0] );
+    }
+
+    FILE *out = stdout;
+    if( outfilename != 0 && (out = fopen( outfilename, "w" )) == 0 )
+        mjpeg_error_exit1( "Couldn't create %s", outfilename );
+
+    int fd = mkstemp( input );
+    if( fd < 0 )
+        mjpeg_error_exit1( "Couldn't create temporary input file" );
+    atexit( remove_input );
+    make_video( width, height, frames, video );
+    write_stream( fd, width, height, video );
+    close( fd );
+    if( !push )
+        video.clear();
+
+    fprintf( out, "input,interlace,threads,reduction_4x4,reduction_2x2,"
+             "width,height,frames,seconds,fps,bits,psnr_y,psnr_u,psnr_v\n" );
+    std::vector<std::string> settings( 4 );
+    for( unsigned int i = 0; i < lists[0].size(); ++i )
+    for( unsigned int m = 0; m < lists[1].size(); ++m )
+    for( unsigned int r4 = 0; r4 < lists[2].size(); ++r4 )
+    for( unsigned int r2 = 0; r2 < lists[3].size(); ++r2 )
+    {
+        settings[0] = lists[0][i];
+        settings[1] = lists[1][m];
+        settings[2] = lists[2][r4];
+        settings[3] = lists[3][r2];
+        BenchResult r = encode( input, settings, extra, width, height,
+                                push ? &video : 0 );
+        fprintf( out, "%s,%s,%s,%s,%s,%d,%d,%d,%.3f,%.2f,%llu,%.3f,%.3f,%.3f\n",
+                 push ? "push" : "y4m", settings[0].c_str(), settings[1].c_str(),
+                 settings[2].c_str(), settings[3].c_str(),
+                 width, height, frames, r.seconds,
+                 r.seconds > 0.0 ? frames / r.seconds : 0.0,
+                 (unsigned long long)r.bits,
+                 r.psnr[0], r.psnr[1], r.psnr[2] );
+        fflush( out );
+    }
+
+    if( out != stdout )
+        fclose( out );
+    return 0;
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
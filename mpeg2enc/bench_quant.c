@@ -0,0 +1,381 @@
+/*
+ *  bench_quant.c:  Checks the SSE4.1 and AVX2 quantisation / inverse
+ *  quantisation routines (quant_sse4.c) give results *identical* to
+ *  the C versions (quantize_ref.c) and reports the throughput of
+ *  each.  Run by "make check".
+ *
+ *  Every QuantizerCalls entry point is checked for MPEG-1 and MPEG-2,
+ *  linear and non-linear quantiser scales and both the default and
+ *  random quantisation matrices, on random and worst case blocks.
+ *  The throughput is reported as ns per call (a macroblock's
+ *  BLOCK_COUNT blocks for the quantisers, a block for the others).
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "cpu_accel.h"
+#include "syntaxconsts.h"
+#include "tables.h"
+#include "quantize_ref.h"
+#include "quant_sse4.h"
+
+#define CHECK_CASES 4000
+#define BENCH_CASES 256
+#define BENCH_USECS 50000
+
+enum entry { QUANT_INTRA, QUANT_NON_INTRA, WEIGHT_INTRA, WEIGHT_INTER,
+             IQUANT_INTRA, IQUANT_NON_INTRA, ENTRIES };
+
+static const char *entry_names[ENTRIES] =
+{
+    "quant_intra", "quant_non_intra",
+    "quant_weight_coeff_intra", "quant_weight_coeff_inter",
+    "iquant_intra", "iquant_non_intra"
+};
+
+struct qcase
+{
+    int16_t blks[BLOCK_COUNT*64];
+    int q_scale_type, dc_prec, mquant, satlim;
+};
+
+struct qresult
+{
+    int16_t blks[BLOCK_COUNT*64];
+    int ret, mquant;
+};
+
+static uint32_t randx = 1;
+
+static int bench_rand( int n )
+{
+    randx = randx * 1103515245 + 12345;
+    return (int)((randx >> 8) % (uint32_t)n);
+}
+
+static int16_t rand_range( int lo, int hi )
+{
+    return lo + bench_rand( hi-lo+1 );
+}
+
+/*
+ * A block to (inverse) quantise, kind:
+ * 0 DCT-like: magnitudes falling off with frequency, 1 sparse and
+ * small, 2 extreme values, 3 uniform over [lo,hi]
+ */
+
+static void make_block( int16_t *blk, int kind, int lo, int hi )
+{
+    int i;
+    for( i = 0; i < 64; ++i )
+    {
+        switch( kind )
+        {
+        case 0 :
+        {
+            int mag = (hi+1) >> (i/8 + (i%8));
+            blk[i] = mag > 0 ? rand_range( -mag, mag ) : 0;
+            break;
+        }
+        case 1 :
+            blk[i] = bench_rand( 4 ) == 0 ? rand_range( -3, 3 ) : 0;
+            break;
+        case 2 :
+            switch( bench_rand( 4 ) )
+            {
+            case 0 : blk[i] = lo; break;
+            case 1 : blk[i] = hi; break;
+            case 2 : blk[i] = 0; break;
+            default : blk[i] = rand_range( -1, 1 ); break;
+            }
+            break;
+        default :
+            blk[i] = rand_range( lo, hi );
+            break;
+        }
+    }
+}
+
+static void make_case( struct qcase *c, enum entry e, int mpeg1 )
+{
+    int b;
+    int lo = -2048, hi = 2047;
+    /* The inverse quantisers work for any 16 bit input */
+    if( (e == IQUANT_INTRA || e == IQUANT_NON_INTRA) && bench_rand( 4 ) == 0 )
+    {
+        lo = -32768;
+        hi = 32767;
+    }
+    for( b = 0; b < BLOCK_COUNT; ++b )
+        make_block( c->blks+64*b, bench_rand( 4 ), lo, hi );
+
+    c->q_scale_type = mpeg1 ? 0 : bench_rand( 2 );
+    c->mquant = c->q_scale_type
+        ? non_linear_mquant_table[1+bench_rand( 31 )]
+        : 2*(1+bench_rand( 31 ));
+    c->dc_prec = mpeg1 ? 0 : bench_rand( 4 );
+    c->satlim = mpeg1 ? 255 : 2047;
+}
+
+static void run_case( struct QuantizerCalls *calls,
+                      struct QuantizerWorkSpace *wsp,
+                      enum entry e, struct qcase *c, struct qresult *r )
+{
+    int b;
+    r->mquant = c->mquant;
+    r->ret = 0;
+    switch( e )
+    {
+    case QUANT_INTRA :
+        calls->pquant_intra( wsp, c->blks, r->blks, c->q_scale_type,
+                             c->dc_prec, c->satlim, &r->mquant );
+        break;
+    case QUANT_NON_INTRA :
+        r->ret = calls->pquant_non_intra( wsp, c->blks, r->blks,
+                                          c->q_scale_type, c->satlim,
+                                          &r->mquant );
+        break;
+    case WEIGHT_INTRA :
+        r->ret = calls->pquant_weight_coeff_intra( wsp, c->blks );
+        break;
+    case WEIGHT_INTER :
+        r->ret = calls->pquant_weight_coeff_inter( wsp, c->blks );
+        break;
+    case IQUANT_INTRA :
+        /* In place, as the encoder does */
+        memcpy( r->blks, c->blks, sizeof(r->blks) );
+        for( b = 0; b < BLOCK_COUNT; ++b )
+            calls->piquant_intra( wsp, r->blks+64*b, r->blks+64*b,
+                                  c->dc_prec, c->mquant );
+        break;
+    default :
+        memcpy( r->blks, c->blks, sizeof(r->blks) );
+        for( b = 0; b < BLOCK_COUNT; ++b )
+            calls->piquant_non_intra( wsp, r->blks+64*b, r->blks+64*b,
+                                      c->mquant );
+        break;
+    }
+}
+
+static int result_size( enum entry e )
+{
+    return (e == WEIGHT_INTRA || e == WEIGHT_INTER) ? 0 : BLOCK_COUNT*64;
+}
+
+/*
+ * Quantisation matrices: [0] the defaults, [1] random (intra entries
+ * >= 8 so MPEG-1 intra quantisation can always avoid clipping)
+ */
+
+static uint16_t intra_q[2][64], inter_q[2][64];
+
+static void make_matrices( void )
+{
+    int i;
+    for( i = 0; i < 64; ++i )
+    {
+        intra_q[0][i] = default_intra_quantizer_matrix[i];
+        inter_q[0][i] = default_nonintra_quantizer_matrix[i];
+        intra_q[1][i] = i == 0 ? 8 : rand_range( 8, 255 );
+        inter_q[1][i] = rand_range( 1, 255 );
+    }
+}
+
+static struct QuantizerWorkSpace *init_c_calls( struct QuantizerCalls *calls,
+                                                int mpeg1, int m )
+{
+    struct QuantizerWorkSpace *wsp;
+    const char *env = getenv( "MJPEGTOOLS_SIMD_DISABLE" );
+    char *saved = env ? strdup( env ) : NULL;
+
+    setenv( "MJPEGTOOLS_SIMD_DISABLE", "all", 1 );
+    init_quantizer( calls, &wsp, mpeg1, intra_q[m], inter_q[m] );
+    if( saved )
+    {
+        setenv( "MJPEGTOOLS_SIMD_DISABLE", saved, 1 );
+        free( saved );
+    }
+    else
+        unsetenv( "MJPEGTOOLS_SIMD_DISABLE" );
+    return wsp;
+}
+
+static int check_exact( const char *set, struct QuantizerCalls *ref,
+                        struct QuantizerCalls *tst,
+                        struct QuantizerWorkSpace *wsp,
+                        int mpeg1, int m )
+{
+    static struct qcase c;
+    static struct qresult r1, r2;
+    int e, n, mismatches = 0;
+
+    for( e = 0; e < ENTRIES; ++e )
+        for( n = 0; n < CHECK_CASES; ++n )
+        {
+            make_case( &c, e, mpeg1 );
+            run_case( ref, wsp, e, &c, &r1 );
+            run_case( tst, wsp, e, &c, &r2 );
+            if( r1.ret != r2.ret || r1.mquant != r2.mquant
+                || memcmp( r1.blks, r2.blks,
+                           result_size( e )*sizeof(int16_t) ) != 0 )
+            {
+                if( mismatches < 10 )
+                    mjpeg_error( "%s_%s (MPEG-%d, matrices %d): case %d differs",
+                                 entry_names[e], set, mpeg1 ? 1 : 2, m, n );
+                ++mismatches;
+            }
+        }
+
+    if( mismatches > 0 )
+        mjpeg_error( "%s MPEG-%d matrices %d: %d mismatches with the C versions",
+                     set, mpeg1 ? 1 : 2, m, mismatches );
+    return mismatches > 0;
+}
+
+/* ns per call of calls' e on the cases */
+
+static double bench( struct QuantizerCalls *calls,
+                     struct QuantizerWorkSpace *wsp,
+                     enum entry e, struct qcase *cases )
+{
+    static struct qresult r;
+    struct timeval start, now;
+    long calls_made = 0, usecs;
+    int n;
+
+    gettimeofday( &start, NULL );
+    do
+    {
+        for( n = 0; n < BENCH_CASES; ++n )
+            run_case( calls, wsp, e, &cases[n], &r );
+        calls_made += BENCH_CASES;
+        gettimeofday( &now, NULL );
+        usecs = (now.tv_sec-start.tv_sec)*1000000L + now.tv_usec-start.tv_usec;
+    } while( usecs < BENCH_USECS );
+
+    /* The inverse quantisers are called per block */
+    if( e == IQUANT_INTRA || e == IQUANT_NON_INTRA )
+        calls_made *= BLOCK_COUNT;
+    return usecs * 1000.0 / calls_made;
+}
+
+#ifdef HAVE_QUANT_SSE4
+static void set_sse41_calls( struct QuantizerCalls *calls, int mpeg1 )
+{
+    calls->pquant_intra = quant_intra_sse41;
+    calls->pquant_non_intra = quant_non_intra_sse41;
+    calls->pquant_weight_coeff_intra = quant_weight_coeff_intra_sse41;
+    calls->pquant_weight_coeff_inter = quant_weight_coeff_inter_sse41;
+    calls->piquant_intra = mpeg1 ? iquant_intra_m1_sse41 : iquant_intra_m2_sse41;
+    calls->piquant_non_intra =
+        mpeg1 ? iquant_non_intra_m1_sse41 : iquant_non_intra_m2_sse41;
+}
+
+static void set_avx2_calls( struct QuantizerCalls *calls, int mpeg1 )
+{
+    calls->pquant_intra = quant_intra_avx2;
+    calls->pquant_non_intra = quant_non_intra_avx2;
+    calls->pquant_weight_coeff_intra = quant_weight_coeff_intra_avx2;
+    calls->pquant_weight_coeff_inter = quant_weight_coeff_inter_avx2;
+    calls->piquant_intra = mpeg1 ? iquant_intra_m1_avx2 : iquant_intra_m2_avx2;
+    calls->piquant_non_intra =
+        mpeg1 ? iquant_non_intra_m1_avx2 : iquant_non_intra_m2_avx2;
+}
+#endif
+
+int main( int argc, char *argv[] )
+{
+    struct QuantizerCalls c_calls[2], best_calls, simd_calls[2];
+    struct QuantizerWorkSpace *wsp, *best_wsp;
+    static struct qcase cases[BENCH_CASES];
+    const char *simd_names[2] = { "SSE4.1", "AVX2" };
+    int have_simd[2] = { 0, 0 };
+    int failed = 0;
+    int mpeg1, m, s, e, n;
+
+    mjpeg_default_handler_verbosity( 1 );
+    make_matrices();
+
+#ifdef HAVE_QUANT_SSE4
+    {
+        int flags = cpu_accel();
+        have_simd[0] = (flags & ACCEL_X86_SSE41) != 0;
+        have_simd[1] = have_simd[0] && (flags & ACCEL_X86_AVX2) != 0;
+    }
+#endif
+    if( !have_simd[0] )
+        mjpeg_info( "No SSE4.1: SIMD versions not checked" );
+    else if( !have_simd[1] )
+        mjpeg_info( "No AVX2: AVX2 versions not checked" );
+
+    for( mpeg1 = 0; mpeg1 < 2; ++mpeg1 )
+        for( m = 0; m < 2; ++m )
+        {
+            wsp = init_c_calls( &c_calls[mpeg1], mpeg1, m );
+            for( s = 0; s < 2; ++s )
+            {
+                if( !have_simd[s] )
+                    continue;
+#ifdef HAVE_QUANT_SSE4
+                if( s == 0 )
+                    set_sse41_calls( &simd_calls[s], mpeg1 );
+                else
+                    set_avx2_calls( &simd_calls[s], mpeg1 );
+#endif
+                failed |= check_exact( simd_names[s], &c_calls[mpeg1],
+                                       &simd_calls[s], wsp, mpeg1, m );
+            }
+            shutdown_quantizer( wsp );
+        }
+    if( !failed && have_simd[0] )
+        mjpeg_info( "SIMD quantisers identical to the C versions" );
+
+    /* Throughput: MPEG-2, default matrices.  "selected" is what the
+       encoder would use on this CPU. */
+    wsp = init_c_calls( &c_calls[0], 0, 0 );
+    init_quantizer( &best_calls, &best_wsp, 0, intra_q[0], inter_q[0] );
+#ifdef HAVE_QUANT_SSE4
+    set_sse41_calls( &simd_calls[0], 0 );
+    set_avx2_calls( &simd_calls[1], 0 );
+#endif
+    mjpeg_info( "%-26s %10s %10s %10s %10s", "ns per call", "C",
+                "selected", simd_names[0], simd_names[1] );
+    for( e = 0; e < ENTRIES; ++e )
+    {
+        double t[4] = { 0.0, 0.0, 0.0, 0.0 };
+        for( n = 0; n < BENCH_CASES; ++n )
+            make_case( &cases[n], e, 0 );
+        t[0] = bench( &c_calls[0], wsp, e, cases );
+        t[1] = bench( &best_calls, best_wsp, e, cases );
+        for( s = 0; s < 2; ++s )
+            if( have_simd[s] )
+                t[2+s] = bench( &simd_calls[s], wsp, e, cases );
+        mjpeg_info( "%-26s %10.1f %10.1f %10.1f %10.1f",
+                    entry_names[e], t[0], t[1], t[2], t[3] );
+    }
+    shutdown_quantizer( best_wsp );
+    shutdown_quantizer( wsp );
+
+    return failed ? 1 : 0;
+}
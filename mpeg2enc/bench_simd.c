@@ -0,0 +1,842 @@
+/*
+ *  bench_simd.c:  Checks the SIMD motion estimation (utils/mmxsse),
+ *  transform (fdct / idct) and prediction (pred_comp) routines give
+ *  the same results as the C versions and reports the throughput of
+ *  every version cpu_accel can select on this CPU.  Run by "make
+ *  check".
+ *
+ *  The routines are run over synthetic SD (720x576) and HD (1920x1088)
+ *  frames the way the encoder calls them: the block routines once
+ *  per macroblock (or 8*8 block) of the frame, the image routines on
+ *  the whole frame.  The throughput is reported as ns per call and
+ *  as MB/sec of the pels (or coefficients) each call reads.
+ *
+ *  An accel level's version of a routine is the one the encoder would
+ *  select on a CPU with just the features up to that level: "-" means
+ *  the level adds no version of its own (or the CPU lacks it).  The
+ *  MMX / SSE fdct and idct and the plain MMX sad_01, sad_10 and sad_11
+ *  (which truncate rather than round the interpolated pels) are not
+ *  bit-exact so only their peak error is checked.  The quantisers are
+ *  checked by bench_quant.
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/time.h>
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "cpu_accel.h"
+#include "motionsearch.h"
+#include "transfrm_ref.h"
+#include "predict_ref.h"
+#include "dct_sse2.h"
+#if defined(HAVE_ASM_MMX)
+#include "mmxsse/mmxsse_motion.h"
+#endif
+
+#define BENCH_USECS 50000
+#define SEARCH_RADIUS 16        /* Pels */
+#define BLOCKS_PER_CALL 6       /* pfdct_blocks / pidct_blocks */
+
+/* Peak error of the versions that are not bit-exact against the C
+   versions: per coefficient for the transforms, per pel (summed over a
+   macroblock) for the SADs */
+#define DCT_PEAK_ERROR 2
+#define SAD_PEAK_ERROR 256
+
+#if defined(HAVE_ASM_MMX)
+extern void fdct_mmx( int16_t *blk );
+extern void init_fdct_sse( void );
+extern void fdct_sse( int16_t *blk );
+extern void idct_mmx( int16_t *blk );
+extern void idct_sse( int16_t *blk );
+extern void init_x86_predict( int32_t cpucap );
+#endif
+
+typedef void (*simd_fn)( void );
+
+enum level { LEVEL_C, LEVEL_MMX, LEVEL_SSE, LEVEL_SSE2, LEVEL_AVX2,
+             LEVEL_AVX512BW, LEVELS };
+
+static const char *level_names[LEVELS] =
+{
+    "C", "MMX", "MMXEXT/SSE", "SSE2", "AVX2", "AVX512BW"
+};
+
+/* The cpu_accel flag each level adds (MMXEXT is the integer part of
+   SSE: cpu_accel sets both on SSE CPUs) */
+
+#if defined(HAVE_ASM_MMX)
+static const int level_flags[LEVELS] =
+{
+    0,
+    ACCEL_X86_MMX,
+    ACCEL_X86_MMXEXT | ACCEL_X86_SSE,
+    ACCEL_X86_SSE2 | ACCEL_X86_SSE41,
+    ACCEL_X86_AVX2,
+    ACCEL_X86_AVX512BW
+};
+#endif
+
+/*
+ * A synthetic frame: the luminance of the current and reference
+ * pictures each followed by its 2*2 and 4*4 sub-sampled planes (as
+ * the encoder lays them out), a motion vector per macroblock and the
+ * blocks of prediction error to transform.
+ */
+
+struct frame
+{
+    const char *name;
+    int width, height;
+    uint8_t *cur, *ref;
+    int mbs;
+    int *mbx, *mby;             /* Macroblock top left pel */
+    int *fmv, *bmv;             /* Half-pel vectors: x, y pairs */
+    int *addflag;
+    int blocks;
+    int16_t *resid;             /* fdct input */
+    int16_t *coeffs;            /* idct input: the C fdct of resid */
+};
+
+enum unit { PER_MB, PER_BLOCK, PER_BLOCKS, PER_FRAME };
+
+struct kernel
+{
+    const char *name;
+    /* Runs fn over the frame into out, returns the bytes of output */
+    int (*run)( const struct kernel *k, simd_fn fn, struct frame *f,
+                uint8_t *out );
+    /* Sets up out before a run (if the run reads it) */
+    void (*prepare)( const struct kernel *k, struct frame *f, uint8_t *out );
+    enum unit unit;
+    int plane;                  /* 0 full, 1 2*2, 2 4*4 sub-sampled;
+                                   fdct 0 / idct 1 input */
+    int h;                      /* Block height */
+    int bytes;                  /* Bytes read per call (per pel for
+                                   PER_FRAME) */
+    int inexact;                /* Levels (bits) whose versions are
+                                   not bit-exact ... */
+    int peak_error;             /* ... and their allowed peak error */
+};
+
+static uint32_t randx = 1;
+
+static int bench_rand( int n )
+{
+    randx = randx * 1103515245 + 12345;
+    return (int)((randx >> 8) % (uint32_t)n);
+}
+
+/*
+ * The routines that take a macroblock (or sub-sampled macroblock) and
+ * a (forward / backward) motion compensated reference block.
+ */
+
+static int plane_stride( struct frame *f, int plane )
+{
+    return f->width >> plane;
+}
+
+static uint8_t *plane_base( struct frame *f, uint8_t *lum, int plane )
+{
+    int wh = f->width * f->height;
+    if( plane == 0 )
+        return lum;
+    else if( plane == 1 )
+        return lum + wh;
+    else
+        return lum + wh + wh/4;
+}
+
+static uint8_t *cur_block( struct frame *f, int plane, int mb )
+{
+    return plane_base( f, f->cur, plane )
+        + (f->mby[mb] >> plane) * plane_stride( f, plane )
+        + (f->mbx[mb] >> plane);
+}
+
+/* Reference block at the integer part of vector mv of mb, its half
+   pel flags in *hx, *hy */
+
+static uint8_t *ref_block( struct frame *f, int plane, int mb, int *mv,
+                           int *hx, int *hy )
+{
+    int x = f->mbx[mb] + (mv[2*mb] >> 1);
+    int y = f->mby[mb] + (mv[2*mb+1] >> 1);
+    if( hx != NULL )
+    {
+        *hx = mv[2*mb] & 1;
+        *hy = mv[2*mb+1] & 1;
+    }
+    return plane_base( f, f->ref, plane )
+        + (y >> plane) * plane_stride( f, plane ) + (x >> plane);
+}
+
+static int run_sad_00( const struct kernel *k, simd_fn fn, struct frame *f,
+                       uint8_t *out )
+{
+    int (*sad)( uint8_t *, uint8_t *, int, int, int ) =
+        (int (*)( uint8_t *, uint8_t *, int, int, int ))fn;
+    int32_t *res = (int32_t *)out;
+    int stride = plane_stride( f, k->plane );
+    int mb;
+    for( mb = 0; mb < f->mbs; ++mb )
+        res[mb] = sad( ref_block( f, k->plane, mb, f->fmv, NULL, NULL ),
+                       cur_block( f, k->plane, mb ), stride, k->h, INT_MAX );
+    return f->mbs * sizeof(int32_t);
+}
+
+/* sad_01, sad_10, sad_11, sad_sub22, sad_sub44 and sumsq_sub22 */
+
+static int run_diff( const struct kernel *k, simd_fn fn, struct frame *f,
+                     uint8_t *out )
+{
+    int (*diff)( uint8_t *, uint8_t *, int, int ) =
+        (int (*)( uint8_t *, uint8_t *, int, int ))fn;
+    int32_t *res = (int32_t *)out;
+    int stride = plane_stride( f, k->plane );
+    int mb;
+    for( mb = 0; mb < f->mbs; ++mb )
+        res[mb] = diff( ref_block( f, k->plane, mb, f->fmv, NULL, NULL ),
+                        cur_block( f, k->plane, mb ), stride, k->h );
+    return f->mbs * sizeof(int32_t);
+}
+
+static int run_sumsq( const struct kernel *k, simd_fn fn, struct frame *f,
+                      uint8_t *out )
+{
+    int (*sumsq)( uint8_t *, uint8_t *, int, int, int, int ) =
+        (int (*)( uint8_t *, uint8_t *, int, int, int, int ))fn;
+    int32_t *res = (int32_t *)out;
+    int mb, hx, hy;
+    uint8_t *blk;
+    for( mb = 0; mb < f->mbs; ++mb )
+    {
+        blk = ref_block( f, 0, mb, f->fmv, &hx, &hy );
+        res[mb] = sumsq( blk, cur_block( f, 0, mb ), f->width, hx, hy, k->h );
+    }
+    return f->mbs * sizeof(int32_t);
+}
+
+/* bsad and bsumsq */
+
+static int run_bidir( const struct kernel *k, simd_fn fn, struct frame *f,
+                      uint8_t *out )
+{
+    int (*bdiff)( uint8_t *, uint8_t *, uint8_t *, int,
+                  int, int, int, int, int ) =
+        (int (*)( uint8_t *, uint8_t *, uint8_t *, int,
+                  int, int, int, int, int ))fn;
+    int32_t *res = (int32_t *)out;
+    int mb, hxf, hyf, hxb, hyb;
+    uint8_t *pf, *pb;
+    for( mb = 0; mb < f->mbs; ++mb )
+    {
+        pf = ref_block( f, 0, mb, f->fmv, &hxf, &hyf );
+        pb = ref_block( f, 0, mb, f->bmv, &hxb, &hyb );
+        res[mb] = bdiff( pf, pb, cur_block( f, 0, mb ), f->width,
+                         hxf, hyf, hxb, hyb, k->h );
+    }
+    return f->mbs * sizeof(int32_t);
+}
+
+static int run_bsumsq_sub22( const struct kernel *k, simd_fn fn,
+                             struct frame *f, uint8_t *out )
+{
+    int (*bsumsq)( uint8_t *, uint8_t *, uint8_t *, int, int ) =
+        (int (*)( uint8_t *, uint8_t *, uint8_t *, int, int ))fn;
+    int32_t *res = (int32_t *)out;
+    int stride = plane_stride( f, k->plane );
+    int mb;
+    for( mb = 0; mb < f->mbs; ++mb )
+        res[mb] = bsumsq( ref_block( f, k->plane, mb, f->fmv, NULL, NULL ),
+                          ref_block( f, k->plane, mb, f->bmv, NULL, NULL ),
+                          cur_block( f, k->plane, mb ), stride, k->h );
+    return f->mbs * sizeof(int32_t);
+}
+
+static int run_variance( const struct kernel *k, simd_fn fn, struct frame *f,
+                         uint8_t *out )
+{
+    void (*variance)( uint8_t *, int, int, uint32_t *, uint32_t * ) =
+        (void (*)( uint8_t *, int, int, uint32_t *, uint32_t * ))fn;
+    uint32_t *res = (uint32_t *)out;
+    int mb;
+    for( mb = 0; mb < f->mbs; ++mb )
+        variance( cur_block( f, 0, mb ), k->h, f->width,
+                  &res[2*mb], &res[2*mb+1] );
+    return 2 * f->mbs * sizeof(uint32_t);
+}
+
+/* subsample_image writes the sub-sampled planes after the image:
+   the image is copied to out first. */
+
+static void prepare_subsample( const struct kernel *k, struct frame *f,
+                               uint8_t *out )
+{
+    memcpy( out, f->cur, f->width * f->height );
+}
+
+static int run_subsample( const struct kernel *k, simd_fn fn, struct frame *f,
+                          uint8_t *out )
+{
+    void (*subsample)( uint8_t *, int, uint8_t *, uint8_t * ) =
+        (void (*)( uint8_t *, int, uint8_t *, uint8_t * ))fn;
+    int wh = f->width * f->height;
+    subsample( out, f->width, out + wh, out + wh + wh/4 );
+    return wh + wh/4 + wh/16;
+}
+
+/* The transforms work in place on a copy of their input.  Repeated
+   (timing) runs transform their own output: the integer routines'
+   time does not depend on the data. */
+
+static void prepare_dct( const struct kernel *k, struct frame *f,
+                         uint8_t *out )
+{
+    memcpy( out, k->plane == 0 ? f->resid : f->coeffs,
+            f->blocks * 64 * sizeof(int16_t) );
+}
+
+static int run_dct( const struct kernel *k, simd_fn fn, struct frame *f,
+                    uint8_t *out )
+{
+    void (*dct)( int16_t * ) = (void (*)( int16_t * ))fn;
+    int16_t *blks = (int16_t *)out;
+    int b;
+    for( b = 0; b < f->blocks; ++b )
+        dct( blks + 64*b );
+    return f->blocks * 64 * sizeof(int16_t);
+}
+
+static int run_dct_blocks( const struct kernel *k, simd_fn fn,
+                           struct frame *f, uint8_t *out )
+{
+    void (*dct)( int16_t *, int ) = (void (*)( int16_t *, int ))fn;
+    int16_t *blks = (int16_t *)out;
+    int b;
+    for( b = 0; b < f->blocks; b += BLOCKS_PER_CALL )
+        dct( blks + 64*b, BLOCKS_PER_CALL );
+    return f->blocks * 64 * sizeof(int16_t);
+}
+
+/* The C fdct_blocks / idct_blocks: the single block routine per block */
+
+static void fdct_blocks_c( int16_t *blks, int count )
+{
+    int i;
+    for( i = 0; i < count; ++i )
+        fdct( blks + 64*i );
+}
+
+static void idct_blocks_c( int16_t *blks, int count )
+{
+    int i;
+    for( i = 0; i < count; ++i )
+        idct( blks + 64*i );
+}
+
+/* pred_comp predicts each macroblock into out, averaging with what is
+   already there (bi-directional prediction) for some: out starts as a
+   copy of the current picture */
+
+static void prepare_pred( const struct kernel *k, struct frame *f,
+                          uint8_t *out )
+{
+    memcpy( out, f->cur, f->width * f->height );
+}
+
+static int run_pred_comp( const struct kernel *k, simd_fn fn, struct frame *f,
+                          uint8_t *out )
+{
+    void (*pred)( uint8_t *, uint8_t *, int, int, int, int, int, int, int,
+                  int ) =
+        (void (*)( uint8_t *, uint8_t *, int, int, int, int, int, int, int,
+                   int ))fn;
+    int mb;
+    for( mb = 0; mb < f->mbs; ++mb )
+        pred( f->ref, out, f->width, 16, k->h, f->mbx[mb], f->mby[mb],
+              f->fmv[2*mb], f->fmv[2*mb+1], f->addflag[mb] );
+    return f->width * f->height;
+}
+
+#define MMX_INEXACT (1<<LEVEL_MMX)
+#define DCT_INEXACT ((1<<LEVEL_MMX) | (1<<LEVEL_SSE))
+
+enum kernel_id
+{
+    K_SAD_00, K_SAD_01, K_SAD_10, K_SAD_11, K_SAD_SUB22, K_SAD_SUB44,
+    K_BSAD, K_SUMSQ, K_SUMSQ_SUB22, K_BSUMSQ, K_BSUMSQ_SUB22, K_VARIANCE,
+    K_SUBSAMPLE_IMAGE, K_FDCT, K_IDCT, K_FDCT_BLOCKS,
+    K_IDCT_BLOCKS, K_PRED_COMP, KERNELS
+};
+
+static const struct kernel kernels[KERNELS] =
+{
+    { "sad_00", run_sad_00, NULL, PER_MB, 0, 16, 2*256, 0, 0 },
+    { "sad_01", run_diff, NULL, PER_MB, 0, 16, 2*256,
+      MMX_INEXACT, SAD_PEAK_ERROR },
+    { "sad_10", run_diff, NULL, PER_MB, 0, 16, 2*256,
+      MMX_INEXACT, SAD_PEAK_ERROR },
+    { "sad_11", run_diff, NULL, PER_MB, 0, 16, 2*256,
+      MMX_INEXACT, SAD_PEAK_ERROR },
+    { "sad_sub22", run_diff, NULL, PER_MB, 1, 8, 2*64, 0, 0 },
+    { "sad_sub44", run_diff, NULL, PER_MB, 2, 4, 2*16, 0, 0 },
+    { "bsad", run_bidir, NULL, PER_MB, 0, 16, 3*256, 0, 0 },
+    { "sumsq", run_sumsq, NULL, PER_MB, 0, 16, 2*256, 0, 0 },
+    { "sumsq_sub22", run_diff, NULL, PER_MB, 1, 8, 2*64, 0, 0 },
+    { "bsumsq", run_bidir, NULL, PER_MB, 0, 16, 3*256, 0, 0 },
+    { "bsumsq_sub22", run_bsumsq_sub22, NULL, PER_MB, 1, 8, 3*64, 0, 0 },
+    { "variance", run_variance, NULL, PER_MB, 0, 16, 256, 0, 0 },
+    { "subsample_image", run_subsample, prepare_subsample, PER_FRAME,
+      0, 0, 1, 0, 0 },
+    { "fdct", run_dct, prepare_dct, PER_BLOCK, 0, 0, 128,
+      DCT_INEXACT, DCT_PEAK_ERROR },
+    { "idct", run_dct, prepare_dct, PER_BLOCK, 1, 0, 128,
+      DCT_INEXACT, DCT_PEAK_ERROR },
+    { "fdct_blocks", run_dct_blocks, prepare_dct, PER_BLOCKS, 0, 0,
+      128*BLOCKS_PER_CALL, 0, 0 },
+    { "idct_blocks", run_dct_blocks, prepare_dct, PER_BLOCKS, 1, 0,
+      128*BLOCKS_PER_CALL, 0, 0 },
+    { "pred_comp", run_pred_comp, prepare_pred, PER_MB, 0, 16, 2*256, 0, 0 }
+};
+
+static int calls_per_run( const struct kernel *k, struct frame *f )
+{
+    switch( k->unit )
+    {
+    case PER_MB : return f->mbs;
+    case PER_BLOCK : return f->blocks;
+    case PER_BLOCKS : return f->blocks / BLOCKS_PER_CALL;
+    default : return 1;
+    }
+}
+
+static double bytes_per_call( const struct kernel *k, struct frame *f )
+{
+    return k->unit == PER_FRAME
+        ? (double)k->bytes * f->width * f->height
+        : (double)k->bytes;
+}
+
+/*
+ * The versions of each kernel each level selects.  The motion routines
+ * are selected by enable_mmxsse_motion and pred_comp by
+ * init_x86_predict with the CPU's flags masked to the level.  The
+ * transforms are picked as init_x86_transform does.
+ */
+
+static simd_fn impls[LEVELS][KERNELS];
+
+static void set_simd_disable( const char *value, char **saved )
+{
+    const char *env = getenv( "MJPEGTOOLS_SIMD_DISABLE" );
+    *saved = env ? strdup( env ) : NULL;
+    setenv( "MJPEGTOOLS_SIMD_DISABLE", value, 1 );
+}
+
+static void restore_simd_disable( char *saved )
+{
+    if( saved )
+    {
+        setenv( "MJPEGTOOLS_SIMD_DISABLE", saved, 1 );
+        free( saved );
+    }
+    else
+        unsetenv( "MJPEGTOOLS_SIMD_DISABLE" );
+}
+
+static void get_motion_impls( simd_fn *impl )
+{
+    impl[K_SAD_00] = (simd_fn)psad_00;
+    impl[K_SAD_01] = (simd_fn)psad_01;
+    impl[K_SAD_10] = (simd_fn)psad_10;
+    impl[K_SAD_11] = (simd_fn)psad_11;
+    impl[K_SAD_SUB22] = (simd_fn)psad_sub22;
+    impl[K_SAD_SUB44] = (simd_fn)psad_sub44;
+    impl[K_BSAD] = (simd_fn)pbsad;
+    impl[K_SUMSQ] = (simd_fn)psumsq;
+    impl[K_SUMSQ_SUB22] = (simd_fn)psumsq_sub22;
+    impl[K_BSUMSQ] = (simd_fn)pbsumsq;
+    impl[K_BSUMSQ_SUB22] = (simd_fn)pbsumsq_sub22;
+    impl[K_VARIANCE] = (simd_fn)pvariance;
+    impl[K_SUBSAMPLE_IMAGE] = (simd_fn)psubsample_image;
+    impl[K_PRED_COMP] = (simd_fn)ppred_comp;
+}
+
+/* Back to the C versions of the motion routines and pred_comp */
+
+static void reset_c_impls( void )
+{
+    char *saved;
+    set_simd_disable( "all", &saved );
+    init_motion_search();
+    restore_simd_disable( saved );
+    ppred_comp = pred_comp;
+}
+
+static void select_c_impls( void )
+{
+    reset_c_impls();
+    get_motion_impls( impls[LEVEL_C] );
+    impls[LEVEL_C][K_FDCT] = (simd_fn)fdct;
+    impls[LEVEL_C][K_IDCT] = (simd_fn)idct;
+    impls[LEVEL_C][K_FDCT_BLOCKS] = (simd_fn)fdct_blocks_c;
+    impls[LEVEL_C][K_IDCT_BLOCKS] = (simd_fn)idct_blocks_c;
+}
+
+#if defined(HAVE_ASM_MMX)
+static void select_level_impls( int l, int flags )
+{
+    simd_fn *impl = impls[l];
+    int kn;
+
+    /* Motion and prediction: from the C versions with the flags up to
+       this level */
+    reset_c_impls();
+    enable_mmxsse_motion( flags );
+    init_x86_predict( flags );
+    get_motion_impls( impl );
+
+    /* Transforms: as the level below unless the level adds a version */
+    for( kn = K_FDCT; kn <= K_IDCT_BLOCKS; ++kn )
+        impl[kn] = impls[l-1][kn];
+    switch( l )
+    {
+    case LEVEL_MMX :
+        impl[K_FDCT] = (simd_fn)fdct_mmx;
+        impl[K_IDCT] = (simd_fn)idct_mmx;
+        break;
+    case LEVEL_SSE :
+        impl[K_FDCT] = (simd_fn)fdct_sse;
+        impl[K_IDCT] = (simd_fn)idct_sse;
+        break;
+#ifdef HAVE_DCT_SSE2
+    case LEVEL_SSE2 :
+        impl[K_FDCT] = (simd_fn)fdct_sse2;
+        impl[K_IDCT] = (simd_fn)idct_sse2;
+        impl[K_FDCT_BLOCKS] = (simd_fn)fdct_blocks_sse2;
+        impl[K_IDCT_BLOCKS] = (simd_fn)idct_blocks_sse2;
+        break;
+    case LEVEL_AVX2 :
+        impl[K_FDCT_BLOCKS] = (simd_fn)fdct_blocks_avx2;
+        impl[K_IDCT_BLOCKS] = (simd_fn)idct_blocks_avx2;
+        break;
+#endif
+    default :
+        break;
+    }
+}
+#endif
+
+/* Returns the number of levels the CPU supports */
+
+static int select_impls( void )
+{
+    int levels = 1;
+
+    /* The selection's own logging is just noise here */
+    mjpeg_default_handler_verbosity( 0 );
+    init_fdct();
+    init_idct();
+    select_c_impls();
+#if defined(HAVE_ASM_MMX)
+    {
+        int cpu = cpu_accel();
+        int flags = 0;
+        init_fdct_sse();
+#ifdef HAVE_DCT_SSE2
+        init_dct_sse2();
+#endif
+        for( levels = 1; levels < LEVELS; ++levels )
+        {
+            if( (cpu & level_flags[levels] & ~ACCEL_X86_SSE41) == 0 )
+                break;
+            flags |= cpu & level_flags[levels];
+            select_level_impls( levels, flags );
+        }
+    }
+#endif
+    mjpeg_default_handler_verbosity( 1 );
+    return levels;
+}
+
+/* Whether level l adds a version of kernel kn of its own */
+
+static int provided( int l, int kn )
+{
+    int below;
+    for( below = 0; below < l; ++below )
+        if( impls[below][kn] == impls[l][kn] )
+            return 0;
+    return 1;
+}
+
+/*
+ * Synthetic pictures: smooth gradients with some texture and noise,
+ * the reference a displaced noisy copy of the current.  The motion
+ * vectors are random within the search radius, clipped so the
+ * (half-pel) reference block lies in the picture.
+ */
+
+static int clip_mv( int mv, int pos, int size )
+{
+    int lo = -2*pos, hi = 2*(size - 17 - pos);
+    return mv < lo ? lo : mv > hi ? hi : mv;
+}
+
+static void make_frame( struct frame *f, const char *name,
+                        int width, int height )
+{
+    int wh = width * height;
+    int lum_size = wh + wh/4 + wh/16;
+    int x, y, mb, b, i, j;
+    uint8_t *c, *r;
+
+    f->name = name;
+    f->width = width;
+    f->height = height;
+    f->cur = (uint8_t *)malloc( lum_size );
+    f->ref = (uint8_t *)malloc( lum_size );
+    for( y = 0; y < height; ++y )
+        for( x = 0; x < width; ++x )
+        {
+            int v = (x + 2*y) / 8 + ((x ^ y) & 0x1f) + bench_rand( 16 );
+            f->cur[y*width+x] = 64 + v % 128;
+        }
+    for( y = 0; y < height; ++y )
+        for( x = 0; x < width; ++x )
+        {
+            int sx = x + 3 < width ? x + 3 : x;
+            int sy = y + 2 < height ? y + 2 : y;
+            f->ref[y*width+x] = f->cur[sy*width+sx] + bench_rand( 9 ) - 4;
+        }
+    (*psubsample_image)( f->cur, width, f->cur + wh, f->cur + wh + wh/4 );
+    (*psubsample_image)( f->ref, width, f->ref + wh, f->ref + wh + wh/4 );
+
+    f->mbs = (width/16) * (height/16);
+    f->mbx = (int *)malloc( f->mbs * sizeof(int) );
+    f->mby = (int *)malloc( f->mbs * sizeof(int) );
+    f->fmv = (int *)malloc( 2 * f->mbs * sizeof(int) );
+    f->bmv = (int *)malloc( 2 * f->mbs * sizeof(int) );
+    f->addflag = (int *)malloc( f->mbs * sizeof(int) );
+    for( mb = 0; mb < f->mbs; ++mb )
+    {
+        f->mbx[mb] = 16 * (mb % (width/16));
+        f->mby[mb] = 16 * (mb / (width/16));
+        f->fmv[2*mb] = clip_mv( bench_rand( 4*SEARCH_RADIUS+1 ) - 2*SEARCH_RADIUS,
+                                f->mbx[mb], width );
+        f->fmv[2*mb+1] = clip_mv( bench_rand( 4*SEARCH_RADIUS+1 ) - 2*SEARCH_RADIUS,
+                                  f->mby[mb], height );
+        f->bmv[2*mb] = clip_mv( bench_rand( 4*SEARCH_RADIUS+1 ) - 2*SEARCH_RADIUS,
+                                f->mbx[mb], width );
+        f->bmv[2*mb+1] = clip_mv( bench_rand( 4*SEARCH_RADIUS+1 ) - 2*SEARCH_RADIUS,
+                                  f->mby[mb], height );
+        f->addflag[mb] = bench_rand( 2 );
+    }
+
+    /* The luminance prediction errors of the (integer part) forward
+       prediction, BLOCKS_PER_CALL to a macroblock */
+    f->blocks = f->mbs * BLOCKS_PER_CALL;
+    f->resid = (int16_t *)malloc( f->blocks * 64 * sizeof(int16_t) );
+    f->coeffs = (int16_t *)malloc( f->blocks * 64 * sizeof(int16_t) );
+    for( b = 0; b < f->blocks; ++b )
+    {
+        mb = b / BLOCKS_PER_CALL;
+        c = cur_block( f, 0, mb ) + 8*(b&1) + 8*((b>>1)&1)*width;
+        r = ref_block( f, 0, mb, f->fmv, NULL, NULL )
+            + 8*(b&1) + 8*((b>>1)&1)*width;
+        for( j = 0; j < 8; ++j )
+            for( i = 0; i < 8; ++i )
+                f->resid[64*b+8*j+i] = c[j*width+i] - r[j*width+i];
+    }
+    memcpy( f->coeffs, f->resid, f->blocks * 64 * sizeof(int16_t) );
+    for( b = 0; b < f->blocks; ++b )
+        fdct( f->coeffs + 64*b );
+}
+
+static void free_frame( struct frame *f )
+{
+    free( f->cur );
+    free( f->ref );
+    free( f->mbx );
+    free( f->mby );
+    free( f->fmv );
+    free( f->bmv );
+    free( f->addflag );
+    free( f->resid );
+    free( f->coeffs );
+}
+
+static int run( const struct kernel *k, simd_fn fn, struct frame *f,
+                uint8_t *out )
+{
+    if( k->prepare != NULL )
+        k->prepare( k, f, out );
+    return k->run( k, fn, f, out );
+}
+
+/* Level l's version of kernel kn against the C version */
+
+static int check( int kn, int l, struct frame *f, uint8_t *ref_out,
+                  uint8_t *out )
+{
+    const struct kernel *k = &kernels[kn];
+    int len = run( k, impls[LEVEL_C][kn], f, ref_out );
+    int i, err, peak = 0, diffs = 0;
+
+    run( k, impls[l][kn], f, out );
+    if( k->inexact & (1<<l) )
+    {
+        /* Coefficients for the transforms, sums for the others */
+        if( k->unit == PER_BLOCK || k->unit == PER_BLOCKS )
+        {
+            int16_t *r = (int16_t *)ref_out, *t = (int16_t *)out;
+            for( i = 0; i < len/(int)sizeof(int16_t); ++i )
+                if( (err = abs( r[i] - t[i] )) > peak )
+                    peak = err;
+        }
+        else
+        {
+            int32_t *r = (int32_t *)ref_out, *t = (int32_t *)out;
+            for( i = 0; i < len/(int)sizeof(int32_t); ++i )
+                if( (err = abs( r[i] - t[i] )) > peak )
+                    peak = err;
+        }
+        mjpeg_info( "%s %s %s: peak error %d", f->name, k->name,
+                    level_names[l], peak );
+        if( peak <= k->peak_error )
+            return 0;
+    }
+    else
+    {
+        for( i = 0; i < len; ++i )
+            diffs += ref_out[i] != out[i];
+        if( diffs == 0 )
+            return 0;
+    }
+    mjpeg_error( "%s %s %s: results differ from the C version",
+                 f->name, k->name, level_names[l] );
+    return 1;
+}
+
+/* ns per call of level l's version of kernel kn */
+
+static double bench( int kn, int l, struct frame *f, uint8_t *out )
+{
+    const struct kernel *k = &kernels[kn];
+    struct timeval start, now;
+    long calls_made = 0, usecs;
+
+    if( k->prepare != NULL )
+        k->prepare( k, f, out );
+    gettimeofday( &start, NULL );
+    do
+    {
+        k->run( k, impls[l][kn], f, out );
+        calls_made += calls_per_run( k, f );
+        gettimeofday( &now, NULL );
+        usecs = (now.tv_sec-start.tv_sec)*1000000L + now.tv_usec-start.tv_usec;
+    } while( usecs < BENCH_USECS );
+
+    return usecs * 1000.0 / calls_made;
+}
+
+static void report( const char *heading, struct frame *f, int levels,
+                    double ns[KERNELS][LEVELS], int mb_per_sec )
+{
+    char line[256];
+    int kn, l, n;
+
+    n = snprintf( line, sizeof(line), "%-16s", heading );
+    for( l = 0; l < LEVELS; ++l )
+        n += snprintf( line+n, sizeof(line)-n, " %10s", level_names[l] );
+    mjpeg_info( "%s", line );
+    for( kn = 0; kn < KERNELS; ++kn )
+    {
+        n = snprintf( line, sizeof(line), "%-16s", kernels[kn].name );
+        for( l = 0; l < LEVELS; ++l )
+        {
+            if( l >= levels || !provided( l, kn ) )
+                n += snprintf( line+n, sizeof(line)-n, " %10s", "-" );
+            else if( mb_per_sec )
+                n += snprintf( line+n, sizeof(line)-n, " %10.0f",
+                               bytes_per_call( &kernels[kn], f )
+                               * 1000.0 / ns[kn][l] );
+            else
+                n += snprintf( line+n, sizeof(line)-n, " %10.1f", ns[kn][l] );
+        }
+        mjpeg_info( "%s", line );
+    }
+}
+
+int main( int argc, char *argv[] )
+{
+    static const struct { const char *name; int width, height; } sizes[] =
+    {
+        { "SD", 720, 576 },
+        { "HD", 1920, 1088 }
+    };
+    static double ns[KERNELS][LEVELS];
+    struct frame f;
+    uint8_t *ref_out, *out;
+    int levels, failed = 0;
+    int s, kn, l;
+    char heading[32];
+
+    mjpeg_default_handler_verbosity( 1 );
+    levels = select_impls();
+    if( levels < LEVELS )
+        mjpeg_info( "No %s: versions from that level up not checked",
+                    level_names[levels] );
+
+    for( s = 0; s < (int)(sizeof(sizes)/sizeof(sizes[0])); ++s )
+    {
+        make_frame( &f, sizes[s].name, sizes[s].width, sizes[s].height );
+        ref_out = (uint8_t *)malloc( 4 * f.width * f.height );
+        out = (uint8_t *)malloc( 4 * f.width * f.height );
+
+        for( kn = 0; kn < KERNELS; ++kn )
+            for( l = 0; l < levels; ++l )
+            {
+                if( !provided( l, kn ) )
+                    continue;
+                if( l > LEVEL_C )
+                    failed |= check( kn, l, &f, ref_out, out );
+                ns[kn][l] = bench( kn, l, &f, out );
+            }
+
+        snprintf( heading, sizeof(heading), "%s ns per call", f.name );
+        report( heading, &f, levels, ns, 0 );
+        snprintf( heading, sizeof(heading), "%s MB/sec", f.name );
+        report( heading, &f, levels, ns, 1 );
+
+        free( ref_out );
+        free( out );
+        free_frame( &f );
+    }
+
+    if( !failed )
+        mjpeg_info( "SIMD versions agree with the C versions" );
+    return failed ? 1 : 0;
+}
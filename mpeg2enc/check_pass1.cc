@@ -0,0 +1,253 @@
+/*
+ *  check_pass1.cc:  Checks the single pass (on-the-fly pass 1) rate
+ *  control codes the same bits whatever the number of threads.  A
+ *  small deterministic synthetic YUV4MPEG stream is encoded in-process
+ *  at -M 1, -M 0 and -M 2 and a checksum of the coded bits of each
+ *  compared with a reference.  The reference was taken once rate
+ *  control's feedback from the bits coded lagged the slices coded in
+ *  parallel, so any other change to the bits coded shows up too.
+ *  Run by "make check".
+ *
+ *  Global motion compensation and the SIMD routines are disabled as
+ *  neither existed when the reference checksum was taken.  With -w
+ *  the synthetic input is written to a file instead so the reference
+ *  can be re-taken with an mpeg2enc binary and the options below.
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "yuv4mpeg.h"
+#include "mpeg2enc.hh"
+
+#define WIDTH 352
+#define HEIGHT 288
+#define FRAMES 15
+
+/*
+ * Checksum (FNV-1a) and size of the MPEG-2 stream coded by
+ * mpeg2enc -f 3 -b 1500 --no-global-motion -M 1 from the synthetic
+ * input with MJPEGTOOLS_SIMD_DISABLE=all set.
+ */
+
+#define REFERENCE_BYTES 114291
+#define REFERENCE_HASH 0x306cc52adedc6712ULL
+
+static uint32_t randx = 1;
+
+static int check_rand( int n )
+{
+    randx = randx * 1103515245 + 12345;
+    return (int)((randx >> 8) % (uint32_t)n);
+}
+
+static uint8_t clip_pel( int v )
+{
+    return v < 0 ? 0 : v > 255 ? 255 : v;
+}
+
+/*
+ * Frame 'n': a textured square panning 2 pels right and 1 down a
+ * frame over a slowly brightening gradient, with noise.  Enough
+ * detail that the quantisers of a 1500kbps stream are kept busy and
+ * the feedback from the coded bits matters.
+ */
+
+static void make_frame( int n, uint8_t *planes[3] )
+{
+    int x, y;
+
+    for( y = 0; y < HEIGHT; ++y )
+    {
+        uint8_t *row = planes[0] + y * WIDTH;
+        for( x = 0; x < WIDTH; ++x )
+        {
+            int tx = x - 2*n - WIDTH/4;
+            int ty = y - n - HEIGHT/4;
+            int pel = 32 + (x + 2*y) * 96 / (WIDTH + 2*HEIGHT) + 2*n;
+            if( tx >= 0 && tx < WIDTH/2 && ty >= 0 && ty < HEIGHT/2 )
+                pel += ((tx >> 3) ^ (ty >> 3)) & 1 ? 80 : (tx*ty) % 48;
+            row[x] = clip_pel( pel + check_rand( 13 ) - 6 );
+        }
+    }
+    for( y = 0; y < HEIGHT/2; ++y )
+        for( x = 0; x < WIDTH/2; ++x )
+        {
+            planes[1][y * WIDTH/2 + x] = clip_pel( 96 + (x + n) % 64 );
+            planes[2][y * WIDTH/2 + x] = clip_pel( 160 - (y + n) % 64 );
+        }
+}
+
+static void write_stream( int fd )
+{
+    y4m_stream_info_t sinfo;
+    y4m_frame_info_t finfo;
+    std::vector<uint8_t> frame( WIDTH*HEIGHT*3/2 );
+    uint8_t *planes[3];
+    int n, err;
+
+    planes[0] = &frame[0];
+    planes[1] = planes[0] + WIDTH*HEIGHT;
+    planes[2] = planes[1] + WIDTH*HEIGHT/4;
+    y4m_init_stream_info( &sinfo );
+    y4m_init_frame_info( &finfo );
+    y4m_si_set_width( &sinfo, WIDTH );
+    y4m_si_set_height( &sinfo, HEIGHT );
+    y4m_si_set_sampleaspect( &sinfo, y4m_sar_PAL_CCIR601 );
+    y4m_si_set_interlace( &sinfo, Y4M_ILACE_NONE );
+    y4m_si_set_framerate( &sinfo, y4m_fps_PAL );
+    y4m_si_set_chroma( &sinfo, Y4M_CHROMA_420JPEG );
+    if( (err = y4m_write_stream_header( fd, &sinfo )) != Y4M_OK )
+        mjpeg_error_exit1( "Write header failed: %s", y4m_strerr(err) );
+    randx = 1;
+    for( n = 0; n < FRAMES; ++n )
+    {
+        make_frame( n, planes );
+        if( (err = y4m_write_frame( fd, &sinfo, &finfo, planes )) != Y4M_OK )
+            mjpeg_error_exit1( "Write frame failed: %s", y4m_strerr(err) );
+    }
+    y4m_fini_stream_info( &sinfo );
+    y4m_fini_frame_info( &finfo );
+}
+
+/* The synthetic input and coded output, removed however we exit */
+
+static char input[] = "/tmp/check_pass1XXXXXX";
+static char output[] = "/tmp/check_pass1XXXXXX";
+
+static void remove_files()
+{
+    unlink( input );
+    unlink( output );
+}
+
+struct Coded
+{
+    uint64_t bytes;
+    uint64_t hash;
+};
+
+static Coded encode( const char *threads )
+{
+    const char *args[] =
+        { "check_pass1", "-f", "3", "-b", "1500", "-v", "0",
+          "--no-global-motion", "-M", threads, "-o", output, input };
+    int argc = sizeof(args)/sizeof(args[0]);
+    std::vector<char *> argv;
+    int i;
+
+    for( i = 0; i < argc; ++i )
+        argv.push_back( const_cast<char *>(args[i]) );
+    argv.push_back( 0 );
+
+    MPEG2EncCmdLineOptions options;
+    optind = 0;                 // Full re-initialisation of getopt
+    if( options.SetFromCmdLine( argc, &argv[0] ) != 0 )
+        mjpeg_error_exit1( "Bad mpeg2enc options" );
+    mjpeg_default_handler_verbosity( 0 );
+    {
+        YUV4MPEGEncoder encoder( options );
+        encoder.Encode();
+    }
+    close( options.istrm_fd );
+
+    Coded coded = { 0, 0xcbf29ce484222325ULL };
+    FILE *f = fopen( output, "rb" );
+    if( f == 0 )
+        mjpeg_error_exit1( "Couldn't read back %s", output );
+    int c;
+    while( (c = getc( f )) != EOF )
+    {
+        coded.hash = (coded.hash ^ (uint8_t)c) * 0x100000001b3ULL;
+        ++coded.bytes;
+    }
+    fclose( f );
+    return coded;
+}
+
+int main( int argc, char *argv[] )
+{
+    const char *writename = 0;
+    int fd, n;
+
+    while( (n = getopt( argc, argv, "w:" )) != -1 )
+    {
+        switch( n )
+        {
+        case 'w' : writename = optarg; break;
+        default :
+            fprintf( stderr, "Usage: %s [-w input.y4m]\n", argv[0] );
+            return 1;
+        }
+    }
+    if( writename != 0 )
+    {
+        if( (fd = open( writename, O_WRONLY|O_CREAT|O_TRUNC, 0644 )) < 0 )
+            mjpeg_error_exit1( "Couldn't create %s", writename );
+        write_stream( fd );
+        close( fd );
+        return 0;
+    }
+
+    setenv( "MJPEGTOOLS_SIMD_DISABLE", "all", 1 );
+    if( (fd = mkstemp( input )) < 0 )
+        mjpeg_error_exit1( "Couldn't create temporary input file" );
+    atexit( remove_files );
+    write_stream( fd );
+    close( fd );
+    if( (fd = mkstemp( output )) < 0 )
+        mjpeg_error_exit1( "Couldn't create temporary output file" );
+    close( fd );
+
+    int failures = 0;
+    static const char *threads[] = { "1", "0", "2" };
+    Coded ref = { REFERENCE_BYTES, REFERENCE_HASH };
+    for( unsigned int i = 0; i < sizeof(threads)/sizeof(threads[0]); ++i )
+    {
+        Coded coded = encode( threads[i] );
+        bool ok = coded.bytes == ref.bytes && coded.hash == ref.hash;
+        printf( "-M %s: %llu bytes, checksum %016llx %s\n", threads[i],
+                (unsigned long long)coded.bytes,
+                (unsigned long long)coded.hash,
+                ok ? "OK" : "DIFFERS" );
+        if( !ok )
+            ++failures;
+    }
+    if( failures > 0 )
+        printf( "Expected %llu bytes, checksum %016llx\n",
+                (unsigned long long)ref.bytes,
+                (unsigned long long)ref.hash );
+    return failures > 0 ? 1 : 0;
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
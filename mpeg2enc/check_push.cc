@@ -0,0 +1,163 @@
+/*
+ *  check_push.cc:  Checks MPEG2PushEncoder reports unusable options
+ *  by a false Ok() rather than ending the process, and that encoders
+ *  that aren't Ok() refuse frames and can safely be destroyed.
+ *  Options are rejected at each stage: out of range, unusable with
+ *  the stream's format, unhandled by the push interface and by
+ *  EncoderParams::Init.  A usable encoder must then still code a
+ *  short stream.  Run by "make check".
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <vector>
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "yuv4mpeg.h"
+#include "mpegconsts.h"
+#include "format_codes.h"
+#include "pushencoder.hh"
+
+#define WIDTH 176
+#define HEIGHT 144
+#define FRAMES 6
+
+static std::vector<uint8_t> frame( WIDTH*HEIGHT*3/2, 128 );
+static const int strides[3] = { WIDTH, WIDTH/2, WIDTH/2 };
+
+static void frame_planes( const uint8_t *planes[3] )
+{
+    planes[0] = &frame[0];
+    planes[1] = planes[0] + WIDTH*HEIGHT;
+    planes[2] = planes[1] + WIDTH*HEIGHT/4;
+}
+
+static MPEG2EncInVidParams stream_params()
+{
+    MPEG2EncInVidParams strm;
+
+    strm.horizontal_size = WIDTH;
+    strm.vertical_size = HEIGHT;
+    strm.frame_rate_code = mpeg_framerate_code( y4m_fps_PAL );
+    strm.interlacing_code = Y4M_ILACE_NONE;
+    strm.aspect_ratio_code = 2;
+    return strm;
+}
+
+/*
+ * RETURN: true iff an encoder with options is rejected: not Ok(),
+ * refusing frames and the end of stream and with nothing to pull.
+ */
+
+static bool rejected( const char *what, MPEG2EncOptions &options )
+{
+    const uint8_t *planes[3];
+    std::vector<uint8_t> packet;
+    bool ok;
+
+    frame_planes( planes );
+    {
+        MPEG2PushEncoder encoder( options, stream_params() );
+        ok = !encoder.Ok()
+            && !encoder.PushFrame( planes, strides )
+            && !encoder.EndOfStream()
+            && !encoder.PullPacket( packet );
+    }
+    printf( "%s: %s\n", what, ok ? "rejected" : "NOT REJECTED" );
+    return ok;
+}
+
+/*
+ * RETURN: bytes coded by an encoder with usable options
+ */
+
+static size_t encode( MPEG2EncOptions &options )
+{
+    const uint8_t *planes[3];
+    std::vector<uint8_t> packet;
+    size_t bytes = 0;
+
+    frame_planes( planes );
+    MPEG2PushEncoder encoder( options, stream_params() );
+    if( !encoder.Ok() )
+        return 0;
+    for( int n = 0; n < FRAMES; ++n )
+        if( !encoder.PushFrame( planes, strides ) )
+            return 0;
+    if( !encoder.EndOfStream() )
+        return 0;
+    while( encoder.PullPacket( packet ) )
+        bytes += packet.size();
+    return bytes;
+}
+
+int main( int argc, char *argv[] )
+{
+    int failures = 0;
+
+    mjpeg_default_handler_verbosity( 0 );
+    {
+        MPEG2EncOptions options;
+        options.searchrad = 48;
+        failures += !rejected( "Search radius out of range", options );
+    }
+    {
+        MPEG2EncOptions options;
+        options.format = MPEG_FORMAT_SVCD;
+        options.aspect_ratio = 1;
+        failures += !rejected( "Aspect ratio unusable for SVCD", options );
+    }
+    {
+        MPEG2EncOptions options;
+        options.rate_control = 1;
+        failures += !rejected( "Two-pass rate control", options );
+    }
+    {
+        MPEG2EncOptions options;
+        options.format = MPEG_FORMAT_MPEG2;
+        failures += !rejected( "Generic MPEG-2 without a bit-rate", options );
+    }
+    {
+        MPEG2EncOptions options;
+        options.hf_quant = 6;
+        options.hf_q_boost = 2.0;
+        for( int i = 0; i < 64; ++i )
+        {
+            options.custom_intra_quantizer_matrix[i] = 200;
+            options.custom_nonintra_quantizer_matrix[i] = 200;
+        }
+        failures += !rejected( "Quantisation matrix boosted too far", options );
+    }
+
+    MPEG2EncOptions options;
+    size_t bytes = encode( options );
+    printf( "Usable options: %lu bytes coded\n", (unsigned long)bytes );
+    if( bytes == 0 )
+        ++failures;
+    return failures > 0 ? 1 : 0;
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,406 @@
+/*  chunkencoder.cc - GOP-parallel encoding of a stream split into
+ *  chunks starting with closed GOPs.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+#include <limits.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include "mjpeg_logging.h"
+#include "encoderparams.hh"
+#include "imageplanes.hh"
+#include "picturereader.hh"
+#include "elemstrmwriter.hh"
+#include "quantize.hh"
+#include "ontheflyratectlpass1.hh"
+#include "ontheflyratectlpass2.hh"
+#include "seqencoder.hh"
+#include "instrumentation.hh"
+#include "chunkencoder.hh"
+
+
+/**************************
+ *
+ * PictureReader for the frames of a single chunk.  Frames are copied
+ * from the shared input reader of the ChunkEncoder.  End of stream
+ * is signalled at the end of the chunk.
+ *
+ *************************/
+
+class ChunkPictureReader : public PictureReader
+{
+public:
+    ChunkPictureReader( EncoderParams &encparams,
+                        ChunkEncoder &_chunkencoder,
+                        int _first_frame ) :
+        PictureReader( encparams ),
+        chunkencoder( _chunkencoder ),
+        first_frame( _first_frame )
+        {
+            // The stream's own reader records the frames' reading:
+            // here they're merely copied.
+            instrumentation = 0;
+        }
+
+    void StreamPictureParams( MPEG2EncInVidParams &strm )
+        {
+            mjpeg_error_exit1( "INTERNAL: chunk readers have no stream header" );
+        }
+protected:
+    bool LoadFrame( ImagePlanes &image )
+        {
+            if( frames_read >= encparams.chunk_frames )
+                return true;
+            return !chunkencoder.CopyFrame( first_frame+frames_read, image );
+        }
+private:
+    ChunkEncoder &chunkencoder;
+    int first_frame;
+};
+
+/**************************
+ *
+ * A chunk's coded output, held until it is its turn to be written
+ * out, and what is needed to carry on the stream's state across it.
+ *
+ *************************/
+
+struct CodedChunk
+{
+    std::vector<uint8_t> bytes;
+    std::vector<uint32_t> picture_bytes;    // Size of each coded picture
+    SNRTotals snr;                          // If encparams.snr_totals
+};
+
+/**************************
+ *
+ * ElemStrmWriter that simply accumulates a chunk's coded output in
+ * memory.  Each buffer written holds one coded picture.
+ *
+ *************************/
+
+class ChunkStrmWriter : public ElemStrmWriter
+{
+public:
+    ChunkStrmWriter( CodedChunk &_coded ) :
+        coded( _coded )
+        {}
+
+    virtual void WriteOutBufferUpto( const uint8_t *buffer, const uint32_t flush_upto )
+        {
+            coded.bytes.insert( coded.bytes.end(), buffer, buffer+flush_upto );
+            coded.picture_bytes.push_back( flush_upto );
+            flushed += flush_upto;
+        }
+
+    virtual uint64_t BitCount() { return flushed * 8LL; }
+private:
+    CodedChunk &coded;
+};
+
+
+
+ChunkEncoder::ChunkEncoder( EncoderParams &_encparams,
+                            PictureReader &_reader,
+                            ElemStrmWriter &_writer ) :
+    encparams( _encparams ),
+    reader( _reader ),
+    writer( _writer ),
+    transform_pool( _encparams ),
+    next_chunk( 0 ),
+    chunks_written( 0 ),
+    end_chunk( UINT_MAX )
+{
+    // As OnTheFlyPass2 models it
+    if( encparams.still_size > 0 )
+        per_pict_bits = encparams.still_size * 8;
+    else
+        per_pict_bits =
+            static_cast<int32_t>(encparams.fieldpic
+                                 ? encparams.bit_rate / (2*encparams.decode_frame_rate)
+                                 : encparams.bit_rate / encparams.decode_frame_rate );
+
+    pthread_mutex_init( &reader_lock, NULL );
+    pthread_mutex_init( &chunk_lock, NULL );
+    pthread_cond_init( &chunk_progress, NULL );
+}
+
+ChunkEncoder::~ChunkEncoder()
+{
+    std::map<unsigned int, CodedChunk *>::iterator i;
+    for( i = completed.begin(); i != completed.end(); ++i )
+        delete i->second;
+    pthread_cond_destroy( &chunk_progress );
+    pthread_mutex_destroy( &chunk_lock );
+    pthread_mutex_destroy( &reader_lock );
+}
+
+
+bool ChunkEncoder::FrameAvailable( int frame )
+{
+    pthread_mutex_lock( &reader_lock );
+    reader.FillBufferUpto( frame );
+    bool available = frame < reader.NumberOfFrames();
+    pthread_mutex_unlock( &reader_lock );
+    return available;
+}
+
+/*
+ * Copy an input frame into a chunk's own frame buffer.  Frames are
+ * only released by the input reader once their chunk is written out
+ * as it may yet have to be coded again.
+ *
+ * RETURN: false iff frame lies beyond the end of the input
+ */
+
+bool ChunkEncoder::CopyFrame( int frame, ImagePlanes &image )
+{
+    pthread_mutex_lock( &reader_lock );
+    reader.FillBufferUpto( frame );
+    if( frame >= reader.NumberOfFrames() )
+    {
+        pthread_mutex_unlock( &reader_lock );
+        return false;
+    }
+
+    // N.b. the sub-sampled luminance is recomputed by the chunk's reader
+    ImagePlanes *src = reader.ReadFrame( frame );
+    memcpy( image.Plane(0), src->Plane(0), encparams.fsubsample_offset );
+    memcpy( image.Plane(1), src->Plane(1), encparams.chrom_buffer_size );
+    memcpy( image.Plane(2), src->Plane(2), encparams.chrom_buffer_size );
+    pthread_mutex_unlock( &reader_lock );
+    return true;
+}
+
+
+/*
+ * Encode a chunk as a self-contained sequence on a private
+ * SeqEncoder, starting with the decoder buffer buffer_variation bits
+ * short of full.
+ *
+ * RETURN: false iff chunk lies beyond the end of the input.
+ */
+
+bool ChunkEncoder::EncodeChunk( unsigned int chunk, CodedChunk &coded,
+                                int32_t buffer_variation )
+{
+    int first_frame = chunk * encparams.chunk_frames;
+    if( !FrameAvailable( first_frame ) )
+        return false;
+
+    // Each chunk needs its own copy of the parameters: the stream state
+    // consumes chapter points (which must be made chunk-relative) as
+    // it goes.  Parallelism comes from encoding chunks concurrently so
+    // chunks are encoded single-threaded.
+    EncoderParams chunk_parms( encparams );
+    chunk_parms.encoding_parallelism = 0;
+    chunk_parms.read_ahead_frames = 0;
+    chunk_parms.stream_frame_offset = first_frame;
+    if( encparams.snr_totals != 0 )
+        chunk_parms.snr_totals = &coded.snr;
+    chunk_parms.chapter_points.clear();
+    deque<int>::const_iterator cp;
+    for( cp = encparams.chapter_points.begin(); cp != encparams.chapter_points.end(); ++cp )
+    {
+        if( *cp > first_frame && *cp < first_frame + encparams.chunk_frames )
+            chunk_parms.chapter_points.push_back( *cp - first_frame );
+    }
+
+    ChunkPictureReader chunk_reader( chunk_parms, *this, first_frame );
+    ChunkStrmWriter chunk_writer( coded );
+    Quantizer quantizer( chunk_parms );
+    OnTheFlyPass1 pass1ratectl( chunk_parms );
+    OnTheFlyPass2 pass2ratectl( chunk_parms );
+    pass2ratectl.ContinueBufferState( buffer_variation );
+    SeqEncoder seqencoder( chunk_parms, chunk_reader, quantizer,
+                           chunk_writer,
+                           pass1ratectl, pass2ratectl,
+                           &transform_pool );
+    chunk_reader.Init();
+    quantizer.Init();
+    seqencoder.Init();
+    seqencoder.EncodeStream();
+
+    mjpeg_info( "Chunk %u (from frame %d) coded: %d frames %lu bytes",
+                chunk, first_frame,
+                chunk_reader.NumberOfFrames(),
+                static_cast<unsigned long>(coded.bytes.size()) );
+    return true;
+}
+
+/*
+ * Follow the decoder's buffer through a coded chunk's pictures
+ * starting buffer_variation bits short of full.  The model is the
+ * pass-2 rate controller's: the buffer is filled at the stream's
+ * (maximum) bit-rate until full.
+ *
+ * RETURN: false iff the buffer would under-run
+ */
+
+bool ChunkEncoder::TrackBuffer( const CodedChunk &coded,
+                                int32_t &buffer_variation )
+{
+    bool fits = true;
+    for( unsigned int i = 0; i < coded.picture_bytes.size(); ++i )
+    {
+        int64_t variation = static_cast<int64_t>(buffer_variation)
+            + per_pict_bits - 8LL * coded.picture_bytes[i];
+        if( variation < -encparams.video_buffer_size )
+            fits = false;
+        buffer_variation = variation < 0 ? static_cast<int32_t>(variation) : 0;
+    }
+    return fits;
+}
+
+
+void *ChunkEncoder::WorkerWrapper( void *chunkencoder )
+{
+    static_cast<ChunkEncoder *>(chunkencoder)->Worker();
+    return 0;
+}
+
+void ChunkEncoder::Worker()
+{
+    pthread_mutex_lock( &chunk_lock );
+    for(;;)
+    {
+        // Don't run too far ahead of the output: every chunk coded but
+        // not yet written costs memory (input frames too!).
+        while( next_chunk < end_chunk
+               && next_chunk >= chunks_written + 2 * encparams.gop_parallel )
+            pthread_cond_wait( &chunk_progress, &chunk_lock );
+        if( next_chunk >= end_chunk )
+            break;
+        unsigned int chunk = next_chunk++;
+        pthread_mutex_unlock( &chunk_lock );
+
+        CodedChunk *coded = new CodedChunk;
+        bool encoded = EncodeChunk( chunk, *coded );
+
+        pthread_mutex_lock( &chunk_lock );
+        if( encoded )
+            completed[chunk] = coded;
+        else
+        {
+            delete coded;
+            if( chunk < end_chunk )
+                end_chunk = chunk;
+        }
+        pthread_cond_broadcast( &chunk_progress );
+    }
+    pthread_mutex_unlock( &chunk_lock );
+}
+
+
+/*********************
+ *
+ * EncodeStream - Start the chunk encoding worker threads and stitch
+ * their output together in order as it becomes available.  A chunk
+ * that under-runs the decoder buffer its predecessor leaves is coded
+ * again here.
+ *
+ ********************/
+
+void ChunkEncoder::EncodeStream()
+{
+    unsigned int workers = encparams.gop_parallel;
+    mjpeg_info( "GOP parallel encoding: %u chunks of %d frames concurrently",
+                workers, encparams.chunk_frames );
+
+    pthread_t *worker_threads = new pthread_t[workers];
+    unsigned int i;
+    for( i = 0; i < workers; ++i )
+    {
+        if( pthread_create( &worker_threads[i], NULL,
+                            &ChunkEncoder::WorkerWrapper, this ) != 0 )
+        {
+            mjpeg_error_exit1( "worker thread creation failed: %s", strerror(errno) );
+        }
+    }
+
+    int32_t buffer_variation = 0;
+    unsigned int recoded = 0;
+    pthread_mutex_lock( &chunk_lock );
+    for(;;)
+    {
+        std::map<unsigned int, CodedChunk *>::iterator next;
+        while( (next = completed.find( chunks_written )) == completed.end()
+               && chunks_written < end_chunk )
+            pthread_cond_wait( &chunk_progress, &chunk_lock );
+        if( next == completed.end() )
+            break;
+        CodedChunk *coded = next->second;
+        completed.erase( next );
+        pthread_mutex_unlock( &chunk_lock );
+
+        // The chunk was coded assuming a full buffer at its start
+        int32_t end_variation = buffer_variation;
+        if( !TrackBuffer( *coded, end_variation ) && buffer_variation < 0 )
+        {
+            mjpeg_info( "Chunk %u under-runs the buffer left by chunk %u: re-coding",
+                        chunks_written, chunks_written-1 );
+            delete coded;
+            coded = new CodedChunk;
+            EncodeChunk( chunks_written, *coded, buffer_variation );
+            end_variation = buffer_variation;
+            if( !TrackBuffer( *coded, end_variation ) )
+                mjpeg_warn( "Chunk %u still under-runs the decoder buffer when re-coded",
+                            chunks_written );
+            ++recoded;
+        }
+        buffer_variation = end_variation;
+
+        if( coded->bytes.size() > 0 )
+            writer.WriteOutBufferUpto( &coded->bytes[0], coded->bytes.size() );
+        if( encparams.snr_totals != 0 )
+            encparams.snr_totals->Add( coded->snr );
+        delete coded;
+
+        pthread_mutex_lock( &reader_lock );
+        int next_first_frame = (chunks_written+1) * encparams.chunk_frames;
+        reader.ReleaseFrame( std::min( next_first_frame, reader.NumberOfFrames() ) - 1 );
+        pthread_mutex_unlock( &reader_lock );
+
+        pthread_mutex_lock( &chunk_lock );
+        ++chunks_written;
+        pthread_cond_broadcast( &chunk_progress );
+    }
+    pthread_mutex_unlock( &chunk_lock );
+
+    for( i = 0; i < workers; ++i )
+        pthread_join( worker_threads[i], NULL );
+    delete [] worker_threads;
+
+    mjpeg_info( "GOP parallel encoding: %u chunks (%u re-coded), %lld bytes",
+                chunks_written, recoded,
+                static_cast<long long>(writer.BitCount()/8) );
+    reader.ReportReadAhead();
+    transform_pool.Report();
+}
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,111 @@
+#ifndef _CHUNKENCODER_HH
+#define _CHUNKENCODER_HH
+
+/*  chunkencoder.hh - GOP-parallel encoding of a stream split into
+ *  chunks starting with closed GOPs.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <pthread.h>
+#include <map>
+#include <vector>
+#include "mjpeg_types.h"
+#include "picturepool.hh"
+
+class EncoderParams;
+class PictureReader;
+class ElemStrmWriter;
+class ImagePlanes;
+struct CodedChunk;
+
+/*********************
+ *
+ * ChunkEncoder - Throughput (not latency!) oriented encoding for
+ * file-to-file jobs.  The input is split into chunks of
+ * encparams.chunk_frames frames.  Each chunk is coded as a sequence of
+ * its own (hence starting with a closed GOP) by a private SeqEncoder
+ * with its own rate controllers.  encparams.gop_parallel chunks are
+ * encoded concurrently and the coded chunks are stitched back together
+ * in order on the output ElemStrmWriter.
+ *
+ * GOP time codes are offset so they run on continuously across
+ * chunks.  Each chunk is coded assuming the decoder's buffer starts
+ * full.  As chunks are written out the buffer is tracked across the
+ * joins (using the pass-2 rate controller's model): a chunk that would
+ * under-run the buffer actually left by its predecessor is coded
+ * again, this time continuing from that buffer state.  Input frames
+ * are therefore kept until their chunk has been written out.
+ *
+ * The chunks' SeqEncoder's share one pool of transform buffers so
+ * that a memory budget can limit how many pictures are being
+ * transformed at once.
+ *
+ ********************/
+
+class ChunkEncoder
+{
+public:
+    ChunkEncoder( EncoderParams &encparams,
+                  PictureReader &reader,
+                  ElemStrmWriter &writer );
+    ~ChunkEncoder();
+
+    void EncodeStream();
+
+private:
+    friend class ChunkPictureReader;
+
+    static void *WorkerWrapper( void *chunkencoder );
+    void Worker();
+    bool EncodeChunk( unsigned int chunk, CodedChunk &coded,
+                      int32_t buffer_variation = 0 );
+    bool TrackBuffer( const CodedChunk &coded, int32_t &buffer_variation );
+
+    // Thread-safe access to the input frames shared by all chunks
+    bool FrameAvailable( int frame );
+    bool CopyFrame( int frame, ImagePlanes &image );
+
+    EncoderParams &encparams;
+    PictureReader &reader;
+    ElemStrmWriter &writer;
+    TransformBufferPool transform_pool;
+
+    int32_t per_pict_bits;          // Bits delivered to the decoder per picture
+
+    // Guards the input reader
+    pthread_mutex_t reader_lock;
+
+    // Guards chunk scheduling / completion state below
+    pthread_mutex_t chunk_lock;
+    pthread_cond_t chunk_progress;
+    unsigned int next_chunk;        // Next chunk to hand to a worker
+    unsigned int chunks_written;    // Chunks stitched into output so far
+    unsigned int end_chunk;         // First chunk beyond end of input
+    std::map<unsigned int, CodedChunk *> completed;
+};
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
+#endif
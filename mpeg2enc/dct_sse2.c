@@ -0,0 +1,271 @@
+/*
+ *  dct_sse2.c:  SSE2 and AVX2 versions of the integer fdct (fdct.c)
+ *  and idct (idct.c).
+ *
+ *  The MMX/SSE transforms use their own (less precise) arithmetic so
+ *  which of them is used changes the encoded stream.  These give
+ *  results *identical* to the C versions, which meet the IEEE-1180
+ *  accuracy limits, for any input.  The verify_dct program checks
+ *  both of these things.
+ *
+ *  The SSE2 versions transform a block per call, the AVX2 versions
+ *  two blocks at a time (one per 128 bit lane) so they only come in
+ *  multi-block flavours.  The actual transforms are in
+ *  dct_sse2_kernel.h which is instantiated for both.
+ *
+ *  The code is compiled with per-function target attributes so no
+ *  special compiler flags are needed: the routines are only ever
+ *  called if cpu_accel() reports the CPU (and O.S.) supports them.
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include "mjpeg_types.h"
+#include "transfrm_ref.h"
+#include "dct_sse2.h"
+
+#ifdef HAVE_DCT_SSE2
+
+#include <immintrin.h>
+
+#define SSE2_FN __attribute__((target("sse2")))
+#define SSE2_INLINE static inline __attribute__((always_inline, target("sse2")))
+#define AVX2_FN __attribute__((target("avx2")))
+#define AVX2_INLINE static inline __attribute__((always_inline, target("avx2")))
+
+/* idct.c's constants */
+
+#define W1 2841 /* 2048*sqrt(2)*cos(1*pi/16) */
+#define W2 2676 /* 2048*sqrt(2)*cos(2*pi/16) */
+#define W3 2408 /* 2048*sqrt(2)*cos(3*pi/16) */
+#define W5 1609 /* 2048*sqrt(2)*cos(5*pi/16) */
+#define W6 1108 /* 2048*sqrt(2)*cos(6*pi/16) */
+#define W7 565  /* 2048*sqrt(2)*cos(7*pi/16) */
+
+/* 32 bit lane for V_MADD16 to compute a*lo + b*hi from 16 bit lo, hi */
+
+#define DCT_PAIR(a,b) \
+    ((int32_t)(((uint32_t)(uint16_t)(b) << 16) | (uint16_t)(a)))
+
+/* fdct.c's row [0] and column [1] coefficients as splatted pairs */
+
+static int32_t fdct_pairs[2][8][4][8];
+
+void init_dct_sse2( void )
+{
+    int j, k, n;
+    for( j = 0; j < 8; ++j )
+        for( k = 0; k < 4; ++k )
+            for( n = 0; n < 8; ++n )
+            {
+                fdct_pairs[0][j][k][n] = DCT_PAIR( fdct_row_coeffs[j][2*k],
+                                                   fdct_row_coeffs[j][2*k+1] );
+                fdct_pairs[1][j][k][n] = DCT_PAIR( fdct_col_coeffs[j][2*k],
+                                                   fdct_col_coeffs[j][2*k+1] );
+            }
+}
+
+/*
+ * SSE2: one block per call
+ */
+
+/* x*181 modulo 2^32 */
+SSE2_INLINE __m128i mul181_sse2( __m128i x )
+{
+    return _mm_add_epi32(
+        _mm_add_epi32( _mm_add_epi32( _mm_slli_epi32( x, 7 ),
+                                      _mm_slli_epi32( x, 5 ) ),
+                       _mm_add_epi32( _mm_slli_epi32( x, 4 ),
+                                      _mm_slli_epi32( x, 2 ) ) ),
+        x );
+}
+
+#define VEC __m128i
+#define KFN(name) name##_k128
+#define KINLINE SSE2_INLINE
+#define V_ADD32 _mm_add_epi32
+#define V_SUB32 _mm_sub_epi32
+#define V_SRAI32 _mm_srai_epi32
+#define V_SLLI32 _mm_slli_epi32
+#define V_MADD16 _mm_madd_epi16
+#define V_MUL181 mul181_sse2
+#define V_PACKS32 _mm_packs_epi32
+#define V_MIN16 _mm_min_epi16
+#define V_MAX16 _mm_max_epi16
+#define V_SET1_16 _mm_set1_epi16
+#define V_SET1_32 _mm_set1_epi32
+#define V_LOADU(p) _mm_loadu_si128( (const __m128i *)(p) )
+#define V_UNPACKLO16 _mm_unpacklo_epi16
+#define V_UNPACKHI16 _mm_unpackhi_epi16
+#define V_UNPACKLO32 _mm_unpacklo_epi32
+#define V_UNPACKHI32 _mm_unpackhi_epi32
+#define V_UNPACKLO64 _mm_unpacklo_epi64
+#define V_UNPACKHI64 _mm_unpackhi_epi64
+
+#include "dct_sse2_kernel.h"
+
+#undef VEC
+#undef KFN
+#undef KINLINE
+#undef V_ADD32
+#undef V_SUB32
+#undef V_SRAI32
+#undef V_SLLI32
+#undef V_MADD16
+#undef V_MUL181
+#undef V_PACKS32
+#undef V_MIN16
+#undef V_MAX16
+#undef V_SET1_16
+#undef V_SET1_32
+#undef V_LOADU
+#undef V_UNPACKLO16
+#undef V_UNPACKHI16
+#undef V_UNPACKLO32
+#undef V_UNPACKHI32
+#undef V_UNPACKLO64
+#undef V_UNPACKHI64
+
+SSE2_INLINE void load_block( const int16_t *blk, __m128i r[8] )
+{
+    int k;
+    for( k = 0; k < 8; ++k )
+        r[k] = _mm_loadu_si128( (const __m128i *)(blk+8*k) );
+}
+
+SSE2_INLINE void store_block( int16_t *blk, const __m128i r[8] )
+{
+    int k;
+    for( k = 0; k < 8; ++k )
+        _mm_storeu_si128( (__m128i *)(blk+8*k), r[k] );
+}
+
+SSE2_FN void fdct_sse2( int16_t *blk )
+{
+    __m128i r[8];
+    load_block( blk, r );
+    fdct_k128( r );
+    store_block( blk, r );
+}
+
+SSE2_FN void idct_sse2( int16_t *blk )
+{
+    __m128i r[8];
+    load_block( blk, r );
+    idct_k128( r );
+    store_block( blk, r );
+}
+
+SSE2_FN void fdct_blocks_sse2( int16_t *blks, int count )
+{
+    __m128i r[8];
+    for( ; count > 0; --count, blks += 64 )
+    {
+        load_block( blks, r );
+        fdct_k128( r );
+        store_block( blks, r );
+    }
+}
+
+SSE2_FN void idct_blocks_sse2( int16_t *blks, int count )
+{
+    __m128i r[8];
+    for( ; count > 0; --count, blks += 64 )
+    {
+        load_block( blks, r );
+        idct_k128( r );
+        store_block( blks, r );
+    }
+}
+
+/*
+ * AVX2: a pair of blocks per pass, first in the low lanes second in
+ * the high lanes.  An odd block at the end is done as for SSE2.
+ */
+
+#define VEC __m256i
+#define KFN(name) name##_k256
+#define KINLINE AVX2_INLINE
+#define V_ADD32 _mm256_add_epi32
+#define V_SUB32 _mm256_sub_epi32
+#define V_SRAI32 _mm256_srai_epi32
+#define V_SLLI32 _mm256_slli_epi32
+#define V_MADD16 _mm256_madd_epi16
+#define V_MUL181(x) _mm256_mullo_epi32( (x), _mm256_set1_epi32( 181 ) )
+#define V_PACKS32 _mm256_packs_epi32
+#define V_MIN16 _mm256_min_epi16
+#define V_MAX16 _mm256_max_epi16
+#define V_SET1_16 _mm256_set1_epi16
+#define V_SET1_32 _mm256_set1_epi32
+#define V_LOADU(p) _mm256_loadu_si256( (const __m256i *)(p) )
+#define V_UNPACKLO16 _mm256_unpacklo_epi16
+#define V_UNPACKHI16 _mm256_unpackhi_epi16
+#define V_UNPACKLO32 _mm256_unpacklo_epi32
+#define V_UNPACKHI32 _mm256_unpackhi_epi32
+#define V_UNPACKLO64 _mm256_unpacklo_epi64
+#define V_UNPACKHI64 _mm256_unpackhi_epi64
+
+#include "dct_sse2_kernel.h"
+
+AVX2_INLINE void load_block_pair( const int16_t *blks, __m256i r[8] )
+{
+    int k;
+    for( k = 0; k < 8; ++k )
+        r[k] = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(
+                _mm_loadu_si128( (const __m128i *)(blks+8*k) ) ),
+            _mm_loadu_si128( (const __m128i *)(blks+64+8*k) ), 1 );
+}
+
+AVX2_INLINE void store_block_pair( int16_t *blks, const __m256i r[8] )
+{
+    int k;
+    for( k = 0; k < 8; ++k )
+    {
+        _mm_storeu_si128( (__m128i *)(blks+8*k), _mm256_castsi256_si128( r[k] ) );
+        _mm_storeu_si128( (__m128i *)(blks+64+8*k), _mm256_extracti128_si256( r[k], 1 ) );
+    }
+}
+
+AVX2_FN void fdct_blocks_avx2( int16_t *blks, int count )
+{
+    __m256i r[8];
+    for( ; count >= 2; count -= 2, blks += 128 )
+    {
+        load_block_pair( blks, r );
+        fdct_k256( r );
+        store_block_pair( blks, r );
+    }
+    if( count > 0 )
+        fdct_sse2( blks );
+}
+
+AVX2_FN void idct_blocks_avx2( int16_t *blks, int count )
+{
+    __m256i r[8];
+    for( ; count >= 2; count -= 2, blks += 128 )
+    {
+        load_block_pair( blks, r );
+        idct_k256( r );
+        store_block_pair( blks, r );
+    }
+    if( count > 0 )
+        idct_sse2( blks );
+}
+
+#endif /* HAVE_DCT_SSE2 */
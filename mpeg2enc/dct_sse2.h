@@ -0,0 +1,61 @@
+#ifndef _DCT_SSE2_H
+#define _DCT_SSE2_H
+
+/*
+ *  dct_sse2.h:  SSE2 and AVX2 versions of the integer fdct (fdct.c)
+ *  and idct (idct.c).
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "mjpeg_types.h"
+
+/* The routines are built using function target attributes rather
+   than special compiler flags.  These need a reasonably recent
+   compiler. */
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    ((defined(__GNUC__) && !defined(__clang__) \
+     && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) \
+     || (defined(__clang__) && __clang_major__ >= 4))
+#define HAVE_DCT_SSE2 1
+#endif
+
+#ifdef HAVE_DCT_SSE2
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+void init_dct_sse2( void );
+
+void fdct_sse2( int16_t *blk );
+void idct_sse2( int16_t *blk );
+void fdct_blocks_sse2( int16_t *blks, int count );
+void idct_blocks_sse2( int16_t *blks, int count );
+
+/* Two blocks at a time */
+void fdct_blocks_avx2( int16_t *blks, int count );
+void idct_blocks_avx2( int16_t *blks, int count );
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* HAVE_DCT_SSE2 */
+
+#endif /* _DCT_SSE2_H */
@@ -0,0 +1,209 @@
+/*
+ *  dct_sse2_kernel.h:  The integer fdct / idct of dct_sse2.c working
+ *  on one block per 128 bit lane.  Included once for SSE2 (one block
+ *  at a time) and once for AVX2 (two blocks at a time) with the
+ *  following defined:
+ *
+ *  VEC         the vector type
+ *  KFN(name)   name of the instance's version of name
+ *  KINLINE     qualifiers (including the target) for its functions
+ *  V_xxx       each of the vector operations used below
+ *
+ *  A block is held as 8 vectors, one per row.  Both transforms are done
+ *  as two vertical passes (every lane doing the same 1-D transform)
+ *  with transposes before each, which leaves the result in rows again.
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+KINLINE void KFN(transpose)( VEC r[8] )
+{
+    VEC a0 = V_UNPACKLO16( r[0], r[1] );
+    VEC a1 = V_UNPACKHI16( r[0], r[1] );
+    VEC a2 = V_UNPACKLO16( r[2], r[3] );
+    VEC a3 = V_UNPACKHI16( r[2], r[3] );
+    VEC a4 = V_UNPACKLO16( r[4], r[5] );
+    VEC a5 = V_UNPACKHI16( r[4], r[5] );
+    VEC a6 = V_UNPACKLO16( r[6], r[7] );
+    VEC a7 = V_UNPACKHI16( r[6], r[7] );
+
+    VEC b0 = V_UNPACKLO32( a0, a2 );
+    VEC b1 = V_UNPACKHI32( a0, a2 );
+    VEC b2 = V_UNPACKLO32( a1, a3 );
+    VEC b3 = V_UNPACKHI32( a1, a3 );
+    VEC b4 = V_UNPACKLO32( a4, a6 );
+    VEC b5 = V_UNPACKHI32( a4, a6 );
+    VEC b6 = V_UNPACKLO32( a5, a7 );
+    VEC b7 = V_UNPACKHI32( a5, a7 );
+
+    r[0] = V_UNPACKLO64( b0, b4 );
+    r[1] = V_UNPACKHI64( b0, b4 );
+    r[2] = V_UNPACKLO64( b1, b5 );
+    r[3] = V_UNPACKHI64( b1, b5 );
+    r[4] = V_UNPACKLO64( b2, b6 );
+    r[5] = V_UNPACKHI64( b2, b6 );
+    r[6] = V_UNPACKLO64( b3, b7 );
+    r[7] = V_UNPACKHI64( b3, b7 );
+}
+
+/*
+ * One pass of the fdct of fdct.c:
+ * r[j] = saturate16( (sum_k coeffs[j][k] * r[k] + round) >> shift )
+ * pairs holds the coefficients as splatted pairs (coeffs[j][2k],
+ * coeffs[j][2k+1]) for V_MADD16.
+ */
+
+KINLINE void KFN(fdct_pass)( VEC r[8], const int32_t pairs[8][4][8],
+                             const int shift )
+{
+    const VEC round = V_SET1_32( 1<<(shift-1) );
+    VEC lo[4], hi[4];
+    int j, k;
+
+    for( k = 0; k < 4; ++k )
+    {
+        lo[k] = V_UNPACKLO16( r[2*k], r[2*k+1] );
+        hi[k] = V_UNPACKHI16( r[2*k], r[2*k+1] );
+    }
+    for( j = 0; j < 8; ++j )
+    {
+        VEC slo = round;
+        VEC shi = round;
+        for( k = 0; k < 4; ++k )
+        {
+            VEC c = V_LOADU( pairs[j][k] );
+            slo = V_ADD32( slo, V_MADD16( lo[k], c ) );
+            shi = V_ADD32( shi, V_MADD16( hi[k], c ) );
+        }
+        r[j] = V_PACKS32( V_SRAI32( slo, shift ), V_SRAI32( shi, shift ) );
+    }
+}
+
+KINLINE void KFN(fdct)( VEC r[8] )
+{
+    KFN(transpose)( r );
+    KFN(fdct_pass)( r, fdct_pairs[0], FDCT_ROW_BITS-FDCT_FRAC_BITS );
+    KFN(transpose)( r );
+    KFN(fdct_pass)( r, fdct_pairs[1], FDCT_COL_BITS+FDCT_FRAC_BITS );
+}
+
+/*
+ * One pass of the Chen-Wang idct of idct.c: the row pass if row is
+ * set, the column pass otherwise.  The first stage products are
+ * done as pairs by V_MADD16 (W7*(x4+x5)+(W1-W7)*x4 == W1*x4+W7*x5
+ * and so on) and everything after that exactly as in idct.c on 32
+ * bit lanes.  Row pass results are truncated to 16 bits as in idct.c,
+ * column pass results clipped to -256..255.
+ */
+
+KINLINE void KFN(idct_pass)( VEC r[8], const int row )
+{
+    const int s0 = row ? 2048 : 256;
+    const VEC c04p = V_SET1_32( DCT_PAIR( s0, s0 ) );
+    const VEC c04m = V_SET1_32( DCT_PAIR( s0, -s0 ) );
+    const VEC c17p = V_SET1_32( DCT_PAIR( W1, W7 ) );
+    const VEC c17m = V_SET1_32( DCT_PAIR( W7, -W1 ) );
+    const VEC c53p = V_SET1_32( DCT_PAIR( W5, W3 ) );
+    const VEC c53m = V_SET1_32( DCT_PAIR( W3, -W5 ) );
+    const VEC c26p = V_SET1_32( DCT_PAIR( W2, W6 ) );
+    const VEC c26m = V_SET1_32( DCT_PAIR( W6, -W2 ) );
+    const VEC round0 = V_SET1_32( row ? 128 : 8192 );
+    const VEC round1 = V_SET1_32( 4 );
+    const VEC round3 = V_SET1_32( 128 );
+    VEC p04[2], p17[2], p53[2], p26[2];
+    VEC out[8][2];
+    int h, k;
+
+    p04[0] = V_UNPACKLO16( r[0], r[4] );
+    p04[1] = V_UNPACKHI16( r[0], r[4] );
+    p17[0] = V_UNPACKLO16( r[1], r[7] );
+    p17[1] = V_UNPACKHI16( r[1], r[7] );
+    p53[0] = V_UNPACKLO16( r[5], r[3] );
+    p53[1] = V_UNPACKHI16( r[5], r[3] );
+    p26[0] = V_UNPACKLO16( r[2], r[6] );
+    p26[1] = V_UNPACKHI16( r[2], r[6] );
+
+    for( h = 0; h < 2; ++h )
+    {
+        VEC x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+        /* first stage (and the products of the second) */
+        x4 = V_MADD16( p17[h], c17p );
+        x5 = V_MADD16( p17[h], c17m );
+        x6 = V_MADD16( p53[h], c53p );
+        x7 = V_MADD16( p53[h], c53m );
+        x3 = V_MADD16( p26[h], c26p );
+        x2 = V_MADD16( p26[h], c26m );
+        if( !row )
+        {
+            x4 = V_SRAI32( V_ADD32( x4, round1 ), 3 );
+            x5 = V_SRAI32( V_ADD32( x5, round1 ), 3 );
+            x6 = V_SRAI32( V_ADD32( x6, round1 ), 3 );
+            x7 = V_SRAI32( V_ADD32( x7, round1 ), 3 );
+            x3 = V_SRAI32( V_ADD32( x3, round1 ), 3 );
+            x2 = V_SRAI32( V_ADD32( x2, round1 ), 3 );
+        }
+        x8 = V_ADD32( V_MADD16( p04[h], c04p ), round0 );
+        x0 = V_ADD32( V_MADD16( p04[h], c04m ), round0 );
+
+        /* second stage */
+        x1 = V_ADD32( x4, x6 );
+        x4 = V_SUB32( x4, x6 );
+        x6 = V_ADD32( x5, x7 );
+        x5 = V_SUB32( x5, x7 );
+
+        /* third stage */
+        x7 = V_ADD32( x8, x3 );
+        x8 = V_SUB32( x8, x3 );
+        x3 = V_ADD32( x0, x2 );
+        x0 = V_SUB32( x0, x2 );
+        x2 = V_SRAI32( V_ADD32( V_MUL181( V_ADD32( x4, x5 ) ), round3 ), 8 );
+        x4 = V_SRAI32( V_ADD32( V_MUL181( V_SUB32( x4, x5 ) ), round3 ), 8 );
+
+        /* fourth stage */
+        out[0][h] = V_ADD32( x7, x1 );
+        out[1][h] = V_ADD32( x3, x2 );
+        out[2][h] = V_ADD32( x0, x4 );
+        out[3][h] = V_ADD32( x8, x6 );
+        out[4][h] = V_SUB32( x8, x6 );
+        out[5][h] = V_SUB32( x0, x4 );
+        out[6][h] = V_SUB32( x3, x2 );
+        out[7][h] = V_SUB32( x7, x1 );
+
+        /* (int16_t)(x>>8) is bits 8..23 of x sign extended */
+        for( k = 0; k < 8; ++k )
+            out[k][h] = row
+                ? V_SRAI32( V_SLLI32( out[k][h], 8 ), 16 )
+                : V_SRAI32( out[k][h], 14 );
+    }
+
+    for( k = 0; k < 8; ++k )
+    {
+        r[k] = V_PACKS32( out[k][0], out[k][1] );
+        if( !row )
+            r[k] = V_MAX16( V_MIN16( r[k], V_SET1_16( 255 ) ),
+                            V_SET1_16( -256 ) );
+    }
+}
+
+KINLINE void KFN(idct)( VEC r[8] )
+{
+    KFN(transpose)( r );
+    KFN(idct_pass)( r, 1 );
+    KFN(transpose)( r );
+    KFN(idct_pass)( r, 0 );
+}
@@ -0,0 +1,420 @@
+/*  despatcher.cc - Work-stealing parallel despatch of per-macroblock
+ *  encoding work to a pool of worker threads.
+ *
+ *  Based on the Despatcher of seqencoder.cc
+ *  (C) 2000, 2001, 2005, 2006 Andrew Stevens
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include "mjpeg_logging.h"
+#include "mpeg2syntaxcodes.h"
+#include "encoderparams.hh"
+#include "picture.hh"
+#include "macroblock.hh"
+#include "despatcher.hh"
+#include "instrumentation.hh"
+
+
+Despatcher::Despatcher() :
+    parallelism(0),
+    next_worker(0),
+    pending(0),
+    outstanding(0),
+    shutdown(false)
+{
+    pthread_mutex_init( &sched_lock, NULL );
+    pthread_cond_init( &work_available, NULL );
+    pthread_cond_init( &work_done, NULL );
+}
+
+void Despatcher::Init( unsigned int _parallelism )
+{
+    parallelism = _parallelism;
+    mjpeg_debug( "PAR = %d\n", parallelism );
+    start_usec = NowUsec();
+    if( parallelism == 0 )
+        return;
+
+    // N.b. workers must never be resized after this point as they
+    // contain mutexes and are shared with the worker threads.
+    workers.resize( parallelism );
+    unsigned int i;
+    for( i = 0; i < parallelism; ++i )
+    {
+        workers[i].despatcher = this;
+        workers[i].id = i;
+        pthread_mutex_init( &workers[i].lock, NULL );
+        workers[i].busy_usec = 0;
+        workers[i].tasks_done = 0;
+        workers[i].tasks_stolen = 0;
+    }
+
+    pthread_attr_t *pattr = 0;
+    /* For some Unixen we get a ridiculously small default stack size.
+       Hence we need to beef this up if we can.
+    */
+#ifdef HAVE_PTHREADSTACKSIZE
+#define MINSTACKSIZE 200000
+
+    pthread_attr_t attr;
+    size_t stacksize;
+
+    pthread_attr_init(&attr);
+    pthread_attr_getstacksize(&attr, &stacksize);
+
+    if (stacksize < MINSTACKSIZE)
+    {
+        pthread_attr_setstacksize(&attr, MINSTACKSIZE);
+    }
+
+    pattr = &attr;
+#endif
+    for( i = 0; i < parallelism; ++i )
+    {
+        mjpeg_debug("Creating worker thread %d", i );
+        if( pthread_create( &workers[i].thread, pattr,
+                            &Despatcher::WorkerWrapper,
+                            &workers[i] ) != 0 )
+        {
+            mjpeg_error_exit1( "worker thread creation failed: %s", strerror(errno) );
+        }
+    }
+}
+
+Despatcher::~Despatcher()
+{
+    if( parallelism > 0 )
+    {
+        WaitForCompletion();
+        pthread_mutex_lock( &sched_lock );
+        shutdown = true;
+        pthread_cond_broadcast( &work_available );
+        pthread_mutex_unlock( &sched_lock );
+        for( unsigned int i = 0; i < parallelism; ++i )
+        {
+            pthread_join( workers[i].thread, NULL );
+            pthread_mutex_destroy( &workers[i].lock );
+        }
+    }
+    pthread_cond_destroy( &work_done );
+    pthread_cond_destroy( &work_available );
+    pthread_mutex_destroy( &sched_lock );
+}
+
+uint64_t Despatcher::NowUsec()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+void *Despatcher::WorkerWrapper( void *arg )
+{
+    Worker *worker = static_cast<Worker *>(arg);
+    worker->despatcher->WorkerLoop( worker->id );
+    return 0;
+}
+
+void Despatcher::PerformTask( const Task &task )
+{
+    if( task.job != 0 )
+    {
+        task.job->Perform();
+        return;
+    }
+    // All macroblock work bar the transform is motion estimation /
+    // mode selection in one of its forms
+    StageTimer timer( task.picture->encparams.instrumentation,
+                      task.picture->timings,
+                      task.encodingFunc == &MacroBlock::Encode
+                      ? STAGE_TRANSFORM : STAGE_ME );
+    vector<MacroBlock>::iterator mbi;
+    vector<MacroBlock>::iterator mb_end = task.picture->mbinfo.begin() + task.end;
+    for( mbi = task.picture->mbinfo.begin() + task.begin; mbi < mb_end; ++mbi )
+    {
+        (*mbi.*task.encodingFunc)();
+    }
+}
+
+/*
+ * Take a task: jobs first as someone is probably waiting for them,
+ * then preferably from the front of our own deque (the order tasks
+ * were queued in gives good locality of reference), otherwise steal
+ * from the back of another worker's deque.
+ */
+
+bool Despatcher::TakeTask( unsigned int id, Task &task )
+{
+    Worker &self = workers[id];
+    bool found = false;
+
+    pthread_mutex_lock( &sched_lock );
+    if( !jobs.empty() )
+    {
+        task = jobs.front();
+        jobs.pop_front();
+        --pending;
+        found = true;
+    }
+    pthread_mutex_unlock( &sched_lock );
+    if( found )
+        return true;
+
+    pthread_mutex_lock( &self.lock );
+    if( !self.tasks.empty() )
+    {
+        task = self.tasks.front();
+        self.tasks.pop_front();
+        found = true;
+    }
+    pthread_mutex_unlock( &self.lock );
+
+    for( unsigned int i = 1; !found && i < parallelism; ++i )
+    {
+        Worker &victim = workers[(id+i)%parallelism];
+        pthread_mutex_lock( &victim.lock );
+        if( !victim.tasks.empty() )
+        {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            found = true;
+            ++self.tasks_stolen;
+        }
+        pthread_mutex_unlock( &victim.lock );
+    }
+
+    if( found )
+    {
+        pthread_mutex_lock( &sched_lock );
+        --pending;
+        pthread_mutex_unlock( &sched_lock );
+    }
+    return found;
+}
+
+void Despatcher::WorkerLoop( unsigned int id )
+{
+    Worker &self = workers[id];
+    Task task;
+    mjpeg_debug( "Worker thread %d started", id );
+
+    for(;;)
+    {
+        if( !TakeTask( id, task ) )
+        {
+            // Nothing to be had: sleep until more work is despatched.
+            // N.b. pending may be non-zero but the deques empty
+            // transiently while another worker is taking a task.
+            pthread_mutex_lock( &sched_lock );
+            while( pending == 0 && !shutdown )
+                pthread_cond_wait( &work_available, &sched_lock );
+            bool finished = shutdown && pending == 0;
+            pthread_mutex_unlock( &sched_lock );
+            if( finished )
+            {
+                mjpeg_debug("SHUTDOWN worker %d", id );
+                return;
+            }
+            continue;
+        }
+
+        uint64_t start = NowUsec();
+        PerformTask( task );
+        __atomic_store_n( &self.busy_usec,
+                          self.busy_usec + NowUsec() - start,
+                          __ATOMIC_RELAXED );
+        ++self.tasks_done;
+
+        pthread_mutex_lock( &sched_lock );
+        if( task.job != 0 )
+            task.job->done = true;
+        if( --outstanding == 0 || task.job != 0 )
+            pthread_cond_broadcast( &work_done );
+        pthread_mutex_unlock( &sched_lock );
+    }
+}
+
+/*
+ * Despatch encodingFunc for every macroblock of the picture (or field).
+ * Work is split into one task per row of macroblocks.  Runs of
+ * consecutive rows are queued to each worker so that, unless stealing
+ * is needed, a worker sweeps through an adjacent region of the picture.
+ */
+
+void Despatcher::Despatch( Picture &picture, void (MacroBlock::*encodingFunc)() )
+{
+    unsigned int mbs_begin, mbs_end;
+    switch( picture.pict_struct )
+    {
+    case TOP_FIELD :
+        mbs_begin = 0;
+        mbs_end = picture.mbinfo.size()/2;
+        break;
+    case BOTTOM_FIELD :
+        mbs_begin = picture.mbinfo.size()/2;
+        mbs_end = picture.mbinfo.size();
+        break;
+    default :
+    case FRAME_PICTURE :
+        mbs_begin = 0;
+        mbs_end = picture.mbinfo.size();
+        break;
+    }
+
+    if( parallelism == 0 )
+    {
+        Task task;
+        task.picture = &picture;
+        task.encodingFunc = encodingFunc;
+        task.begin = mbs_begin;
+        task.end = mbs_end;
+        task.job = 0;
+        PerformTask( task );
+        return;
+    }
+
+    unsigned int row_len = picture.encparams.mb_width;
+    unsigned int rows = (mbs_end - mbs_begin + row_len - 1) / row_len;
+
+    pthread_mutex_lock( &sched_lock );
+    for( unsigned int w = 0; w < parallelism; ++w )
+    {
+        unsigned int first_row = w * rows / parallelism;
+        unsigned int last_row = (w+1) * rows / parallelism;
+        Worker &worker = workers[(next_worker+w)%parallelism];
+        pthread_mutex_lock( &worker.lock );
+        for( unsigned int row = first_row; row < last_row; ++row )
+        {
+            Task task;
+            task.picture = &picture;
+            task.encodingFunc = encodingFunc;
+            task.begin = mbs_begin + row * row_len;
+            task.end = task.begin + row_len < mbs_end ? task.begin + row_len : mbs_end;
+            task.job = 0;
+            worker.tasks.push_back( task );
+        }
+        pthread_mutex_unlock( &worker.lock );
+    }
+    // Rotate which worker gets the first rows so that small
+    // despatches don't always land on the same threads.
+    next_worker = (next_worker+1) % parallelism;
+    pending += rows;
+    outstanding += rows;
+    pthread_cond_broadcast( &work_available );
+    pthread_mutex_unlock( &sched_lock );
+}
+
+/*
+ * Despatch a single job.  It is taken by the next worker to look for
+ * work.
+ */
+
+void Despatcher::Despatch( DespatcherJob &job )
+{
+    if( parallelism == 0 )
+    {
+        job.Perform();
+        job.done = true;
+        return;
+    }
+
+    Task task;
+    task.picture = 0;
+    task.encodingFunc = 0;
+    task.begin = task.end = 0;
+    task.job = &job;
+
+    pthread_mutex_lock( &sched_lock );
+    job.done = false;
+    jobs.push_back( task );
+    ++pending;
+    ++outstanding;
+    pthread_cond_broadcast( &work_available );
+    pthread_mutex_unlock( &sched_lock );
+}
+
+void Despatcher::WaitFor( DespatcherJob &job )
+{
+    if( parallelism == 0 )
+        return;
+    pthread_mutex_lock( &sched_lock );
+    while( !job.done )
+        pthread_cond_wait( &work_done, &sched_lock );
+    pthread_mutex_unlock( &sched_lock );
+}
+
+void Despatcher::WaitForCompletion()
+{
+    if( parallelism == 0 )
+        return;
+    pthread_mutex_lock( &sched_lock );
+    while( outstanding > 0 )
+        pthread_cond_wait( &work_done, &sched_lock );
+    pthread_mutex_unlock( &sched_lock );
+}
+
+/*
+ * Report how busy each worker thread has been since Init.  A
+ * well-balanced load shows similar figures for every worker.
+ */
+
+void Despatcher::ReportUtilisation()
+{
+    double elapsed = static_cast<double>(NowUsec() - start_usec);
+    if( elapsed <= 0.0 )
+        elapsed = 1.0;
+    for( unsigned int i = 0; i < parallelism; ++i )
+    {
+        const Worker &worker = workers[i];
+        mjpeg_info( "Worker %2d: %5.1f%% busy %7u tasks (%u stolen)",
+                    i,
+                    100.0 * static_cast<double>(worker.busy_usec) / elapsed,
+                    worker.tasks_done,
+                    worker.tasks_stolen );
+    }
+}
+
+/*
+ * Record the workers' busy / idle times so far with instrumentation.
+ * Unlike ReportUtilisation this may be called with work in progress.
+ */
+
+void Despatcher::ReportUtilisation( Instrumentation &instrumentation )
+{
+    if( parallelism == 0 )
+        return;
+    std::vector<uint64_t> busy_usec( parallelism );
+    for( unsigned int i = 0; i < parallelism; ++i )
+        busy_usec[i] = __atomic_load_n( &workers[i].busy_usec, __ATOMIC_RELAXED );
+    instrumentation.WorkerTimes( busy_usec, NowUsec() - start_usec );
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
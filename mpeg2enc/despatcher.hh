@@ -0,0 +1,141 @@
+#ifndef _DESPATCHER_HH
+#define _DESPATCHER_HH
+
+/*  despatcher.hh - Work-stealing parallel despatch of per-macroblock
+ *  encoding work to a pool of worker threads.
+ *
+ *  Based on the Despatcher of seqencoder.cc
+ *  (C) 2000, 2001, 2005, 2006 Andrew Stevens
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <pthread.h>
+#include <deque>
+#include <vector>
+#include "mjpeg_types.h"
+
+class Picture;
+class MacroBlock;
+class Instrumentation;
+
+/*********************
+ *
+ * DespatcherJob - An arbitrary unit of work (e.g. coding a slice) that
+ * can be despatched to the worker threads and then individually
+ * waited for.
+ *
+ ********************/
+
+class DespatcherJob
+{
+public:
+    DespatcherJob() : done(true) {}
+    virtual ~DespatcherJob() {}
+    virtual void Perform() = 0;
+private:
+    friend class Despatcher;
+    bool done;                  // Guarded by the Despatcher's sched_lock
+};
+
+/*********************
+ *
+ * Despatcher - Encoding work is despatched as small tasks (by default a
+ * row of macroblocks each).  Each worker thread has its own deque of
+ * tasks: it takes work from the front of its own deque and, when that
+ * runs dry, steals from the back of other workers' deques.  Thus if
+ * some parts of a picture are much more expensive to encode than
+ * others the load balances itself.
+ *
+ * With parallelism 0 work is simply performed in the despatching
+ * thread.
+ *
+ * Any number of Despatch-es may be outstanding: WaitForCompletion
+ * waits until *all* despatched work is done.  DespatcherJob-s are
+ * someone's critical path so they are taken ahead of any queued
+ * macroblock work and can be waited for individually.
+ *
+ ********************/
+
+class Despatcher
+{
+public:
+    Despatcher();
+    ~Despatcher();
+    void Init( unsigned int parallelism );
+    void Despatch( Picture &picture, void (MacroBlock::*encodingFunc)() );
+    void Despatch( DespatcherJob &job );
+    void WaitFor( DespatcherJob &job );
+    void WaitForCompletion();
+    void ReportUtilisation();
+    void ReportUtilisation( Instrumentation &instrumentation );
+
+private:
+    struct Task
+    {
+        Picture *picture;
+        void (MacroBlock::*encodingFunc)();
+        unsigned int begin;         // Macroblock index range [begin,end)
+        unsigned int end;
+        DespatcherJob *job;         // If non-null job to perform instead
+    };
+
+    struct Worker
+    {
+        Despatcher *despatcher;
+        unsigned int id;
+        pthread_t thread;
+        pthread_mutex_t lock;       // Guards tasks
+        std::deque<Task> tasks;
+        // Utilisation statistics (updated by the worker only)
+        uint64_t busy_usec;         // N.b. read while the worker runs
+        unsigned int tasks_done;
+        unsigned int tasks_stolen;
+    };
+
+    static void *WorkerWrapper( void *arg );
+    void WorkerLoop( unsigned int id );
+    bool TakeTask( unsigned int id, Task &task );
+    static void PerformTask( const Task &task );
+    static uint64_t NowUsec();
+
+    unsigned int parallelism;
+    std::vector<Worker> workers;
+    unsigned int next_worker;       // Round-robin start for distributing tasks
+
+    // Guards the counters / flags below
+    pthread_mutex_t sched_lock;
+    pthread_cond_t work_available;
+    pthread_cond_t work_done;
+    std::deque<Task> jobs;          // Queued jobs (taken before any tasks)
+    int pending;                    // Tasks queued but not yet taken
+    int outstanding;                // Tasks despatched but not yet completed
+    bool shutdown;
+
+    uint64_t start_usec;
+};
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
+#endif
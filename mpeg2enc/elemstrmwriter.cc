@@ -63,26 +63,12 @@ ElemStrmWriter::~ElemStrmWriter()
 /* *********************************************************************** */
 
 
-OutputFragBuf::OutputFragBuf()
-{
-    pendingbits = 0;
-    unflushed = 0;
-    outcnt = 8;
-}
-
-OutputFragBuf::~OutputFragBuf()
-{
-}
-
-
-/* *********************************************************************** */
-
-
 ElemStrmFragBuf::ElemStrmFragBuf(ElemStrmWriter &_writer ) :
-	OutputFragBuf(),
     writer(_writer)
 {
     buffer = NULL;
+    buffer_size = 1024*16;
+    AdjustBuffer();
     ResetBuffer();
 }
 
@@ -102,90 +88,34 @@ void ElemStrmFragBuf::AdjustBuffer()
 
 void ElemStrmFragBuf::ResetBuffer()
 {
-    outcnt = 8;
-    buffer_size = 1024*16;
     unflushed = 0;
-    AdjustBuffer();
+    accum = 0;
+    accbits = 0;
 }
 
-void ElemStrmFragBuf::FlushBuffer( )
-{
-	assert( outcnt == 8 );
-	writer.WriteOutBufferUpto( buffer, unflushed );
-    ResetBuffer();
-}
-
-
-
 /**************
  *
- * Write least significant n (0<=n<=32) bits of val to output buffer
+ * Flush out buffer. The accumulator holds a whole number of bytes
+ * (we're byte-aligned) which are stored first.
  *
  *************/
 
-void ElemStrmFragBuf::PutBits(uint32_t val, int n)
-{
-	val = (n == 32) ? val : (val & (~(0xffffffffU << n)));
-	while( n >= outcnt )
-	{
-		pendingbits = (pendingbits << outcnt ) | (val >> (n-outcnt));
-		if( unflushed == buffer_size )
-			AdjustBuffer();
-		buffer[unflushed] = pendingbits;
-		++unflushed;
-		n -= outcnt;
-		outcnt = 8;
-	}
-	if( n != 0 )
-	{
-		pendingbits = (pendingbits<<n) | val;
-		outcnt -= n;
-	}
-}
-
-
-/* *********************************************************************** */
-
-
-CountOnlyFragBuf::CountOnlyFragBuf() :
-	OutputFragBuf()
-{
-}
-
-CountOnlyFragBuf::~CountOnlyFragBuf()
-{
-
-}
-
-void CountOnlyFragBuf::ResetBuffer()
-{
-    outcnt = 8;
-    unflushed = 0;
-}
-
-void CountOnlyFragBuf::FlushBuffer( )
-{
-    unflushed = 0;
-}
-
-/**************
- *
- * Write least significant n (0<=n<=32) bits of val to output buffer
- *
- *************/
-
-void CountOnlyFragBuf::PutBits(uint32_t val, int n)
+void ElemStrmFragBuf::FlushBuffer( )
 {
-	int bits = (8-outcnt)+n;
-	int bytes = bits / 8;
-	int remainder = bits % 8;
-	unflushed += bytes;
-	outcnt = 8-remainder;
+    assert( Aligned() );
+    if( unflushed + 4 > buffer_size )
+    {
+        AdjustBuffer();
+    }
+    for( ; accbits > 0; accbits -= 8 )
+    {
+        buffer[unflushed++] = static_cast<uint8_t>(accum >> (accbits-8));
+    }
+    writer.WriteOutBufferUpto( buffer, unflushed );
+    ResetBuffer();
 }
 
 
-
-
 /* 
  * Local variables:
  *  c-file-style: "stroustrup"
@@ -21,6 +21,7 @@
  */
 
 #include "mjpeg_types.h"
+#include "mjpeg_logging.h"
 
 class EncoderParams;
 
@@ -41,64 +42,39 @@ protected:
 
 /******************************
  *
- * Elementry stream buffer used to accumulate (byte-aligned) fragments ofencoded video.  Currently
- * each frame has its own buffer.
+ * Fragment buffers accumulate the bits of (byte-aligned) fragments of
+ * encoded video.  Currently each frame and each slice being coded has
+ * its own buffer.
+ *
+ * The bit-level coding of MPEG2CodingBuf is a template over the kind
+ * of fragment buffer (its "policy") rather than calling a virtual
+ * PutBits for every VLC codeword.  A fragment buffer provides:
+ *
+ *  PutBits(val,n) - Append the rightmost (least significant) n (0<=n<=32)
+ *                   bits of val.
+ *  AlignBits()    - Pad with zero bits to the next byte boundary.
+ *  Aligned()      - True if at a byte boundary.
+ *  ByteCount()    - Number of complete bytes held.
+ *  FlushBuffer()  - Write out the (byte-aligned) contents and empty the
+ *                   buffer.
+ *  ResetBuffer()  - Empty the buffer discarding its contents.
+ *  TransferTo(dest) - Append the contents (which need not be
+ *                   byte-aligned) to dest and empty the buffer.
  *
  *****************************/
 
-class OutputFragBuf
-{
-public:
-	OutputFragBuf();
-    virtual ~OutputFragBuf();
-
-    /**************
-     *
-     * Flush out buffer
-     * N.b. attempts to flush in non byte-aligned states are illegal
-     * and will abort
-     *
-     *************/
-    virtual void FlushBuffer() = 0;
-
-    /**************
-     *
-     * Reset buffer - empty buffer discarding current contents.
-     *
-     * ***********/
-
-    virtual void ResetBuffer() = 0;
-
-    /**************
-     *
-     * Write rightmost (least significant) n (0<=n<=32) bits of val to current buffer
-     *
-     *************/
-    virtual void PutBits( uint32_t val, int n) = 0;
-
-    inline void AlignBits()
-    {
-    	if (outcnt!=8)
-    		PutBits(0,outcnt);
-    }
-    inline bool Aligned() const { return outcnt == 8; }
-    inline int ByteCount() const { return unflushed; }
-
-protected:
-    int unflushed;
-    int outcnt;                 // Bits unwritten in current output byte
-    uint32_t pendingbits;
-};
-
 
 /******************************
  *
- * Elementry stream buffer used to accumulate (byte-aligned) fragments ofencoded video.  Currently
- * each frame has its own buffer.
+ * ElemStrmFragBuf - Fragment buffer holding the coded bits for
+ * writing out.  Bits are gathered in a 64-bit accumulator and
+ * stored to the buffer 32 bits (big-endian) at a time so that
+ * PutBits is a handful of inline shifts with one buffer size check
+ * per 32 bits coded.
  *
  *****************************/
 
-class ElemStrmFragBuf : public OutputFragBuf
+class ElemStrmFragBuf
 {
 public:
 	ElemStrmFragBuf( ElemStrmWriter &outstrm);
@@ -111,7 +87,7 @@ public:
      * and will abort
      *
      *************/
-    virtual void FlushBuffer();
+    void FlushBuffer();
 
     /**************
      * 
@@ -119,66 +95,114 @@ public:
      * 
      * ***********/
      
-    virtual void ResetBuffer();
+    void ResetBuffer();
     
     /**************
      *
      * Write rightmost (least significant) n (0<=n<=32) bits of val to current buffer 
      *
      *************/
-    virtual void PutBits( uint32_t val, int n);
+    inline void PutBits( uint32_t val, int n)
+    {
+        // accbits < 32 on entry so the accumulator can't overflow
+        accum = (accum << n) | (val & ((static_cast<uint64_t>(1) << n) - 1));
+        accbits += n;
+        if( accbits >= 32 )
+        {
+            accbits -= 32;
+            PutWord( static_cast<uint32_t>(accum >> accbits) );
+        }
+    }
+
+    inline void AlignBits()
+    {
+        if( (accbits & 7) != 0 )
+            PutBits( 0, 8 - (accbits & 7) );
+    }
+    inline bool Aligned() const { return (accbits & 7) == 0; }
+    inline int ByteCount() const { return unflushed + (accbits >> 3); }
+
+    /**************
+     *
+     * Append the contents of the buffer (which need not be byte-aligned)
+     * to another buffer and then reset it.
+     *
+     *************/
+    template <class DestFragBuf>
+    void TransferTo( DestFragBuf &dest )
+    {
+        for( int i = 0; i < unflushed; i += 4 )
+            dest.PutBits( (static_cast<uint32_t>(buffer[i]) << 24)
+                          | (buffer[i+1] << 16) | (buffer[i+2] << 8)
+                          | buffer[i+3], 32 );
+        if( accbits != 0 )
+            dest.PutBits( static_cast<uint32_t>(accum), accbits );
+        ResetBuffer();
+    }
     
 private:
     void AdjustBuffer();
 
+    /**************
+     *
+     * Store 32 bits big-endian (compilers turn this into a
+     * byte-swapping store).
+     *
+     *************/
+    inline void PutWord( uint32_t word )
+    {
+        if( unflushed + 4 > buffer_size )
+            AdjustBuffer();
+        buffer[unflushed] = static_cast<uint8_t>(word >> 24);
+        buffer[unflushed+1] = static_cast<uint8_t>(word >> 16);
+        buffer[unflushed+2] = static_cast<uint8_t>(word >> 8);
+        buffer[unflushed+3] = static_cast<uint8_t>(word);
+        unflushed += 4;
+    }
+
 protected:
     ElemStrmWriter &writer;
     uint8_t *buffer;            // Output buffer - used to hold byte
                                 // aligned output before flushing or
                                 // backing up and re-encoding
     int buffer_size;
+    int unflushed;              // Bytes stored in buffer
+    uint64_t accum;             // Bits not yet stored...
+    int accbits;                // ... how many (always < 32)
 };
 
 
 /******************************
  *
- * Elementry stream buffer used to accumulate (byte-aligned) fragments ofencoded video.  Currently
- * each frame has its own buffer.
+ * CountOnlyFragBuf - Fragment buffer that only counts the bits coded.
+ * Used to find out how many bits alternative codings would take
+ * without generating them.
  *
  *****************************/
 
-class CountOnlyFragBuf : public OutputFragBuf
+class CountOnlyFragBuf
 {
 public:
-	CountOnlyFragBuf();
-    ~CountOnlyFragBuf();
-
-    /**************
-     *
-     * Flush out buffer
-     * N.b. attempts to flush in non byte-aligned states are illegal
-     * and will abort
-     *
-     *************/
-    virtual void FlushBuffer();
-
-    /**************
-     *
-     * Reset buffer - empty buffer discarding current contents.
-     *
-     * ***********/
-
-    virtual void ResetBuffer();
-
-    /**************
-     *
-     * Write rightmost (least significant) n (0<=n<=32) bits of val to current buffer
-     *
-     *************/
-    virtual void PutBits( uint32_t val, int n);
+	CountOnlyFragBuf() : bits( 0 ) {}
+
+    inline void FlushBuffer() { bits = 0; }
+    inline void ResetBuffer() { bits = 0; }
+    inline void PutBits( uint32_t val, int n) { bits += n; }
+    inline void AlignBits() { bits = (bits + 7) & ~7; }
+    inline bool Aligned() const { return (bits & 7) == 0; }
+    inline int ByteCount() const { return bits >> 3; }
+    inline int BitCount() const { return bits; }
+
+    template <class DestFragBuf>
+    void TransferTo( DestFragBuf &dest )
+    {
+        mjpeg_error_exit1( "INTERNAL: bit counting buffers can't be transferred" );
+    }
 
+private:
+    int bits;
 };
-
+
 /* 
  * Local variables:
  *  c-file-style: "stroustrup"
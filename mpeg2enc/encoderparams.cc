@@ -59,12 +59,15 @@
 #include "ratectl.hh"
 #include "cpu_accel.h"
 #include "motionsearch.h"
+#include "imageplanes.hh"
 #include <string.h> // REMOVE
 
 #define MAX(a,b) ( (a)>(b) ? (a) : (b) )
 #define MIN(a,b) ( (a)<(b) ? (a) : (b) )
 
-EncoderParams::EncoderParams( const MPEG2EncOptions &encoptions)
+EncoderParams::EncoderParams( const MPEG2EncOptions &encoptions) :
+    instrumentation( 0 ),
+    snr_totals( 0 )
 {
 }
 
@@ -97,10 +100,43 @@ void EncoderParams::InitEncodingControls( const MPEG2EncOptions &options)
 		break;
 	}
 
+    gop_parallel = options.gop_parallel > MAX_WORKER_THREADS ?
+                   MAX_WORKER_THREADS : options.gop_parallel;
+    chunk_frames = options.chunk_gops * N_max;
+    stream_frame_offset = 0;
+
+    /* By default only read ahead in a thread of our own if we're
+       using threads anyway */
+    if( options.read_ahead >= 0 )
+        read_ahead_frames = options.read_ahead;
+    else if( encoding_parallelism > 0 || gop_parallel > 0 )
+        read_ahead_frames = 8;
+    else
+        read_ahead_frames = 0;
+    memory_budget = static_cast<uint64_t>(options.memory_budget) << 20;
+
+    /* By default look for scene cuts far enough ahead to plan the
+       next two GOPs - unless GOP length is fixed anyway */
+    if( options.lookahead >= 0 )
+        lookahead_frames = options.lookahead;
+    else
+        lookahead_frames = N_max + N_min;
+    if( N_min == N_max )
+        lookahead_frames = 0;
+    adaptive_bgroups = options.adaptive_bgroups && M > 1 && M_min == 1;
+    if( options.adaptive_bgroups && !adaptive_bgroups )
+    {
+        mjpeg_warn( "Adaptive B frames need B frames (-R) that may be dropped (no -P): ignored" );
+    }
+
 	me44_red		= options.me44_red;
 	me22_red		= options.me22_red;
+    predictive_me   = options.predictive_search != 0;
+    global_me       = options.global_motion != 0;
 
     unit_coeff_elim	= options.unit_coeff_elim;
+    rd_quant        = options.rd_quant != 0;
+    rd_mode_cands   = options.rd_mode_cands;
 
 	/* round picture dimensions to nearest multiple of 16 or 32 */
 	mb_width = (horizontal_size+15)/16;
@@ -158,6 +194,26 @@ void EncoderParams::InitEncodingControls( const MPEG2EncOptions &options)
 
 	mb_per_pict = mb_width*mb_height2;
 
+    /* Reading ahead is only an optimisation: it mustn't take more
+       than a quarter of any memory budget. */
+    if( memory_budget > 0 )
+    {
+        int max_read_ahead = 
+            static_cast<int>( memory_budget / 4 / ImagePlanes::BufferSize( *this ) );
+        if( read_ahead_frames > max_read_ahead )
+        {
+            mjpeg_info( "Memory budget: read-ahead reduced to %d frames",
+                        max_read_ahead );
+            read_ahead_frames = max_read_ahead;
+        }
+        if( lookahead_frames > max_read_ahead )
+        {
+            mjpeg_info( "Memory budget: scene cut lookahead reduced to %d frames",
+                        max_read_ahead );
+            lookahead_frames = max_read_ahead;
+        }
+    }
+
 
 #ifdef OUTPUT_STAT
 	/* open statistics output file */
@@ -180,7 +236,11 @@ static int f_code( int max_radius )
 	return c;
 }
 
-void EncoderParams::Init( const MPEG2EncOptions &options )
+/*
+ * RETURN: false (after reporting why) iff the options are unusable.
+ */
+
+bool EncoderParams::Init( const MPEG2EncOptions &options )
 {
 	int i;
     const char *msg = 0;
@@ -238,7 +298,8 @@ void EncoderParams::Init( const MPEG2EncOptions &options )
 
 	if(options.bitrate == 0 )
 	{
-		mjpeg_error_exit1( "Generic format - must specify bit-rate!" );
+		mjpeg_error( "Generic format - must specify bit-rate!" );
+		return false;
 	}
 
 	still_size = 0;
@@ -708,10 +769,12 @@ void EncoderParams::Init( const MPEG2EncOptions &options )
 		}
 	}
 
-    InitQuantMatrices( options );
+    if( !InitQuantMatrices( options ) )
+        return false;
     InitEncodingControls( options );
 
     chapter_points.insert(chapter_points.end(),options.chapter_points.begin(),options.chapter_points.end());
+    return true;
 }
 
 
@@ -734,7 +797,7 @@ static int quant_hfnoise_filt(int orgquant, int qmat_pos, double hf_q_boost )
     }
 
 
-void EncoderParams::InitQuantMatrices( const MPEG2EncOptions &options )
+bool EncoderParams::InitQuantMatrices( const MPEG2EncOptions &options )
 {
     int i, v;
     const char *msg = NULL;
@@ -798,9 +861,9 @@ void EncoderParams::InitQuantMatrices( const MPEG2EncOptions &options )
         niqmat = options.custom_nonintra_quantizer_matrix;
         break;
     default:
-        mjpeg_error_exit1("Help!  Unknown hf_quant value %d",
-                          options.hf_quant);
-        /* NOTREACHED */
+        mjpeg_error("Help!  Unknown hf_quant value %d",
+                    options.hf_quant);
+        return false;
     }
 
     if  (msg)
@@ -810,15 +873,21 @@ void EncoderParams::InitQuantMatrices( const MPEG2EncOptions &options )
     {
         v = quant_hfnoise_filt(qmat[i], i, options.hf_q_boost);
         if  (v < 1 || v > 255)
-            mjpeg_error_exit1("bad intra value after -N adjust");
+        {
+            mjpeg_error("bad intra value after -N adjust");
+            return false;
+        }
         intra_q[i] = v;
 
         v = quant_hfnoise_filt(niqmat[i], i, options.hf_q_boost);
         if  (v < 1 || v > 255)
-            mjpeg_error_exit1("bad nonintra value after -N adjust");
+        {
+            mjpeg_error("bad nonintra value after -N adjust");
+            return false;
+        }
         inter_q[i] = v;
     }
-
+    return true;
 }
 
 
@@ -81,15 +81,17 @@ struct motion_data {
 
 struct RateCtl;
 class MPEG2EncOptions;
+class Instrumentation;
+class SNRTotals;
 
 class EncoderParams
 {
 public:
 	EncoderParams( const MPEG2EncOptions &options);
-	void Init(const MPEG2EncOptions &options);
+	bool Init(const MPEG2EncOptions &options);   // False iff options unusable
 
 private:
-	void InitQuantMatrices(const class MPEG2EncOptions &options);
+	bool InitQuantMatrices(const class MPEG2EncOptions &options);
 	void InitEncodingControls(const class MPEG2EncOptions &options);
 	void RangeChecks();
 	void ProfileAndLevelChecks();
@@ -235,6 +237,10 @@ public:
     int me44_red;			/* Sub-mean population reduction passes
                             * for 4x4 and 2x2 */
     int me22_red;			/* Motion compensation stages  */
+    bool predictive_me;     /* Predictive search seeded from neighbouring
+                               and previous motion vectors */
+    bool global_me;         /* Centre frame motion searches on the
+                               estimated global motion */
     int seq_length_limit;
     double nonvid_bit_rate;	/* Bit-rate for non-video to assume for
 								   sequence splitting calculations */
@@ -253,11 +259,33 @@ public:
     int encoding_parallelism; /* Maximum number of concurrent worker threads
                                  to be used for encoding  */
 
+    int gop_parallel;           /* Number of chunks of the stream encoded
+                                   concurrently (0 = sequential encoding) */
+    int chunk_frames;           /* Frames per chunk (a whole number of
+                                   maximum length GOPs) */
+    int stream_frame_offset;    /* Input stream frame # of first frame
+                                   encoded.  Non-0 only when encoding a
+                                   chunk of a stream. */
+    int read_ahead_frames;      /* Input frames the reader thread reads
+                                   ahead of the encoder (0 = no thread) */
+    uint64_t memory_budget;     /* Bytes of buffer memory optional
+                                   buffering must fit in (0 = unlimited) */
+    int lookahead_frames;       /* Input frames scanned ahead of the
+                                   encoder for scene cuts (0 = none) */
+    bool adaptive_bgroups;      /* Choose # B frames (up to M-1) of
+                                   each B group using the lookahead */
+
     int unit_coeff_elim;	/* Threshold of unit coefficient
                                    density below which unit
                                    coefficient blocks should be
                                    zeroed.  < 0 implies DCT
                                    coefficient should be included. */
+    bool rd_quant;              /* Rate-distortion optimised (trellis)
+                                   quantisation */
+    int rd_mode_cands;          /* Number of each macroblock's best (by
+                                   variance) coding modes from which the
+                                   one coded is selected by rate-distortion
+                                   cost (0/1 = simply the best by variance) */
 
     double coding_tolerance;  /* Fraction of bit allocation that
                                       actual coding size may deviate from
@@ -266,6 +294,12 @@ public:
 
     deque<int> chapter_points; /* Frame #'s for where chapters occur (I frames, closed GOP's) */
 
+    Instrumentation *instrumentation; /* Stage timing / counts collector
+                                         (0 = none).  Owned by the
+                                         MPEG2Encoder. */
+    SNRTotals *snr_totals;          /* Reconstruction error totals
+                                       (0 = not measured) */
+
 };
 
 
@@ -52,6 +52,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "mjpeg_types.h"
+#include "transfrm_ref.h"
 
 static double aanscales[64];
 static float  aanscalesf[64];
@@ -433,43 +434,55 @@ void fdct_test(int16_t *block)
 
 #endif
 
-#ifndef PI
-# ifdef M_PI
-#  define PI M_PI
-# else
-#  define PI 3.14159265358979323846
-# endif
-#endif
-
-/* private data */
-static int c[8][8]; /* transform coefficients */
+/*
+ * Integer fdct.  A plain matrix multiply, rows then columns, but with
+ * enough precision to meet the IEEE-1180 accuracy limits (the 9 bit
+ * coefficients used previously were well outside them).  Row
+ * coefficients have FDCT_ROW_BITS fractional bits, the row pass
+ * results are kept to 16 bits (saturated) with FDCT_FRAC_BITS
+ * fractional bits and the column coefficients have FDCT_COL_BITS.
+ * Thus every product is 16*16->32 bits and, for 12 bit input, every
+ * sum fits in 32 bits: which is what lets the SIMD versions
+ * (dct_sse2.c) give results *identical* to this one.
+ *
+ * coeff[i][j] = round( s(i) * cos( pi/8 * i * (j+1/2) ) * 2^bits )
+ * where s(0) = sqrt(1/8) and s(i>0) = 1/2.
+ */
 
+const int16_t fdct_row_coeffs[8][8] =
+{
+    {  11585,  11585,  11585,  11585,  11585,  11585,  11585,  11585 },
+    {  16069,  13623,   9102,   3196,  -3196,  -9102, -13623, -16069 },
+    {  15137,   6270,  -6270, -15137, -15137,  -6270,   6270,  15137 },
+    {  13623,  -3196, -16069,  -9102,   9102,  16069,   3196, -13623 },
+    {  11585, -11585, -11585,  11585,  11585, -11585, -11585,  11585 },
+    {   9102, -16069,   3196,  13623, -13623,  -3196,  16069,  -9102 },
+    {   6270, -15137,  15137,  -6270,  -6270,  15137, -15137,   6270 },
+    {   3196,  -9102,  13623, -16069,  16069, -13623,   9102,  -3196 }
+};
 
-/*!
- * Warning this DCT is actually too imprecise... it really
- * needs 11-bit precise coefficiencts (FDCT_COS_BITS=11)
- * to avoid nasty mismatch errors at low q.  Unfortunately
- * it would then need > 32 bits.   It is also suspect
- * that rounding is towards +infinity rather than away from 0.
- */
+const int16_t fdct_col_coeffs[8][8] =
+{
+    {   5793,   5793,   5793,   5793,   5793,   5793,   5793,   5793 },
+    {   8035,   6811,   4551,   1598,  -1598,  -4551,  -6811,  -8035 },
+    {   7568,   3135,  -3135,  -7568,  -7568,  -3135,   3135,   7568 },
+    {   6811,  -1598,  -8035,  -4551,   4551,   8035,   1598,  -6811 },
+    {   5793,  -5793,  -5793,   5793,   5793,  -5793,  -5793,   5793 },
+    {   4551,  -8035,   1598,   6811,  -6811,  -1598,   8035,  -4551 },
+    {   3135,  -7568,   7568,  -3135,  -3135,   7568,  -7568,   3135 },
+    {   1598,  -4551,   6811,  -8035,   8035,  -6811,   4551,  -1598 }
+};
 
+#define FDCT_ROW_SHIFT (FDCT_ROW_BITS-FDCT_FRAC_BITS)
+#define FDCT_COL_SHIFT (FDCT_COL_BITS+FDCT_FRAC_BITS)
 
-#define FDCT_COS_BITS 9
-#define FDCT_COS_MUL (1<<FDCT_COS_BITS)
-#define FDCT_RES_SHIFT (2*FDCT_COS_BITS)
-#define FDCT_RES_ROUND (1<<(FDCT_RES_SHIFT-1))
+static inline int16_t saturate16( int x )
+{
+    return x < -32768 ? -32768 : (x > 32767 ? 32767 : x);
+}
 
 void init_fdct(void)
 {
-	int i, j;
-	double s;
-
-	for (i=0; i<8; i++)
-	{
-		s = (i==0) ? sqrt(0.125) : 0.5;
-		for (j=0; j<8; j++)
-			c[i][j] = (s * cos((PI/8.0)*i*(j+0.5))*FDCT_COS_MUL + 0.5);
-	}
 #ifdef FDCTTEST
     init_fdct_daan();
     init_fdct_ref();
@@ -481,43 +494,29 @@ void init_fdct(void)
 void fdct(int16_t *block)
 {
 
-	int i, j;
-	int tmp[64];
+	int i, j, k;
+	int16_t tmp[64];
 	for (i=0; i<8; i++)
 		for (j=0; j<8; j++)
 		{
-			int s =
-				  c[j][0] * block[8*i+0]
-				+ c[j][1] * block[8*i+1]
-				+ c[j][2] * block[8*i+2]
-				+ c[j][3] * block[8*i+3]
-				+ c[j][4] * block[8*i+4]
-				+ c[j][5] * block[8*i+5]
-				+ c[j][6] * block[8*i+6]
-				+ c[j][7] * block[8*i+7];
-
-			tmp[8*i+j] = s;
+			int s = 1<<(FDCT_ROW_SHIFT-1);
+			for (k=0; k<8; k++)
+				s += fdct_row_coeffs[j][k] * block[8*i+k];
+			tmp[8*i+j] = saturate16(s>>FDCT_ROW_SHIFT);
 		}
 
 	for (j=0; j<8; j++)
 		for (i=0; i<8; i++)
 		{
-			int s =
-				  c[i][0] * tmp[8*0+j]
-				+ c[i][1] * tmp[8*1+j]
-				+ c[i][2] * tmp[8*2+j]
-				+ c[i][3] * tmp[8*3+j]
-				+ c[i][4] * tmp[8*4+j]
-				+ c[i][5] * tmp[8*5+j]
-				+ c[i][6] * tmp[8*6+j]
-				+ c[i][7] * tmp[8*7+j];
-
-			block[8*i+j] = (s+FDCT_RES_ROUND)>>FDCT_RES_SHIFT;
+			int s = 1<<(FDCT_COL_SHIFT-1);
+			for (k=0; k<8; k++)
+				s += fdct_col_coeffs[i][k] * tmp[8*k+j];
+			block[8*i+j] = saturate16(s>>FDCT_COL_SHIFT);
 		}
 
 }
 
-
+
 /* 
  * Local variables:
  *  c-file-style: "stroustrup"
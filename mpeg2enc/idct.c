@@ -50,6 +50,11 @@
 /* this code assumes >> to be a two's-complement arithmetic */
 /* right shift: (-2)>>1 == -1 , (-3)>>1 == -2               */
 
+/* N.b. the SIMD versions (dct_sse2.c) give results identical to
+   this code for *any* input.  For this the (out of range) multiplies
+   by 181 are done modulo 2^32 as they are in SIMD registers and the
+   final clipping does not rely on a table. */
+
 
 // define if you want to include idct testing code
 #define IDCTTEST
@@ -65,8 +70,10 @@
 /* global declarations */
 
 /* private data */
-static int16_t iclip[1024]; /* clipping table */
-static int16_t *iclp;
+static inline int16_t iclp(int x)
+{
+  return (x<-256) ? -256 : ((x>255) ? 255 : x);
+}
 
 /* private prototypes */
 static void idctrow (int16_t *blk);
@@ -120,8 +127,8 @@ static void idctrow(int16_t *blk)
   x8 -= x3;
   x3 = x0 + x2;
   x0 -= x2;
-  x2 = (181*(x4+x5)+128)>>8;
-  x4 = (181*(x4-x5)+128)>>8;
+  x2 = (int)(181U*(x4+x5)+128)>>8;
+  x4 = (int)(181U*(x4-x5)+128)>>8;
   
   /* fourth stage */
   blk[0] = (x7+x1)>>8;
@@ -152,7 +159,7 @@ static void idctcol(int16_t *blk)
         (x4 = blk[8*1]) | (x5 = blk[8*7]) | (x6 = blk[8*5]) | (x7 = blk[8*3])))
   {
     blk[8*0]=blk[8*1]=blk[8*2]=blk[8*3]=blk[8*4]=blk[8*5]=blk[8*6]=blk[8*7]=
-      iclp[(blk[8*0]+32)>>6];
+      iclp((blk[8*0]+32)>>6);
     return;
   }
 
@@ -182,18 +189,18 @@ static void idctcol(int16_t *blk)
   x8 -= x3;
   x3 = x0 + x2;
   x0 -= x2;
-  x2 = (181*(x4+x5)+128)>>8;
-  x4 = (181*(x4-x5)+128)>>8;
+  x2 = (int)(181U*(x4+x5)+128)>>8;
+  x4 = (int)(181U*(x4-x5)+128)>>8;
   
   /* fourth stage */
-  blk[8*0] = iclp[(x7+x1)>>14];
-  blk[8*1] = iclp[(x3+x2)>>14];
-  blk[8*2] = iclp[(x0+x4)>>14];
-  blk[8*3] = iclp[(x8+x6)>>14];
-  blk[8*4] = iclp[(x8-x6)>>14];
-  blk[8*5] = iclp[(x0-x4)>>14];
-  blk[8*6] = iclp[(x3-x2)>>14];
-  blk[8*7] = iclp[(x7-x1)>>14];
+  blk[8*0] = iclp((x7+x1)>>14);
+  blk[8*1] = iclp((x3+x2)>>14);
+  blk[8*2] = iclp((x0+x4)>>14);
+  blk[8*3] = iclp((x8+x6)>>14);
+  blk[8*4] = iclp((x8-x6)>>14);
+  blk[8*5] = iclp((x0-x4)>>14);
+  blk[8*6] = iclp((x3-x2)>>14);
+  blk[8*7] = iclp((x7-x1)>>14);
 }
 
 /* two dimensional inverse discrete cosine transform */
@@ -339,12 +346,6 @@ void idct_test(int16_t *block)
 
 void init_idct(void)
 {
-  int i;
-
-  iclp = iclip+512;
-  for (i= -512; i<512; i++)
-    iclp[i] = (i<-256) ? -256 : ((i>255) ? 255 : i);
-
 #ifdef IDCTTEST
   memset(&idct_res,0,sizeof(idct_res));
   init_idct_ref();
@@ -1,3 +1,5 @@
+#include <string.h>
+#include "motionsearch.h"
 #include "imageplanes.hh"
 
 
@@ -80,3 +82,91 @@ void ImagePlanes::BorderMark( uint8_t *frame,
         }
     }
 }
+
+
+/*********************
+ *
+ * BorderExtend - Pad out the image data read to the encoded (whole
+ * macroblock) size by replicating the last pixel of each line and the
+ * last line(s).  For interlaced material lines are replicated from
+ * the same field.
+ *
+ ********************/
+
+void ImagePlanes::BorderExtend( EncoderParams &encparams )
+{
+    int width = static_cast<int>(encparams.horizontal_size);
+    int height = static_cast<int>(encparams.vertical_size);
+    if( width == encparams.enc_width && height == encparams.enc_height )
+        return;
+
+    int line_step = encparams.prog_seq ? 1 : 2;
+    EdgeReplicate( planes[0], encparams.phy_width,
+                   width, height,
+                   encparams.enc_width, encparams.enc_height,
+                   line_step );
+    for( int c = 1; c <= 2; ++c )
+        EdgeReplicate( planes[c], encparams.phy_chrom_width,
+                       width/2, height/2,
+                       encparams.enc_chrom_width, encparams.enc_chrom_height,
+                       line_step );
+}
+
+void ImagePlanes::EdgeReplicate( uint8_t *plane, int stride,
+                                 int data_width, int data_height,
+                                 int total_width, int total_height,
+                                 int line_step )
+{
+    int i, j;
+    for( j = 0; j < data_height; ++j )
+    {
+        uint8_t *line = plane + j*stride;
+        for( i = data_width; i < total_width; ++i )
+            line[i] = line[data_width-1];
+    }
+    for( j = data_height; j < total_height; ++j )
+    {
+        int src = j - line_step >= 0 ? j - line_step : j - 1;
+        memcpy( plane + j*stride, plane + src*stride, total_width );
+    }
+}
+
+/*********************
+ *
+ * SubSampleLum - Compute the 2*2 and 4*4 sub-sampled luminance
+ * (appended to the Y plane) used for motion estimation.  For field
+ * pictures each field is sub-sampled separately.
+ *
+ ********************/
+
+void ImagePlanes::SubSampleLum( EncoderParams &encparams )
+{
+    int linestride = encparams.fieldpic 
+        ? 2*encparams.phy_width 
+        : encparams.phy_width;
+    uint8_t *org_Y = planes[0];
+    psubsample_image( org_Y, 
+                      linestride,
+                      org_Y+encparams.fsubsample_offset, 
+                      org_Y+encparams.qsubsample_offset );
+}
+
+/*********************
+ *
+ * SwapPlanes - Exchange the image data (Y, U and V planes, the Y
+ * plane's appended sub-sampled data included) with another
+ * ImagePlanes of the same encoder, so a frame can be handed over
+ * without copying it.
+ *
+ ********************/
+
+void ImagePlanes::SwapPlanes( ImagePlanes &other )
+{
+    for( int c = YPLANE; c <= VPLANE; ++c )
+    {
+        uint8_t *tmp = planes[c];
+        planes[c] = other.planes[c];
+        other.planes[c] = tmp;
+    }
+}
+
@@ -43,8 +43,20 @@ class ImagePlanes
 
         inline uint8_t *Plane( unsigned int plane) { return planes[plane]; }
         inline uint8_t **Planes() { return planes; }
+
+        void SwapPlanes( ImagePlanes &other );
+        void BorderExtend( EncoderParams &encparams );
+        void SubSampleLum( EncoderParams &encparams );
+
+        // Bytes of storage used by an ImagePlanes
+        static unsigned int BufferSize( EncoderParams &encparams )
+            { return encparams.lum_buffer_size + 2 * encparams.chrom_buffer_size; }
     
     protected:
+        static void EdgeReplicate( uint8_t *plane, int stride,
+                                   int data_width, int data_height,
+                                   int total_width, int total_height,
+                                   int line_step );
         static void BorderMark( uint8_t *frame,  
                                 int total_width, int total_height,
                                 int image_data_width, int image_data_height);
@@ -0,0 +1,276 @@
+/*  instrumentation.cc - Per-stage timing and event counts of the
+ *  encoder, written out as JSON lines.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include "mjpeg_logging.h"
+#include "mpeg2syntaxcodes.h"
+#include "tables.h"
+#include "picture.hh"
+#include "instrumentation.hh"
+
+static const char *stage_names[NUM_STAGES] =
+{
+    "read", "subsample", "me", "transform", "quant", "vlc", "recon"
+};
+
+static const char *sad_kind_names[NUM_SAD_KINDS] =
+{
+    "sad_00", "sad_01", "sad_10", "sad_11", "bsad",
+    "build_sub44_mests", "build_sub22_mests", "find_best_one_pel"
+};
+
+Instrumentation::Instrumentation( const char *filename, int _interval ) :
+    interval( _interval ),
+    pictures( 0 ),
+    since_flush( 0 ),
+    bytes( 0 )
+{
+    file = fopen( filename, "w" );
+    if( file == 0 )
+        mjpeg_error_exit1( "Couldn't create instrumentation file %s: %s",
+                           filename, strerror(errno) );
+    for( int s = 0; s < NUM_STAGES; ++s )
+        stage_totals[s] = 0;
+    for( int k = 0; k < NUM_SAD_KINDS; ++k )
+        sad_totals[k] = 0;
+    pthread_mutex_init( &lock, NULL );
+}
+
+Instrumentation::~Instrumentation()
+{
+    if( !pending.empty() )
+        Flush();
+    fclose( file );
+    pthread_mutex_destroy( &lock );
+}
+
+uint64_t Instrumentation::NowUsec()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+/*
+ * Records are only queued: they're written out by Flush so the
+ * encoder isn't held up by file I/O every picture.
+ */
+
+void Instrumentation::Emit( const std::string &record )
+{
+    pending.push_back( record );
+}
+
+void Instrumentation::FrameRead( int frame, uint64_t read_usec,
+                                 uint64_t subsample_usec )
+{
+    char buf[128];
+    snprintf( buf, sizeof(buf),
+              "{\"record\":\"frame\",\"frame\":%d,"
+              "\"read_us\":%llu,\"subsample_us\":%llu}",
+              frame,
+              static_cast<unsigned long long>(read_usec),
+              static_cast<unsigned long long>(subsample_usec) );
+    pthread_mutex_lock( &lock );
+    stage_totals[STAGE_READ] += read_usec;
+    stage_totals[STAGE_SUBSAMPLE] += subsample_usec;
+    Emit( buf );
+    pthread_mutex_unlock( &lock );
+}
+
+/*
+ * A picture's coding has been committed to the output: record the
+ * time spent on it in every encoding it had.  N.b. decode numbers
+ * start afresh with each GOP-parallel chunk.
+ */
+
+void Instrumentation::PictureCoded( const Picture &picture )
+{
+    char buf[128];
+    std::string record;
+    snprintf( buf, sizeof(buf),
+              "{\"record\":\"picture\",\"frame\":%d,\"decode\":%d,"
+              "\"type\":\"%c\",\"struct\":\"%s\",\"bytes\":%d",
+              picture.encparams.stream_frame_offset + picture.present,
+              picture.decode,
+              pict_type_char[picture.pict_type],
+              picture.pict_struct == FRAME_PICTURE ? "frame"
+              : picture.pict_struct == TOP_FIELD ? "top" : "bottom",
+              picture.EncodedSize() / 8 );
+    record = buf;
+    for( int s = STAGE_ME; s < NUM_STAGES; ++s )
+    {
+        snprintf( buf, sizeof(buf), ",\"%s_us\":%llu", stage_names[s],
+                  static_cast<unsigned long long>(picture.timings.usec[s]) );
+        record += buf;
+    }
+    record += "}";
+
+    pthread_mutex_lock( &lock );
+    for( int s = STAGE_ME; s < NUM_STAGES; ++s )
+        stage_totals[s] += picture.timings.usec[s];
+    for( int k = 0; k < NUM_SAD_KINDS; ++k )
+        sad_totals[k] += picture.sad_calls.calls[k];
+    bytes += picture.EncodedSize() / 8;
+    ++pictures;
+    ++since_flush;
+    Emit( record );
+    pthread_mutex_unlock( &lock );
+}
+
+/*
+ * Busy time of each of a Despatcher's worker threads and the time
+ * they have existed.
+ */
+
+void Instrumentation::WorkerTimes( const std::vector<uint64_t> &busy_usec,
+                                   uint64_t elapsed_usec )
+{
+    char buf[64];
+    std::string record = "{\"record\":\"workers\",\"busy_us\":[";
+    for( unsigned int i = 0; i < busy_usec.size(); ++i )
+    {
+        snprintf( buf, sizeof(buf), "%s%llu", i == 0 ? "" : ",",
+                  static_cast<unsigned long long>(busy_usec[i]) );
+        record += buf;
+    }
+    record += "],\"idle_us\":[";
+    for( unsigned int i = 0; i < busy_usec.size(); ++i )
+    {
+        uint64_t idle = elapsed_usec > busy_usec[i] ? elapsed_usec - busy_usec[i] : 0;
+        snprintf( buf, sizeof(buf), "%s%llu", i == 0 ? "" : ",",
+                  static_cast<unsigned long long>(idle) );
+        record += buf;
+    }
+    record += "]}";
+
+    pthread_mutex_lock( &lock );
+    Emit( record );
+    pthread_mutex_unlock( &lock );
+}
+
+bool Instrumentation::FlushDue()
+{
+    pthread_mutex_lock( &lock );
+    bool due = interval > 0 && since_flush >= static_cast<unsigned int>(interval);
+    pthread_mutex_unlock( &lock );
+    return due;
+}
+
+void Instrumentation::EmitTotals()
+{
+    char buf[128];
+    std::string record;
+
+    snprintf( buf, sizeof(buf),
+              "{\"record\":\"totals\",\"pictures\":%u,\"bytes\":%llu",
+              pictures, static_cast<unsigned long long>(bytes) );
+    record = buf;
+    for( int s = 0; s < NUM_STAGES; ++s )
+    {
+        snprintf( buf, sizeof(buf), ",\"%s_us\":%llu", stage_names[s],
+                  static_cast<unsigned long long>(stage_totals[s]) );
+        record += buf;
+    }
+    record += ",\"sad_calls\":{";
+    for( int k = 0; k < NUM_SAD_KINDS; ++k )
+    {
+        snprintf( buf, sizeof(buf), "%s\"%s\":%llu", k == 0 ? "" : ",",
+                  sad_kind_names[k], static_cast<unsigned long long>(sad_totals[k]) );
+        record += buf;
+    }
+    record += "}}";
+    Emit( record );
+}
+
+void Instrumentation::Flush()
+{
+    pthread_mutex_lock( &lock );
+    EmitTotals();
+    for( unsigned int i = 0; i < pending.size(); ++i )
+        fprintf( file, "%s\n", pending[i].c_str() );
+    fflush( file );
+    pending.clear();
+    since_flush = 0;
+    pthread_mutex_unlock( &lock );
+}
+
+
+SNRTotals::SNRTotals() :
+    pictures( 0 )
+{
+    for( int c = 0; c < 3; ++c )
+        sqr_err[c] = pels[c] = 0.0;
+    pthread_mutex_init( &lock, NULL );
+}
+
+SNRTotals::~SNRTotals()
+{
+    pthread_mutex_destroy( &lock );
+}
+
+void SNRTotals::Add( const Picture &picture )
+{
+    pthread_mutex_lock( &lock );
+    for( int c = 0; c < 3; ++c )
+    {
+        sqr_err[c] += picture.sqr_err[c];
+        pels[c] += picture.snr_pels[c];
+    }
+    ++pictures;
+    pthread_mutex_unlock( &lock );
+}
+
+void SNRTotals::Add( const SNRTotals &totals )
+{
+    pthread_mutex_lock( &lock );
+    for( int c = 0; c < 3; ++c )
+    {
+        sqr_err[c] += totals.sqr_err[c];
+        pels[c] += totals.pels[c];
+    }
+    pictures += totals.pictures;
+    pthread_mutex_unlock( &lock );
+}
+
+double SNRTotals::PSNR( int comp ) const
+{
+    double mse = pels[comp] > 0.0 ? sqr_err[comp] / pels[comp] : 0.0;
+    // Keeps a perfect reconstruction's PSNR finite
+    if( mse < 0.00001 )
+        mse = 0.00001;
+    return 10.0 * log10( 255.0 * 255.0 / mse );
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
@@ -0,0 +1,227 @@
+#ifndef _INSTRUMENTATION_HH
+#define _INSTRUMENTATION_HH
+
+/*  instrumentation.hh - Per-stage timing and event counts of the
+ *  encoder, written out as JSON lines.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <string>
+#include <vector>
+#include "mjpeg_types.h"
+
+class Picture;
+
+/*
+ * The stages a picture's encoding time is broken down into.  Reading
+ * and sub-sampling are per input frame rather than per picture.
+ */
+
+enum InstrStage
+{
+    STAGE_READ,
+    STAGE_SUBSAMPLE,
+    STAGE_ME,                   // Motion estimation and mode selection
+    STAGE_TRANSFORM,            // Prediction and forward DCT
+    STAGE_QUANT,
+    STAGE_VLC,
+    STAGE_RECON,                // Inverse quantisation / DCT
+    NUM_STAGES
+};
+
+/*********************
+ *
+ * StageTimes - Time (usec) spent in each stage.  Add may be called
+ * concurrently from several threads: the work of a stage is usually
+ * shared out between the worker threads so the times are summed
+ * thread time not elapsed time.
+ *
+ ********************/
+
+class StageTimes
+{
+public:
+    StageTimes() { Clear(); }
+    void Clear()
+        {
+            for( int s = 0; s < NUM_STAGES; ++s )
+                usec[s] = 0;
+        }
+    inline void Add( InstrStage stage, uint64_t t )
+        { __sync_fetch_and_add( &usec[stage], t ); }
+    uint64_t usec[NUM_STAGES];
+};
+
+/*
+ * The motion search routines whose calls are counted.  The SADs of
+ * the sub-sampled images are made within the build_sub*_mests
+ * routines and aren't counted separately.
+ */
+
+enum SADKind
+{
+    SAD_00, SAD_01, SAD_10, SAD_11, BSAD,
+    BUILD_SUB44_MESTS, BUILD_SUB22_MESTS, FIND_BEST_ONE_PEL,
+    NUM_SAD_KINDS
+};
+
+/*********************
+ *
+ * SADCounts - Calls of each motion search routine.  A macroblock's
+ * motion estimation counts in counts of its own which are then added
+ * to its picture's.  As for StageTimes Add may be called
+ * concurrently.
+ *
+ ********************/
+
+class SADCounts
+{
+public:
+    SADCounts() { Clear(); }
+    void Clear()
+        {
+            for( int k = 0; k < NUM_SAD_KINDS; ++k )
+                calls[k] = 0;
+        }
+    void Add( const SADCounts &counts )
+        {
+            for( int k = 0; k < NUM_SAD_KINDS; ++k )
+                if( counts.calls[k] != 0 )
+                    __sync_fetch_and_add( &calls[k], counts.calls[k] );
+        }
+    uint64_t calls[NUM_SAD_KINDS];
+};
+
+/*********************
+ *
+ * Instrumentation - Collects the stage times of each coded picture
+ * and each input frame read, counts of the motion search SAD routine
+ * calls and of the bytes coded.  Records are written as JSON lines
+ * to a file every 'interval' coded pictures (if interval > 0) and at
+ * the end of the stream, each batch closing with a "totals" record of
+ * the running totals.
+ *
+ * Despatchers (the worker threads) report their busy / idle times
+ * when a batch is written: so only the SeqEncoder's despatch of work
+ * is observed, and in GOP-parallel mode there is one "workers" record
+ * per chunk.
+ *
+ * The SAD counts are those of the pictures coded (Picture::sad_calls),
+ * counted only by instrumented encoders.
+ *
+ ********************/
+
+class Instrumentation
+{
+public:
+    Instrumentation( const char *filename, int interval );
+    ~Instrumentation();
+
+    static uint64_t NowUsec();
+
+    void FrameRead( int frame, uint64_t read_usec, uint64_t subsample_usec );
+    void PictureCoded( const Picture &picture );
+    void WorkerTimes( const std::vector<uint64_t> &busy_usec,
+                      uint64_t elapsed_usec );
+    bool FlushDue();
+    void Flush();
+
+private:
+    void Emit( const std::string &record );
+    void EmitTotals();
+
+    FILE *file;
+    int interval;
+    pthread_mutex_t lock;           // Guards everything below
+    std::vector<std::string> pending;
+    unsigned int pictures;          // Pictures coded
+    unsigned int since_flush;       // ... since the last batch written
+    uint64_t bytes;                 // Bytes of coded pictures
+    uint64_t stage_totals[NUM_STAGES];
+    uint64_t sad_totals[NUM_SAD_KINDS];
+};
+
+/*********************
+ *
+ * SNRTotals - Sums the squared errors of the reconstructed pictures
+ * against the originals (see Picture::CalcSNR) to give the PSNR of a
+ * whole stream.  Setting EncoderParams::snr_totals has B pictures
+ * reconstructed too, which they otherwise need not be.  Add may be
+ * called concurrently (GOP-parallel chunks' totals are added as the
+ * chunks are written out).
+ *
+ ********************/
+
+class SNRTotals
+{
+public:
+    SNRTotals();
+    ~SNRTotals();
+
+    void Add( const Picture &picture );
+    void Add( const SNRTotals &totals );
+    unsigned int Pictures() const { return pictures; }
+    double PSNR( int comp ) const;  // comp: 0 Y, 1 Cb, 2 Cr
+
+private:
+    pthread_mutex_t lock;
+    unsigned int pictures;
+    double sqr_err[3];
+    double pels[3];
+};
+
+/*********************
+ *
+ * StageTimer - Times its own lifetime as stage 'stage' of 'times'.
+ * A null instrumentation means timing is off.
+ *
+ ********************/
+
+class StageTimer
+{
+public:
+    StageTimer( const Instrumentation *instr, StageTimes &_times,
+                InstrStage _stage ) :
+        times( instr != 0 ? &_times : 0 ),
+        stage( _stage ),
+        start( instr != 0 ? Instrumentation::NowUsec() : 0 )
+        {}
+    ~StageTimer()
+        {
+            if( times != 0 )
+                times->Add( stage, Instrumentation::NowUsec() - start );
+        }
+private:
+    StageTimes *times;
+    InstrStage stage;
+    uint64_t start;
+};
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
+#endif
@@ -0,0 +1,302 @@
+/*  lookahead.cc - Cheap analysis of input frames ahead of the encoder
+ *  used to plan GOP structure (scene cuts) before encoding.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mjpeg_logging.h"
+#include "fastintfns.h"
+#include "motionsearch.h"
+#include "encoderparams.hh"
+#include "imageplanes.hh"
+#include "picturereader.hh"
+#include "lookahead.hh"
+
+/*
+ * Search radius (in 4*4 sub-sampled pels) when predicting a
+ * macroblock's 4*4 sub-sampled luminance from the previous frame.
+ */
+
+#define LOOKAHEAD_SEARCH_RADIUS 2
+
+/*
+ * A frame is a scene cut if more than SCENE_CUT_INTRA of its
+ * macroblocks look intra coded (c.f. GOP splitting after pass-1 in
+ * SeqEncoder) and that is a jump of more than SCENE_CUT_JUMP over its
+ * predecessor.  The latter stops material that is hard to predict
+ * throughout (flashing, noise) from being chopped into minimum
+ * length GOPs.
+ */
+
+#define SCENE_CUT_INTRA 0.6
+#define SCENE_CUT_JUMP 0.3
+
+/*
+ * Costs of B frames are weighted relative to I/P frames when choosing
+ * B frame group lengths: B frames are quantised more coarsely and
+ * their coding errors don't propagate.
+ */
+
+#define BGROUP_B_WEIGHT 0.7
+#define BGROUP_MAX_RADIUS 4
+
+
+/*
+ * Sum of absolute deviations from its mean of a 4*4 block: a cheap
+ * stand-in for the cost of intra coding the corresponding macroblock.
+ */
+
+static int block_intra( uint8_t *blk, int lx )
+{
+    int sum = 0;
+    int intra = 0;
+    int i, j;
+    for( j = 0; j < 4; ++j )
+        for( i = 0; i < 4; ++i )
+            sum += blk[i+j*lx];
+    int mean = (sum+8)>>4;
+    for( j = 0; j < 4; ++j )
+        for( i = 0; i < 4; ++i )
+            intra += abs( blk[i+j*lx]-mean );
+    return intra;
+}
+
+
+Lookahead::Lookahead( EncoderParams &_encparams, PictureReader &_reader ) :
+    encparams( _encparams ),
+    reader( _reader )
+{
+}
+
+void Lookahead::Init()
+{
+    w44 = encparams.enc_width>>2;
+    h44 = encparams.enc_height>>2;
+    qlx = encparams.phy_width>>2;
+    frames_scanned = 0;
+    prev_intra = 0.0;
+    scene_cuts.clear();
+}
+
+/*
+ * Estimate the fraction of macroblocks of a frame that would be
+ * intra coded if it were predicted from the previous frame scanned:
+ * those whose best match nearby in the previous frame is worse than
+ * their deviation from their own mean.
+ */
+
+double Lookahead::IntraFraction( uint8_t *cur44 )
+{
+    int blocks = 0;
+    int intra_blocks = 0;
+    int bx, by;
+    uint8_t *match;
+
+    for( by = 0; by+4 <= h44; by += 4 )
+        for( bx = 0; bx+4 <= w44; bx += 4 )
+        {
+            uint8_t *blk = cur44+bx+by*qlx;
+            if( BlockMatch( &prev44[0], blk, bx, by, LOOKAHEAD_SEARCH_RADIUS, match )
+                > block_intra( blk, qlx ) )
+                ++intra_blocks;
+            ++blocks;
+        }
+
+    return blocks > 0 ? static_cast<double>(intra_blocks) / blocks : 0.0;
+}
+
+/*
+ * Find the best match within r sub-sampled pels in the 4*4 sub-sampled
+ * luminance of a reference frame for the 4*4 block at (bx,by).
+ *
+ * RETURN: SAD of the best match, match set to point to it.
+ */
+
+int Lookahead::BlockMatch( uint8_t *ref44, uint8_t *blk, int bx, int by, int r,
+                           uint8_t *&match )
+{
+    int best = INT_MAX;
+    int dx, dy;
+    for( dy = -r; dy <= r; ++dy )
+    {
+        if( by+dy < 0 || by+dy+4 > h44 )
+            continue;
+        for( dx = -r; dx <= r; ++dx )
+        {
+            if( bx+dx < 0 || bx+dx+4 > w44 )
+                continue;
+            uint8_t *cand = ref44+(bx+dx)+(by+dy)*qlx;
+            int d = (*psad_sub44)( cand, blk, qlx, 4 );
+            if( d < best )
+            {
+                best = d;
+                match = cand;
+            }
+        }
+    }
+    return best;
+}
+
+uint8_t *Lookahead::Frame44( int frame )
+{
+    return reader.ReadFrame( frame )->Plane(0)+encparams.qsubsample_offset;
+}
+
+/*
+ * Cost of coding frame cur as a P frame predicted from frame ref.
+ * The search radius grows with the distance between the frames.
+ */
+
+int Lookahead::PCost( int ref, int cur )
+{
+    uint8_t *ref44 = Frame44( ref );
+    uint8_t *cur44 = Frame44( cur );
+    int r = intmin( LOOKAHEAD_SEARCH_RADIUS*(cur-ref), BGROUP_MAX_RADIUS );
+    int cost = 0;
+    int bx, by;
+    uint8_t *match;
+
+    for( by = 0; by+4 <= h44; by += 4 )
+        for( bx = 0; bx+4 <= w44; bx += 4 )
+        {
+            uint8_t *blk = cur44+bx+by*qlx;
+            cost += intmin( BlockMatch( ref44, blk, bx, by, r, match ),
+                            block_intra( blk, qlx ) );
+        }
+    return cost;
+}
+
+/*
+ * Cost of coding frame cur as a B frame predicted from frames fwd
+ * and bwd: the cheapest of forward, backward and interpolated
+ * prediction and intra coding for each block.
+ */
+
+int Lookahead::BCost( int fwd, int bwd, int cur )
+{
+    uint8_t *fwd44 = Frame44( fwd );
+    uint8_t *bwd44 = Frame44( bwd );
+    uint8_t *cur44 = Frame44( cur );
+    int rf = intmin( LOOKAHEAD_SEARCH_RADIUS*(cur-fwd), BGROUP_MAX_RADIUS );
+    int rb = intmin( LOOKAHEAD_SEARCH_RADIUS*(bwd-cur), BGROUP_MAX_RADIUS );
+    int cost = 0;
+    int bx, by, i, j;
+    uint8_t *fmatch, *bmatch;
+
+    for( by = 0; by+4 <= h44; by += 4 )
+        for( bx = 0; bx+4 <= w44; bx += 4 )
+        {
+            uint8_t *blk = cur44+bx+by*qlx;
+            int best = intmin( BlockMatch( fwd44, blk, bx, by, rf, fmatch ),
+                               BlockMatch( bwd44, blk, bx, by, rb, bmatch ) );
+            int interp = 0;
+            for( j = 0; j < 4; ++j )
+                for( i = 0; i < 4; ++i )
+                    interp += abs( blk[i+j*qlx] 
+                                   - ((fmatch[i+j*qlx]+bmatch[i+j*qlx]+1)>>1) );
+            cost += intmin( intmin( best, interp ), block_intra( blk, qlx ) );
+        }
+    return cost;
+}
+
+/*
+ * Choose the B frame group length with the lowest (B weighted) cost.
+ * So that all candidates cost the same frames the frames following a
+ * shorter group are costed as a chain of P frames.  Ties go to the
+ * longer group as for static material everything is (nearly) free.
+ */
+
+int Lookahead::BGroupLength( int ref, int max_length )
+{
+    reader.FillBufferUpto( ref+max_length );
+    int last_frame = reader.NumberOfFrames()-1;
+    if( ref+max_length > last_frame )
+        return max_length;      // End of stream truncates the group anyway
+
+    int best_length = max_length;
+    double best_cost = 0.0;
+    double p_chain = 0.0;
+    int length, k;
+    for( length = max_length; length >= 1; --length )
+    {
+        double cost = PCost( ref, ref+length ) + p_chain;
+        for( k = 1; k < length; ++k )
+            cost += BGROUP_B_WEIGHT * BCost( ref, ref+length, ref+k );
+        mjpeg_debug( "Lookahead: B group %d+%d cost %.0f", ref, length, cost );
+        if( length == max_length || cost < best_cost )
+        {
+            best_length = length;
+            best_cost = cost;
+        }
+        if( length > 1 )
+            p_chain += PCost( ref+length-1, ref+length );
+    }
+    return best_length;
+}
+
+void Lookahead::ScanUpto( int frame )
+{
+    if( frame < frames_scanned )
+        return;
+    reader.FillBufferUpto( frame );
+    int last_frame = reader.NumberOfFrames()-1;
+    if( frame > last_frame )
+        frame = last_frame;
+
+    for( ; frames_scanned <= frame; ++frames_scanned )
+    {
+        uint8_t *cur44 =
+            reader.ReadFrame( frames_scanned )->Plane(0)+encparams.qsubsample_offset;
+        if( frames_scanned > 0 )
+        {
+            double intra = IntraFraction( cur44 );
+            mjpeg_debug( "Lookahead: frame %d intra %.2f", frames_scanned, intra );
+            if( intra > SCENE_CUT_INTRA && intra > prev_intra + SCENE_CUT_JUMP )
+            {
+                mjpeg_info( "Scene cut detected at frame %d", frames_scanned );
+                scene_cuts.insert( frames_scanned );
+            }
+            prev_intra = intra;
+        }
+        else
+            prev44.resize( qlx*h44 );
+        memcpy( &prev44[0], cur44, qlx*h44 );
+    }
+}
+
+int Lookahead::NextSceneCut( int from, int upto ) const
+{
+    std::set<int>::const_iterator cut = scene_cuts.lower_bound( from );
+    if( cut == scene_cuts.end() || *cut > upto )
+        return -1;
+    return *cut;
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
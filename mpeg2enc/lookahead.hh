@@ -0,0 +1,94 @@
+#ifndef _LOOKAHEAD_HH
+#define _LOOKAHEAD_HH
+
+/*  lookahead.hh - Cheap analysis of input frames ahead of the encoder
+ *  used to plan GOP structure (scene cuts) before encoding.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <set>
+#include <vector>
+#include "mjpeg_types.h"
+
+class EncoderParams;
+class PictureReader;
+
+/*********************
+ *
+ * Lookahead - Scores each input frame (in presentation order) for
+ * how badly it is predicted by its predecessor using only the 4*4
+ * sub-sampled luminance the reader has already prepared.  Frames
+ * that mostly can't be predicted are scene cuts: StreamState plans
+ * GOPs so that they start on them rather than discovering them
+ * after pass-1 encoding a P frame and then having to re-encode it.
+ *
+ * Frames are scanned strictly in order and the previous frame's
+ * sub-sampled luminance is kept so that the reader is free to
+ * release frames behind the scan.
+ *
+ * The same cheap inter/intra costs are used to choose how many B
+ * frames each B frame group of a GOP should have.
+ *
+ ********************/
+
+class Lookahead
+{
+public:
+    Lookahead( EncoderParams &encparams, PictureReader &reader );
+    void Init();
+
+    // Scan frames upto and including frame (or the end of the stream)
+    void ScanUpto( int frame );
+
+    // First scene cut c with from <= c <= upto, -1 if none known.
+    int NextSceneCut( int from, int upto ) const;
+    bool SceneCut( int frame ) const
+        { return scene_cuts.find( frame ) != scene_cuts.end(); }
+
+    // Length (B's plus their I/P frame) up to max_length of the
+    // B frame group following reference frame ref that codes cheapest.
+    int BGroupLength( int ref, int max_length );
+
+private:
+    double IntraFraction( uint8_t *cur44 );
+    uint8_t *Frame44( int frame );
+    int BlockMatch( uint8_t *ref44, uint8_t *blk, int bx, int by, int r,
+                    uint8_t *&match );
+    int PCost( int ref, int cur );
+    int BCost( int fwd, int bwd, int cur );
+
+    EncoderParams &encparams;
+    PictureReader &reader;
+    int w44, h44, qlx;              // 4*4 sub-sampled luminance dimensions
+    int frames_scanned;
+    double prev_intra;              // Intra fraction of last frame scanned
+    std::vector<uint8_t> prev44;    // ... and its 4*4 sub-sampled luminance
+    std::set<int> scene_cuts;
+};
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
+#endif
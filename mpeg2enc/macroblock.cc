@@ -22,10 +22,15 @@
 #include <stdio.h>
 #include <cassert>
 #include <limits.h>
+#include <math.h>
 
 #include "macroblock.hh"
 #include "mpeg2syntaxcodes.h"
 #include "picture.hh"
+#include "encoderparams.hh"
+#include "mpeg2coder.hh"
+#include "quantize.hh"
+#include "ratectl.hh"
 
 void MacroBlock::Encode()
 { 
@@ -42,20 +47,69 @@ void MacroBlock::MotionEstimateAndModeSelect()
 
 void MacroBlock::MotionEstimate()
 {
+    SADCounts counts;
+    SADCounts *sad_calls = 
+        picture->encparams.instrumentation != 0 ? &counts : 0;
+
 	if (picture->pict_struct==FRAME_PICTURE)
 	{			
-		FrameMEs();
+		FrameMEs( sad_calls );
 	}
 	else
 	{		
-		FieldME();
+		FieldME( sad_calls );
 	}
+    if( sad_calls != 0 )
+        picture->sad_calls.Add( counts );
+    RecordFrameMVs();
+}
+
+/*
+ * Record the frame motion vectors of the forward / backward frame
+ * prediction estimates (if any) in the picture's macroblock fields
+ * where motion vector prediction of later macroblocks and pictures
+ * looks for them.
+ */
+
+void MacroBlock::RecordFrameMVs()
+{
+    MotionEstSet::const_iterator i;
+    int mvs = 0;
+    for( i = best_of_kind_me.begin(); i < best_of_kind_me.end(); ++i )
+    {
+        if( i->motion_type != MC_FRAME )
+            continue;
+        if( i->mb_type == MB_FORWARD && !(mvs & (1<<MotionEst::fwd)) )
+        {
+            fields->frame_mv[MotionEst::fwd][k] = i->MV[0][MotionEst::fwd];
+            mvs |= 1<<MotionEst::fwd;
+        }
+        else if( i->mb_type == MB_BACKWARD && !(mvs & (1<<MotionEst::bwd)) )
+        {
+            fields->frame_mv[MotionEst::bwd][k] = i->MV[0][MotionEst::bwd];
+            mvs |= 1<<MotionEst::bwd;
+        }
+    }
+    fields->frame_mvs[k] = mvs;
+}
+
+/*
+ * Select the motion estimate the macroblock is to be coded with,
+ * keeping the copies of its hot fields in the picture's macroblock
+ * fields up to date.
+ */
+
+void MacroBlock::SetBestME( MotionEst *me )
+{
+    best_me = me;
+    fields->var[k] = me->var;
+    fields->mb_type[k] = me->mb_type;
 }
 
 void MacroBlock::SelectCodingModeOnVariance()
 {
-    vector<MotionEst>::iterator i;
-    vector<MotionEst>::iterator min_me;
+    MotionEstSet::iterator i;
+    MotionEst *best = 0;
     int best_score = INT_MAX;
     int best_fwd_score = INT_MAX;
     int cur_score;
@@ -72,7 +126,7 @@ void MacroBlock::SelectCodingModeOnVariance()
         if( cur_score < best_score )
         {
             best_score = cur_score;
-            best_me = &*i;
+            best = &*i;
         }
         if( i->mb_type & MB_BACKWARD == 0 && cur_score < best_fwd_score)
         {   
@@ -80,7 +134,204 @@ void MacroBlock::SelectCodingModeOnVariance()
             best_fwd_me = &*i;
         }
     }
+    SetBestME( best );
+
+}
+
+/**********************************************
+ *
+ * SelectCodingModeRD - Select the coding mode by actually coding
+ * the best few candidates (by variance, as above) and choosing the
+ * one with the least bits + lambda * squared error.  Each candidate
+ * is predicted, transformed and quantised (at rate control's initial
+ * quantisation for the picture) into scratch DCT blocks and the bits
+ * its coding would take are counted.
+ *
+ * This is done once, when pass-1 transforms the picture (see
+ * SeqEncoder::TransformPicture): only then are the prediction buffers
+ * and rate control for the picture set up.  Re-encodings keep the
+ * mode chosen.  It runs for each row of the picture's macroblocks in
+ * parallel on the worker threads.  A row is a slice, selected in
+ * order, so intra DC coefficients are costed relative to the DC
+ * predictors the slice coder will have.  Motion vectors are costed
+ * relative to the same kind of estimate of the macroblock to the
+ * left.
+ *
+ *********************************************/
+
+static const MotionEst *same_kind_me( const MacroBlock &mb, const MotionEst &me )
+{
+    MotionEstSet::const_iterator i;
+    for( i = mb.best_of_kind_me.begin(); i < mb.best_of_kind_me.end(); ++i )
+        if( i->mb_type == me.mb_type && i->motion_type == me.motion_type )
+            return &*i;
+    return 0;
+}
 
+static void count_mvs( MPEG2CountingBuf &counter, const Picture &picture,
+                       const MotionEst &me, const MotionEst *pred_me, int back )
+{
+    const bool frame = picture.pict_struct == FRAME_PICTURE;
+    const int hor_f_code = back ? picture.back_hor_f_code : picture.forw_hor_f_code;
+    const int vert_f_code = back ? picture.back_vert_f_code : picture.forw_vert_f_code;
+    const int vecs = me.motion_type == (frame ? MC_FIELD : MC_16X8) ? 2 : 1;
+    const int vshift = frame && me.motion_type != MC_FRAME ? 1 : 0;
+    const bool field_sel = frame ? me.motion_type == MC_FIELD : me.motion_type != MC_DMV;
+    int r;
+
+    for( r = 0; r < vecs; ++r )
+    {
+        int pmv_x = pred_me != 0 ? pred_me->MV[r][back][0] : 0;
+        int pmv_y = pred_me != 0 ? pred_me->MV[r][back][1] : 0;
+        if( field_sel )
+            counter.PutBits( me.field_sel[r][back], 1 );
+        counter.PutMV( me.MV[r][back][0] - pmv_x, hor_f_code );
+        counter.PutMV( (me.MV[r][back][1]>>vshift) - (pmv_y>>vshift), vert_f_code );
+    }
+    if( me.motion_type == MC_DMV )
+    {
+        counter.PutDMV( me.dualprimeMV[0] );
+        counter.PutDMV( me.dualprimeMV[1] );
+    }
+}
+
+/*
+ * Count the bits coding the macroblock in its selected mode would
+ * take.  dc_dct_pred: the intra DC predictors before the macroblock,
+ * updated as the slice coder would.
+ */
+
+int MacroBlock::CountCodingBits( MPEG2CountingBuf &counter, int dc_dct_pred[3] )
+{
+    const MotionEst *pred_me = 0;
+    const int cbp = CBP();
+    int mb_type = best_me->mb_type;
+    int comp;
+
+    if( TopleftX() > 0 )
+        pred_me = same_kind_me( *(this-1), *best_me );
+    if( cbp && !(mb_type & MB_INTRA) )
+        mb_type |= MB_PATTERN;
+    if( picture->pict_type == P_TYPE && !cbp )
+        mb_type |= MB_FORWARD;
+
+    counter.ResetBuffer();
+    counter.PutMBType( picture->pict_type, mb_type );
+    if( (mb_type & (MB_FORWARD|MB_BACKWARD)) && !picture->frame_pred_dct )
+        counter.PutBits( best_me->motion_type, 2 );
+    if( picture->pict_struct == FRAME_PICTURE && cbp && !picture->frame_pred_dct )
+        counter.PutBits( field_dct, 1 );
+    if( mb_type & MB_FORWARD )
+        count_mvs( counter, *picture, *best_me, pred_me, 0 );
+    if( mb_type & MB_BACKWARD )
+        count_mvs( counter, *picture, *best_me, pred_me, 1 );
+    if( mb_type & MB_PATTERN )
+        counter.PutCPB( cbp & 63 );
+
+    for( comp = 0; comp < BLOCK_COUNT; ++comp )
+    {
+        if( !(cbp & (1<<(BLOCK_COUNT-1-comp))) )
+            continue;
+        if( mb_type & MB_INTRA )
+            counter.PutIntraBlk( picture, qdctblocks[comp],
+                                 comp < 4 ? 0 : (comp&1)+1,
+                                 dc_dct_pred[comp < 4 ? 0 : (comp&1)+1] );
+        else
+            counter.PutNonIntraBlk( picture, qdctblocks[comp] );
+    }
+    return counter.BitCount();
+}
+
+void MacroBlock::SelectCodingModeRD()
+{
+    static const int max_cands = 16;
+    const int num_wanted = picture->encparams.rd_mode_cands < max_cands 
+        ? picture->encparams.rd_mode_cands
+        : max_cands;
+    MotionEst *cands[max_cands];
+    int scores[max_cands];
+    int num_cands = 0;
+    int k;
+    MotionEstSet::iterator i;
+
+    // The num_wanted candidates SelectCodingModeOnVariance would rank
+    // highest.  N.b. in a P picture (possibly a B picture being
+    // re-encoded as P) only forward prediction is possible.
+    for( i = best_of_kind_me.begin(); i < best_of_kind_me.end(); ++i )
+    {
+        if( picture->pict_type == P_TYPE && (i->mb_type & MB_BACKWARD) )
+            continue;
+        int score = i->var + (i->mb_type == MB_INTRA ? 3*3*256 : 0);
+        if( num_cands == num_wanted && score >= scores[num_cands-1] )
+            continue;
+        k = num_cands < num_wanted ? num_cands++ : num_wanted-1;
+        for( ; k > 0 && scores[k-1] > score; --k )
+        {
+            cands[k] = cands[k-1];
+            scores[k] = scores[k-1];
+        }
+        cands[k] = &*i;
+        scores[k] = score;
+    }
+
+    // Code each into the scratch blocks of our row of macroblocks
+    Picture::ModeSelectScratch &scratch =
+        picture->rd_scratch[Index() / picture->encparams.mb_width];
+    DCTblock *blocks = scratch.blocks;
+    DCTblock *qblocks = scratch.qblocks;
+    DCTblock *own_blocks = dctblocks;
+    DCTblock *own_qblocks = qdctblocks;
+    MPEG2CountingBuf &counter = *scratch.counter;
+    const double lambda = RateCtl::QuantLambda( picture->rd_mquant );
+    double best_cost = HUGE_VAL;
+    MotionEst *best = cands[0];
+    int best_dc_dct_pred[3] = { 0, 0, 0 };
+    int c;
+
+    // Slices start with (and non-intra macroblocks leave) the DC
+    // predictors reset
+    if( TopleftX() == 0 )
+        for( c = 0; c < 3; ++c )
+            scratch.dc_dct_pred[c] = 0;
+
+    SetDCTblocks( blocks, qblocks );
+    for( k = 0; k < num_cands; ++k )
+    {
+        int dc_dct_pred[3];
+        for( c = 0; c < 3; ++c )
+            dc_dct_pred[c] = scratch.dc_dct_pred[c];
+        best_me = cands[k];
+        Predict();
+        Transform();
+        MQuant() = picture->rd_mquant;
+        Quantize( picture->quantizer );
+        double cost = lambda * CountCodingBits( counter, dc_dct_pred );
+
+        // Squared error of the reconstructed coefficients
+        const bool intra = (best_me->mb_type & MB_INTRA) != 0;
+        IQuantize( picture->quantizer );
+        for( int b = 0; b < BLOCK_COUNT; ++b )
+        {
+            const bool coded = intra || (CBP() & (1<<(BLOCK_COUNT-1-b)));
+            for( int c = 0; c < 64; ++c )
+            {
+                const double err = blocks[b][c] - (coded ? qblocks[b][c] : 0);
+                cost += err * err;
+            }
+        }
+
+        if( cost < best_cost )
+        {
+            best_cost = cost;
+            best = cands[k];
+            for( c = 0; c < 3; ++c )
+                best_dc_dct_pred[c] = intra ? dc_dct_pred[c] : 0;
+        }
+    }
+    for( c = 0; c < 3; ++c )
+        scratch.dc_dct_pred[c] = best_dc_dct_pred[c];
+    SetDCTblocks( own_blocks, own_qblocks );
+    SetBestME( best );
 }
 
 /**********************************************
@@ -92,9 +343,9 @@ void MacroBlock::SelectCodingModeOnVariance()
 
 void MacroBlock::ForceIFrame()
 {
-    vector<MotionEst>::iterator i = best_of_kind_me.begin();
+    MotionEstSet::iterator i = best_of_kind_me.begin();
     assert( i->mb_type == MB_INTRA );
-    best_me = &*i;
+    SetBestME( &*i );
 }
 
 /**********************************************
@@ -107,7 +358,7 @@ void MacroBlock::ForceIFrame()
 
 void MacroBlock::ForcePFrame()
 {
-    best_me = best_fwd_me;
+    SetBestME( best_fwd_me );
 }
 
 
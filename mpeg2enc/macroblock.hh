@@ -49,6 +49,7 @@
  */
 
 #include <vector>
+#include <cassert>
 #include "mjpeg_types.h"
 #include "encodertypes.h"
 
@@ -74,8 +75,90 @@ public:
                    (measure of activity) */
 };
 
+/*
+ * The best motion estimate of each kind (best_of_kind_me) for a
+ * macroblock.  There are at most MAX_ME_KINDS: intra plus frame and
+ * field forward, backward and interpolated for a B frame picture.
+ * Held inline in the macroblock rather than as a separately
+ * allocated vector.
+ */
+
+#define MAX_ME_KINDS 8
+
+class MotionEstSet
+{
+public:
+    typedef MotionEst *iterator;
+    typedef const MotionEst *const_iterator;
+
+    MotionEstSet() : count(0) {}
+
+    inline iterator begin() { return me; }
+    inline iterator end() { return me+count; }
+    inline const_iterator begin() const { return me; }
+    inline const_iterator end() const { return me+count; }
+    inline unsigned int size() const { return count; }
+    inline MotionEst &operator[]( unsigned int k ) { return me[k]; }
+    inline const MotionEst &operator[]( unsigned int k ) const { return me[k]; }
+    inline void clear() { count = 0; }
+    inline void push_back( const MotionEst &est )
+        {
+            assert( count < MAX_ME_KINDS );
+            me[count++] = est;
+        }
+    template <class InputIterator>
+    void assign( InputIterator first, InputIterator last )
+        {
+            for( count = 0; first != last; ++first )
+                push_back( *first );
+        }
+
+private:
+    MotionEst me[MAX_ME_KINDS];
+    unsigned int count;
+};
+
+/*********************
+ *
+ * MacroBlockFields - The per-macroblock data of a picture that is
+ * swept through picture-wide (by rate control, statistics and motion
+ * vector prediction) kept as contiguous arrays indexed by macroblock
+ * number.  The macroblocks themselves are large and a sweep reading
+ * a field or two of each would otherwise touch a cache line or more
+ * per macroblock.
+ *
+ ********************/
+
+class MacroBlockFields
+{
+public:
+    void Init( unsigned int mbs )
+        {
+            act.assign( mbs, 0.0 );
+            mquant.assign( mbs, 0 );
+            cbp.assign( mbs, 0 );
+            var.assign( mbs, 0 );
+            mb_type.assign( mbs, 0 );
+            frame_mvs.assign( mbs, 0 );
+            frame_mv[0].resize( mbs );
+            frame_mv[1].resize( mbs );
+        }
+
+    vector<double> act;         // activity measure
+    vector<int> mquant;         // quantization parameter
+    vector<int> cbp;            // coded block pattern
+    vector<int> var;            // var of best_me
+    vector<int> mb_type;        // mb_type of best_me
+    vector<uint8_t> frame_mvs;  // Bit 1<<dir set if frame_mv[dir] valid
+    vector<MotionVector> frame_mv[2]; // Frame motion vectors of the
+                                      // forward/backward frame estimates
+};
+
 class Quantizer;
+class MPEG2CodingBuf;
+class MPEG2CountingBuf;
 class MotionCand;
+class SADCounts;
 
 /* macroblock information */
 class SubSampledImg;
@@ -84,35 +167,49 @@ class MacroBlock
 {
 public:
     MacroBlock(Picture &_picture,
+               MacroBlockFields &_fields,
+               const unsigned int _k,
                const unsigned int _i,
-               const unsigned int _j,
-               DCTblock *_dctblocks,
-               DCTblock *_qdctblocks
+               const unsigned int _j
                ) :
         picture(&_picture),
+        fields(&_fields),
+        k(_k),
         i(_i),
         j(_j),
         pel( _i, _j ),
         hpel( _i<<1, _j<<1 ),
-        dctblocks(_dctblocks),
-        qdctblocks(_qdctblocks)
+        dctblocks(0),
+        qdctblocks(0)
         {
         }
 
     inline Picture &ParentPicture() const { return *picture; }
-    inline int BaseLumVariance() const { return best_me->var; }
-    inline double Activity() const { return act; }
+    inline int BaseLumVariance() const { return fields->var[k]; }
+    inline double Activity() const { return fields->act[k]; }
+    inline int &MQuant() const { return fields->mquant[k]; }
+    inline int &CBP() const { return fields->cbp[k]; }
+    inline unsigned int Index() const { return k; }
     inline const int TopleftX() const { return i; }
     inline const int TopleftY() const { return j; }
     inline DCTblock *RawDCTblocks() const { return dctblocks; }
     inline DCTblock *QuantDCTblocks() const { return qdctblocks; }
+    inline void SetDCTblocks( DCTblock *_dctblocks, DCTblock *_qdctblocks )
+        {
+            dctblocks = _dctblocks;
+            qdctblocks = _qdctblocks;
+        }
 
 
     void Encode();
     void MotionEstimateAndModeSelect();
+    void SelectCodingModeRD();
     void ForceIFrame();
     void ForcePFrame();
+    void SetBestME( MotionEst *me );
+    void RecordFrameMVs();
     void Quantize( Quantizer &quant);             // In quantize.cc
+    void QuantizeRD( Quantizer &quant, MPEG2CodingBuf &coding );
     void IQuantize( Quantizer &quant);
     void Transform();          // In transfrm.cc
     void ITransform();
@@ -120,9 +217,10 @@ public:
 protected:
     void MotionEstimate();
     void SelectCodingModeOnVariance();
+    int CountCodingBits( MPEG2CountingBuf &counter, int dc_dct_pred[3] );
     void FrameME();            // In motionest.cc
-    void FrameMEs();
-    void FieldME();
+    void FrameMEs( SADCounts *sad_calls );
+    void FieldME( SADCounts *sad_calls );
     void Predict();            // In predict.cc
 
 
@@ -132,11 +230,14 @@ private:
                             const SubSampledImg &ssmb,
                             const MotionCand (&best_fieldmcs)[2][2], 
                             MotionCand &best_mc,
-                            MotionVector &min_dpmv);
+                            MotionVector &min_dpmv,
+                            SADCounts *sad_calls);
 
 private:
 
     Picture *picture;   
+    MacroBlockFields *fields;   // Picture's arrays of hot per-MB data
+    unsigned int k;             // Index of MB in picture (and fields)
     unsigned int i,j;           // Co-ordinates top-left in picture DEBUG
     Coord pel;                  // Co-ordinates top-left in picture (pels)
     Coord hpel;                 // Co-ordindates top-left in picture (half-pel)
@@ -155,14 +256,8 @@ private:
 
 public:
 	bool field_dct;             // Field DCT encoded rather than frame DCT
-	int mquant; /* quantization parameter */
-	int cbp; /* coded block pattern */
 	bool skipped; /* skipped macroblock */
-	double act; /* activity measure */
-	int i_act;  /* Activity measure if intra coded (I/P-frame) */
-	int p_act;  /* Activity measure for *forward* prediction (P-frame) */
-	int b_act;	/* Activity measure if bi-directionally coded (B-frame) */
-    vector<MotionEst> best_of_kind_me; 
+    MotionEstSet best_of_kind_me; 
                                  // The best predicting motion compensation
                                 // of each possible kind.
     MotionEst *best_me;      // Best predicting motion estimate overall
@@ -102,6 +102,30 @@ struct SubSampledImg
 	uint8_t *vmb;       // V component  one-pel
 };
 
+/*
+  Candidate vectors (pel offsets relative to the macroblock) with
+  which the predictive search is seeded.
+*/
+
+#define MAX_ME_PREDICTORS 8
+
+struct MEPredictors
+{
+    MEPredictors() : len(0) {}
+    void Add( int x, int y )
+        {
+            int k;
+            for( k = 0; k < len; ++k )
+                if( mv[k].x == x && mv[k].y == y )
+                    return;
+            if( len < MAX_ME_PREDICTORS )
+                mv[len++] = Coord( x, y );
+        }
+
+    int len;
+    Coord mv[MAX_ME_PREDICTORS];
+};
+
 
 
 /*
@@ -111,6 +135,7 @@ struct SubSampledImg
 
 
 static void field_estimate (const Picture &picture,
+							SADCounts *sad_calls,
 							uint8_t *toporg,
 							uint8_t *topref, 
 							uint8_t *botorg, 
@@ -124,13 +149,16 @@ static void field_estimate (const Picture &picture,
 
 static void mb_me_search (
     const EncoderParams &eparams,
+    SADCounts *sad_calls,
 	uint8_t *org, uint8_t *ref,
     int fieldoff,
 	SubSampledImg *ssblk,
 	int lx, int i0, int j0, 
 	int sx, int sy, int h, 
 	int xmax, int ymax,
-	MotionCand *motion );
+	MotionCand *motion,
+    const Coord &centre = Coord( 0, 0 ),
+    const MEPredictors *preds = 0 );
 
 
 inline int mv_coding_penalty( int mv_x, int mv_y )
@@ -138,6 +166,17 @@ inline int mv_coding_penalty( int mv_x, int mv_y )
     return (abs(mv_x) + abs(mv_y))<<3;
 }
 
+/*
+ * Count a call of a motion search routine.  sad_calls is null unless
+ * the encoder is instrumented.
+ */
+
+static inline void count_call( SADCounts *sad_calls, SADKind kind )
+{
+    if( sad_calls != 0 )
+        ++sad_calls->calls[kind];
+}
+
 
 /* 
  *  Compute subsampled images for fast motion compensation search
@@ -286,8 +325,10 @@ static inline int chrom_var_sum( SubSampledImg *ssblk, int h, int lx )
 static inline int bidir_pred_sad( const MotionCand *motion_f, 
 									  const MotionCand *motion_b,
 									  uint8_t *mb,  
-									  int lx, int h)
+									  int lx, int h,
+									  SADCounts *sad_calls)
 {
+	count_call( sad_calls, BSAD );
 	return pbsad(motion_f->blk, motion_b->blk, 
 					 mb, lx, 
 					 motion_f->hx, motion_f->hy,
@@ -336,6 +377,7 @@ static void display_mb(MotionCand *lum_mc,
 
 void FieldMotionCands(
     const EncoderParams &eparams,
+    SADCounts *sad_calls,
 	uint8_t *org,
 	uint8_t *ref,
 	SubSampledImg *topssmb,
@@ -347,14 +389,14 @@ void FieldMotionCands(
 	)
 {
 	/* predict top field from top field */
-	mb_me_search( eparams,
+	mb_me_search( eparams, sad_calls,
                   org,ref,0,topssmb,
                   eparams.phy_width<<1,i,j>>1,sx,sy>>1,8,
                   eparams.enc_width,eparams.enc_height>>1,
                   &fieldmcs[Parity::top][Parity::top]);
 
 	/* predict top field from bottom field */
-	mb_me_search( eparams,
+	mb_me_search( eparams, sad_calls,
                   org,ref,eparams.phy_width,topssmb, 
                   eparams.phy_width<<1,i,j>>1,sx,sy>>1,8,
                   eparams.enc_width,eparams.enc_height>>1, 
@@ -379,14 +421,14 @@ void FieldMotionCands(
 	}
 
 	/* predict bottom field from top field */
-	mb_me_search( eparams,
+	mb_me_search( eparams, sad_calls,
                   org,ref,0,botssmb,
                   eparams.phy_width<<1,i,j>>1,sx,sy>>1,8,
                   eparams.enc_width,eparams.enc_height>>1,
                   &fieldmcs[Parity::top][Parity::bot]);
 
 	/* predict bottom field from bottom field */
-	mb_me_search( eparams,
+	mb_me_search( eparams, sad_calls,
                   org,ref,eparams.phy_width,botssmb,
                   eparams.phy_width<<1,i,j>>1,sx,sy>>1,8,
                   eparams.enc_width,eparams.enc_height>>1,
@@ -428,7 +470,8 @@ bool DualPrimeMetric( const Picture &picture,
                       uint8_t *ref,
                       uint8_t *pred_mb,
                       int stride,
-                      int &measure
+                      int &measure,
+                      SADCounts *sad_calls
     )
 {
     Coord cross;
@@ -451,6 +494,7 @@ bool DualPrimeMetric( const Picture &picture,
         uint8_t *crossref = ref + cross_fieldoff
             + (cross.x>>1) + (stride<<1)*(cross.y>>1);
         /* compute prediction error */
+        count_call( sad_calls, BSAD );
         part_meas += meas( sameref, crossref,
                            pred_mb,
                            stride<<1,
@@ -471,7 +515,8 @@ MacroBlock::FrameDualPrimeCand (uint8_t *ref,
                                 const SubSampledImg &ssmb,
                                 const MotionCand (&best_fieldmcs)[Parity::dim][Parity::dim], 
                                 MotionCand &best_mc,
-                                MotionVector &min_dpmv)
+                                MotionVector &min_dpmv,
+                                SADCounts *sad_calls)
 {
 	int local_dist;
     int stride = picture->encparams.phy_width;
@@ -552,7 +597,8 @@ MacroBlock::FrameDualPrimeCand (uint8_t *ref,
                                          ref,
                                          ssmb.mb,
                                          stride,
-                                         local_dist );
+                                         local_dist,
+                                         sad_calls );
 
                     /* update best legal MV with smallest distortion
                      * distortion */
@@ -578,7 +624,8 @@ MacroBlock::FrameDualPrimeCand (uint8_t *ref,
                          ref,
                          ssmb.mb,
                          stride,
-                         best_mc.var );
+                         best_mc.var,
+                         0 );
         best_mc.sad = best_sad + mv_coding_penalty( min_same.x-mb.x, 
                                                     min_same.y-mb.y );
         best_mc.pos = min_same;
@@ -594,7 +641,8 @@ static void dpfield_estimate(
 	int i, int j, 
 	MotionCand *bestsp_mc,
 	MotionCand *bestdp_mc,
-	int *vmcp
+	int *vmcp,
+	SADCounts *sad_calls
 	)
 
 {
@@ -682,6 +730,7 @@ static void dpfield_estimate(
 	} /* end delta y loop */
 
 	/* Compute L1 error for decision purposes */
+	count_call( sad_calls, BSAD );
 	bestdp_mc->sad =
 		pbsad(
 			sameref + (imins>>1) + eparams.phy_width2*(jmins>>1),
@@ -697,6 +746,301 @@ static void dpfield_estimate(
 }
 
 
+/*
+ * Predictors for the predictive motion search.
+ *
+ * Frame motion vectors of macroblock index of a picture that has
+ * already been motion estimated (dir = MotionEst::fwd or
+ * MotionEst::bwd).  Half-pel units.
+ */
+
+static inline bool frame_motion_vector( const Picture &picture, int index,
+                                        int dir, MotionVector &mv )
+{
+    if( !(picture.mbfields.frame_mvs[index] & (1<<dir)) )
+        return false;
+    mv = picture.mbfields.frame_mv[dir][index];
+    return true;
+}
+
+/*
+ * Scale a half-pel vector component by num/den rounding to the
+ * nearest pel.
+ */
+
+static inline int scaled_pel( int hpel, int num, int den )
+{
+    int n = hpel * num;
+    int d = den << 1;
+    return n >= 0 ? (n + (d>>1)) / d : -((-n + (d>>1)) / d);
+}
+
+/*
+ * The picture whose frame motion vectors serve as temporal predictors
+ * for picture and the scaling of its vectors to vectors relative to
+ * picture's forward (scale[0]/den) and backward (scale[1]/den)
+ * reference.  The source is a P frame picture that picture is
+ * predicted from: the previous reference for P pictures, the next one
+ * for B pictures.  Its vectors span the interval picture lies in (B)
+ * or precedes (P) so motion continuity makes scaled versions good
+ * guesses.
+ *
+ * RETURN: 0 if there is no usable source.
+ */
+
+static const Picture *temporal_mv_source( const Picture &picture,
+                                          int scale[2], int &den )
+{
+    const Picture *src;
+    if( picture.pict_struct != FRAME_PICTURE || picture.fwd_ref_frame == 0 )
+        return 0;
+    if( picture.pict_type == P_TYPE )
+        src = picture.fwd_ref_frame;
+    else if( picture.pict_type == B_TYPE )
+        src = picture.bwd_ref_frame;
+    else
+        return 0;
+    if( src == 0 || src->pict_type != P_TYPE 
+        || src->pict_struct != FRAME_PICTURE || src->fwd_ref_distance <= 0 )
+        return 0;
+
+    den = src->fwd_ref_distance;
+    scale[0] = picture.fwd_ref_distance;
+    scale[1] = picture.present - src->present;
+    return src;
+}
+
+/*
+ * Global motion pre-pass.
+ *
+ * Coarse level: every 16*16 block of the 4*4 sub-sampled luminance
+ * (64*64 pels) of the picture is exhaustively matched against the
+ * sub-sampled reference within +/- r44.  Blocks whose best match
+ * is clearly better than no motion vote for its displacement, the
+ * others vote for 0.  The most popular displacement wins if
+ * enough blocks agree.
+ *
+ * RETURN: false if there is no convincing global motion.
+ */
+
+#define GM_BLOCK 16
+
+static bool global_motion_44( uint8_t *cur44, uint8_t *ref44,
+                              int qlx, int w44, int h44, 
+                              int rx, int ry,
+                              Coord &g44, SADCounts *sad_calls )
+{
+    int vw = 2*rx+1;
+    vector<int> votes( vw*(2*ry+1), 0 );
+    int blocks = 0;
+    int bx, by, dx, dy;
+
+    for( by = 0; by+GM_BLOCK <= h44; by += GM_BLOCK )
+        for( bx = 0; bx+GM_BLOCK <= w44; bx += GM_BLOCK )
+        {
+            uint8_t *blk = cur44+bx+by*qlx;
+            count_call( sad_calls, SAD_00 );
+            int zero = psad_00( ref44+bx+by*qlx, blk, qlx, GM_BLOCK, INT_MAX );
+            int best = zero;
+            int bvx = 0, bvy = 0;
+            for( dy = -ry; dy <= ry; ++dy )
+            {
+                if( by+dy < 0 || by+dy+GM_BLOCK > h44 )
+                    continue;
+                for( dx = -rx; dx <= rx; ++dx )
+                {
+                    if( bx+dx < 0 || bx+dx+GM_BLOCK > w44 )
+                        continue;
+                    count_call( sad_calls, SAD_00 );
+                    int d = psad_00( ref44+(bx+dx)+(by+dy)*qlx, blk, 
+                                     qlx, GM_BLOCK, best );
+                    if( d < best )
+                    {
+                        best = d;
+                        bvx = dx;
+                        bvy = dy;
+                    }
+                }
+            }
+            if( best*8 >= zero*7 )
+                bvx = bvy = 0;
+            ++votes[(bvx+rx)+(bvy+ry)*vw];
+            ++blocks;
+        }
+
+    int winner = rx+ry*vw;
+    int k;
+    for( k = 0; k < static_cast<int>(votes.size()); ++k )
+    {
+        if( votes[k] > votes[winner] 
+            || ( votes[k] == votes[winner] 
+                 && abs(k%vw-rx)+abs(k/vw-ry) < abs(winner%vw-rx)+abs(winner/vw-ry) ) )
+            winner = k;
+    }
+    g44 = Coord( winner%vw-rx, winner/vw-ry );
+    return (g44.x != 0 || g44.y != 0) && votes[winner]*4 >= blocks;
+}
+
+/*
+ * Fine level: choose the displacement within one 2*2 sub-sampled pel
+ * of the coarse estimate that best matches the whole picture.
+ *
+ * RETURN: displacement in 2*2 sub-sampled pels.
+ */
+
+static Coord global_motion_22( uint8_t *cur22, uint8_t *ref22,
+                               int flx, int w22, int h22,
+                               const Coord &g44, SADCounts *sad_calls )
+{
+    Coord c( g44.x<<1, g44.y<<1 );
+    Coord best = c;
+    int best_sad = INT_MAX;
+    int bx, by, ex, ey;
+
+    for( ey = -1; ey <= 1; ++ey )
+        for( ex = -1; ex <= 1; ++ex )
+        {
+            int dx = c.x+ex;
+            int dy = c.y+ey;
+            int sad = 0;
+            int blocks = 0;
+            // Only blocks whose displaced match lies inside the
+            // reference for *all* candidates so sums are comparable
+            for( by = 0; by+GM_BLOCK <= h22; by += GM_BLOCK )
+            {
+                if( by+c.y-1 < 0 || by+c.y+1+GM_BLOCK > h22 )
+                    continue;
+                for( bx = 0; bx+GM_BLOCK <= w22; bx += GM_BLOCK )
+                {
+                    if( bx+c.x-1 < 0 || bx+c.x+1+GM_BLOCK > w22 )
+                        continue;
+                    count_call( sad_calls, SAD_00 );
+                    sad += psad_00( ref22+(bx+dx)+(by+dy)*flx, 
+                                    cur22+bx+by*flx, flx, GM_BLOCK, INT_MAX );
+                    ++blocks;
+                }
+            }
+            if( blocks > 0 && sad < best_sad )
+            {
+                best_sad = sad;
+                best = Coord( dx, dy );
+            }
+        }
+    return best;
+}
+
+/*
+ * Estimate the global motion of a frame picture relative to its
+ * reference picture(s) hierarchically from the sub-sampled luminance
+ * of the original images.  The result (in pels) seeds the predictive
+ * search.  Unless disabled the frame motion searches are also
+ * centred on it: the offset is rounded to whole 4*4 sub-sampled pels
+ * and limited so the vectors searched are still legal for the
+ * picture's f_codes.
+ */
+
+void Picture::EstimateGlobalMotion()
+{
+    int dir;
+    for( dir = 0; dir < 2; ++dir )
+    {
+        global_motion[dir] = Coord( 0, 0 );
+        search_centre[dir] = Coord( 0, 0 );
+    }
+    if( !(encparams.global_me || encparams.predictive_me)
+        || pict_struct != FRAME_PICTURE || pict_type == I_TYPE )
+        return;
+
+    int qlx = encparams.phy_width>>2;
+    int flx = encparams.phy_width>>1;
+    int ndirs = pict_type == B_TYPE ? 2 : 1;
+    SADCounts counts;
+    SADCounts *sad_counts = encparams.instrumentation != 0 ? &counts : 0;
+    for( dir = 0; dir < ndirs; ++dir )
+    {
+        ImagePlanes *ref = dir == 0 ? fwd_org : bwd_org;
+        int hor_f_code = dir == 0 ? forw_hor_f_code : back_hor_f_code;
+        int vert_f_code = dir == 0 ? forw_vert_f_code : back_vert_f_code;
+        int sx = dir == 0 ? sxf : sxb;
+        int sy = dir == 0 ? syf : syb;
+
+        // Widest legal range: 4<<f_code pels (capped to keep the
+        // exhaustive coarse search affordable)
+        int rx = intmin( 1<<hor_f_code, 16 );
+        int ry = intmin( 1<<vert_f_code, 16 );
+        Coord g44;
+        if( !global_motion_44( org_img->Plane(0)+encparams.qsubsample_offset,
+                               ref->Plane(0)+encparams.qsubsample_offset,
+                               qlx, encparams.enc_width>>2, encparams.enc_height>>2,
+                               rx, ry, g44, sad_counts ) )
+            continue;
+        Coord g22 = global_motion_22( org_img->Plane(0)+encparams.fsubsample_offset,
+                                      ref->Plane(0)+encparams.fsubsample_offset,
+                                      flx, encparams.enc_width>>1, encparams.enc_height>>1,
+                                      g44, sad_counts );
+        global_motion[dir] = Coord( g22.x<<1, g22.y<<1 );
+
+        if( encparams.global_me )
+        {
+            int lx = intmax( (4<<hor_f_code) - sx, 0 ) & ~3;
+            int ly = intmax( (4<<vert_f_code) - sy, 0 ) & ~3;
+            int cx = (global_motion[dir].x/4)*4;
+            int cy = (global_motion[dir].y/4)*4;
+            search_centre[dir] = Coord( cx < -lx ? -lx : (cx > lx ? lx : cx),
+                                        cy < -ly ? -ly : (cy > ly ? ly : cy) );
+        }
+    }
+    if( sad_counts != 0 )
+        sad_calls.Add( counts );
+}
+
+/*
+ * Gather the predictors for the predictive search of a macroblock of
+ * a frame picture: the zero vector, the macroblock to the left, the
+ * co-located macroblock of the temporal source and its neighbours to
+ * the right and below, and the picture's global motion.  N.b. the
+ * macroblock above is deliberately not used: with multi-threading
+ * the row above may still be being searched which would make the
+ * result depend on thread timing.
+ */
+
+static void gather_predictors( const MacroBlock &mb, int dir,
+                               MEPredictors &preds )
+{
+    const Picture &picture = mb.ParentPicture();
+    const EncoderParams &eparams = picture.encparams;
+    int index = mb.Index();
+    MotionVector mv;
+
+    preds.Add( 0, 0 );
+    if( mb.TopleftX() > 0 
+        && frame_motion_vector( picture, index-1, dir, mv ) )
+        preds.Add( scaled_pel( mv[Dim::X], 1, 1 ), 
+                   scaled_pel( mv[Dim::Y], 1, 1 ) );
+
+    int scale[2], den;
+    const Picture *src = temporal_mv_source( picture, scale, den );
+    if( src != 0 )
+    {
+        int colocated[3];
+        int n = 0;
+        colocated[n++] = index;
+        if( mb.TopleftX() + 16 < eparams.enc_width )
+            colocated[n++] = index+1;
+        if( index + eparams.mb_width < eparams.mb_per_pict )
+            colocated[n++] = index+eparams.mb_width;
+        for( int k = 0; k < n; ++k )
+        {
+            if( frame_motion_vector( *src, colocated[k],
+                                     MotionEst::fwd, mv ) )
+                preds.Add( scaled_pel( mv[Dim::X], scale[dir], den ),
+                           scaled_pel( mv[Dim::Y], scale[dir], den ) );
+        }
+    }
+
+    preds.Add( picture.global_motion[dir].x, picture.global_motion[dir].y );
+}
+
 /*
  * Collection motion estimates for the different modes for frame pictures
  * picture: picture object for which MC is to be computed.
@@ -713,7 +1057,7 @@ static void dpfield_estimate(
 const static bool trace_me = false;
 #endif
 
-void MacroBlock::FrameMEs()
+void MacroBlock::FrameMEs( SADCounts *sad_calls )
 {
     const Picture &picture = ParentPicture();
     const EncoderParams &eparams = picture.encparams;
@@ -741,6 +1085,10 @@ void MacroBlock::FrameMEs()
 	MotionCand best_fieldmcs[2][2];
     MotionVector min_dpmv;
 
+    // Seed vectors for the predictive search (if selected)
+    MEPredictors fwd_preds;
+    MEPredictors bwd_preds;
+
     int mb_row_start = j*eparams.phy_width;
 	
     MotionEst me;
@@ -803,12 +1151,16 @@ void MacroBlock::FrameMEs()
                                  eparams.phy_width, 16 );
         best_of_kind_me.push_back( me );
 
-        mb_me_search( eparams,
+        if( eparams.predictive_me )
+            gather_predictors( *this, MotionEst::fwd, fwd_preds );
+        mb_me_search( eparams, sad_calls,
                       picture.fwd_org->Plane(0),picture.fwd_rec->Plane(0),
                       0,
                       &ssmb, eparams.phy_width,
                       i,j,picture.sxf,picture.syf,16,
-                      eparams.enc_width,eparams.enc_height, &framef_mc);
+                      eparams.enc_width,eparams.enc_height, &framef_mc,
+                      picture.search_centre[0],
+                      eparams.predictive_me ? &fwd_preds : 0 );
         framef_mc.fieldoff = 0;
 
         me.mb_type = MB_FORWARD;
@@ -828,7 +1180,7 @@ void MacroBlock::FrameMEs()
 			botssmb.umb = ssmb.umb+(eparams.phy_width>>1);
 			botssmb.vmb = ssmb.vmb+(eparams.phy_width>>1);
 
-			FieldMotionCands( eparams,
+			FieldMotionCands( eparams, sad_calls,
                                         picture.fwd_org->Plane(0), picture.fwd_rec->Plane(0),
                                         &ssmb, &botssmb,
                                         i,j,picture.sxf,picture.syf,
@@ -852,7 +1204,8 @@ void MacroBlock::FrameMEs()
 
 			if ( eparams.dualprime 
         && FrameDualPrimeCand( picture.fwd_rec->Plane(0), ssmb,
-                                       best_fieldmcs, dualpf_mc, min_dpmv ) 
+                                       best_fieldmcs, dualpf_mc, min_dpmv,
+                                       sad_calls ) 
                 )
             {
                     me.mb_type = MB_FORWARD;
@@ -871,21 +1224,31 @@ void MacroBlock::FrameMEs()
 
         /*  FRAME modes: always possible */
 
+        if( eparams.predictive_me )
+        {
+            gather_predictors( *this, MotionEst::fwd, fwd_preds );
+            gather_predictors( *this, MotionEst::bwd, bwd_preds );
+        }
+
         // Forward motion estimates
-        mb_me_search( eparams,
+        mb_me_search( eparams, sad_calls,
                       picture.fwd_org->Plane(0),picture.fwd_rec->Plane(0),0,&ssmb,
                                 eparams.phy_width,i,j,picture.sxf,picture.syf,
                                 16,eparams.enc_width,eparams.enc_height,
-                                &framef_mc
+                                &framef_mc,
+                      picture.search_centre[0],
+                      eparams.predictive_me ? &fwd_preds : 0
 					   );
         framef_mc.fieldoff = 0;
         
         // Backword motion estimates...
-        mb_me_search( eparams,
+        mb_me_search( eparams, sad_calls,
                       picture.bwd_org->Plane(0),picture.bwd_rec->Plane(0),0,&ssmb,
                       eparams.phy_width, i,j,picture.sxb,picture.syb,
                       16, eparams.enc_width, eparams.enc_height,
-                      &frameb_mc);
+                      &frameb_mc,
+                      picture.search_centre[1],
+                      eparams.predictive_me ? &bwd_preds : 0 );
         frameb_mc.fieldoff = 0;
 
         me.motion_type = MC_FRAME;
@@ -921,7 +1284,7 @@ void MacroBlock::FrameMEs()
 			botssmb.vmb = ssmb.vmb+(eparams.phy_width>>1);
 
             // Forward motion estimates...
-			FieldMotionCands( eparams,
+			FieldMotionCands( eparams, sad_calls,
                                         picture.fwd_org->Plane(0),picture.fwd_rec->Plane(0),
                                         &ssmb, &botssmb,
                                         i,j,picture.sxf,picture.syf,
@@ -931,7 +1294,7 @@ void MacroBlock::FrameMEs()
             
 
 			// Backward motion estimates...
-			FieldMotionCands( eparams,
+			FieldMotionCands( eparams, sad_calls,
                                         picture.bwd_org->Plane(0),picture.bwd_rec->Plane(0),
                                         &ssmb, &botssmb,
                                         i,j,picture.sxb,picture.syb,
@@ -1002,7 +1365,7 @@ void MacroBlock::FrameMEs()
  *  me.motion_type: MC_FIELD, MC_16X8
  *
  */
-void MacroBlock::FieldME()
+void MacroBlock::FieldME( SADCounts *sad_calls )
 {
     const Picture &picture = ParentPicture();
     const EncoderParams &eparams = picture.encparams;
@@ -1079,7 +1442,7 @@ void MacroBlock::FieldME()
                 topref = picture.rec_img->Plane(0);
 			}
 		}
-		field_estimate(picture,
+		field_estimate(picture, sad_calls,
 					   toporg,topref,botorg,botref,&ssmb,
 					   i,j,picture.sxf,picture.syf,
 					   &fieldf_mc,
@@ -1096,7 +1459,8 @@ void MacroBlock::FieldME()
 							 topref,botref,ssmb.mb,i,j,
 							 &fieldsp_mc,
 							 &dualp_mc,
-							 &vmc_dp);
+							 &vmc_dp,
+							 sad_calls);
 			dctl_dp = dualp_mc.sad;
 		}
 		/* select between dual prime, field and 16x8 prediction */
@@ -1186,7 +1550,7 @@ void MacroBlock::FieldME()
 	else /* if (pict_type==B_TYPE) */
 	{
 		/* forward prediction */
-		field_estimate( picture,
+		field_estimate( picture, sad_calls,
                                 picture.fwd_org->Plane(0),
                                 picture.fwd_rec->Plane(0),
                                 picture.fwd_org->Plane(0),
@@ -1200,7 +1564,7 @@ void MacroBlock::FieldME()
 		dmc8f = field8uf_mc.sad + field8lf_mc.sad;
 
 		/* backward prediction */
-		field_estimate( picture,
+		field_estimate( picture, sad_calls,
                                 picture.bwd_org->Plane(0),
                                 picture.bwd_rec->Plane(0),
                                 picture.bwd_org->Plane(0),
@@ -1215,11 +1579,14 @@ void MacroBlock::FieldME()
 
 		/* calculate distances for bidirectional prediction */
 		/* field */
-		dmcfieldi = bidir_pred_sad( &fieldf_mc, &fieldb_mc, ssmb.mb, w2, 16);
+		dmcfieldi = bidir_pred_sad( &fieldf_mc, &fieldb_mc, ssmb.mb, w2, 16,
+									sad_calls );
 
 		/* 16x8 upper and lower half blocks */
-		dmc8i =  bidir_pred_sad( &field8uf_mc, &field8ub_mc, ssmb.mb, w2, 16 );
-		dmc8i += bidir_pred_sad( &field8lf_mc, &field8lb_mc, ssmb.mb, w2, 16 );
+		dmc8i =  bidir_pred_sad( &field8uf_mc, &field8ub_mc, ssmb.mb, w2, 16,
+								 sad_calls );
+		dmc8i += bidir_pred_sad( &field8lf_mc, &field8lb_mc, ssmb.mb, w2, 16,
+								 sad_calls );
 
 		/* select prediction type of minimum distance */
 		if (dmcfieldi<dmc8i && dmcfieldi<dmcfieldf && dmcfieldi<dmc8f
@@ -1359,6 +1726,7 @@ void MacroBlock::FieldME()
 
 static void field_estimate (
 	const Picture &picture,
+	SADCounts *sad_calls,
 	uint8_t *toporg,
 	uint8_t *topref, 
 	uint8_t *botorg, 
@@ -1394,7 +1762,7 @@ static void field_estimate (
 	if (notop)
 		topfld_mc.sad = dt = 65536; /* infinity */
 	else
-		mb_me_search(eparams,
+		mb_me_search(eparams, sad_calls,
                      toporg,topref,0,ssmb,
                      eparams.phy_width<<1, i,j,sx,sy>>1,16,
                      eparams.enc_width,eparams.enc_height>>1, &topfld_mc);
@@ -1403,7 +1771,7 @@ static void field_estimate (
 	if (nobot)
 		botfld_mc.sad = db = 65536; /* infinity */
 	else
-		mb_me_search(eparams,
+		mb_me_search(eparams, sad_calls,
                      botorg,botref,eparams.phy_width,ssmb,
                      eparams.phy_width<<1, i,j,sx,sy>>1,16,
                      eparams.enc_width,eparams.enc_height>>1, &botfld_mc);
@@ -1442,7 +1810,7 @@ static void field_estimate (
 	if (notop)
 		topfld_mc.sad = dt = 65536;
 	else
-		mb_me_search(eparams,
+		mb_me_search(eparams, sad_calls,
                      toporg,topref,0,ssmb,
                      eparams.phy_width<<1, i,j,sx,sy>>1,8,
                      eparams.enc_width,eparams.enc_height>>1,&topfld_mc);
@@ -1451,7 +1819,7 @@ static void field_estimate (
 	if (nobot)
 		botfld_mc.sad = db = 65536;
 	else
-		mb_me_search(eparams,
+		mb_me_search(eparams, sad_calls,
                      botorg,botref,eparams.phy_width,ssmb,
                      eparams.phy_width<<1, i,j,sx,sy>>1,8,
                      eparams.enc_width,
@@ -1488,7 +1856,7 @@ static void field_estimate (
 	if (notop)
 		topfld_mc.sad = dt = 65536;
 	else
-		mb_me_search(eparams,
+		mb_me_search(eparams, sad_calls,
                      toporg,topref,0,&botssmb,
                      eparams.phy_width<<1, i,j+8,sx,sy>>1,8,
                      eparams.enc_width,eparams.enc_height>>1, &topfld_mc);
@@ -1497,7 +1865,7 @@ static void field_estimate (
 	if (nobot)
 		botfld_mc.sad = db = 65536;
 	else
-		mb_me_search(eparams,
+		mb_me_search(eparams, sad_calls,
                      botorg,botref,eparams.phy_width,&botssmb,
                      eparams.phy_width<<1,i,j+8,sx,sy>>1,8,
                      eparams.enc_width,eparams.enc_height>>1, &botfld_mc);
@@ -1591,8 +1959,112 @@ static int dump( uint8_t *blk, int stride )
 }
 #endif
 
+/*
+ * Predictive (EPZS style) 1-pel motion search.  The predictors are
+ * evaluated and, unless the best of them is already a good enough
+ * match, refined by diamond searches around it: a large diamond first
+ * if even the best predictor matches poorly, then the small diamond
+ * until no neighbour improves.  The cost of a candidate is its SAD
+ * plus the (approximate) cost of coding its vector so ties go to
+ * short vectors.  Unlike the exhaustive search the cost barely
+ * depends on the size of the search window.
+ *
+ * Result in best is relative to i0, j0 in pels.
+ */
+
+#define ME_DIAMOND_MAX_STEPS 32
+
+static void predictive_search( uint8_t *ref, uint8_t *blk,
+                               int lx, int h,
+                               int i0, int j0,
+                               int ilow, int jlow, int ihigh, int jhigh,
+                               const MEPredictors &preds,
+                               me_result_s *best,
+                               SADCounts *sad_calls )
+{
+    static const int large_diamond[8][2] =
+        { {0,-2}, {-1,-1}, {1,-1}, {-2,0}, {2,0}, {-1,1}, {1,1}, {0,2} };
+    static const int small_diamond[4][2] =
+        { {0,-1}, {-1,0}, {1,0}, {0,1} };
+
+    // Good enough to stop searching: ~2 per pel, and when to start
+    // with large steps: ~16 per pel
+    const int stop_threshold = h << 5;
+    const int large_threshold = h << 8;
+
+    int best_cost = INT_MAX;
+    int bx = 0, by = 0;
+    int k, step;
+
+    for( k = 0; k < preds.len; ++k )
+    {
+        int x = preds.mv[k].x;
+        int y = preds.mv[k].y;
+        x = x < ilow-i0 ? ilow-i0 : (x > ihigh-i0 ? ihigh-i0 : x);
+        y = y < jlow-j0 ? jlow-j0 : (y > jhigh-j0 ? jhigh-j0 : y);
+        int penalty = mv_coding_penalty( x<<1, y<<1 );
+        if( penalty >= best_cost )
+            continue;
+        count_call( sad_calls, SAD_00 );
+        int cost = psad_00( ref+(i0+x)+(j0+y)*lx, blk, lx, h, 
+                            best_cost-penalty ) + penalty;
+        if( cost < best_cost )
+        {
+            best_cost = cost;
+            bx = x;
+            by = y;
+        }
+    }
+
+    if( best_cost >= stop_threshold )
+    {
+        int npoints = best_cost >= large_threshold ? 8 : 4;
+        const int (*pattern)[2] = npoints == 8 ? large_diamond : small_diamond;
+        for( step = 0; step < ME_DIAMOND_MAX_STEPS; ++step )
+        {
+            int cx = bx, cy = by;
+            for( k = 0; k < npoints; ++k )
+            {
+                int x = cx + pattern[k][0];
+                int y = cy + pattern[k][1];
+                if( i0+x < ilow || i0+x > ihigh || j0+y < jlow || j0+y > jhigh )
+                    continue;
+                int penalty = mv_coding_penalty( x<<1, y<<1 );
+                if( penalty >= best_cost )
+                    continue;
+                count_call( sad_calls, SAD_00 );
+                int cost = psad_00( ref+(i0+x)+(j0+y)*lx, blk, lx, h, 
+                                    best_cost-penalty ) + penalty;
+                if( cost < best_cost )
+                {
+                    best_cost = cost;
+                    bx = x;
+                    by = y;
+                }
+            }
+
+            // Centre is best: switch from large to small diamond or
+            // we're done.
+            if( bx == cx && by == cy )
+            {
+                if( npoints == 4 )
+                    break;
+                npoints = 4;
+                pattern = small_diamond;
+            }
+            if( best_cost < stop_threshold )
+                break;
+        }
+    }
+
+    best->weight = best_cost > 0xffff ? 0xffff : best_cost;
+    best->x = bx;
+    best->y = by;
+}
+
 static void mb_me_search(
     const EncoderParams &eparams,
+    SADCounts *sad_calls,
 	uint8_t *org,
 	uint8_t *ref,
     int fieldoff,
@@ -1600,7 +2072,9 @@ static void mb_me_search(
 	int lx, int i0, int j0, 
 	int sx, int sy, int h,
 	int xmax, int ymax,
-	MotionCand *res
+	MotionCand *res,
+    const Coord &centre,
+    const MEPredictors *preds
 	)
 {
 	me_result_s best;
@@ -1638,78 +2112,91 @@ static void mb_me_search(
 	/* Create a distance-order mests of possible motion estimations
 	  based on the fast estimation data - 4*4 pel sums (4*4
 	  sub-sampled) rather than actual pel's.  1/16 the size...  */
-	jlow = j0-sy;
+	jlow = j0+centre.y-sy;
 	jlow = jlow < 0 ? 0 : jlow;
-	jhigh =  j0+(sy-1);
+	jhigh =  j0+centre.y+(sy-1);
 	jhigh = jhigh > ymax ? ymax : jhigh;
-	ilow = i0-sx;
+	ilow = i0+centre.x-sx;
 	ilow = ilow < 0 ? 0 : ilow;
-	ihigh =  i0+(sx-1);
+	ihigh =  i0+centre.x+(sx-1);
 	ihigh = ihigh > xmax ? xmax : ihigh;
 
-	/*
- 	   Very rarely this may fail to find matchs due to all the good
-	   looking ones being over threshold. hence we make sure we
-	   fall back to a 0 motion estimation in this case.
-	   
-		 The sad for the 0 motion estimation is also very useful as
-		 a basis for setting thresholds for rejecting really dud 4*4
-		 and 2*2 sub-sampled matches.
-	*/
-	best.weight = psad_00(reffld+i0+j0*lx,ssblk->mb,lx,h,INT_MAX);
-	best.x = 0;
-	best.y = 0;
-
-	/* Generate the best matches at 4*4 sub-sampling. 
-	   The precise fraction of the matches included is
-	   controlled by eparams.44_red
-	   Note: we use the original picture here for the match...
-	 */
-
-
-	pbuild_sub44_mests( &sub44set,
-                        ilow, jlow, ihigh, jhigh,
-                        i0, j0,
-                        best.weight,
-                        s44org, 
-                        ssblk->qmb, qlx, qh,
-                        eparams.me44_red); 
+	if( preds != 0 )
+	{
+		predictive_search( reffld, ssblk->mb, lx, h, i0, j0,
+						   ilow, jlow, ihigh, jhigh, *preds, &best,
+						   sad_calls );
+	}
+	else
+	{
+		/*
+	 	   Very rarely this may fail to find matchs due to all the good
+		   looking ones being over threshold. hence we make sure we
+		   fall back to a 0 motion estimation in this case.
+		   
+			 The sad for the 0 motion estimation is also very useful as
+			 a basis for setting thresholds for rejecting really dud 4*4
+			 and 2*2 sub-sampled matches.
+		*/
+		count_call( sad_calls, SAD_00 );
+		best.weight = psad_00(reffld+i0+j0*lx,ssblk->mb,lx,h,INT_MAX);
+		best.x = 0;
+		best.y = 0;
+
+		/* Generate the best matches at 4*4 sub-sampling. 
+		   The precise fraction of the matches included is
+		   controlled by eparams.44_red
+		   Note: we use the original picture here for the match...
+		 */
+
+
+		count_call( sad_calls, BUILD_SUB44_MESTS );
+		pbuild_sub44_mests( &sub44set,
+	                        ilow, jlow, ihigh, jhigh,
+	                        i0, j0,
+	                        best.weight,
+	                        s44org, 
+	                        ssblk->qmb, qlx, qh,
+	                        eparams.me44_red); 
 #ifdef DEBUG_MOTION_EST
-    if( trace_me )
-        log_result_set( &sub44set );
+	    if( trace_me )
+	        log_result_set( &sub44set );
 #endif	
-	/* Generate the best 2*2 sub-sampling matches from the
-	   immediate 2*2 neighbourhoods of the 4*4 sub-sampling matches.
-	   The precise fraction of the matches included is controlled
-	   by eparams.22_red.
-	   Note: we use the original picture here for the match...
-
-	*/
-
-	pbuild_sub22_mests( &sub44set, &sub22set,
-                        i0, j0, 
-                        ihigh,  jhigh, 
-                        best.weight,
-                        s22org, ssblk->fmb, flx, fh,
-                        eparams.me22_red);
+		/* Generate the best 2*2 sub-sampling matches from the
+		   immediate 2*2 neighbourhoods of the 4*4 sub-sampling matches.
+		   The precise fraction of the matches included is controlled
+		   by eparams.22_red.
+		   Note: we use the original picture here for the match...
+
+		*/
+
+		count_call( sad_calls, BUILD_SUB22_MESTS );
+		pbuild_sub22_mests( &sub44set, &sub22set,
+	                        i0, j0, 
+	                        ihigh,  jhigh, 
+	                        best.weight,
+	                        s22org, ssblk->fmb, flx, fh,
+	                        eparams.me22_red);
 
 #ifdef DEBUG_MOTION_EST
-    if( trace_me )
-        log_result_set( &sub22set );
+	    if( trace_me )
+	        log_result_set( &sub22set );
 #endif
+			
+	    /* Now choose best 1-pel match from the 2*2 neighbourhoods
+		   of the best 2*2 sub-sampled matches.
+		   Note that here we start using the reference picture not the
+		   original.
+		*/
 		
-    /* Now choose best 1-pel match from the 2*2 neighbourhoods
-	   of the best 2*2 sub-sampled matches.
-	   Note that here we start using the reference picture not the
-	   original.
-	*/
-	
 
-	pfind_best_one_pel( &sub22set,
-                        reffld, ssblk->mb, 
-                        i0, j0,
-                        ihigh, jhigh, 
-                        lx, h, &best );
+		count_call( sad_calls, FIND_BEST_ONE_PEL );
+		pfind_best_one_pel( &sub22set,
+	                        reffld, ssblk->mb, 
+	                        i0, j0,
+	                        ihigh, jhigh, 
+	                        lx, h, &best );
+	}
 
 #ifdef DEBUG_MOTION_EST
     if( trace_me )
@@ -1745,6 +2232,7 @@ static void mb_me_search(
 			orgblk = reffld+(i>>1)+((j>>1)*lx);
 			if( i&1 )
 			{
+				count_call( sad_calls, j & 1 ? SAD_11 : SAD_01 );
 				if( j & 1 )
 					d = psad_11(orgblk,ssblk->mb,lx,h);
 				else
@@ -1752,6 +2240,7 @@ static void mb_me_search(
 			}
 			else
 			{
+				count_call( sad_calls, j & 1 ? SAD_10 : SAD_00 );
 				if( j & 1 )
 					d = psad_10(orgblk,ssblk->mb,lx,h);
 				else
@@ -52,6 +52,9 @@
 #include <stdio.h>
 #include <math.h>
 #include <cassert>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "mpeg2syntaxcodes.h"
 #include "tables.h"
 #include "mpeg2coder.hh"
@@ -59,13 +62,15 @@
 #include "mpeg2encoder.hh"
 #include "picture.hh"
 
-MPEG2CodingBuf::MPEG2CodingBuf( EncoderParams &_encparams, ElemStrmWriter &_writer ) :
+template <class FragBuf>
+MPEG2Coder<FragBuf>::MPEG2Coder( EncoderParams &_encparams, FragBuf *_frag_buf ) :
     encparams( _encparams ),
-	frag_buf( new ElemStrmFragBuf( _writer ) )
+	frag_buf( _frag_buf )
 {
 }
 
-MPEG2CodingBuf::~MPEG2CodingBuf()
+template <class FragBuf>
+MPEG2Coder<FragBuf>::~MPEG2Coder()
 {
 	delete frag_buf;
 }
@@ -74,7 +79,8 @@ MPEG2CodingBuf::~MPEG2CodingBuf()
  *
  * drop_frame not implemented
  */
-int MPEG2CodingBuf::FrameToTimeCode(int gop_timecode0_frame)
+template <class FragBuf>
+int MPEG2Coder<FragBuf>::FrameToTimeCode(int gop_timecode0_frame)
 {
 	int frame = gop_timecode0_frame;
 	int fps, pict, sec, minute, hour, tc;
@@ -101,7 +107,8 @@ int MPEG2CodingBuf::FrameToTimeCode(int gop_timecode0_frame)
  *
  ***************/
 
-void MPEG2CodingBuf::PutSeqHdr()
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutSeqHdr()
 {
 	int i;
     assert( frag_buf->Aligned() );
@@ -148,7 +155,8 @@ void MPEG2CodingBuf::PutSeqHdr()
  *
  *************************/
 
-void MPEG2CodingBuf::PutSeqExt()
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutSeqExt()
 {
 	assert( frag_buf->Aligned() );
 	frag_buf->PutBits(EXT_START_CODE,32); /* extension_start_code */
@@ -173,7 +181,8 @@ void MPEG2CodingBuf::PutSeqExt()
  *
  ****************************/
 
-void MPEG2CodingBuf::PutSeqDispExt()
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutSeqDispExt()
 {
 	assert( frag_buf->Aligned() );
 	frag_buf->PutBits(EXT_START_CODE,32); /* extension_start_code */
@@ -197,7 +206,8 @@ void MPEG2CodingBuf::PutSeqDispExt()
  *
  *******************************/
 
-void MPEG2CodingBuf::PutUserData(const uint8_t *userdata, int len)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutUserData(const uint8_t *userdata, int len)
 {
 	int i;
 	assert( frag_buf->Aligned() );
@@ -210,7 +220,8 @@ void MPEG2CodingBuf::PutUserData(const uint8_t *userdata, int len)
  *
  * uses tc0 (timecode of first frame) and frame0 (number of first frame)
  */
-void MPEG2CodingBuf::PutGopHdr(int frame,int closed_gop )
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutGopHdr(int frame,int closed_gop )
 {
 	int tc;
 
@@ -225,22 +236,111 @@ void MPEG2CodingBuf::PutGopHdr(int frame,int closed_gop )
 
 
 /* generate sequence_end_code (6.2.2) */
-void MPEG2CodingBuf::PutSeqEnd(void)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutSeqEnd(void)
 {
 	frag_buf->AlignBits();
 	frag_buf->PutBits(SEQ_END_CODE,32);
 }
 
 
+/*
+ * Gather the coefficients of a block in scan order.
+ *
+ * RETURN: mask with bit n set iff coefficient n (in scan order) is non-zero.
+ */
+
+static inline uint64_t ScanNonZero( const int16_t *blk, const uint8_t *scan_tbl,
+                                    int16_t *coeffs )
+{
+	int n;
+	uint64_t nz = 0;
+#if defined(__SSE2__)
+	for (n=0; n<64; n++)
+		coeffs[n] = blk[scan_tbl[n]];
+	const __m128i zero = _mm_setzero_si128();
+	for (n=0; n<64; n+=16)
+	{
+		__m128i z0 = _mm_cmpeq_epi16( _mm_loadu_si128( (const __m128i *)(coeffs+n) ), zero );
+		__m128i z1 = _mm_cmpeq_epi16( _mm_loadu_si128( (const __m128i *)(coeffs+n+8) ), zero );
+		uint32_t zeros = _mm_movemask_epi8( _mm_packs_epi16( z0, z1 ) );
+		nz |= static_cast<uint64_t>(~zeros & 0xffff) << n;
+	}
+#else
+	for (n=0; n<64; n++)
+	{
+		coeffs[n] = blk[scan_tbl[n]];
+		nz |= static_cast<uint64_t>(coeffs[n] != 0) << n;
+	}
+#endif
+	return nz;
+}
+
+/* Index of lowest set bit of a non-zero mask */
+
+static inline int LowestSetBit( uint64_t mask )
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll( mask );
+#else
+	int n = 0;
+	while( !(mask & 1) )
+	{
+		mask >>= 1;
+		++n;
+	}
+	return n;
+#endif
+}
+
+/*
+ * Generate variable length codes for the AC (or for non-intra blocks
+ * all) coefficients of a block (7.2.2): the non-zero coefficients are
+ * found in a single pass and the runs between them read off their
+ * positions.
+ */
+
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutACs(const int16_t *blk, const uint8_t *scan_tbl,
+                                 bool intra, int vlcformat)
+{
+	int16_t coeffs[64];
+	uint64_t nz = ScanNonZero( blk, scan_tbl, coeffs );
+	int n, next;
+
+	if (intra)
+	{
+		nz &= ~static_cast<uint64_t>(1); /* DC is coded separately */
+		next = 1;
+	}
+	else if (nz != 0)
+	{
+		/* first coefficient in non-intra block */
+		n = LowestSetBit( nz );
+		PutACfirst( n, coeffs[n] );
+		nz &= nz-1;
+		next = n+1;
+	}
+	while (nz != 0)
+	{
+		n = LowestSetBit( nz );
+		PutAC( n-next, coeffs[n], vlcformat );
+		nz &= nz-1;
+		next = n+1;
+	}
+}
+
 /* generate variable length codes for an intra-coded block (6.2.6, 6.3.17) */
 
-void MPEG2CodingBuf::PutIntraBlk(Picture *picture, int16_t *blk, int cc)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutIntraBlk(Picture *picture, int16_t *blk, int cc,
+                                 int &dc_dct_pred)
 {
-	int n, dct_diff, run, signed_level;
+	int dct_diff;
 
 	/* DC coefficient (7.2.1) */
-	dct_diff = blk[0] - picture->dc_dct_pred[cc]; /* difference to previous block */
-	picture->dc_dct_pred[cc] = blk[0];
+	dct_diff = blk[0] - dc_dct_pred; /* difference to previous block */
+	dc_dct_pred = blk[0];
 
 	if (cc==0)
 		PutDClum(dct_diff);
@@ -248,20 +348,8 @@ void MPEG2CodingBuf::PutIntraBlk(Picture *picture, int16_t *blk, int cc)
 		PutDCchrom(dct_diff);
 
 	/* AC coefficients (7.2.2) */
-	run = 0;
-	const uint8_t *scan_tbl = (picture->altscan ? alternate_scan : zig_zag_scan);
-	for (n=1; n<64; n++)
-	{
-		/* use appropriate entropy scanning pattern */
-		signed_level = blk[scan_tbl[n]];
-		if (signed_level!=0)
-		{
-			PutAC(run,signed_level,picture->intravlc);
-			run = 0;
-		}
-		else
-			run++; /* count zero coefficients */
-	}
+	PutACs(blk, picture->altscan ? alternate_scan : zig_zag_scan,
+		   true, picture->intravlc);
 
 	/* End of Block -- normative block punctuation */
 	if (picture->intravlc)
@@ -271,41 +359,18 @@ void MPEG2CodingBuf::PutIntraBlk(Picture *picture, int16_t *blk, int cc)
 }
 
 /* generate variable length codes for a non-intra-coded block (6.2.6, 6.3.17) */
-void  MPEG2CodingBuf::PutNonIntraBlk(Picture *picture, int16_t *blk)
+template <class FragBuf>
+void  MPEG2Coder<FragBuf>::PutNonIntraBlk(Picture *picture, int16_t *blk)
 {
-	int n, run, signed_level, first;
-
-	run = 0;
-	first = 1;
-
-	for (n=0; n<64; n++)
-	{
-		/* use appropriate entropy scanning pattern */
-		signed_level = blk[(picture->altscan ? alternate_scan : zig_zag_scan)[n]];
-
-		if (signed_level!=0)
-		{
-			if (first)
-			{
-				/* first coefficient in non-intra block */
-				PutACfirst(run,signed_level);
-				first = 0;
-			}
-			else
-				PutAC(run,signed_level,0);
-
-			run = 0;
-		}
-		else
-			run++; /* count zero coefficients */
-	}
+	PutACs(blk, picture->altscan ? alternate_scan : zig_zag_scan, false, 0);
 
 	/* End of Block -- normative block punctuation  */
 	frag_buf->PutBits(2,2);
 }
 
 /* generate variable length code for a motion vector component (7.6.3.1) */
-void  MPEG2CodingBuf::PutMV(int dmv, int f_code)
+template <class FragBuf>
+void  MPEG2Coder<FragBuf>::PutMV(int dmv, int f_code)
 {
   int r_size, f, vmin, vmax, dv, temp, motion_code, motion_residual;
 
@@ -343,7 +408,8 @@ void  MPEG2CodingBuf::PutMV(int dmv, int f_code)
 
 
 /* generate variable length code for DC coefficient (7.2.1) */
-void MPEG2CodingBuf::PutDC(const sVLCtable *tab, int val)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutDC(const sVLCtable *tab, int val)
 {
 	int absval, size;
 
@@ -374,7 +440,8 @@ void MPEG2CodingBuf::PutDC(const sVLCtable *tab, int val)
 }
 
 /* generate variable length code for DC coefficient (7.2.1) */
-int MPEG2CodingBuf::DC_bits(const sVLCtable *tab, int val)
+template <class FragBuf>
+int MPEG2Coder<FragBuf>::DC_bits(const sVLCtable *tab, int val)
 {
 	int absval, size;
 
@@ -396,7 +463,8 @@ int MPEG2CodingBuf::DC_bits(const sVLCtable *tab, int val)
 
 /* generate variable length code for first coefficient
  * of a non-intra block (7.2.2.2) */
-void MPEG2CodingBuf::PutACfirst(int run, int val)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutACfirst(int run, int val)
 {
 	if (run==0 && (val==1 || val==-1)) /* these are treated differently */
 		frag_buf->PutBits(2|(val<0),2); /* generate '1s' (s=sign), (Table B-14, line 2) */
@@ -405,12 +473,23 @@ void MPEG2CodingBuf::PutACfirst(int run, int val)
 }
 
 /* generate variable length code for other DCT coefficients (7.2.2) */
-void MPEG2CodingBuf::PutAC(int run, int signed_level, int vlcformat)
+template <class FragBuf>
+inline void MPEG2Coder<FragBuf>::PutAC(int run, int signed_level, int vlcformat)
 {
-	int level, len;
-	const VLCtable *ptab = NULL;
+	int level = abs(signed_level);
+	uint32_t vlc = (run<32 && level<41) ? run_level_vlc[vlcformat][run][level] : 0;
 
-	level = abs(signed_level);
+	if (vlc!=0) /* a VLC code exists */
+		frag_buf->PutBits((vlc>>8)|(signed_level<0), vlc&0xff);
+	else
+		PutACescape(run, signed_level);
+}
+
+/* no VLC for this (run, level) combination: use escape coding (7.2.2.3) */
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutACescape(int run, int signed_level)
+{
+	int level = abs(signed_level);
 
 	/* make sure run and level are valid */
 	if (run<0 || run>63 || level==0 || level>encparams.dctsatlim)
@@ -418,92 +497,42 @@ void MPEG2CodingBuf::PutAC(int run, int signed_level, int vlcformat)
 		assert( signed_level == -(encparams.dctsatlim+1)); 	/* Negative range is actually 1 more */
 	}
 
-	len = 0;
-
-	if (run<2 && level<41)
+	frag_buf->PutBits(1l,6); /* Escape */
+	frag_buf->PutBits(run,6); /* 6 bit code for run */
+	if (encparams.mpeg1)
 	{
-		/* vlcformat selects either of Table B-14 / B-15 */
-		if (vlcformat)
-			ptab = &dct_code_tab1a[run][level-1];
-		else
-			ptab = &dct_code_tab1[run][level-1];
-
-		len = ptab->len;
-	}
-	else if (run<32 && level<6)
-	{
-		/* vlcformat selects either of Table B-14 / B-15 */
-		if (vlcformat)
-			ptab = &dct_code_tab2a[run-2][level-1];
-		else
-			ptab = &dct_code_tab2[run-2][level-1];
-
-		len = ptab->len;
-	}
-
-	if (len!=0) /* a VLC code exists */
-	{
-		frag_buf->PutBits(ptab->code,len);
-		frag_buf->PutBits(signed_level<0,1); /* sign */
+		/* ISO/IEC 11172-2 uses a 8 or 16 bit code */
+		if (signed_level>127)
+			frag_buf->PutBits(0,8);
+		if (signed_level<-127)
+			frag_buf->PutBits(128,8);
+		frag_buf->PutBits(signed_level,8);
 	}
 	else
 	{
-		/* no VLC for this (run, level) combination: use escape coding (7.2.2.3) */
-		frag_buf->PutBits(1l,6); /* Escape */
-		frag_buf->PutBits(run,6); /* 6 bit code for run */
-		if (encparams.mpeg1)
-		{
-			/* ISO/IEC 11172-2 uses a 8 or 16 bit code */
-			if (signed_level>127)
-				frag_buf->PutBits(0,8);
-			if (signed_level<-127)
-				frag_buf->PutBits(128,8);
-			frag_buf->PutBits(signed_level,8);
-		}
-		else
-		{
-			/* ISO/IEC 13818-2 uses a 12 bit code, Table B-16 */
-			frag_buf->PutBits(signed_level,12);
-		}
+		/* ISO/IEC 13818-2 uses a 12 bit code, Table B-16 */
+		frag_buf->PutBits(signed_level,12);
 	}
 }
 
-/* generate variable length code for other DCT coefficients (7.2.2) */
-int MPEG2CodingBuf::AC_bits(int run, int signed_level, int vlcformat)
+/* length of variable length code for other DCT coefficients (7.2.2) */
+template <class FragBuf>
+int MPEG2Coder<FragBuf>::AC_bits(int run, int signed_level, int vlcformat)
 {
-	int level;
-	const VLCtable *ptab;
+	int level = abs(signed_level);
+	uint32_t vlc = (run<32 && level<41) ? run_level_vlc[vlcformat][run][level] : 0;
 
-	level = abs(signed_level);
-
-	if (run<2 && level<41)
-	{
-		/* vlcformat selects either of Table B-14 / B-15 */
-		if (vlcformat)
-			ptab = &dct_code_tab1a[run][level-1];
-		else
-			ptab = &dct_code_tab1[run][level-1];
-
-		return ptab->len+1;
-	}
-	else if (run<32 && level<6)
-	{
-		/* vlcformat selects either of Table B-14 / B-15 */
-		if (vlcformat)
-			ptab = &dct_code_tab2a[run-2][level-1];
-		else
-			ptab = &dct_code_tab2[run-2][level-1];
-
-		return ptab->len+1;
-	}
+	if (vlc!=0)
+		return vlc&0xff;
+	else if (encparams.mpeg1)
+		return 12 + (level>127 ? 16 : 8);
 	else
-	{
-		return 12+12;
-	}
+		return 12 + 12;
 }
 
 /* generate variable length code for macroblock_address_increment (6.3.16) */
-void MPEG2CodingBuf::PutAddrInc(int addrinc)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutAddrInc(int addrinc)
 {
 	while (addrinc>33)
 	{
@@ -514,7 +543,8 @@ void MPEG2CodingBuf::PutAddrInc(int addrinc)
 	frag_buf->PutBits(addrinctab[addrinc-1].code,addrinctab[addrinc-1].len);
 }
 
-int MPEG2CodingBuf::AddrInc_bits(int addrinc)
+template <class FragBuf>
+int MPEG2Coder<FragBuf>::AddrInc_bits(int addrinc)
 {
 	int bits = 0;
 	while (addrinc>33)
@@ -526,19 +556,22 @@ int MPEG2CodingBuf::AddrInc_bits(int addrinc)
 }
 
 /* generate variable length code for macroblock_type (6.3.16.1) */
-void MPEG2CodingBuf::PutMBType(int pict_type, int mb_type)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutMBType(int pict_type, int mb_type)
 {
 	frag_buf->PutBits(mbtypetab[pict_type-1][mb_type].code,
 				   mbtypetab[pict_type-1][mb_type].len);
 }
 
-int MPEG2CodingBuf::MBType_bits( int pict_type, int mb_type)
+template <class FragBuf>
+int MPEG2Coder<FragBuf>::MBType_bits( int pict_type, int mb_type)
 {
 	return mbtypetab[pict_type-1][mb_type].len;
 }
 
 /* generate variable length code for motion_code (6.3.16.3) */
-void MPEG2CodingBuf::PutMotionCode(int motion_code)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutMotionCode(int motion_code)
 {
 	int abscode;
 
@@ -548,14 +581,16 @@ void MPEG2CodingBuf::PutMotionCode(int motion_code)
 		frag_buf->PutBits(motion_code<0,1); /* sign, 0=positive, 1=negative */
 }
 
-int MPEG2CodingBuf::MotionCode_bits( int motion_code )
+template <class FragBuf>
+int MPEG2Coder<FragBuf>::MotionCode_bits( int motion_code )
 {
 	int abscode = (motion_code>=0) ? motion_code : -motion_code; 
 	return 1+motionvectab[abscode].len;
 }
 
 /* generate variable length code for dmvector[t] (6.3.16.3), Table B-11 */
-void MPEG2CodingBuf::PutDMV(int dmv)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutDMV(int dmv)
 {
 	if (dmv==0)
 		frag_buf->PutBits(0,1);
@@ -565,7 +600,8 @@ void MPEG2CodingBuf::PutDMV(int dmv)
 		frag_buf->PutBits(3,2);
 }
 
-int MPEG2CodingBuf::DMV_bits(int dmv)
+template <class FragBuf>
+int MPEG2Coder<FragBuf>::DMV_bits(int dmv)
 {
 	return dmv == 0 ? 1 : 2;
 }
@@ -574,19 +610,21 @@ int MPEG2CodingBuf::DMV_bits(int dmv)
  *
  * 4:2:2, 4:4:4 not implemented
  */
-void MPEG2CodingBuf::PutCPB(int cbp)
+template <class FragBuf>
+void MPEG2Coder<FragBuf>::PutCPB(int cbp)
 {
 	frag_buf->PutBits(cbptable[cbp].code,cbptable[cbp].len);
 }
 
-int MPEG2CodingBuf::CBP_bits(int cbp)
+template <class FragBuf>
+int MPEG2Coder<FragBuf>::CBP_bits(int cbp)
 {
 	return cbptable[cbp].len;
 }
 
 
-const MPEG2CodingBuf::VLCtable 
-MPEG2CodingBuf::addrinctab[33]=
+const MPEG2CoderTables::VLCtable 
+MPEG2CoderTables::addrinctab[33]=
 {
   {0x01,1},  {0x03,3},  {0x02,3},  {0x03,4},
   {0x02,4},  {0x03,5},  {0x02,5},  {0x07,7},
@@ -605,8 +643,8 @@ MPEG2CodingBuf::addrinctab[33]=
  * indexed by [macroblock_type]
  */
 
-const MPEG2CodingBuf::VLCtable 
-MPEG2CodingBuf::mbtypetab[3][32]=
+const MPEG2CoderTables::VLCtable 
+MPEG2CoderTables::mbtypetab[3][32]=
 {
  /* I */
  {
@@ -643,8 +681,8 @@ MPEG2CodingBuf::mbtypetab[3][32]=
  * indexed by [coded_block_pattern]
  */
 
-const MPEG2CodingBuf::VLCtable 
-MPEG2CodingBuf::cbptable[64]=
+const MPEG2CoderTables::VLCtable 
+MPEG2CoderTables::cbptable[64]=
 {
   {0x01,9}, {0x0b,5}, {0x09,5}, {0x0d,6}, 
   {0x0d,4}, {0x17,7}, {0x13,7}, {0x1f,8}, 
@@ -671,8 +709,8 @@ MPEG2CodingBuf::cbptable[64]=
  * sign of motion_code is treated elsewhere
  */
 
-const MPEG2CodingBuf::VLCtable 
-MPEG2CodingBuf::motionvectab[17]=
+const MPEG2CoderTables::VLCtable 
+MPEG2CoderTables::motionvectab[17]=
 {
   {0x01,1},  {0x01,2},  {0x01,3},  {0x01,4},
   {0x03,6},  {0x05,7},  {0x04,7},  {0x03,7},
@@ -692,8 +730,8 @@ MPEG2CodingBuf::motionvectab[17]=
  * indexed by [dct_dc_size_luminance]
  */
 
-const MPEG2CodingBuf::sVLCtable 
-MPEG2CodingBuf::DClumtab[12]=
+const MPEG2CoderTables::sVLCtable 
+MPEG2CoderTables::DClumtab[12]=
 {
   {0x0004,3}, {0x0000,2}, {0x0001,2}, {0x0005,3}, {0x0006,3}, {0x000e,4},
   {0x001e,5}, {0x003e,6}, {0x007e,7}, {0x00fe,8}, {0x01fe,9}, {0x01ff,9}
@@ -705,8 +743,8 @@ MPEG2CodingBuf::DClumtab[12]=
  * indexed by [dct_dc_size_chrominance]
  */
 
-const MPEG2CodingBuf::sVLCtable 
-MPEG2CodingBuf::DCchromtab[12]=
+const MPEG2CoderTables::sVLCtable 
+MPEG2CoderTables::DCchromtab[12]=
 {
   {0x0000,2}, {0x0001,2}, {0x0002,2}, {0x0006,3}, {0x000e,4}, {0x001e,5},
   {0x003e,6}, {0x007e,7}, {0x00fe,8}, {0x01fe,9}, {0x03fe,10},{0x03ff,10}
@@ -721,8 +759,8 @@ MPEG2CodingBuf::DCchromtab[12]=
  * codes do not include s (sign bit)
  */
 
-const MPEG2CodingBuf::VLCtable 
-MPEG2CodingBuf::dct_code_tab1[2][40]=
+const MPEG2CoderTables::VLCtable 
+MPEG2CoderTables::dct_code_tab1[2][40]=
 {
  /* run = 0, level = 1...40 */
  {
@@ -752,8 +790,8 @@ MPEG2CodingBuf::dct_code_tab1[2][40]=
  }
 };
 
-const MPEG2CodingBuf::VLCtable 
-MPEG2CodingBuf::dct_code_tab2[30][5]=
+const MPEG2CoderTables::VLCtable 
+MPEG2CoderTables::dct_code_tab2[30][5]=
 {
   /* run = 2...31, level = 1...5 */
   {{0x05, 4}, {0x04, 7}, {0x0b,10}, {0x14,12}, {0x14,13}},
@@ -797,8 +835,8 @@ MPEG2CodingBuf::dct_code_tab2[30][5]=
  * codes do not include s (sign bit)
  */
 
-const MPEG2CodingBuf::VLCtable 
-MPEG2CodingBuf::dct_code_tab1a[2][40]=
+const MPEG2CoderTables::VLCtable 
+MPEG2CoderTables::dct_code_tab1a[2][40]=
 {
  /* run = 0, level = 1...40 */
  {
@@ -828,8 +866,8 @@ MPEG2CodingBuf::dct_code_tab1a[2][40]=
  }
 };
 
-const MPEG2CodingBuf::VLCtable 
-MPEG2CodingBuf::dct_code_tab2a[30][5]=
+const MPEG2CoderTables::VLCtable 
+MPEG2CoderTables::dct_code_tab2a[30][5]=
 {
   /* run = 2...31, level = 1...5 */
   {{0x05, 5}, {0x07, 7}, {0xfc, 8}, {0x0c,10}, {0x14,13}},
@@ -865,6 +903,39 @@ MPEG2CodingBuf::dct_code_tab2a[30][5]=
 };
 
 
+uint32_t MPEG2CoderTables::run_level_vlc[2][32][41];
+
+void MPEG2CoderTables::InitRunLevelVLC()
+{
+	int vlcformat, run, level;
+	for (vlcformat=0; vlcformat<2; vlcformat++)
+		for (run=0; run<32; run++)
+			for (level=1; level<41; level++)
+			{
+				const VLCtable *ptab = NULL;
+				if (run<2)
+					ptab = vlcformat ? &dct_code_tab1a[run][level-1]
+						: &dct_code_tab1[run][level-1];
+				else if (level<6)
+					ptab = vlcformat ? &dct_code_tab2a[run-2][level-1]
+						: &dct_code_tab2[run-2][level-1];
+				run_level_vlc[vlcformat][run][level] =
+					(ptab == NULL || ptab->len == 0)
+					? 0 : (ptab->code << 9) | (ptab->len+1);
+			}
+}
+
+/* The tables are built before any coding can take place */
+
+static struct RunLevelVLCInit
+{
+	RunLevelVLCInit() { MPEG2CoderTables::InitRunLevelVLC(); }
+} run_level_vlc_init;
+
+
+template class MPEG2Coder<ElemStrmFragBuf>;
+template class MPEG2Coder<CountOnlyFragBuf>;
+
 
 /* 
  * Local variables:
@@ -30,19 +30,77 @@
 
 class Picture;
 
+/*****************************
+ *
+ * MPEG2CoderTables - The VLC tables shared by all MPEG2Coder's
+ *
+ ****************************/
 
-class MPEG2CodingBuf
+class MPEG2CoderTables
 {
 public:
-    MPEG2CodingBuf( EncoderParams &encoder, ElemStrmWriter &writer );
+    static void InitRunLevelVLC();
 
-    virtual ~MPEG2CodingBuf();
+protected:
+    /* type definitions for variable length code table entries */
+    
+    typedef struct
+    {
+        unsigned char code; /* right justified */
+        char len;
+    } VLCtable;
+    
+    /* for codes longer than 8 bits (excluding leading zeroes) */
+    typedef struct
+    {
+        unsigned short code; /* right justified */
+        char len;
+    } sVLCtable;
+
+    const static VLCtable addrinctab[33];
+    const static VLCtable mbtypetab[3][32];
+    const static VLCtable cbptable[64];
+    const static VLCtable motionvectab[17];
+    const static sVLCtable DClumtab[12];
+    const static sVLCtable DCchromtab[12];
+    const static VLCtable dct_code_tab1[2][40];
+    const static VLCtable dct_code_tab2[30][5];
+    const static VLCtable dct_code_tab1a[2][40];
+    const static VLCtable dct_code_tab2a[30][5];
+
+    /* DCT coefficient (run,level) VLC's of Table B-14 [0] and B-15 [1]
+       with room for the sign bit packed as code << 8 | length, 0 if
+       the (run,level) has to be escape coded. Built from the
+       dct_code_tab's by InitRunLevelVLC. */
+    static uint32_t run_level_vlc[2][32][41];
+};
+
+/*****************************
+ *
+ * MPEG2Coder - MPEG2 packed bit / VLC syntax coding into a fragment
+ * buffer.  The kind of fragment buffer (ElemStrmFragBuf to generate
+ * the bits, CountOnlyFragBuf to just count them) is a template
+ * parameter so that the bit-level output of each VLC codeword is
+ * inlined rather than a virtual call.  The coder takes ownership of
+ * its fragment buffer.
+ *
+ * Instantiated (in mpeg2coder.cc) for ElemStrmFragBuf and CountOnlyFragBuf.
+ *
+ ****************************/
+
+template <class FragBuf>
+class MPEG2Coder : public MPEG2CoderTables
+{
+public:
+    MPEG2Coder( EncoderParams &encoder, FragBuf *frag_buf );
+
+    virtual ~MPEG2Coder();
 
 	void PutUserData( const uint8_t *userdata, int len);
 	void PutGopHdr(int frame, int closed_gop );
 	void PutSeqEnd();
 	void PutSeqHdr();
-    void PutIntraBlk(Picture *picture, int16_t *blk, int cc);
+    void PutIntraBlk(Picture *picture, int16_t *blk, int cc, int &dc_dct_pred);
     void PutNonIntraBlk(Picture *picture, int16_t *blk);
     void PutMV(int dmv, int f_code);
     void PutDMV(int dmv);
@@ -51,6 +109,9 @@ public:
     void PutMotionCode(int motion_code);
     void PutCPB(int cbp);
 
+    /* Length of the VLC for DCT coefficient (run, signed_level) in
+       a block after the first coefficient (7.2.2) */
+    int AC_bits(int run, int signed_level, int vlcformat);
 
 
     inline void PutBits( uint32_t val, int n)
@@ -84,6 +145,11 @@ public:
     	frag_buf->ResetBuffer();
     }
 
+    inline void TransferTo( MPEG2Coder &dest )
+    {
+        frag_buf->TransferTo( *dest.frag_buf );
+    }
+
 private:
 	void PutSeqExt();
 	void PutSeqDispExt();
@@ -112,27 +178,12 @@ private:
             return DC_bits(DClumtab,val);
         }
 
-    /* type definitions for variable length code table entries */
-    
-    typedef struct
-    {
-        unsigned char code; /* right justified */
-        char len;
-    } VLCtable;
-    
-    /* for codes longer than 8 bits (excluding leading zeroes) */
-    typedef struct
-    {
-        unsigned short code; /* right justified */
-        char len;
-    } sVLCtable;
-
-
     void PutDC(const sVLCtable *tab, int val);
     int DC_bits(const sVLCtable *tab, int val);
+    void PutACs(const int16_t *blk, const uint8_t *scan_tbl, bool intra, int vlcformat);
     void PutACfirst(int run, int val);
     void PutAC(int run, int signed_level, int vlcformat);
-    int AC_bits(int run, int signed_level, int vlcformat);
+    void PutACescape(int run, int signed_level);
     int AddrInc_bits(int addrinc);
     int MBType_bits( int pict_type, int mb_type);
     int MotionCode_bits( int motion_code );
@@ -141,21 +192,46 @@ private:
 
 private:
 	EncoderParams &encparams;
-	ElemStrmFragBuf	*frag_buf;
+protected:
+	FragBuf	*frag_buf;
+};
 
-    const static VLCtable addrinctab[33];
-    const static VLCtable mbtypetab[3][32];
-    const static VLCtable cbptable[64];
-    const static VLCtable motionvectab[17];
-    const static sVLCtable DClumtab[12];
-    const static sVLCtable DCchromtab[12];
-    const static VLCtable dct_code_tab1[2][40];
-    const static VLCtable dct_code_tab2[30][5];
-    const static VLCtable dct_code_tab1a[2][40];
-    const static VLCtable dct_code_tab2a[30][5];
 
+/*****************************
+ *
+ * MPEG2CodingBuf - MPEG2 coding of (part of) a Picture into a buffer
+ * for writing out with an ElemStrmWriter.
+ *
+ ****************************/
+
+class MPEG2CodingBuf : public MPEG2Coder<ElemStrmFragBuf>
+{
+public:
+    MPEG2CodingBuf( EncoderParams &encoder, ElemStrmWriter &writer ) :
+        MPEG2Coder<ElemStrmFragBuf>( encoder, new ElemStrmFragBuf( writer ) )
+        {}
 };
-
+
+/*****************************
+ *
+ * MPEG2CountingBuf - MPEG2 coding that only counts the bits that would
+ * be generated.  Used to compare the cost of alternative codings.
+ *
+ ****************************/
+
+class MPEG2CountingBuf : public MPEG2Coder<CountOnlyFragBuf>
+{
+public:
+    MPEG2CountingBuf( EncoderParams &encoder ) :
+        MPEG2Coder<CountOnlyFragBuf>( encoder, new CountOnlyFragBuf() )
+        {}
+
+    inline int BitCount() const
+    {
+        return frag_buf->BitCount();
+    }
+};
+
 /* 
  * Local variables:
  *  c-file-style: "stroustrup"
@@ -58,8 +58,7 @@
 
 #include <algorithm>
 
-#include "mpeg2encoder.hh"
-#include "mpeg2encoptions.hh"
+#include "mpeg2enc.hh"
 #include "encoderparams.hh"
 #include "picturereader.hh"
 #include "imageplanes.hh"
@@ -68,7 +67,9 @@
 #include "ontheflyratectlpass1.hh"
 #include "ontheflyratectlpass2.hh"
 #include "seqencoder.hh"
+#include "chunkencoder.hh"
 #include "mpeg2coder.hh"
+#include "instrumentation.hh"
 #include "format_codes.h"
 #include "mpegconsts.h"
 
@@ -276,31 +277,6 @@ int Y4MPipeReader::PipeRead(uint8_t *buf, int len)
 
 
 
-/**************************
- *
- * Derived class for options set from command line
- *
- *************************/
-
-class MPEG2EncCmdLineOptions : public MPEG2EncOptions
-{
-public:
-    MPEG2EncCmdLineOptions();
-    int SetFromCmdLine(int argc, char *argv[] );
-    void Usage();
-    void StartupBanner();
-    void SetFormatPresets( const MPEG2EncInVidParams &strm );
-private:
-    void DisplayFrameRates();
-    void DisplayAspectRatios();
-    int ParseCustomMatrixFile(const char *fname, int dbug);
-    void ParseCustomOption(const char *arg);
-public:
-    int istrm_fd;
-    char *outfilename;
-
-};
-
 void MPEG2EncCmdLineOptions::SetFormatPresets( const MPEG2EncInVidParams &strm )
 {
     if( MPEG2EncOptions::SetFormatPresets( strm ) )
@@ -312,6 +288,8 @@ MPEG2EncCmdLineOptions::MPEG2EncCmdLineOptions() :
 {
     outfilename = 0;
     istrm_fd = 0;
+    instrument_file = 0;
+    instrument_every = 0;
         
 }
 
@@ -556,6 +534,13 @@ void MPEG2EncCmdLineOptions::Usage()
 "    A work-around for a Bug in an obscure hardware decoder.\n"
 "--dualprime-mpeg2\n"
 "    Turn ON use of dual-prime motion compensation. Default is OFF unless this option is used\n"
+"--predictive-search\n"
+"    Use a fast predictive motion search seeded from neighbouring and\n"
+"    previous motion vectors instead of the exhaustive sub-sampled search.\n"
+"    Makes large search radii (-r) affordable for high-motion material.\n"
+"--no-global-motion\n"
+"    Do not centre motion searches on the estimated global motion (pans)\n"
+"    of each picture.\n"
 "--custom-quant-matrices|-K kvcd|tmpgenc|default|hi-res|file=inputfile|help\n"
 "    Request custom or userspecified (from a file) quantization matrices\n"
 "--unit-coeff-elim|-E num\n"
@@ -563,13 +548,49 @@ void MPEG2EncCmdLineOptions::Usage()
 "    because they code to only unit coefficients. The number specifies\n"
 "    how aggresively this should be done. A negative value means DC\n"
 "    coefficients are included.  Reasonable values -40 to 40\n"
+"--rd-quant\n"
+"    Choose the quantised DCT coefficients of each block to minimise\n"
+"    distortion plus bits (trellis quantisation).  Better quality for the\n"
+"    bits spent at some cost in encoding speed.\n"
+"--rd-mode-select num\n"
+"    Choose each macroblock's coding mode from its num best candidates (by\n"
+"    prediction error variance) by coding each and comparing bits and\n"
+"    distortion. [0|2..16] 0 = variance only (default: 0)\n"
 "--b-per-refframe| -R 0|1|2\n"
 "    The number of B frames to generate between each I/P frame\n"
+"--adaptive-b-frames\n"
+"    Choose the number of B frames between each I/P frame (up to the\n"
+"    -R setting) to suit the material, using the scene cut lookahead.\n"
 "--cbr|-u\n"
 "    For MPEG-2 force the use of (suboptimal) ConstantBitRate (CBR) encoding\n"
 "--chapters X[,Y[,...]]\n"
 "    Specifies which frames should be chapter points (first frame is 0)\n"
 "    Chapter points are I frames on closed GOP's.\n"
+"--gop-parallel num\n"
+"    Split the stream into chunks starting with closed GOPs and encode\n"
+"    num chunks concurrently.  Trades memory and latency for throughput\n"
+"    on machines with many CPU's. [0..16] 0 = off (default: 0)\n"
+"--chunk-gops num\n"
+"    Length of chunks for --gop-parallel in maximum size GOPs (default: 8)\n"
+"--read-ahead num\n"
+"    Read and prepare up to num input frames ahead of the encoder in a\n"
+"    thread of its own. [0..64] 0 = read on demand\n"
+"    (default: 8 if multi-threaded otherwise 0)\n"
+"--memory-budget MBytes\n"
+"    Limit the memory spent on optional buffering (input read-ahead and\n"
+"    concurrently transformed pictures) to fit an overall budget of\n"
+"    MBytes.  0 = unlimited (default: 0)\n"
+"--lookahead num\n"
+"    Scan num input frames ahead of the encoder for scene cuts and start\n"
+"    GOPs on them. [0..250] 0 = off\n"
+"    (default: maximum plus minimum GOP size)\n"
+"--instrument file\n"
+"    Write the time spent in each stage of encoding each picture, the\n"
+"    worker threads' busy and idle times and counts of motion search\n"
+"    SAD calls and bytes coded to file as JSON lines.\n"
+"--instrument-every num\n"
+"    Write the --instrument records out every num pictures rather than\n"
+"    only at the end of the stream. 0 = at end (default: 0)\n"
 "--help|-?\n"
 "    Print this lot out!\n"
 	);
@@ -611,6 +632,13 @@ void MPEG2EncCmdLineOptions::StartupBanner()
 		mjpeg_info( "Sequence unlimited length" );
 
 	mjpeg_info("Search radius: %d",searchrad);
+	if( predictive_search )
+		mjpeg_info("Motion search: predictive");
+	mjpeg_info("Global motion search centring: %s", global_motion ? "yes" : "no");
+	if( rd_quant )
+		mjpeg_info("Quantisation: rate-distortion optimised");
+	if( rd_mode_cands > 1 )
+		mjpeg_info("Coding mode: best by rate-distortion of %d candidates", rd_mode_cands);
 	if (mpeg == 2)
            {
            mjpeg_info("DualPrime: %s", hack_dualprime == 1 ? "yes" : "no");
@@ -625,7 +653,15 @@ int MPEG2EncCmdLineOptions::SetFromCmdLine( int argc,	char *argv[] )
 
 	enum LongOnlyOptions
 	{
-		CHAPTERS = 256
+		CHAPTERS = 256,
+		GOP_PARALLEL,
+		CHUNK_GOPS,
+		READ_AHEAD,
+		MEMORY_BUDGET,
+		LOOKAHEAD,
+		RD_MODE_SELECT,
+		INSTRUMENT,
+		INSTRUMENT_EVERY
 	};
 static const char   short_options[]=
         "l:a:f:x:y:n:b:z:T:B:q:o:S:I:r:M:4:2:A:Q:X:D:g:G:v:V:F:N:updsHcCPK:E:R:t:L:Z:";
@@ -673,14 +709,26 @@ static struct option long_options[]=
         { "no-constraints", 0, &ignore_constraints, 1},
         { "no-altscan-mpeg2", 0, &hack_altscan_bug, 1},
         { "dualprime-mpeg2", 0, &hack_dualprime, 1},
+        { "predictive-search", 0, &predictive_search, 1},
+        { "no-global-motion", 0, &global_motion, 0},
+        { "adaptive-b-frames", 0, &adaptive_bgroups, 1},
         { "playback-field-order", 1, 0, 'z'},
         { "multi-thread",      1, 0, 'M' },
         { "custom-quant-matrices", 1, 0, 'K'},
         { "unit-coeff-elim",   1, 0, 'E'},
+        { "rd-quant",          0, &rd_quant, 1},
         { "b-per-refframe",    1, 0, 'R' },
         { "cbr",               0, 0, 'u'},
         { "help",              0, 0, '?' },
         { "chapters",          1, 0, CHAPTERS },
+        { "gop-parallel",      1, 0, GOP_PARALLEL },
+        { "chunk-gops",        1, 0, CHUNK_GOPS },
+        { "read-ahead",        1, 0, READ_AHEAD },
+        { "memory-budget",     1, 0, MEMORY_BUDGET },
+        { "lookahead",         1, 0, LOOKAHEAD },
+        { "rd-mode-select",    1, 0, RD_MODE_SELECT },
+        { "instrument",        1, 0, INSTRUMENT },
+        { "instrument-every",  1, 0, INSTRUMENT_EVERY },
         { 0,                   0, 0, 0 }
     };
 
@@ -1000,6 +1048,65 @@ while( (n=getopt(argc,argv,short_options)) != -1)
             chapter_points.push_back(atoi(x));
         std::sort(chapter_points.begin(),chapter_points.end());
         break;
+    case GOP_PARALLEL :
+        gop_parallel = atoi(optarg);
+        if( gop_parallel < 0 || gop_parallel > 16 )
+        {
+            mjpeg_error( "--gop-parallel option requires arg 0..16" );
+            ++nerr;
+        }
+        break;
+    case CHUNK_GOPS :
+        chunk_gops = atoi(optarg);
+        if( chunk_gops < 1 )
+        {
+            mjpeg_error( "--chunk-gops option requires arg >= 1" );
+            ++nerr;
+        }
+        break;
+    case READ_AHEAD :
+        read_ahead = atoi(optarg);
+        if( read_ahead < 0 || read_ahead > 64 )
+        {
+            mjpeg_error( "--read-ahead option requires arg 0..64" );
+            ++nerr;
+        }
+        break;
+    case MEMORY_BUDGET :
+        memory_budget = atoi(optarg);
+        if( memory_budget < 0 )
+        {
+            mjpeg_error( "--memory-budget option requires arg >= 0" );
+            ++nerr;
+        }
+        break;
+    case LOOKAHEAD :
+        lookahead = atoi(optarg);
+        if( lookahead < 0 || lookahead > 250 )
+        {
+            mjpeg_error( "--lookahead option requires arg 0..250" );
+            ++nerr;
+        }
+        break;
+    case RD_MODE_SELECT :
+        rd_mode_cands = atoi(optarg);
+        if( rd_mode_cands < 0 || rd_mode_cands == 1 || rd_mode_cands > 16 )
+        {
+            mjpeg_error( "--rd-mode-select option requires arg 0 or 2..16" );
+            ++nerr;
+        }
+        break;
+    case INSTRUMENT :
+        instrument_file = optarg;
+        break;
+    case INSTRUMENT_EVERY :
+        instrument_every = atoi(optarg);
+        if( instrument_every < 0 )
+        {
+            mjpeg_error( "--instrument-every option requires arg >= 0" );
+            ++nerr;
+        }
+        break;
     case ':' :
         mjpeg_error( "Missing parameter to option!" );
     case '?':
@@ -1047,17 +1154,16 @@ return nerr;
 
 
 
-class YUV4MPEGEncoder : public MPEG2Encoder
-{
-public:
-    YUV4MPEGEncoder( MPEG2EncCmdLineOptions &options );
-    void Encode();
-};
-
-
 YUV4MPEGEncoder::YUV4MPEGEncoder( MPEG2EncCmdLineOptions &cmd_options ) :
     MPEG2Encoder( cmd_options )
 {
+    // N.b. must be set up before anything that might record with it
+    if( cmd_options.instrument_file != 0 )
+    {
+        instrumentation = new Instrumentation( cmd_options.instrument_file,
+                                               cmd_options.instrument_every );
+        parms.instrumentation = instrumentation;
+    }
     reader = new Y4MPipeReader( parms, cmd_options.istrm_fd );
     MPEG2EncInVidParams strm;
 
@@ -1094,7 +1200,8 @@ YUV4MPEGEncoder::YUV4MPEGEncoder( MPEG2EncCmdLineOptions &cmd_options ) :
                                 );
 
     // This order is important! Don't change...
-    parms.Init( options );
+    if( !parms.Init( options ) )
+        mjpeg_error_exit1( "Encoding options unusable" );
     reader->Init();
     quantizer->Init();
     seqencoder->Init();
@@ -1103,9 +1210,19 @@ YUV4MPEGEncoder::YUV4MPEGEncoder( MPEG2EncCmdLineOptions &cmd_options ) :
 
 void YUV4MPEGEncoder::Encode( )
 {
-    seqencoder->EncodeStream();
+    if( parms.gop_parallel > 0 )
+    {
+        ChunkEncoder chunkencoder( parms, *reader, *writer );
+        chunkencoder.EncodeStream();
+    }
+    else
+        seqencoder->EncodeStream();
 }
 
+/* bench_encode links this file for the encoder and its option
+   handling, but has its own main */
+
+#ifndef MPEG2ENC_NO_MAIN
 int main( int argc, char *argv[] )
 {
     MPEG2EncCmdLineOptions options;
@@ -1128,6 +1245,7 @@ int main( int argc, char *argv[] )
 #endif
 	return 0;
 }
+#endif
 
 
 /* 
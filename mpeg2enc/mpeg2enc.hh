@@ -0,0 +1,76 @@
+#ifndef _MPEG2ENC_HH
+#define _MPEG2ENC_HH
+
+/* mpeg2enc.hh - The YUV4MPEG / mjpegtools command line wrapper's
+ * encoder, shared with bench_encode which runs it in-process. */
+/*  (C) 2000/2001 Andrew Stevens */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include "mpeg2encoder.hh"
+#include "mpeg2encoptions.hh"
+
+/**************************
+ *
+ * Derived class for options set from command line
+ *
+ *************************/
+
+class MPEG2EncCmdLineOptions : public MPEG2EncOptions
+{
+public:
+    MPEG2EncCmdLineOptions();
+    int SetFromCmdLine(int argc, char *argv[] );
+    void Usage();
+    void StartupBanner();
+    void SetFormatPresets( const MPEG2EncInVidParams &strm );
+private:
+    void DisplayFrameRates();
+    void DisplayAspectRatios();
+    int ParseCustomMatrixFile(const char *fname, int dbug);
+    void ParseCustomOption(const char *arg);
+public:
+    int istrm_fd;
+    char *outfilename;
+    char *instrument_file;
+    int instrument_every;
+
+};
+
+/**************************
+ *
+ * Encoder of a YUV4MPEG stream read from istrm_fd to outfilename
+ *
+ *************************/
+
+class YUV4MPEGEncoder : public MPEG2Encoder
+{
+public:
+    YUV4MPEGEncoder( MPEG2EncCmdLineOptions &options );
+    void Encode();
+};
+
+
+/* 
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
+#endif
@@ -33,6 +33,7 @@
 #include "ratectl.hh"
 #include "seqencoder.hh"
 #include "mpeg2coder.hh"
+#include "instrumentation.hh"
 
 #include "simd.h"
 #include "motionsearch.h"
@@ -45,11 +46,12 @@ MPEG2Encoder::MPEG2Encoder( MPEG2EncOptions &_options) :
     quantizer(0),
     coder(0),
     pass1ratectl(0),
-    pass2ratectl(0)
+    pass2ratectl(0),
+    seqencoder(0),
+    instrumentation(0)
 {
-    if( !simd_init )
-        SIMDInitOnce();
-    simd_init = true;
+    // Encoders may be constructed concurrently by several threads
+    pthread_once( &simd_once, &MPEG2Encoder::SIMDInitOnce );
 }
 
 
@@ -63,16 +65,19 @@ MPEG2Encoder::~MPEG2Encoder()
     delete quantizer;
     delete writer;
     delete reader;
+    delete instrumentation;
 }
 
 
 bool MPEG2Encoder::simd_init = false;
+pthread_once_t MPEG2Encoder::simd_once = PTHREAD_ONCE_INIT;
     
 void MPEG2Encoder::SIMDInitOnce()
 {
 	init_motion_search();
 	init_transform();
 	init_predict();
+	simd_init = true;
 }    
 
 
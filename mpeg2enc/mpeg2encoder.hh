@@ -23,6 +23,7 @@
  */
 
 #include <stdio.h>
+#include <pthread.h>
 #include "mpeg2encoptions.hh"
 #include "encoderparams.hh"
 
@@ -37,6 +38,7 @@ class Transformer;
 class MPEG2CodingBuf;
 class BitStreamWriter;
 class ElemStrmWriter;
+class Instrumentation;
 
 class MPEG2Encoder
 {
@@ -44,8 +46,11 @@ public:
     MPEG2Encoder( MPEG2EncOptions &options );
     ~MPEG2Encoder();
 
+    // The SIMD routine selection is process-wide: made once, by
+    // whichever encoder is constructed first.
     static void SIMDInitOnce();
     static bool simd_init;
+    static pthread_once_t simd_once;
     MPEG2EncOptions &options;
     EncoderParams parms;
     PictureReader  *reader;
@@ -55,6 +60,7 @@ public:
     Pass1RateCtl   *pass1ratectl;
     Pass2RateCtl   *pass2ratectl;
     SeqEncoder     *seqencoder;
+    Instrumentation *instrumentation;   // Optional: 0 if none
 };
 
 
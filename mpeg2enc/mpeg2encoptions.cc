@@ -69,6 +69,12 @@ MPEG2EncOptions::MPEG2EncOptions()
  * Is fixed.
 */
     num_cpus = 0;
+    gop_parallel = 0;
+    chunk_gops = 8;
+    read_ahead = -1;
+    memory_budget = 0;
+    lookahead = -1;
+    adaptive_bgroups = 0;
     vid32_pulldown = 0;
     svcd_scan_data = -1;
     seq_hdr_every_gop = 0;
@@ -81,12 +87,16 @@ MPEG2EncOptions::MPEG2EncOptions()
     mpeg2_dc_prec = 1;
     ignore_constraints = 0;
     unit_coeff_elim = 0;
+    rd_quant = 0;
+    rd_mode_cands = 0;
     force_cbr = 0;
     verbose = 1;
     hack_svcd_hds_bug = 1;
     hack_altscan_bug = 0;
     /* dual prime Disabled by default. --dualprime-mpeg2 to enable (set to 1) */
     hack_dualprime = 0;
+    predictive_search = 0;
+    global_motion = 1;
     force_cbr = 0;
 };
 
@@ -235,7 +245,10 @@ int MPEG2EncOptions::CheckBasicConstraints()
 	if( vid32_pulldown )
 	{
 		if( mpeg == 1 )
-			mjpeg_error_exit1( "MPEG-1 cannot encode 3:2 pulldown (for transcoding to VCD set 24fps)!" );
+		{
+			mjpeg_error( "MPEG-1 cannot encode 3:2 pulldown (for transcoding to VCD set 24fps)!" );
+			++nerr;
+		}
 
 		if( frame_rate != 4 && frame_rate != 5  )
 		{
@@ -290,16 +303,17 @@ int MPEG2EncOptions::CheckBasicConstraints()
 	}
     if( preserve_B && Bgrp_size == 0 )
     {
-		mjpeg_error_exit1("Preserving I/P frame spacing is impossible for still encoding" );
+		mjpeg_error("Preserving I/P frame spacing is impossible for still encoding" );
+		++nerr;
     }
-
-	if( preserve_B && 
+	else if( preserve_B && 
 		( min_GOP_size % Bgrp_size != 0 ||
 		  max_GOP_size % Bgrp_size != 0 )
 		)
 	{
 		mjpeg_error("Preserving I/P frame spacing is impossible if min and max GOP sizes are" );
-		mjpeg_error_exit1("Not both divisible by %d", Bgrp_size );
+		mjpeg_error("Not both divisible by %d", Bgrp_size );
+		++nerr;
 	}
 
 	switch( format )
@@ -308,7 +322,10 @@ int MPEG2EncOptions::CheckBasicConstraints()
 	case MPEG_FORMAT_SVCD_NSR :
 	case MPEG_FORMAT_SVCD : 
 		if( aspect_ratio != 2 && aspect_ratio != 3 )
-			mjpeg_error_exit1("SVCD only supports 4:3 and 16:9 aspect ratios");
+		{
+			mjpeg_error("SVCD only supports 4:3 and 16:9 aspect ratios");
+			++nerr;
+		}
 		if( svcd_scan_data )
 		{
 			mjpeg_warn( "Generating dummy SVCD scan-data offsets to be filled in by \"vcdimager\"");
@@ -380,9 +397,187 @@ int MPEG2EncOptions::CheckBasicConstraints()
 
 
 
-bool MPEG2EncOptions::SetFormatPresets( const MPEG2EncInVidParams &strm )
+/*
+ * Check each option lies in the range the command line parser
+ * enforces, or is left at its "use default" value.  Encoders used as
+ * a library have their options set directly, bypassing the parser.
+ * RETURN: the number of options out of range.
+ */
+
+int MPEG2EncOptions::CheckRanges()
 {
     int nerr = 0;
+
+    if( format < MPEG_FORMAT_FIRST || format > MPEG_FORMAT_LAST )
+    {
+        mjpeg_error( "Format must be %d..%d", MPEG_FORMAT_FIRST, MPEG_FORMAT_LAST );
+        ++nerr;
+    }
+    if( mpeg != 1 && mpeg != 2 )
+    {
+        mjpeg_error( "MPEG version must be 1 or 2" );
+        ++nerr;
+    }
+    if( level != 0 && level != MAIN_LEVEL && level != HIGH_LEVEL )
+    {
+        mjpeg_error( "Level must be main or high" );
+        ++nerr;
+    }
+    if( bitrate < 0 || target_bitrate < 0 || nonvid_bitrate < 0 )
+    {
+        mjpeg_error( "Bit-rates must not be negative" );
+        ++nerr;
+    }
+    if( stream_Xhi != 0.0 && stream_Xhi < 1000000.0 )
+    {
+        mjpeg_error( "Mean complexity fails sanity check (< 1000000.0)" );
+        ++nerr;
+    }
+    if( still_size != 0 && (still_size < 20*1024 || still_size > 500*1024) )
+    {
+        mjpeg_error( "Still size must be 20..500KB" );
+        ++nerr;
+    }
+    if( mpeg2_dc_prec < 0 || mpeg2_dc_prec > 3 )
+    {
+        mjpeg_error( "Intra DC precision must be 8..11 bits" );
+        ++nerr;
+    }
+    if( quant < 0 || quant > 32 )
+    {
+        mjpeg_error( "Quantisation floor must be 1..32" );
+        ++nerr;
+    }
+    if( display_hsize < 0 || display_hsize >= 16384
+        || (display_hsize > 0 && display_hsize < 32)
+        || display_vsize < 0 || display_vsize >= 16384
+        || (display_vsize > 0 && display_vsize < 32) )
+    {
+        mjpeg_error( "Display size must be in range [32..16383]" );
+        ++nerr;
+    }
+    if( frame_rate != 0 && !mpeg_valid_framerate_code(frame_rate) )
+    {
+        mjpeg_error( "Illegal frame rate code %d", frame_rate );
+        ++nerr;
+    }
+    if( fieldenc < -1 || fieldenc > 2 )
+    {
+        mjpeg_error( "Field encoding must be 0, 1 or 2" );
+        ++nerr;
+    }
+    if( norm != 0 && norm != 'p' && norm != 'n' && norm != 's' )
+    {
+        mjpeg_error( "Norm must be n, p or s" );
+        ++nerr;
+    }
+    if( searchrad < 0 || searchrad > 32 )
+    {
+        mjpeg_error( "Search radius must be 0..32" );
+        ++nerr;
+    }
+    if( num_cpus < 0 || num_cpus > 32 )
+    {
+        mjpeg_error( "Encoding parallelism must be 0..32" );
+        ++nerr;
+    }
+    if( me44_red < 0 || me44_red > 4 || me22_red < 0 || me22_red > 4 )
+    {
+        mjpeg_error( "Motion search reduction factors must be 0..4" );
+        ++nerr;
+    }
+    if( video_buffer_size != 0
+        && (video_buffer_size < 20 || video_buffer_size > 4000) )
+    {
+        mjpeg_error( "Video buffer size must be 20..4000KB" );
+        ++nerr;
+    }
+    if( seq_length_limit < 0 )
+    {
+        mjpeg_error( "Sequence length limit must be positive" );
+        ++nerr;
+    }
+    if( min_GOP_size < -1 || max_GOP_size < -1
+        || min_GOP_size == 0 || max_GOP_size == 0 )
+    {
+        mjpeg_error( "GOP sizes must be positive" );
+        ++nerr;
+    }
+    if( Bgrp_size < 1 || Bgrp_size > 3 )
+    {
+        mjpeg_error( "B frames between I/P frames must be 0, 1 or 2" );
+        ++nerr;
+    }
+    if( hf_quant < 0 || hf_quant > 6 )
+    {
+        mjpeg_error( "Unknown quantisation matrix selection %d", hf_quant );
+        ++nerr;
+    }
+    if( hf_q_boost < 0.0 || hf_q_boost > 2.0 )
+    {
+        mjpeg_error( "High frequency quantisation boost must be 0.0 .. 2.0" );
+        ++nerr;
+    }
+    if( unit_coeff_elim < -40 || unit_coeff_elim > 40 )
+    {
+        mjpeg_error( "Unit coefficient elimination must be -40..40" );
+        ++nerr;
+    }
+    if( rate_control < 0 || rate_control > 1 )
+    {
+        mjpeg_error( "Rate control must be 0 or 1" );
+        ++nerr;
+    }
+    if( act_boost < 0.0 || act_boost > 4.0 )
+    {
+        mjpeg_error( "Activity boost must be 0.0 .. 4.0" );
+        ++nerr;
+    }
+    if( boost_var_ceil < 0 || boost_var_ceil > 50*50 )
+    {
+        mjpeg_error( "Boost variance ceiling must be 0 .. 2500" );
+        ++nerr;
+    }
+    if( gop_parallel < 0 || gop_parallel > 16 )
+    {
+        mjpeg_error( "GOP parallelism must be 0..16" );
+        ++nerr;
+    }
+    if( chunk_gops < 1 )
+    {
+        mjpeg_error( "GOPs per chunk must be >= 1" );
+        ++nerr;
+    }
+    if( read_ahead < -1 || read_ahead > 64 )
+    {
+        mjpeg_error( "Read-ahead must be 0..64 frames" );
+        ++nerr;
+    }
+    if( memory_budget < 0 )
+    {
+        mjpeg_error( "Memory budget must be >= 0" );
+        ++nerr;
+    }
+    if( lookahead < -1 || lookahead > 250 )
+    {
+        mjpeg_error( "Lookahead must be 0..250 frames" );
+        ++nerr;
+    }
+    if( rd_mode_cands < 0 || rd_mode_cands == 1 || rd_mode_cands > 16 )
+    {
+        mjpeg_error( "RD mode selection candidates must be 0 or 2..16" );
+        ++nerr;
+    }
+    return nerr;
+}
+
+
+
+bool MPEG2EncOptions::SetFormatPresets( const MPEG2EncInVidParams &strm )
+{
+    int nerr = CheckRanges();
+    if( nerr != 0 )
+        return true;
     in_img_width = strm.horizontal_size;
     in_img_height = strm.vertical_size;
     mjpeg_info( "Selecting %s output profile", 
@@ -477,7 +672,8 @@ bool MPEG2EncOptions::SetFormatPresets( const MPEG2EncInVidParams &strm )
 				still_size = 30*1024;
 			if( still_size < 20*1024 || still_size > 42*1024 )
 			{
-				mjpeg_error_exit1( "VCD normal-resolution stills must be >= 20KB and <= 42KB each");
+				mjpeg_error( "VCD normal-resolution stills must be >= 20KB and <= 42KB each");
+				++nerr;
 			}
 			/* VBV delay encoded normally */
 			vbv_buffer_still_size = 46*1024;
@@ -494,7 +690,8 @@ bool MPEG2EncOptions::SetFormatPresets( const MPEG2EncInVidParams &strm )
 				still_size = 125*1024;
 			if( still_size < 46*1024 || still_size > 220*1024 )
 			{
-				mjpeg_error_exit1( "VCD normal-resolution stills should be >= 46KB and <= 220KB each");
+				mjpeg_error( "VCD normal-resolution stills should be >= 46KB and <= 220KB each");
+				++nerr;
 			}
 			vbv_buffer_still_size = still_size;
 			video_buffer_size = 224;
@@ -503,7 +700,8 @@ bool MPEG2EncOptions::SetFormatPresets( const MPEG2EncInVidParams &strm )
 		else
 		{
 			mjpeg_error("VCD normal resolution stills must be 352x288 (PAL) or 352x240 (NTSC)");
-			mjpeg_error_exit1( "VCD high resolution stills must be 704x576 (PAL) or 704x480 (NTSC)");
+			mjpeg_error( "VCD high resolution stills must be 704x576 (PAL) or 704x480 (NTSC)");
+			++nerr;
 		}
 		seq_hdr_every_gop = 1;
 		seq_end_every_gop = 1;
@@ -546,12 +744,14 @@ bool MPEG2EncOptions::SetFormatPresets( const MPEG2EncInVidParams &strm )
 		else
 		{
 			mjpeg_error("SVCD normal resolution stills must be 480x576 (PAL) or 480x480 (NTSC)");
-			mjpeg_error_exit1( "SVCD high resolution stills must be 704x576 (PAL) or 704x480 (NTSC)");
+			mjpeg_error( "SVCD high resolution stills must be 704x576 (PAL) or 704x480 (NTSC)");
+			++nerr;
 		}
 
 		if( still_size < 30*1024 || still_size > 200*1024 )
 		{
-			mjpeg_error_exit1( "SVCD resolution stills must be >= 30KB and <= 200KB each");
+			mjpeg_error( "SVCD resolution stills must be >= 30KB and <= 200KB each");
+			++nerr;
 		}
 
 
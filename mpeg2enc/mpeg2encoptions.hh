@@ -47,6 +47,7 @@ public:
     bool SetFormatPresets(  const MPEG2EncInVidParams &strm );  // True iff fail
     int InferStreamDataParams( const MPEG2EncInVidParams &strm );
     int CheckBasicConstraints();
+    int CheckRanges();
 
     uint16_t custom_intra_quantizer_matrix[64];
     uint16_t custom_nonintra_quantizer_matrix[64];
@@ -63,6 +63,17 @@ struct MPEG2EncParams
     int preserve_B;
     int Bgrp_size;
     int num_cpus;
+    int gop_parallel;           /* # GOP-aligned chunks encoded concurrently
+                                   (0 = normal sequential encoding) */
+    int chunk_gops;             /* Maximum length GOPs per chunk */
+    int read_ahead;             /* Input frames read ahead by a reader
+                                   thread (-1 = automatic) */
+    int memory_budget;          /* Approximate limit on buffer memory
+                                   in MBytes (0 = unlimited) */
+    int lookahead;              /* Input frames scanned ahead for scene
+                                   cuts (-1 = automatic) */
+    int adaptive_bgroups;       /* Choose # B frames per I/P frame to
+                                   suit the material */
     int vid32_pulldown;
     int svcd_scan_data;
     int seq_hdr_every_gop;
@@ -75,9 +86,17 @@ struct MPEG2EncParams
     int hack_svcd_hds_bug;
     int hack_altscan_bug;
     int hack_dualprime;
+    int predictive_search;      /* Predictive rather than exhaustive
+                                   motion search */
+    int global_motion;          /* Centre motion searches on the
+                                   picture's global motion */
     int mpeg2_dc_prec;
     int ignore_constraints;
     int unit_coeff_elim;
+    int rd_quant;               /* Rate-distortion optimised (trellis)
+                                   quantisation */
+    int rd_mode_cands;          /* Macroblock coding modes compared by
+                                   rate-distortion cost (0 = off) */
     int force_cbr;
     int verbose;
 };
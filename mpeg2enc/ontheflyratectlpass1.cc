@@ -316,6 +316,7 @@ void OnTheFlyPass1::InitPict(Picture &picture)
 	avg_act = actsum/(double)(encparams.mb_per_pict);
 	sum_avg_act += avg_act;
 	actcovered = 0.0;
+	mbs_covered = 0;
 	sum_base_Q = 0.0;
     sum_actual_Q = 0;
 
@@ -657,9 +658,14 @@ int OnTheFlyPass1::MacroBlockQuant( const MacroBlock &mb )
         */
 
         /* Guesstimate a virtual buffer fullness based on
-           bits used vs. bits in proportion to activity encoded
+           bits used vs. bits in proportion to activity encoded.
+           N.b. the bits used may not yet include those of the last
+           few macroblocks quantised (see Picture::QuantiseAndCode)
+           so nor may the activity.
         */
 
+        while( mbs_covered < picture.CodedMacroBlocks() )
+            actcovered += picture.mbinfo[mbs_covered++].BaseLumVariance();
 
         double dj = static_cast<double>(vbuf_fullness) 
             + static_cast<double>(picture.EncodedSize())
@@ -716,8 +722,6 @@ int OnTheFlyPass1::MacroBlockQuant( const MacroBlock &mb )
 
     sum_base_Q += cur_base_Q;
     sum_actual_Q += cur_mquant;
-	/* Update activity covered */
-	actcovered += lum_variance;
 
 	return cur_mquant;
 }
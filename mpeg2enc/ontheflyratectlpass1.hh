@@ -61,13 +61,15 @@ public:
 
     /*
 	  actsum - Total activity (sum block lum variances) in frame
-	  actcovered - Activity macroblocks so far quantised (used to
+	  actcovered - Activity of the macroblocks so far coded (used to
 	  fine tune quantisation to avoid starving highly
-	  active blocks appearing late in frame...) UNUSED
+	  active blocks appearing late in frame...)
+	  mbs_covered - Number of those macroblocks
 	  avg_act - Current average activity...
 	*/
 	double actsum;
 	double actcovered;
+	int mbs_covered;
 	double sum_avg_act;
 	double avg_act;
 	double sum_avg_quant;
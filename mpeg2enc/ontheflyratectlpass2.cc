@@ -82,6 +82,7 @@ OnTheFlyPass2::OnTheFlyPass2(EncoderParams &encparams ) :
         m_picture_xhi_bitrate = 0;
         m_strm_Xhi = 0.0;
         m_seq_ctrl_bitrate = encparams.bit_rate;
+        start_buffer_variation = 0;
 }
 
 
@@ -111,7 +112,9 @@ void OnTheFlyPass2::InitSeq()
   /* If its stills with a size we have to hit then make the
      guesstimates of for initial quantisation pessimistic...
   */
-  bits_transported = seq_bits_used = 0;
+  bits_transported = start_buffer_variation;
+  seq_bits_used = 0;
+  start_buffer_variation = 0;
   field_rate = 2*encparams.decode_frame_rate;
   fields_per_pict = encparams.fieldpic ? 1 : 2;
 
@@ -133,6 +136,13 @@ void OnTheFlyPass2::InitSeq()
 }
 
 
+void OnTheFlyPass2::ContinueBufferState( int32_t variation )
+{
+  buffer_variation = variation;
+  start_buffer_variation = variation;
+}
+
+
 void OnTheFlyPass2::GopSetup( std::deque<Picture *>::iterator gop_begin,
                               std::deque<Picture *>::iterator gop_end )
 {
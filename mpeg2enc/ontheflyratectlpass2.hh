@@ -157,6 +157,13 @@ public:
                            std::deque<Picture *>::iterator gop_end );
     virtual void PictUpdate (Picture &picture, int &padding_needed );
 
+    /*
+     * Start the first sequence with the decoder buffer 'variation'
+     * bits short of full (rather than full) to carry on the buffer
+     * state left by a preceding, separately encoded, stream.
+     */
+    void ContinueBufferState( int32_t variation );
+
     virtual int  MacroBlockQuant( const MacroBlock &mb);
     virtual int  InitialMacroBlockQuant();
 
@@ -217,6 +224,7 @@ private:
     int sum_actual_Q;         // Accumulates actual quantisation
     double buffer_variation_danger; // Buffer variation level below full
                                  // at which serious risk of data under-run in muxed stream
+    int32_t start_buffer_variation; // Buffer variation next sequence starts with
 };
 
 
@@ -47,6 +47,7 @@
 #include "config.h"
 #include <cassert>
 #include <math.h>
+#include <stdlib.h>
 #include "mjpeg_types.h"
 #include "mjpeg_logging.h"
 #include "mpeg2syntaxcodes.h"
@@ -58,7 +59,90 @@
 #include "seqencoder.hh"
 #include "ratectl.hh"
 #include "tables.h"
+#include "despatcher.hh"
 #include "imageplanes.hh"
+#include "picturepool.hh"
+
+
+/**************************
+ *
+ * A slice to be coded by a worker thread into its own fragment buffer.
+ * The coded slice is transferred to the picture's coding buffer rather
+ * than flushed out to an ElemStrmWriter.
+ *
+ *************************/
+
+class SliceJob : public DespatcherJob, private ElemStrmWriter
+{
+public:
+    SliceJob( Picture &_picture ) :
+        picture( _picture ),
+        slice_coding( _picture.encparams, *this ),
+        coder( _picture, slice_coding )
+        {}
+
+    virtual void Perform()
+        {
+            if( picture.encparams.rd_quant )
+                QuantiseRD();
+            StageTimer timer( picture.encparams.instrumentation,
+                              picture.timings, STAGE_VLC );
+            coder.CodeSlice( slice_mb_y, mquant_pred );
+        }
+
+    void Transfer()
+        {
+            // Slices start byte-aligned
+            picture.coding->AlignBits();
+            slice_coding.TransferTo( *picture.coding );
+        }
+
+    int slice_mb_y;
+    int mquant_pred;
+private:
+    /*
+     * RD optimised quantisation needs the VLC coding costs and is
+     * expensive so it is done here, a slice to a worker thread, rather
+     * than by the thread running rate control.  Rate control's choice
+     * of quantisation for each macroblock has already been made.
+     */
+    void QuantiseRD()
+        {
+            EncoderParams &encparams = picture.encparams;
+            MacroBlock *mb = &picture.mbinfo[slice_mb_y * encparams.mb_width];
+            bool coded = false;
+            for( int i = 0; i < encparams.mb_width; ++i, ++mb )
+            {
+                StageTimer timer( encparams.instrumentation,
+                                  picture.timings, STAGE_QUANT );
+                mb->QuantizeRD( picture.quantizer, slice_coding );
+                // Start the slice with the quantisation of its first
+                // macroblock with coded DCT blocks
+                if( mb->CBP() && !coded )
+                {
+                    mquant_pred = mb->MQuant();
+                    coded = true;
+                }
+            }
+        }
+
+    virtual void WriteOutBufferUpto( const uint8_t *buffer, const uint32_t flush_upto )
+        {
+            mjpeg_error_exit1( "INTERNAL: coded slices are transferred not flushed" );
+        }
+    virtual uint64_t BitCount() { return 0; }
+
+    Picture &picture;
+    MPEG2CodingBuf slice_coding;
+    SliceCoder coder;
+};
+
+/*
+ * Coded slices are appended to the picture's coding this many slices
+ * behind the slice being quantised.
+ */
+
+static const int SLICE_CODING_LAG = 4;
 
 
 Picture::Picture( EncoderParams &_encparams, 
@@ -69,33 +153,50 @@ Picture::Picture( EncoderParams &_encparams,
     coding( new MPEG2CodingBuf( _encparams, writer) )
 {
 	int i,j;
-	/* Allocate buffers for picture transformation */
-	blocks = 
-        static_cast<DCTblock*>(
-            bufalloc(encparams.mb_per_pict*BLOCK_COUNT*sizeof(DCTblock)));
-	qblocks =
-		static_cast<DCTblock *>(
-            bufalloc(encparams.mb_per_pict*BLOCK_COUNT*sizeof(DCTblock)));
-    DCTblock *block = blocks;
-    DCTblock *qblock = qblocks;
+    // N.b. the buffers for picture transformation are only attached
+    // while the picture is actually being encoded.
+    mbfields.Init( encparams.mb_per_pict );
+    mbinfo.reserve( encparams.mb_per_pict );
     for (j=0; j<encparams.enc_height2; j+=16)
     {
         for (i=0; i<encparams.enc_width; i+=16)
         {
-            mbinfo.push_back(MacroBlock(*this, i,j, block,qblock ));
-            block += BLOCK_COUNT;
-            qblock += BLOCK_COUNT;
+            mbinfo.push_back(MacroBlock(*this, mbfields, mbinfo.size(), i,j ));
         }
     }
-
+    transform = 0;
+    pred = 0;
 
     rec_img = new ImagePlanes( encparams );
-    pred   = new ImagePlanes( encparams );
+
+    rd_scratch_blocks = 0;
+    if( encparams.rd_mode_cands > 1 )
+    {
+        unsigned int rows = mbinfo.size() / encparams.mb_width;
+        rd_scratch_blocks =
+            static_cast<DCTblock *>(
+                bufalloc( rows * 2 * BLOCK_COUNT * sizeof(DCTblock) ) );
+        rd_scratch.resize( rows );
+        for( unsigned int r = 0; r < rows; ++r )
+        {
+            rd_scratch[r].blocks = rd_scratch_blocks + 2 * r * BLOCK_COUNT;
+            rd_scratch[r].qblocks = rd_scratch[r].blocks + BLOCK_COUNT;
+            rd_scratch[r].counter = new MPEG2CountingBuf( encparams );
+        }
+    }
+
+    for( j = 0; j < SLICE_CODING_LAG; ++j )
+        slice_jobs.push_back( new SliceJob( *this ) );
 
     // Initialise the reference image pointers to NULL to ensure errors show
     org_img = 0;
     fwd_rec = fwd_org = 0;
     bwd_rec = bwd_org = 0;
+    fwd_ref_frame = bwd_ref_frame = 0;
+    fwd_ref_distance = 0;
+    coded_mbs = 0;
+    refcount = 0;
+    org_frame = -1;
 
     // This is really just a dummy for the non 0xffff case.  Its ignored by decodes
     // anyhow (completely useless piece of information - only a Committee creation
@@ -109,11 +210,48 @@ Picture::Picture( EncoderParams &_encparams,
 
 Picture::~Picture()
 {
+    for( unsigned int r = 0; r < rd_scratch.size(); ++r )
+        delete rd_scratch[r].counter;
+    free( rd_scratch_blocks );
+    for( unsigned int j = 0; j < slice_jobs.size(); ++j )
+        delete slice_jobs[j];
     delete rec_img;
-    delete pred;
     delete coding;
 }
 
+/*
+ *
+ * Attach / detach the working storage needed to transform, code and
+ * reconstruct the picture.
+ *
+ */
+
+void Picture::AttachTransformBuffers( TransformBuffers *buffers )
+{
+    transform = buffers;
+    pred = buffers->pred;
+    DCTblock *block = buffers->blocks;
+    DCTblock *qblock = buffers->qblocks;
+    vector<MacroBlock>::iterator mbi;
+    for( mbi = mbinfo.begin(); mbi < mbinfo.end(); ++mbi )
+    {
+        mbi->SetDCTblocks( block, qblock );
+        block += BLOCK_COUNT;
+        qblock += BLOCK_COUNT;
+    }
+}
+
+TransformBuffers *Picture::DetachTransformBuffers()
+{
+    TransformBuffers *buffers = transform;
+    transform = 0;
+    pred = 0;
+    vector<MacroBlock>::iterator mbi;
+    for( mbi = mbinfo.begin(); mbi < mbinfo.end(); ++mbi )
+        mbi->SetDCTblocks( 0, 0 );
+    return buffers;
+}
+
 /*
  *
  * Reconstruct the decoded image for references images and
@@ -124,9 +262,10 @@ Picture::~Picture()
 
 void Picture::Reconstruct()
 {
+    StageTimer timer( encparams.instrumentation, timings, STAGE_RECON );
 
 #ifndef OUTPUT_STAT
-	if( pict_type!=B_TYPE)
+	if( pict_type!=B_TYPE || encparams.snr_totals != 0 )
 	{
 #endif
 		IQuantize();
@@ -159,7 +298,9 @@ void Picture::SetFrameParams( const StreamState &ss, int field )
     np = ss.np;
     closed_gop = ss.closed_gop;
     dc_prec = encparams.dc_prec;
+    fwd_ref_distance = fwd_ref_frame != 0 ? present - fwd_ref_frame->present : 0;
     SetFieldParams( field );
+    EstimateGlobalMotion();
 }
 
 
@@ -326,10 +467,10 @@ void Picture::IQuantize()
 double Picture::VarSumBestMotionComp()
 {
     double var_sum = 0.0;
-    vector<MacroBlock>::iterator i;
-    for( i = mbinfo.begin(); i < mbinfo.end(); ++i )
+    const int *var = &mbfields.var[0];
+    for( int k = 0; k < encparams.mb_per_pict; ++k )
     {
-        var_sum += i->best_me->var;
+        var_sum += var[k];
     }
     return var_sum;
 }
@@ -337,11 +478,11 @@ double Picture::VarSumBestMotionComp()
 double Picture::MinVarBestMotionComp()
 {
     double min_var = 1.0e26;
-    vector<MacroBlock>::iterator i;
-    for( i = mbinfo.begin(); i < mbinfo.end(); ++i )
+    const int *var = &mbfields.var[0];
+    for( int k = 0; k < encparams.mb_per_pict; ++k )
     {
         min_var = fmin( min_var,
-                        static_cast<double>(i->best_me->var) );
+                        static_cast<double>(var[k]) );
     }
     return min_var;
 }
@@ -362,9 +503,12 @@ double Picture::ActivityBestMotionComp()
 	double actj,sum;
 	int blksum;
 	sum = 0.0;
-    vector<MacroBlock>::iterator i;
-    for (i = mbinfo.begin(); i < mbinfo.end(); ++i )
+    const int *mb_type = &mbfields.mb_type[0];
+    double *act = &mbfields.act[0];
+    for( int k = 0; k < encparams.mb_per_pict; ++k )
     {
+        DCTblock *blocks = mbinfo[k].RawDCTblocks();
+
         /* A.Stevens Jul 2000 Luminance variance *has* to be a
            rotten measure of how active a block in terms of bits
            needed to code a lossless DCT.  E.g. a half-white
@@ -375,7 +519,7 @@ double Picture::ActivityBestMotionComp()
            original we use the absolute sum of DCT coefficients as
            our block activity measure.  */
 
-        if( i->best_me->mb_type  & MB_INTRA )
+        if( mb_type[k] & MB_INTRA )
         {
             /* Compensate for the wholly disproprotionate weight
              of the DC coefficients.  Shold produce more sensible
@@ -385,14 +529,14 @@ double Picture::ActivityBestMotionComp()
             blksum =  -80*COEFFSUM_SCALE;
             for( int l = 0; l < 6; ++l )
                 blksum += 
-                    quantizer.WeightCoeffIntra( i->RawDCTblocks()[l] ) ;
+                    quantizer.WeightCoeffIntra( blocks[l] ) ;
         }
         else
         {
             blksum = 0;
             for( int l = 0; l < 6; ++l )
                 blksum += 
-                    quantizer.WeightCoeffInter( i->RawDCTblocks()[l] ) ;
+                    quantizer.WeightCoeffInter( blocks[l] ) ;
         }
         /* It takes some bits to code even an entirely zero block...
            It also makes a lot of calculations a lot better conditioned
@@ -405,7 +549,7 @@ double Picture::ActivityBestMotionComp()
         if( actj < 12.0 )
             actj = 12.0;
 
-        i->act = actj;
+        act[k] = actj;
         sum += actj;
     }
     return sum;
@@ -422,54 +566,23 @@ void Picture::ITransform()
 	}
 }
 
-void Picture::MotionSubSampledLum( )
-{
-	int linestride;
-    EncoderParams &eparams = encparams;
-	/* In an interlaced field the "next" line is 2 width's down rather
-	   than 1 width down  .
-       TODO: Shoudn't we be treating the frame as interlaced for
-       frame based interlaced encoding too... or at least for the
-       interlaced ME modes?
-    */
-
-	if (!eparams.fieldpic)
-	{
-		linestride = eparams.phy_width;
-	}
-	else
-	{
-		linestride = 2*eparams.phy_width;
-	}
-
-    uint8_t *org_Y = org_img->Plane(0);
-    psubsample_image( org_Y, 
-                                 linestride,
-                                 org_Y+eparams.fsubsample_offset, 
-                                 org_Y+eparams.qsubsample_offset );
-}
-
 
-//
-// TODO Coders internal state (.e.g prev_mb) should be taken out of Picture object state
-//
-
-bool Picture::SkippableMotionMode( MotionEst &cur_mb_mm, MotionEst &prev_mb_mm)
+bool SliceCoder::SkippableMotionMode( MotionEst &cur_mb_mm, MotionEst &prev_mb_mm)
 {
 
-    if (pict_type==P_TYPE && !(cur_mb_mm.mb_type&MB_FORWARD))
+    if (picture.pict_type==P_TYPE && !(cur_mb_mm.mb_type&MB_FORWARD))
     {
         /* P picture, no motion vectors -> skipable */
         return true;
     }
-    else if(pict_type==B_TYPE )
+    else if(picture.pict_type==B_TYPE )
     {
         /* B frame picture with same prediction type
          * (forward/backward/interp.)  and same active vectors
          * as in previous macroblock -> skippable
          */
 
-        if (  pict_struct==FRAME_PICTURE
+        if (  picture.pict_struct==FRAME_PICTURE
               && cur_mb_mm.motion_type==MC_FRAME
               && ((prev_mb_mm.mb_type ^ cur_mb_mm.mb_type) &(MB_FORWARD|MB_BACKWARD))==0
               && (!(cur_mb_mm.mb_type&MB_FORWARD) ||
@@ -488,17 +601,17 @@ bool Picture::SkippableMotionMode( MotionEst &cur_mb_mm, MotionEst &prev_mb_mm)
          * vertical field selects as current field -> skippable
          */
 
-        if (pict_struct!=FRAME_PICTURE
+        if (picture.pict_struct!=FRAME_PICTURE
             && cur_mb_mm.motion_type==MC_FIELD
             && ((prev_mb_mm.mb_type^cur_mb_mm.mb_type)&(MB_FORWARD|MB_BACKWARD))==0
             && (!(cur_mb_mm.mb_type&MB_FORWARD) ||
                 (PMV[0][0][0]==cur_mb_mm.MV[0][0][0] &&
                  PMV[0][0][1]==cur_mb_mm.MV[0][0][1] &&
-                 cur_mb_mm.field_sel[0][0]==(pict_struct==BOTTOM_FIELD)))
+                 cur_mb_mm.field_sel[0][0]==(picture.pict_struct==BOTTOM_FIELD)))
             && (!(cur_mb_mm.mb_type&MB_BACKWARD) ||
                 (PMV[0][1][0]==cur_mb_mm.MV[0][1][0] &&
                  PMV[0][1][1]==cur_mb_mm.MV[0][1][1] &&
-                 cur_mb_mm.field_sel[0][1]==(pict_struct==BOTTOM_FIELD))))
+                 cur_mb_mm.field_sel[0][1]==(picture.pict_struct==BOTTOM_FIELD))))
         {
             return true;
         }
@@ -509,148 +622,228 @@ bool Picture::SkippableMotionMode( MotionEst &cur_mb_mm, MotionEst &prev_mb_mm)
 }
 
 
+/* ************************************************
+ *
+ * CodeSlice - Generate the VLC bitstream for a slice (a row of
+ * macroblocks) whose macroblocks have already been quantised.
+ *
+ * mquant_pred - the quantisation in force at the start of the slice
+ * (coded in the slice header).
+ *
+ * *********************************************** */
+
+void SliceCoder::CodeSlice( int slice_mb_y, int mquant_pred )
+{
+    StartSlice( slice_mb_y, mquant_pred );
+    for( int i = 0; i < picture.encparams.mb_width; ++i )
+        CodeMacroBlock();
+}
+
+void SliceCoder::StartSlice( int slice_mb_y, int _mquant_pred )
+{
+    mquant_pred = _mquant_pred;
+    PutSliceHdr(slice_mb_y, mquant_pred);
+    Reset_DC_DCT_Pred();
+    Reset_MV_Pred();
+
+    MBAinc = 1; /* first MBAinc denotes absolute position */
+    slice_mb_x = 0;
+    cur_mb = &picture.mbinfo[slice_mb_y * picture.encparams.mb_width];
+    prev_mb = 0;
+}
+
+/*
+ * Code the slice's next macroblock, which must already have been
+ * quantised.
+ */
+
+void SliceCoder::CodeMacroBlock()
+{
+    int i = slice_mb_x;
+
+    /*
+     * Macroblocks that don't end or begin a slice, don't have a coded DCT block and
+     * whose motion compensation is predicted and doesn't need coding can be skipped.
+     *
+     */
+
+
+    if( i!=0 && i!=picture.encparams.mb_width-1 && !cur_mb->CBP()
+        && SkippableMotionMode( *cur_mb->best_me, *prev_mb->best_me ) )
+    {
+        ++MBAinc;
+        if( picture.pict_type == P_TYPE )
+        {
+            /* reset predictors */
+            Reset_DC_DCT_Pred();
+            Reset_MV_Pred();
+        }
+    }
+    else
+    {
+        int mb_type = cur_mb->best_me->mb_type;
+
+        /* Code mquant and update prediction if it changed in this macroblock */
+        if( cur_mb->CBP() && cur_mb->MQuant() != mquant_pred )
+        {
+            mquant_pred = cur_mb->MQuant();
+            mb_type |= MB_QUANT;
+        }
+
+        /* Inter-coded MB with some coded DCT blocks ===> PATTERN to code */
+        if ( cur_mb->CBP() && !(mb_type & MB_INTRA) )
+            mb_type|= MB_PATTERN;
+        /* For P frames there's no VLC for 'No MC, Not Coded':
+         * we have to transmit (0,0) motion vectors
+         */
+        if ( picture.pict_type==P_TYPE && !cur_mb->CBP())
+            mb_type|= MB_FORWARD;
+        coding.PutAddrInc(MBAinc); /* macroblock_address_increment */
+        MBAinc = 1;
+
+        coding.PutMBType(picture.pict_type,mb_type); /* macroblock type */
+
+        if ( (mb_type & (MB_FORWARD|MB_BACKWARD)) && !picture.frame_pred_dct)
+            coding.PutBits(cur_mb->best_me->motion_type,2);
+
+        if (picture.pict_struct==FRAME_PICTURE && cur_mb->CBP() && !picture.frame_pred_dct)
+            coding.PutBits(cur_mb->field_dct,1);
+
+        if (mb_type & MB_QUANT)
+        {
+            coding.PutBits(picture.q_scale_type
+                           ? map_non_linear_mquant[cur_mb->MQuant()]
+                           : cur_mb->MQuant()>>1,5);
+        }
+
+
+
+        if (mb_type & MB_FORWARD)
+        {
+            /* forward motion vectors, update predictors */
+            PutMVs( *cur_mb->best_me, false );
+        }
+
+        if (mb_type & MB_BACKWARD)
+        {
+            /* backward motion vectors, update predictors */
+            PutMVs( *cur_mb->best_me,  true );
+        }
+
+        if (mb_type & MB_PATTERN)
+        {
+            coding.PutCPB((cur_mb->CBP() >> (BLOCK_COUNT-6)) & 63);
+        }
+
+        /* Output VLC DCT Blocks for Macroblock */
+
+        PutDCTBlocks( *cur_mb, mb_type );
+        /* reset predictors */
+        if (!(mb_type & MB_INTRA))
+            Reset_DC_DCT_Pred();
+
+        if (mb_type & MB_INTRA || (picture.pict_type==P_TYPE && !(mb_type & MB_FORWARD)))
+        {
+            Reset_MV_Pred();
+        }
+    }
+    ++slice_mb_x;
+    prev_mb = cur_mb;
+    ++cur_mb;
+}
+
 /* ************************************************
  *
  * QuantiseAndEncode - Quantise and Encode a picture.
  *
  * NOTE: It may seem perverse to quantise at the same time as
- * coding-> However, actually makes (limited) sense
- * - feedback from the *actual* bit-allocation may be used to adjust 
- * quantisation "on the fly". This is good for fast 1-pass no-look-ahead coding->
+ * coding. However, actually makes (limited) sense
+ * - feedback from the *actual* bit-allocation may be used to adjust
+ * quantisation "on the fly". This is good for fast 1-pass no-look-ahead coding.
  * - The coded result is in any even only buffered not actually written
  * out. We can back off and try again with a different quantisation
  * easily.
- * - The alternative is calculating size and generating actual codes seperately.
- * The poorer cache coherence of this latter probably makes the performance gain
- * modest.
+ *
+ * Quantisation (and hence rate control) is done one slice at a time
+ * in this thread.  The VLC coding of each quantised slice is
+ * despatched to the worker threads, each slice being coded into the
+ * buffer of one of the picture's slice_jobs.  The coded slices are
+ * appended to the picture's coding in order once SLICE_CODING_LAG
+ * further slices have been quantised.  With RD optimised quantisation
+ * the slice jobs quantise their slices too, so only rate control's
+ * choice of quantisation is made in this thread.
+ *
+ * Rate control that steers by the bits used so far thus only sees
+ * those of the slices appended: it compares them with the activity
+ * of the macroblocks they were used for (CodedMacroBlocks) so it
+ * makes exactly the same choices whatever the number of threads.
  *
  * *********************************************** */
 
-void Picture::QuantiseAndCode(RateCtl &ratectl)
+void Picture::QuantiseAndCode(RateCtl &ratectl, Despatcher &despatcher)
 {
-    /* Now the actual quantisation and encoding->.. */
- 
     int i, j, k;
-    int MBAinc;
-    MacroBlock *cur_mb = 0;
+    MacroBlock *cur_mb;
 	int mquant_pred = ratectl.InitialMacroBlockQuant();
 
-	k = 0;
-    
     /* TODO: We're currently hard-wiring each macroblock row as a
        slice.  For MPEG-2 we could do this better and reduce slice
        start code coverhead... */
 
+	k = 0;
+    coded_mbs = 0;
 	for (j=0; j<encparams.mb_height2; j++)
 	{
-        PutSliceHdr(j, mquant_pred);
-        Reset_DC_DCT_Pred();
-        Reset_MV_Pred();
-
-        MBAinc = 1; /* first MBAinc denotes absolute position */
+        SliceJob *slice = slice_jobs[j % SLICE_CODING_LAG];
+        if( j >= SLICE_CODING_LAG )
+        {
+            despatcher.WaitFor( *slice );
+            slice->Transfer();
+            coded_mbs = (j - SLICE_CODING_LAG + 1) * encparams.mb_width;
+        }
+        slice->slice_mb_y = j;
+        slice->mquant_pred = mquant_pred;
 
-        /* Slice of macroblocks... */
 		for (i=0; i<encparams.mb_width; i++)
 		{
-            prev_mb = cur_mb;
 			cur_mb = &mbinfo[k];
 
             int suggested_mquant = ratectl.MacroBlockQuant( *cur_mb );
-            cur_mb->mquant = suggested_mquant;
-
-			/* Quantize macroblock : N.b. cbp is also set as side-effect of call. */
-            cur_mb->Quantize( quantizer);
-
-            /*
-             * Macroblocks that don't end or begin a slice, don't have a coded DCT block and
-             * whose motion compensation is predicted and doesn't need coding can be skipped.
-             *
-             */
+            cur_mb->MQuant() = suggested_mquant;
+            ++k;
 
+            /* RD optimised quantisation is left to the slice job */
+            if( encparams.rd_quant )
+                continue;
 
-            if( i!=0 && i!=encparams.mb_width-1 && !cur_mb->cbp
-                && SkippableMotionMode( *cur_mb->best_me, *prev_mb->best_me ) )
+			/* Quantize macroblock : N.b. cbp is also set as side-effect of call. */
             {
-                ++MBAinc;
-                if( pict_type == P_TYPE )
-                {
-                    /* reset predictors */
-                    Reset_DC_DCT_Pred();
-                    Reset_MV_Pred();
-                }
+                StageTimer timer( encparams.instrumentation, timings,
+                                  STAGE_QUANT );
+                cur_mb->Quantize( quantizer);
             }
-            else
-            {
-                int mb_type = cur_mb->best_me->mb_type;
-
-                /* Code mquant and update prediction if it changed in this macroblock */
-                if( cur_mb->cbp && cur_mb->mquant != mquant_pred )
-                {
-                    mquant_pred = cur_mb->mquant;
-                    mb_type |= MB_QUANT;
-                }
-
-                /* Inter-coded MB with some coded DCT blocks ===> PATTERN to code */
-                if ( cur_mb->cbp && !(mb_type & MB_INTRA) )
-                    mb_type|= MB_PATTERN;
-                /* For P frames there's no VLC for 'No MC, Not Coded':
-                * we have to transmit (0,0) motion vectors
-                */
-                if ( pict_type==P_TYPE && !cur_mb->cbp)
-                    mb_type|= MB_FORWARD;
-                coding->PutAddrInc(MBAinc); /* macroblock_address_increment */
-                MBAinc = 1;
-                
-                coding->PutMBType(pict_type,mb_type); /* macroblock type */
-
-                if ( (mb_type & (MB_FORWARD|MB_BACKWARD)) && !frame_pred_dct)
-                    coding->PutBits(cur_mb->best_me->motion_type,2);
-
-                if (pict_struct==FRAME_PICTURE 	&& cur_mb->cbp && !frame_pred_dct)
-                    coding->PutBits(cur_mb->field_dct,1);
-
-                if (mb_type & MB_QUANT)
-                {
-                    coding->PutBits(q_scale_type 
-                            ? map_non_linear_mquant[cur_mb->mquant]
-                            : cur_mb->mquant>>1,5);
-                }
-
-
-
-                if (mb_type & MB_FORWARD)
-                {
-                    /* forward motion vectors, update predictors */
-                    PutMVs( *cur_mb->best_me, false );
-                }
-
-                if (mb_type & MB_BACKWARD)
-                {
-                    /* backward motion vectors, update predictors */
-                    PutMVs( *cur_mb->best_me,  true );
-                }
 
-                if (mb_type & MB_PATTERN)
-                {
-                    coding->PutCPB((cur_mb->cbp >> (BLOCK_COUNT-6)) & 63);
-                }
-            
-                /* Output VLC DCT Blocks for Macroblock */
-
-                PutDCTBlocks( *cur_mb, mb_type );
-                /* reset predictors */
-                if (!(mb_type & MB_INTRA))
-                    Reset_DC_DCT_Pred();
+            /* Track the quantisation the slice coder will have in force
+               at the start of the next slice: it only changes in
+               macroblocks with coded DCT blocks */
+            if( cur_mb->CBP() )
+                mquant_pred = cur_mb->MQuant();
+        }
 
-                if (mb_type & MB_INTRA || (pict_type==P_TYPE && !(mb_type & MB_FORWARD)))
-                {
-                    Reset_MV_Pred();
-                }
-            }
-            ++k;
-        } /* Slice MB loop */
+        despatcher.Despatch( *slice );
     } /* Slice loop */
 
+    /* Append the coded slices still in flight in order */
+    for( j = encparams.mb_height2 - SLICE_CODING_LAG; 
+         j < encparams.mb_height2; ++j )
+    {
+        if( j < 0 )
+            continue;
+        SliceJob &slice = *slice_jobs[j % SLICE_CODING_LAG];
+        despatcher.WaitFor( slice );
+        slice.Transfer();
+    }
+    coded_mbs = k;
 }
 
 
@@ -676,7 +869,7 @@ void Picture::PutHeaders()
    
     if( gop_start )
     {
-      coding->PutGopHdr( decode,  closed_gop );
+      coding->PutGopHdr( decode + encparams.stream_frame_offset,  closed_gop );
     }
     
     /* picture header and picture coding extension */
@@ -724,11 +917,11 @@ int Picture::EncodedSize() const
 
 double Picture::IntraCodedBlocks() const
 { 
-    vector<MacroBlock>::const_iterator mbi = mbinfo.begin();
+    const int *mb_type = &mbfields.mb_type[0];
     int intra = 0;
-    for( mbi = mbinfo.begin(); mbi < mbinfo.end(); ++mbi)
+    for( int k = 0; k < encparams.mb_per_pict; ++k )
     {
-        if( mbi->best_me->mb_type&MB_INTRA )
+        if( mb_type[k]&MB_INTRA )
             ++intra;
     }
     return static_cast<double>(intra) / mbinfo.size();
@@ -26,6 +26,7 @@
 #include "encoderparams.hh"
 #include "synchrolib.h"
 #include "macroblock.hh"
+#include "instrumentation.hh"
 #include <vector>
 #include "mpeg2syntaxcodes.h"
 
@@ -67,9 +68,51 @@ class Quantizer;
 class StreamState;
 class ElemStrmWriter;
 class MPEG2CodingBuf;
+class MPEG2CountingBuf;
 class ImagePlanes;
+class Despatcher;
+class TransformBuffers;
+class Picture;
+class SliceJob;
 
-class Picture : public CodingPredictors
+/*********************
+ *
+ * SliceCoder - Generates the VLC bitstream for a slice of already
+ * quantised macroblocks.  Each SliceCoder has its own coding
+ * predictors and output buffer so the slices of a picture can be coded
+ * in parallel.  A slice may also be coded a macroblock at a time
+ * (StartSlice then CodeMacroBlock for each of its macroblocks).
+ *
+ ********************/
+
+class SliceCoder : public CodingPredictors
+{
+public:
+    SliceCoder( Picture &_picture, MPEG2CodingBuf &_coding ) :
+        picture( _picture ),
+        coding( _coding )
+        {}
+
+    void CodeSlice( int slice_mb_y, int mquant_pred );
+    void StartSlice( int slice_mb_y, int mquant_pred );
+    void CodeMacroBlock();
+
+protected:
+    void PutSliceHdr( int slice_mb_y, int mquant );
+    void PutMVs( MotionEst &me, bool back );
+    void PutDCTBlocks( MacroBlock &mb, int mb_type );
+    bool SkippableMotionMode( MotionEst &cur_mb_mm, MotionEst &prev_mb_mm);
+
+    Picture &picture;
+    MPEG2CodingBuf &coding;
+
+    int slice_mb_x;         // Slice position of the next macroblock
+    MacroBlock *cur_mb;     // ... and the macroblock itself
+    int MBAinc;
+    int mquant_pred;        // Quantisation in force
+};
+
+class Picture
 {
 public:
     
@@ -79,9 +122,10 @@ public:
              Quantizer &_quantizer );
     ~Picture();
 
-    void QuantiseAndCode(RateCtl &ratecontrol);
+    void AttachTransformBuffers( TransformBuffers *buffers );
+    TransformBuffers *DetachTransformBuffers();
+    void QuantiseAndCode(RateCtl &ratecontrol, Despatcher &despatcher);
 
-    void MotionSubSampledLum();
     void ITransform();
     void IQuantize();
     void CalcSNR();
@@ -91,12 +135,15 @@ public:
     void DiscardCoding();
     
     void SetFrameParams( const StreamState &ss, int field );
+    void EstimateGlobalMotion();        // In motionest.cc
 
     
     // Metrics used for stearing the encoding
     inline double Complexity() const { return Xhi; }
     void SetComplexity( double _Xhi ) { Xhi = _Xhi; }
     int EncodedSize() const;
+    // Macroblocks whose coding EncodedSize() counts (in order)
+    inline int CodedMacroBlocks() const { return coded_mbs; }
     double IntraCodedBlocks() const;   // Proportion of Macroblocks coded Intra
 
 
@@ -139,11 +186,9 @@ public:
 protected:
     
     void SetFieldParams(int field);
-    void PutSliceHdr( int slice_mb_y, int mquant );
-    void PutMVs( MotionEst &me, bool back );
-    void PutDCTBlocks( MacroBlock &mb, int mb_type );
     void PutCodingExt(); 
-    bool SkippableMotionMode( MotionEst &cur_mb_mm, MotionEst &prev_mb_mm);
+
+    int coded_mbs;
 
 public:
 
@@ -157,13 +202,82 @@ public:
     Quantizer &quantizer;
     MPEG2CodingBuf *coding;
     
-	/* 8*8 block data, raw (unquantised) and quantised, and (eventually but
-	   not yet inverse quantised */
-	DCTblock *blocks;
-	DCTblock *qblocks;
-
 	/* Macroblocks of picture */
 	vector<MacroBlock> mbinfo;
+    MacroBlockFields mbfields;  // Their hot per-MB data: see macroblock.hh
+
+    /***************
+     *
+     * Working storage attached only while the picture is being
+     * transformed, coded and reconstructed: 8*8 block data, raw
+     * (unquantised) and quantised, and the motion compensated
+     * prediction.
+     *
+     **************/
+
+    TransformBuffers *transform;
+	ImagePlanes *pred;
+
+    /***************
+     *
+     * Scratch for rate-distortion coding mode selection (see
+     * MacroBlock::SelectCodingModeRD): 8*8 blocks, raw and quantised,
+     * a bit counter and the intra DC predictors reached so far in the
+     * row.  Despatched macroblock work is split by row so each row of
+     * macroblocks has its own.  Only allocated if
+     * encparams.rd_mode_cands > 1.
+     *
+     **************/
+
+    struct ModeSelectScratch
+    {
+        DCTblock *blocks;
+        DCTblock *qblocks;
+        MPEG2CountingBuf *counter;
+        DC_DctPred dc_dct_pred;
+    };
+    vector<ModeSelectScratch> rd_scratch;
+    DCTblock *rd_scratch_blocks;
+
+    /***************
+     *
+     * The slices being VLC coded by the worker threads, each into
+     * buffers of its own (see QuantiseAndCode).  Kept for every
+     * coding of the picture so the buffers are only grown once.
+     *
+     **************/
+
+    vector<SliceJob *> slice_jobs;
+
+    /***************
+     *
+     * PicturePool book-keeping
+     *
+     **************/
+
+    int refcount;               // References held on this picture
+    int org_frame;              // Input frame org_img is, -1 if none
+
+    /***************
+     *
+     * Time spent on each stage of the picture's encoding(s).  Only
+     * kept if encparams.instrumentation is set.
+     *
+     **************/
+
+    StageTimes timings;
+    SADCounts sad_calls;        // ... and motion search routine calls
+
+    /***************
+     *
+     * Squared error of the reconstruction against the original (Y, Cb,
+     * Cr) and the pels it is summed over.  Only calculated if
+     * encparams.snr_totals is set.
+     *
+     **************/
+
+    double sqr_err[3];
+    unsigned int snr_pels[3];
 
 
     /***************
@@ -184,6 +298,10 @@ public:
 	 */
     Picture *fwd_ref_frame;
     Picture *bwd_ref_frame;     // 0 if Not B_TYPE
+    int fwd_ref_distance;       // Frames from fwd_ref_frame (0 if none)
+    Coord global_motion[2];     // Estimated global motion relative to
+                                // fwd and bwd reference (pels)
+    Coord search_centre[2];     // Offset of frame motion search windows
     
 	/* picture encoding source data  */
 	ImagePlanes *fwd_org, *bwd_org;	// Original Images of fwd and bwd
@@ -193,7 +311,6 @@ public:
 	ImagePlanes *org_img, *rec_img;	// Images for current pict: orginal
                                                         // and reconstructed.  Reconstructed
                                                         // 0 for B planes except when debugging
-	ImagePlanes *pred;
 	int sxf, syf, sxb, syb;		/* MC search limits. */
 	bool secondfield;			/* Second field of field frame */
 	bool ipflag;				/* P pict in IP frame (FIELD pics only)*/
@@ -223,6 +340,8 @@ public:
                                 // below which zeroing should be applied.
     int unit_coeff_first;       // First coefficient for zeroing purposes...
                                 // either 1 or 0.
+    int rd_mquant;              // Quantisation assumed by RD coding mode
+                                // decisions (rate control's initial choice)
 	/* Information for GOP start frames */
 	bool gop_start;             /* GOP Start picture */
     bool closed_gop;            /* GOP is closed   */
@@ -0,0 +1,316 @@
+/*  picturepool.cc - Reference counted pool of the Picture objects
+ *  of an encoder and the transform buffers of pictures being coded.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+#include <cassert>
+#include <limits.h>
+#include <stdlib.h>
+#include "mjpeg_logging.h"
+#include "cpu_accel.h"
+#include "syntaxconsts.h"
+#include "encoderparams.hh"
+#include "imageplanes.hh"
+#include "picturereader.hh"
+#include "picture.hh"
+#include "picturepool.hh"
+
+
+TransformBuffers::TransformBuffers( EncoderParams &encparams )
+{
+    blocks =
+        static_cast<DCTblock*>(
+            bufalloc(encparams.mb_per_pict*BLOCK_COUNT*sizeof(DCTblock)));
+    qblocks =
+        static_cast<DCTblock *>(
+            bufalloc(encparams.mb_per_pict*BLOCK_COUNT*sizeof(DCTblock)));
+    pred = new ImagePlanes( encparams );
+}
+
+TransformBuffers::~TransformBuffers()
+{
+    free( blocks );
+    free( qblocks );
+    delete pred;
+}
+
+unsigned int TransformBuffers::BufferSize( EncoderParams &encparams )
+{
+    return 2 * encparams.mb_per_pict * BLOCK_COUNT * sizeof(DCTblock)
+        + ImagePlanes::BufferSize( encparams );
+}
+
+
+TransformBufferPool::TransformBufferPool( EncoderParams &_encparams ) :
+    encparams( _encparams ),
+    allocated( 0 ),
+    in_use( 0 ),
+    peak_in_use( 0 ),
+    waits( 0 )
+{
+    pthread_mutex_init( &pool_lock, NULL );
+    pthread_cond_init( &buffers_freed, NULL );
+}
+
+TransformBufferPool::~TransformBufferPool()
+{
+    for( unsigned int i = 0; i < free_buffers.size(); ++i )
+        delete free_buffers[i];
+    pthread_cond_destroy( &buffers_freed );
+    pthread_mutex_destroy( &pool_lock );
+}
+
+/*
+ * Get a set of transform buffers, allocating a fresh one unless that
+ * would take us over our share of the memory budget.  In that case we
+ * wait for another encoder to release one.  N.b. encoders never hold
+ * more than one set at a time so this can't deadlock.
+ */
+
+TransformBuffers *TransformBufferPool::Get()
+{
+    unsigned int limit = UINT_MAX;
+    if( encparams.memory_budget > 0 )
+    {
+        limit = static_cast<unsigned int>(
+            encparams.memory_budget / 4 / TransformBuffers::BufferSize(encparams) );
+        if( limit < 1 )
+            limit = 1;
+    }
+
+    TransformBuffers *buffers;
+    pthread_mutex_lock( &pool_lock );
+    if( free_buffers.empty() && allocated >= limit )
+    {
+        ++waits;
+        while( free_buffers.empty() )
+            pthread_cond_wait( &buffers_freed, &pool_lock );
+    }
+    if( free_buffers.empty() )
+    {
+        buffers = new TransformBuffers( encparams );
+        ++allocated;
+    }
+    else
+    {
+        buffers = free_buffers.back();
+        free_buffers.pop_back();
+    }
+    if( ++in_use > peak_in_use )
+        peak_in_use = in_use;
+    pthread_mutex_unlock( &pool_lock );
+    return buffers;
+}
+
+void TransformBufferPool::Release( TransformBuffers *buffers )
+{
+    pthread_mutex_lock( &pool_lock );
+    free_buffers.push_back( buffers );
+    --in_use;
+    pthread_cond_signal( &buffers_freed );
+    pthread_mutex_unlock( &pool_lock );
+}
+
+uint64_t TransformBufferPool::PeakBytes()
+{
+    pthread_mutex_lock( &pool_lock );
+    uint64_t bytes =
+        static_cast<uint64_t>(peak_in_use) * TransformBuffers::BufferSize( encparams );
+    pthread_mutex_unlock( &pool_lock );
+    return bytes;
+}
+
+void TransformBufferPool::Report()
+{
+    uint64_t peak_bytes = PeakBytes();
+    pthread_mutex_lock( &pool_lock );
+    mjpeg_info( "Transform buffers: %u allocated, peak %u in use (%.1f MB)",
+                allocated, peak_in_use, peak_bytes / 1048576.0 );
+    if( waits > 0 )
+        mjpeg_info( "Transform buffers: memory budget forced %u waits", waits );
+    pthread_mutex_unlock( &pool_lock );
+}
+
+
+
+PicturePool::PicturePool( EncoderParams &_encparams,
+                          ElemStrmWriter &_writer,
+                          Quantizer &_quantizer,
+                          PictureReader &_reader ) :
+    encparams( _encparams ),
+    writer( _writer ),
+    quantizer( _quantizer ),
+    reader( _reader ),
+    live( 0 ),
+    peak_live( 0 ),
+    frames_released( 0 )
+{
+}
+
+PicturePool::~PicturePool()
+{
+    for( unsigned int i = 0; i < pictures.size(); ++i )
+        delete pictures[i];
+}
+
+/*
+ * Get a fresh picture.  The caller holds the only reference to it.
+ */
+
+Picture *PicturePool::Get()
+{
+    Picture *fresh;
+    if( free_pictures.size() == 0 )
+    {
+        fresh = new Picture(encparams,  writer , quantizer);
+        pictures.push_back( fresh );
+    }
+    else
+    {
+        fresh = free_pictures.back();
+        free_pictures.pop_back();
+    }
+    fresh->refcount = 1;
+    fresh->org_frame = -1;
+    fresh->fwd_ref_frame = 0;
+    fresh->bwd_ref_frame = 0;
+    fresh->timings.Clear();
+    fresh->sad_calls.Clear();
+    if( ++live > peak_live )
+        peak_live = live;
+    return fresh;
+}
+
+void PicturePool::Retain( Picture *picture )
+{
+    assert( picture->refcount > 0 );
+    ++picture->refcount;
+}
+
+/*
+ * Drop a reference to a picture.  Once the last is gone the
+ * picture is free for re-use and it no longer needs its input frame.
+ */
+
+void PicturePool::Release( Picture *picture )
+{
+    assert( picture->refcount > 0 );
+    if( --picture->refcount > 0 )
+        return;
+
+    if( picture->org_frame >= 0 )
+    {
+        if( --frame_users[picture->org_frame] == 0 )
+        {
+            frame_users.erase( picture->org_frame );
+            FrameDone( picture->org_frame );
+        }
+        picture->org_frame = -1;
+    }
+    free_pictures.push_back( picture );
+    --live;
+}
+
+/*
+ * The encoder is finished with a picture: it will never be encoded
+ * again so it no longer needs the pictures it was predicted from.
+ * It may of course still be needed as a reference itself.
+ */
+
+void PicturePool::Retire( Picture *picture )
+{
+    if( picture->fwd_ref_frame != 0 )
+        Release( picture->fwd_ref_frame );
+    if( picture->bwd_ref_frame != 0 )
+        Release( picture->bwd_ref_frame );
+    picture->fwd_ref_frame = 0;
+    picture->bwd_ref_frame = 0;
+    Release( picture );
+}
+
+
+/*
+ * Set the input frame a picture is coded from.  If the picture
+ * already had a frame (GOP re-structuring can change which frame is
+ * coded) that frame *will* be coded by a later picture so it is not
+ * yet done with even if no picture is currently using it.
+ */
+
+void PicturePool::SetOrgFrame( Picture &picture, int present )
+{
+    if( picture.org_frame >= 0 )
+    {
+        if( --frame_users[picture.org_frame] == 0 )
+            frame_users.erase( picture.org_frame );
+    }
+    picture.org_img = reader.ReadFrame( present );
+    picture.org_frame = present;
+    ++frame_users[present];
+}
+
+void PicturePool::SetReferences( Picture &picture,
+                                 Picture *fwd_ref, Picture *bwd_ref )
+{
+    picture.fwd_ref_frame = fwd_ref;
+    picture.bwd_ref_frame = bwd_ref;
+    if( fwd_ref != 0 )
+        Retain( fwd_ref );
+    if( bwd_ref != 0 )
+        Retain( bwd_ref );
+}
+
+void PicturePool::FrameDone( int frame )
+{
+    frames_done.insert( frame );
+    while( frames_done.erase( frames_released ) > 0 )
+    {
+        reader.ReleaseFrame( frames_released );
+        ++frames_released;
+    }
+}
+
+/*
+ * Report how many pictures encoding actually needed and warn if this
+ * (which depends on GOP structure, not on any tunable) blew the
+ * memory budget.
+ */
+
+void PicturePool::Report( TransformBufferPool &transform_pool )
+{
+    uint64_t picture_bytes = ImagePlanes::BufferSize( encparams )
+        + encparams.mb_per_pict * sizeof(MacroBlock);
+    uint64_t peak_bytes = peak_live * picture_bytes + transform_pool.PeakBytes();
+    mjpeg_info( "Picture pool: %u pictures allocated, peak %u in use (%.1f MB with transform buffers)",
+                static_cast<unsigned int>(pictures.size()), peak_live,
+                peak_bytes / 1048576.0 );
+    if( encparams.memory_budget > 0 && peak_bytes > encparams.memory_budget )
+        mjpeg_warn( "Memory budget of %.0f MB exceeded: GOP structure needed %.1f MB of pictures",
+                    encparams.memory_budget / 1048576.0, peak_bytes / 1048576.0 );
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
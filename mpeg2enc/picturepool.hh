@@ -0,0 +1,155 @@
+#ifndef _PICTUREPOOL_HH
+#define _PICTUREPOOL_HH
+
+/*  picturepool.hh - Reference counted pool of the Picture objects
+ *  of an encoder and the transform buffers of pictures being coded.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <pthread.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "mjpeg_types.h"
+#include "macroblock.hh"
+
+class EncoderParams;
+class ElemStrmWriter;
+class Quantizer;
+class PictureReader;
+class ImagePlanes;
+class Picture;
+
+/*********************
+ *
+ * TransformBuffers - The storage a picture needs only while it is
+ * actually being encoded: the motion compensated prediction and the
+ * raw and quantised DCT blocks of its macroblocks.  Encoding proper
+ * is (nearly) serial so a handful of these serve all the (many)
+ * Picture's buffered for GOP-wise rate control.
+ *
+ ********************/
+
+class TransformBuffers
+{
+public:
+    TransformBuffers( EncoderParams &encparams );
+    ~TransformBuffers();
+    static unsigned int BufferSize( EncoderParams &encparams );
+
+    DCTblock *blocks;
+    DCTblock *qblocks;
+    ImagePlanes *pred;
+};
+
+/*********************
+ *
+ * TransformBufferPool - TransformBuffers are handed out to pictures
+ * about to be encoded and returned once they are coded and
+ * reconstructed.  A pool may be shared by several SeqEncoder's (one
+ * per concurrently encoded chunk): if encparams.memory_budget is set
+ * Get blocks once buffers for a quarter of the budget are in use.
+ *
+ ********************/
+
+class TransformBufferPool
+{
+public:
+    TransformBufferPool( EncoderParams &encparams );
+    ~TransformBufferPool();
+
+    TransformBuffers *Get();
+    void Release( TransformBuffers *buffers );
+    void Report();
+    uint64_t PeakBytes();
+
+private:
+    EncoderParams &encparams;
+    pthread_mutex_t pool_lock;      // Guards everything below
+    pthread_cond_t buffers_freed;
+    std::vector<TransformBuffers *> free_buffers;
+    unsigned int allocated;
+    unsigned int in_use;
+    unsigned int peak_in_use;
+    unsigned int waits;             // # Get's that had to wait
+};
+
+/*********************
+ *
+ * PicturePool - The Picture's of a SeqEncoder.  Picture's are
+ * reference counted: the encoder holds a reference to each picture
+ * from Get until it has been committed in pass-2 (and to the
+ * pictures pass-1 is currently predicting from), and each
+ * picture holds a reference to the pictures it is predicted from.
+ * Pictures whose last reference is released are recycled, as is the
+ * input frame they were coded from once no live picture still uses it.
+ *
+ ********************/
+
+class PicturePool
+{
+public:
+    PicturePool( EncoderParams &encparams,
+                 ElemStrmWriter &writer,
+                 Quantizer &quantizer,
+                 PictureReader &reader );
+    ~PicturePool();
+
+    Picture *Get();
+    void Retain( Picture *picture );
+    void Release( Picture *picture );
+    void Retire( Picture *picture );
+
+    // Setup the input frame and reference pictures of a fresh picture
+    void SetOrgFrame( Picture &picture, int present );
+    void SetReferences( Picture &picture, Picture *fwd_ref, Picture *bwd_ref );
+
+    void Report( TransformBufferPool &transform_pool );
+
+private:
+    void FrameDone( int frame );
+
+    EncoderParams &encparams;
+    ElemStrmWriter &writer;
+    Quantizer &quantizer;
+    PictureReader &reader;
+
+    std::vector<Picture *> pictures;        // All Picture's allocated
+    std::vector<Picture *> free_pictures;   // Those free for re-use
+    unsigned int live;
+    unsigned int peak_live;
+
+    // Live pictures using each input frame.  Input frames are released
+    // in order so frames whose pictures have all been freed are held
+    // in frames_done until their predecessors are.
+    std::map<int,int> frame_users;
+    std::set<int> frames_done;
+    int frames_released;
+};
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
+#endif
@@ -23,34 +23,65 @@
 #include "picturereader.hh"
 #include "mpeg2encoder.hh"
 #include "imageplanes.hh"
+#include "instrumentation.hh"
 #include <limits.h>
+#include <string.h>
+#include <errno.h>
 //#include <stdio.h>
 //#include <stdlib.h>
 //#include <unistd.h>
-//#include <string.h>
-//#include <errno.h>
 //#include "simd.h"
 
 
 PictureReader::PictureReader( EncoderParams &_encparams ) :
-    encparams( _encparams )
+    encparams( _encparams ),
+    instrumentation( _encparams.instrumentation )
 {
     frames_read = 0;
     frames_released = 0;
     istrm_nframes = INT_MAX;
+    read_ahead = 0;
+    frames_wanted = 0;
+    shutdown = false;
+    depth_samples = 0;
+    depth_sum = 0.0;
+    encoder_waits = 0;
+    reader_waits = 0;
+    pthread_mutex_init( &buffer_lock, NULL );
+    pthread_cond_init( &frame_read, NULL );
+    pthread_cond_init( &frame_wanted, NULL );
 }
 
 
 void PictureReader::Init()
 {
+    read_ahead = encparams.read_ahead_frames;
+    if( read_ahead == 0 )
+        return;
 
+    frames_wanted = read_ahead;
+    if( pthread_create( &read_ahead_thread, NULL,
+                        &PictureReader::ReadAheadWrapper, this ) != 0 )
+    {
+        mjpeg_error_exit1( "reader thread creation failed: %s", strerror(errno) );
+    }
 }
 
 PictureReader::~PictureReader()
 {
+    if( read_ahead > 0 )
+    {
+        pthread_mutex_lock( &buffer_lock );
+        shutdown = true;
+        pthread_cond_signal( &frame_wanted );
+        pthread_mutex_unlock( &buffer_lock );
+        pthread_join( read_ahead_thread, NULL );
+    }
     for( unsigned int i = 0; i < input_imgs_buf.size(); ++i )
         delete input_imgs_buf[i];
-
+    pthread_cond_destroy( &frame_wanted );
+    pthread_cond_destroy( &frame_read );
+    pthread_mutex_destroy( &buffer_lock );
 }
 
 void PictureReader::AllocateBufferUpto( int buffer_slot )
@@ -63,45 +94,174 @@ void PictureReader::AllocateBufferUpto( int buffer_slot )
 
 void PictureReader::ReleaseFrame( int num_frame)
 {
+    pthread_mutex_lock( &buffer_lock );
     while( frames_released <= num_frame )
     {
         input_imgs_buf.push_back( input_imgs_buf.front() );
         input_imgs_buf.pop_front();
         ++frames_released;
     }
+    pthread_mutex_unlock( &buffer_lock );
 }
 
+/*
+ * Load a frame and prepare it for encoding.
+ *
+ * RETURN: true iff EOF or ERROR
+ */
+
+bool PictureReader::LoadAndPrepareFrame( int num_frame, ImagePlanes &image )
+{
+    if( instrumentation == 0 )
+    {
+        if( LoadFrame( image ) )
+            return true;
+        image.BorderExtend( encparams );
+        image.SubSampleLum( encparams );
+        return false;
+    }
+
+    uint64_t start = Instrumentation::NowUsec();
+    if( LoadFrame( image ) )
+        return true;
+    uint64_t loaded = Instrumentation::NowUsec();
+    image.BorderExtend( encparams );
+    image.SubSampleLum( encparams );
+    instrumentation->FrameRead( num_frame, loaded - start,
+                                Instrumentation::NowUsec() - loaded );
+    return false;
+}
 
 
 void PictureReader::FillBufferUpto( int num_frame )
 {
+    pthread_mutex_lock( &buffer_lock );
+    if( read_ahead > 0 )
+    {
+        if( num_frame+1+read_ahead > frames_wanted )
+        {
+            frames_wanted = num_frame+1+read_ahead;
+            pthread_cond_signal( &frame_wanted );
+        }
+        ++depth_samples;
+        if( frames_read > num_frame+1 )
+            depth_sum += frames_read-(num_frame+1);
+        if( frames_read <= num_frame && frames_read < istrm_nframes )
+            ++encoder_waits;
+        while( frames_read <= num_frame && frames_read < istrm_nframes )
+            pthread_cond_wait( &frame_read, &buffer_lock );
+        pthread_mutex_unlock( &buffer_lock );
+        return;
+    }
+
     while(frames_read <= num_frame  &&   frames_read < istrm_nframes ) 
     {
         AllocateBufferUpto( frames_read-frames_released );
-        if( LoadFrame( *input_imgs_buf[frames_read-frames_released] ) )
+        if( LoadAndPrepareFrame( frames_read,
+                                 *input_imgs_buf[frames_read-frames_released] ) )
         {
             istrm_nframes = frames_read;
             mjpeg_info( "Signaling last frame = %d", istrm_nframes-1 );
-            return;
+            break;
         }
         ++frames_read; 
     }
+    pthread_mutex_unlock( &buffer_lock );
 }
 
 ImagePlanes *PictureReader::ReadFrame( int num_frame )
 {
+    FillBufferUpto( num_frame );
+    pthread_mutex_lock( &buffer_lock );
     if(istrm_nframes!=INT_MAX && num_frame>=istrm_nframes )
     {
         mjpeg_error("Internal error: PictureReader::ReadFrame: attempt to reading beyond known EOS");
         abort();
     }
-   FillBufferUpto( num_frame );
-   return input_imgs_buf[num_frame-frames_released];
+    ImagePlanes *frame = input_imgs_buf[num_frame-frames_released];
+    pthread_mutex_unlock( &buffer_lock );
+    return frame;
+}
+
+int PictureReader::NumberOfFrames()
+{
+    pthread_mutex_lock( &buffer_lock );
+    int nframes = istrm_nframes;
+    pthread_mutex_unlock( &buffer_lock );
+    return nframes;
+}
+
+
+/*********************
+ *
+ * ReadAhead - Body of the reader thread.  Frames are loaded into the
+ * buffer without holding the lock: the buffer slot being loaded lies
+ * beyond frames_read so the encoder never touches it and releasing
+ * frames only moves slots before it.
+ *
+ ********************/
+
+void *PictureReader::ReadAheadWrapper( void *reader )
+{
+    static_cast<PictureReader *>(reader)->ReadAhead();
+    return 0;
+}
+
+void PictureReader::ReadAhead()
+{
+    pthread_mutex_lock( &buffer_lock );
+    while( frames_read < istrm_nframes )
+    {
+        if( frames_read >= frames_wanted && !shutdown )
+        {
+            ++reader_waits;
+            while( frames_read >= frames_wanted && !shutdown )
+                pthread_cond_wait( &frame_wanted, &buffer_lock );
+        }
+        if( shutdown )
+            break;
+
+        AllocateBufferUpto( frames_read-frames_released );
+        ImagePlanes *image = input_imgs_buf[frames_read-frames_released];
+        int num_frame = frames_read;
+        pthread_mutex_unlock( &buffer_lock );
+
+        bool eos = LoadAndPrepareFrame( num_frame, *image );
+
+        pthread_mutex_lock( &buffer_lock );
+        if( eos )
+        {
+            istrm_nframes = frames_read;
+            mjpeg_info( "Signaling last frame = %d", istrm_nframes-1 );
+        }
+        else
+            ++frames_read;
+        pthread_cond_broadcast( &frame_read );
+    }
+    pthread_mutex_unlock( &buffer_lock );
+}
+
+/*
+ * Report how far ahead of the encoder the reader thread managed to
+ * stay.  If the encoder often has to wait the source is the
+ * bottleneck; if the reader is usually waiting the encoder is.
+ */
+
+void PictureReader::ReportReadAhead()
+{
+    if( read_ahead == 0 )
+        return;
+    pthread_mutex_lock( &buffer_lock );
+    mjpeg_info( "Input read-ahead: %.1f of %d frames ready on average",
+                depth_samples > 0 ? depth_sum / depth_samples : 0.0,
+                read_ahead );
+    mjpeg_info( "Input read-ahead: encoder waited %u times, reader waited %u times",
+                encoder_waits, reader_waits );
+    pthread_mutex_unlock( &buffer_lock );
 }
 
 
 
-
 /* 
  * Local variables:
  *  c-file-style: "stroustrup"
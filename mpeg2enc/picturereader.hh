@@ -28,8 +28,23 @@
 
 class EncoderParams;
 class ImagePlanes;
+class Instrumentation;
 struct MPEG2EncInVidParams;
 
+/*********************
+ *
+ * PictureReader - Buffers the input frames needed for encoding.  Frames
+ * are loaded (by LoadFrame in derived classes) and then prepared for
+ * encoding: padded out to whole macroblocks and sub-sampled for motion
+ * estimation.
+ *
+ * If encparams.read_ahead_frames > 0 a reader thread loads and
+ * prepares frames up to that many frames ahead of the latest frame
+ * the encoder has asked for, so that the encoder only stalls if its
+ * source really cannot keep up.
+ *
+ ********************/
+
 class PictureReader
 {
 public:
@@ -41,21 +56,42 @@ public:
     ImagePlanes *ReadFrame( int num_frame );
     void ReleaseFrame( int num_frame );
     void FillBufferUpto( int num_frame );
-    inline int NumberOfFrames() { return istrm_nframes; }
+    int NumberOfFrames();
+    void ReportReadAhead();
 protected:
     void ReadChunkSequential( int num_frame );
     void AllocateBufferUpto( int buffer_slot );
     virtual bool LoadFrame( ImagePlanes &image ) = 0;
+private:
+    bool LoadAndPrepareFrame( int num_frame, ImagePlanes &image );
+    static void *ReadAheadWrapper( void *reader );
+    void ReadAhead();
     
 protected:
     EncoderParams &encparams;
+    Instrumentation *instrumentation;   // Records reads if non-0
 
 	int frames_read; 
     int frames_released;
     std::deque<ImagePlanes *> input_imgs_buf;
-    std::deque<ImagePlanes *>  unused;
     int istrm_nframes;      // Number of frames in stream once EOS known,
                                      // Otherwise INT_MAX
+private:
+    // Read-ahead thread.  N.b. with a read-ahead thread the buffer
+    // state above is guarded by buffer_lock.
+    int read_ahead;                 // Frames to read ahead (0 = no thread)
+    pthread_t read_ahead_thread;
+    pthread_mutex_t buffer_lock;
+    pthread_cond_t frame_read;      // Signalled when a frame is read (or EOS)
+    pthread_cond_t frame_wanted;    // Signalled when encoder wants more frames
+    int frames_wanted;              // Frames the reader thread should have read
+    bool shutdown;
+
+    // Read-ahead statistics
+    unsigned int depth_samples;     // # times encoder asked for a frame
+    double depth_sum;               // Sum of frames ready ahead of encoder
+    unsigned int encoder_waits;     // # times encoder waited for reader
+    unsigned int reader_waits;      // # times reader waited for encoder
 };
 
 
@@ -0,0 +1,394 @@
+/*  pushencoder.cc - An mpeg2enc++ encoder for use as a library: raw
+ *  frames are pushed in and the coded stream pulled out.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include "config.h"
+#include <string.h>
+#include <deque>
+#include "mjpeg_logging.h"
+#include "encoderparams.hh"
+#include "imageplanes.hh"
+#include "picturereader.hh"
+#include "elemstrmwriter.hh"
+#include "quantize.hh"
+#include "ontheflyratectlpass1.hh"
+#include "ontheflyratectlpass2.hh"
+#include "seqencoder.hh"
+#include "chunkencoder.hh"
+#include "pushencoder.hh"
+
+
+/**************************
+ *
+ * PictureReader for pushed frames.  Frames are queued (copied into
+ * spare ImagePlanes) by Push and handed over to the encoder's buffer
+ * by LoadFrame, which waits for a frame or the end of stream.
+ *
+ *************************/
+
+class PushPictureReader : public PictureReader
+{
+public:
+    PushPictureReader( EncoderParams &encparams,
+                       const MPEG2EncInVidParams &strm,
+                       int queue_frames );
+    ~PushPictureReader();
+
+    void StreamPictureParams( MPEG2EncInVidParams &_strm )
+        { _strm = strm; }
+    bool Push( const uint8_t * const planes[3], const int strides[3] );
+    void EndOfStream( bool discard );
+protected:
+    bool LoadFrame( ImagePlanes &image );
+private:
+    MPEG2EncInVidParams strm;
+    unsigned int queue_frames;
+
+    pthread_mutex_t queue_lock;     // Guards everything below
+    pthread_cond_t frame_pushed;    // Signalled when a frame is pushed (or EOS)
+    pthread_cond_t frame_taken;     // Signalled when the encoder takes a frame
+    std::deque<ImagePlanes *> queue;    // Pushed, not yet loaded
+    std::vector<ImagePlanes *> spare;
+    bool eos;
+};
+
+PushPictureReader::PushPictureReader( EncoderParams &encparams,
+                                      const MPEG2EncInVidParams &_strm,
+                                      int _queue_frames ) :
+    PictureReader( encparams ),
+    strm( _strm ),
+    queue_frames( _queue_frames > 0 ? _queue_frames : 1 ),
+    eos( false )
+{
+    pthread_mutex_init( &queue_lock, NULL );
+    pthread_cond_init( &frame_pushed, NULL );
+    pthread_cond_init( &frame_taken, NULL );
+}
+
+PushPictureReader::~PushPictureReader()
+{
+    for( unsigned int i = 0; i < queue.size(); ++i )
+        delete queue[i];
+    for( unsigned int i = 0; i < spare.size(); ++i )
+        delete spare[i];
+    pthread_cond_destroy( &frame_taken );
+    pthread_cond_destroy( &frame_pushed );
+    pthread_mutex_destroy( &queue_lock );
+}
+
+/*
+ * RETURN: false iff the frame was pushed after the end of stream
+ */
+
+bool PushPictureReader::Push( const uint8_t * const planes[3],
+                              const int strides[3] )
+{
+    ImagePlanes *frame;
+
+    pthread_mutex_lock( &queue_lock );
+    while( queue.size() >= queue_frames && !eos )
+        pthread_cond_wait( &frame_taken, &queue_lock );
+    if( eos )
+    {
+        pthread_mutex_unlock( &queue_lock );
+        mjpeg_error( "Frame pushed after end of stream" );
+        return false;
+    }
+    if( spare.empty() )
+        frame = new ImagePlanes( encparams );
+    else
+    {
+        frame = spare.back();
+        spare.pop_back();
+    }
+    pthread_mutex_unlock( &queue_lock );
+
+    // Copying needs no lock: the encoder only sees queued frames
+    int h = encparams.horizontal_size;
+    int v = encparams.vertical_size;
+    for( int i = 0; i < v; ++i )
+        memcpy( frame->Plane(0)+i*encparams.phy_width,
+                planes[0]+i*strides[0], h );
+    h /= 2;
+    v /= 2;
+    for( int c = 1; c < 3; ++c )
+        for( int i = 0; i < v; ++i )
+            memcpy( frame->Plane(c)+i*encparams.phy_chrom_width,
+                    planes[c]+i*strides[c], h );
+
+    pthread_mutex_lock( &queue_lock );
+    queue.push_back( frame );
+    pthread_cond_signal( &frame_pushed );
+    pthread_mutex_unlock( &queue_lock );
+    return true;
+}
+
+/*
+ * Frames pushed so far are still encoded unless discard.
+ */
+
+void PushPictureReader::EndOfStream( bool discard )
+{
+    pthread_mutex_lock( &queue_lock );
+    eos = true;
+    if( discard )
+    {
+        spare.insert( spare.end(), queue.begin(), queue.end() );
+        queue.clear();
+    }
+    pthread_cond_broadcast( &frame_pushed );
+    pthread_cond_broadcast( &frame_taken );
+    pthread_mutex_unlock( &queue_lock );
+}
+
+/*
+ * RETURN: true iff EOS
+ */
+
+bool PushPictureReader::LoadFrame( ImagePlanes &image )
+{
+    pthread_mutex_lock( &queue_lock );
+    while( queue.empty() && !eos )
+        pthread_cond_wait( &frame_pushed, &queue_lock );
+    if( queue.empty() )
+    {
+        pthread_mutex_unlock( &queue_lock );
+        return true;
+    }
+    ImagePlanes *frame = queue.front();
+    queue.pop_front();
+    pthread_mutex_unlock( &queue_lock );
+
+    image.SwapPlanes( *frame );
+
+    pthread_mutex_lock( &queue_lock );
+    spare.push_back( frame );
+    pthread_cond_signal( &frame_taken );
+    pthread_mutex_unlock( &queue_lock );
+    return false;
+}
+
+/**************************
+ *
+ * ElemStrmWriter that queues each buffer of coded output written as
+ * a packet until it is pulled.
+ *
+ *************************/
+
+class PacketStrmWriter : public ElemStrmWriter
+{
+public:
+    PacketStrmWriter();
+    ~PacketStrmWriter();
+
+    virtual void WriteOutBufferUpto( const uint8_t *buffer, const uint32_t flush_upto );
+    virtual uint64_t BitCount() { return flushed * 8LL; }
+
+    void EndOfStream();
+    bool Pull( std::vector<uint8_t> &packet, bool wait );
+private:
+    pthread_mutex_t packets_lock;   // Guards everything below
+    pthread_cond_t packet_ready;    // Signalled when a packet is queued (or EOS)
+    std::deque<std::vector<uint8_t> > packets;
+    bool eos;
+};
+
+PacketStrmWriter::PacketStrmWriter() :
+    eos( false )
+{
+    pthread_mutex_init( &packets_lock, NULL );
+    pthread_cond_init( &packet_ready, NULL );
+}
+
+PacketStrmWriter::~PacketStrmWriter()
+{
+    pthread_cond_destroy( &packet_ready );
+    pthread_mutex_destroy( &packets_lock );
+}
+
+void PacketStrmWriter::WriteOutBufferUpto( const uint8_t *buffer,
+                                           const uint32_t flush_upto )
+{
+    if( flush_upto == 0 )
+        return;
+    pthread_mutex_lock( &packets_lock );
+    packets.push_back( std::vector<uint8_t>() );
+    packets.back().assign( buffer, buffer+flush_upto );
+    pthread_cond_signal( &packet_ready );
+    pthread_mutex_unlock( &packets_lock );
+    flushed += flush_upto;
+}
+
+void PacketStrmWriter::EndOfStream()
+{
+    pthread_mutex_lock( &packets_lock );
+    eos = true;
+    pthread_cond_broadcast( &packet_ready );
+    pthread_mutex_unlock( &packets_lock );
+}
+
+bool PacketStrmWriter::Pull( std::vector<uint8_t> &packet, bool wait )
+{
+    pthread_mutex_lock( &packets_lock );
+    while( wait && packets.empty() && !eos )
+        pthread_cond_wait( &packet_ready, &packets_lock );
+    if( packets.empty() )
+    {
+        pthread_mutex_unlock( &packets_lock );
+        return false;
+    }
+    packet.swap( packets.front() );
+    packets.pop_front();
+    pthread_mutex_unlock( &packets_lock );
+    return true;
+}
+
+
+/**************************
+ *
+ * MPEG2PushEncoder
+ *
+ *************************/
+
+MPEG2PushEncoder::MPEG2PushEncoder( MPEG2EncOptions &options,
+                                    const MPEG2EncInVidParams &strm,
+                                    int queue_frames ) :
+    MPEG2Encoder( options ),
+    ok( false ),
+    started( false )
+{
+    reader = push_reader = new PushPictureReader( parms, strm, queue_frames );
+    writer = packet_writer = new PacketStrmWriter();
+    if( options.SetFormatPresets( strm ) )
+    {
+        mjpeg_error( "Encoding options unusable for the stream" );
+        return;
+    }
+    if( options.rate_control != 0 )
+    {
+        mjpeg_error( "Only the one-pass rate controller (-A 0) is available" );
+        return;
+    }
+
+    quantizer = new Quantizer( parms );
+    pass1ratectl = new OnTheFlyPass1( parms );
+    pass2ratectl = new OnTheFlyPass2( parms );
+
+    seqencoder = new SeqEncoder( parms, *reader, *quantizer,
+                                 *writer,
+                                 *pass1ratectl,
+                                 *pass2ratectl
+                                );
+
+    // This order is important! Don't change...  SeqEncoder::Init
+    // already reads frames so it is left to the encoder thread.
+    if( !parms.Init( options ) )
+        return;
+    reader->Init();
+    quantizer->Init();
+    ok = true;
+}
+
+/*
+ * Frames still waiting to be encoded are dropped: nobody will pull
+ * what they'd code to.
+ */
+
+MPEG2PushEncoder::~MPEG2PushEncoder()
+{
+    if( started )
+    {
+        push_reader->EndOfStream( true );
+        pthread_join( encoder_thread, NULL );
+    }
+}
+
+bool MPEG2PushEncoder::PushFrame( const uint8_t * const planes[3],
+                                  const int strides[3] )
+{
+    if( !started && !Start() )
+        return false;
+    return push_reader->Push( planes, strides );
+}
+
+bool MPEG2PushEncoder::EndOfStream()
+{
+    if( !started && !Start() )
+        return false;
+    push_reader->EndOfStream( false );
+    return true;
+}
+
+bool MPEG2PushEncoder::PullPacket( std::vector<uint8_t> &packet, bool wait )
+{
+    return ok && packet_writer->Pull( packet, wait );
+}
+
+/*
+ * RETURN: false iff the encoder is unusable or its thread can't be
+ * started.
+ */
+
+bool MPEG2PushEncoder::Start()
+{
+    if( !ok )
+    {
+        mjpeg_error( "Encoder options unusable: nothing can be encoded" );
+        return false;
+    }
+    int err = pthread_create( &encoder_thread, NULL,
+                              &MPEG2PushEncoder::EncoderWrapper, this );
+    if( err != 0 )
+    {
+        mjpeg_error( "encoder thread creation failed: %s", strerror(err) );
+        return false;
+    }
+    started = true;
+    return true;
+}
+
+void *MPEG2PushEncoder::EncoderWrapper( void *encoder )
+{
+    static_cast<MPEG2PushEncoder *>(encoder)->Encode();
+    return 0;
+}
+
+void MPEG2PushEncoder::Encode()
+{
+    seqencoder->Init();
+    if( parms.gop_parallel > 0 )
+    {
+        ChunkEncoder chunkencoder( parms, *reader, *writer );
+        chunkencoder.EncodeStream();
+    }
+    else
+        seqencoder->EncodeStream();
+    packet_writer->EndOfStream();
+}
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
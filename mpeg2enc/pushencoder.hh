@@ -0,0 +1,106 @@
+#ifndef _PUSHENCODER_HH
+#define _PUSHENCODER_HH
+
+/*  pushencoder.hh - An mpeg2enc++ encoder for use as a library: raw
+ *  frames are pushed in and the coded stream pulled out.
+ *
+ *  (C) 2026 mjpegtools contributors */
+
+/*  This Software is free software; you can redistribute it
+ *  and/or modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2 of
+ *  the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ */
+
+#include <pthread.h>
+#include <vector>
+#include "mjpeg_types.h"
+#include "mpeg2encoder.hh"
+
+class PushPictureReader;
+class PacketStrmWriter;
+
+/*********************
+ *
+ * MPEG2PushEncoder - Encodes frames pushed by the caller, who pulls
+ * the coded stream back as packets: one per coded picture (one per
+ * coded chunk in GOP-parallel mode).  Concatenated the packets form
+ * the MPEG elementary stream.
+ *
+ * The encoder looks ahead some way so the first packet only appears
+ * after a few frames and some only after EndOfStream.  It runs on a
+ * thread of its own, started by the first PushFrame (or EndOfStream):
+ * until then parms may still be adjusted.  PushFrame only blocks
+ * while queue_frames frames are already waiting to be encoded.
+ * Packets are held until pulled.
+ *
+ * Any number of encoders may run concurrently in one process, each
+ * with its own options.  They share the constant tables and the SIMD
+ * routine selection, set up once by the first encoder constructed.
+ *
+ * Unusable options (out of range, inconsistent with the stream or
+ * not handled by this interface), and frames pushed after the end of
+ * stream, are reported by mjpeg_error and a false Ok(), PushFrame or
+ * EndOfStream.  Only failures once encoding has started (running out
+ * of memory, say) still end the process by mjpeg_error_exit1, as
+ * everywhere else in the library.
+ *
+ ********************/
+
+class MPEG2PushEncoder : public MPEG2Encoder
+{
+public:
+    MPEG2PushEncoder( MPEG2EncOptions &options,
+                      const MPEG2EncInVidParams &strm,
+                      int queue_frames = 4 );
+    ~MPEG2PushEncoder();
+
+    // RETURN: false iff the options are unusable: the encoder can
+    // then only be destroyed.
+    inline bool Ok() const { return ok; }
+
+    // A 4:2:0 frame of strm's size: rows of planes[c] lie
+    // strides[c] bytes apart (ImagePlanes' are phy_width and
+    // phy_chrom_width).  The frame is copied.
+    // RETURN: false iff the frame could not be accepted (not Ok(),
+    // after EndOfStream or the encoder could not be started).
+    bool PushFrame( const uint8_t * const planes[3], const int strides[3] );
+    bool EndOfStream();
+
+    // Next packet of coded stream (if wait, once one is ready).
+    // RETURN: false iff there is none: with wait only once the end of
+    // stream has been coded and every packet pulled (or if not Ok()).
+    bool PullPacket( std::vector<uint8_t> &packet, bool wait = true );
+
+private:
+    bool Start();
+    static void *EncoderWrapper( void *encoder );
+    void Encode();
+
+    PushPictureReader *push_reader;
+    PacketStrmWriter *packet_writer;
+    bool ok;
+    bool started;
+    pthread_t encoder_thread;
+};
+
+
+/*
+ * Local variables:
+ *  c-file-style: "stroustrup"
+ *  tab-width: 4
+ *  indent-tabs-mode: nil
+ * End:
+ */
+#endif
@@ -67,7 +67,7 @@
  *
  * this routine also updates the predictions for motion vectors (PMV)
  */
-void Picture::PutMVs( MotionEst &me, bool back )
+void SliceCoder::PutMVs( MotionEst &me, bool back )
 
 {
 	int hor_f_code;
@@ -75,22 +75,22 @@ void Picture::PutMVs( MotionEst &me, bool back )
 
 	if( back )
 	{
-		hor_f_code = back_hor_f_code;
-		vert_f_code = back_vert_f_code;
+		hor_f_code = picture.back_hor_f_code;
+		vert_f_code = picture.back_vert_f_code;
 	}
 	else
 	{
-		hor_f_code = forw_hor_f_code;
-		vert_f_code = forw_vert_f_code;
+		hor_f_code = picture.forw_hor_f_code;
+		vert_f_code = picture.forw_vert_f_code;
 	}
 
-	if (pict_struct==FRAME_PICTURE)
+	if (picture.pict_struct==FRAME_PICTURE)
 	{
 		if (me.motion_type==MC_FRAME)
 		{
 			/* frame prediction */
-			coding->PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
-			coding->PutMV(me.MV[0][back][1]-PMV[0][back][1],vert_f_code);
+			coding.PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
+			coding.PutMV(me.MV[0][back][1]-PMV[0][back][1],vert_f_code);
 			PMV[0][back][0]=PMV[1][back][0]=me.MV[0][back][0];
 			PMV[0][back][1]=PMV[1][back][1]=me.MV[0][back][1];
 		}
@@ -98,12 +98,12 @@ void Picture::PutMVs( MotionEst &me, bool back )
 		{
 			/* field prediction */
 
-			coding->PutBits(me.field_sel[0][back],1);
-			coding->PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
-			coding->PutMV((me.MV[0][back][1]>>1)-(PMV[0][back][1]>>1),vert_f_code);
-			coding->PutBits(me.field_sel[1][back],1);
-			coding->PutMV(me.MV[1][back][0]-PMV[1][back][0],hor_f_code);
-			coding->PutMV((me.MV[1][back][1]>>1)-(PMV[1][back][1]>>1),vert_f_code);
+			coding.PutBits(me.field_sel[0][back],1);
+			coding.PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
+			coding.PutMV((me.MV[0][back][1]>>1)-(PMV[0][back][1]>>1),vert_f_code);
+			coding.PutBits(me.field_sel[1][back],1);
+			coding.PutMV(me.MV[1][back][0]-PMV[1][back][0],hor_f_code);
+			coding.PutMV((me.MV[1][back][1]>>1)-(PMV[1][back][1]>>1),vert_f_code);
 			PMV[0][back][0]=me.MV[0][back][0];
 			PMV[0][back][1]=me.MV[0][back][1];
 			PMV[1][back][0]=me.MV[1][back][0];
@@ -114,7 +114,7 @@ void Picture::PutMVs( MotionEst &me, bool back )
 		{
 #ifdef DEBUG_DPME
             MotionVector DMV[Parity::dim /*pred*/];
-                        calc_DMV(*this,
+                        calc_DMV(picture,
                          DMV,
                          me.dualprimeMV,
                          me.MV[0][0][0],
@@ -127,10 +127,10 @@ void Picture::PutMVs( MotionEst &me, bool back )
                 exit(0);
 #endif
 			/* dual prime prediction */
-			coding->PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
-			coding->PutDMV(me.dualprimeMV[0]);
-			coding->PutMV((me.MV[0][back][1]>>1)-(PMV[0][back][1]>>1),vert_f_code);
-			coding->PutDMV(me.dualprimeMV[1]);
+			coding.PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
+			coding.PutDMV(me.dualprimeMV[0]);
+			coding.PutMV((me.MV[0][back][1]>>1)-(PMV[0][back][1]>>1),vert_f_code);
+			coding.PutDMV(me.dualprimeMV[1]);
 			PMV[0][back][0]=PMV[1][back][0]=me.MV[0][back][0];
 			PMV[0][back][1]=PMV[1][back][1]=me.MV[0][back][1];
 		}
@@ -141,21 +141,21 @@ void Picture::PutMVs( MotionEst &me, bool back )
 		if (me.motion_type==MC_FIELD)
 		{
 			/* field prediction */
-			coding->PutBits(me.field_sel[0][back],1);
-			coding->PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
-			coding->PutMV(me.MV[0][back][1]-PMV[0][back][1],vert_f_code);
+			coding.PutBits(me.field_sel[0][back],1);
+			coding.PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
+			coding.PutMV(me.MV[0][back][1]-PMV[0][back][1],vert_f_code);
 			PMV[0][back][0]=PMV[1][back][0]=me.MV[0][back][0];
 			PMV[0][back][1]=PMV[1][back][1]=me.MV[0][back][1];
 		}
 		else if (me.motion_type==MC_16X8)
 		{
 			/* 16x8 prediction */
-			coding->PutBits(me.field_sel[0][back],1);
-			coding->PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
-			coding->PutMV(me.MV[0][back][1]-PMV[0][back][1],vert_f_code);
-			coding->PutBits(me.field_sel[1][back],1);
-			coding->PutMV(me.MV[1][back][0]-PMV[1][back][0],hor_f_code);
-			coding->PutMV(me.MV[1][back][1]-PMV[1][back][1],vert_f_code);
+			coding.PutBits(me.field_sel[0][back],1);
+			coding.PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
+			coding.PutMV(me.MV[0][back][1]-PMV[0][back][1],vert_f_code);
+			coding.PutBits(me.field_sel[1][back],1);
+			coding.PutMV(me.MV[1][back][0]-PMV[1][back][0],hor_f_code);
+			coding.PutMV(me.MV[1][back][1]-PMV[1][back][1],vert_f_code);
 			PMV[0][back][0]=me.MV[0][back][0];
 			PMV[0][back][1]=me.MV[0][back][1];
 			PMV[1][back][0]=me.MV[1][back][0];
@@ -164,34 +164,35 @@ void Picture::PutMVs( MotionEst &me, bool back )
 		else
 		{
 			/* dual prime prediction */
-			coding->PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
-			coding->PutDMV(me.dualprimeMV[0]);
-			coding->PutMV(me.MV[0][back][1]-PMV[0][back][1],vert_f_code);
-			coding->PutDMV(me.dualprimeMV[1]);
+			coding.PutMV(me.MV[0][back][0]-PMV[0][back][0],hor_f_code);
+			coding.PutDMV(me.dualprimeMV[0]);
+			coding.PutMV(me.MV[0][back][1]-PMV[0][back][1],vert_f_code);
+			coding.PutDMV(me.dualprimeMV[1]);
 			PMV[0][back][0]=PMV[1][back][0]=me.MV[0][back][0];
 			PMV[0][back][1]=PMV[1][back][1]=me.MV[0][back][1];
 		}
 	}
 }
 
-void Picture::PutDCTBlocks( MacroBlock &mb, int mb_type )
+void SliceCoder::PutDCTBlocks( MacroBlock &mb, int mb_type )
 {
     int comp;
     int cc;
     for (comp=0; comp<BLOCK_COUNT; comp++)
     {
         /* block loop */
-        if( mb.cbp & (1<<(BLOCK_COUNT-1-comp)))
+        if( mb.CBP() & (1<<(BLOCK_COUNT-1-comp)))
         {
             if (mb_type & MB_INTRA)
             {
                 // TODO: 420 Only?
                 cc = (comp<4) ? 0 : (comp&1)+1;
-                coding->PutIntraBlk(this, mb.QuantDCTblocks()[comp],cc);
+                coding.PutIntraBlk(&picture, mb.QuantDCTblocks()[comp],cc,
+                                   dc_dct_pred[cc]);
             }
             else
             {
-                coding->PutNonIntraBlk(this,mb.QuantDCTblocks()[comp]);
+                coding.PutNonIntraBlk(&picture,mb.QuantDCTblocks()[comp]);
             }
         }
     }
@@ -263,25 +264,25 @@ void Picture::PutCodingExt()
 }
 
 
-void Picture::PutSliceHdr( int slice_mb_y, int mquant )
+void SliceCoder::PutSliceHdr( int slice_mb_y, int mquant )
 {
     /* slice header (6.2.4) */
-    coding->AlignBits();
+    coding.AlignBits();
     
-    if (encparams.mpeg1 || encparams.vertical_size<=2800)
-        coding->PutBits(SLICE_MIN_START+slice_mb_y,32); /* slice_start_code */
+    if (picture.encparams.mpeg1 || picture.encparams.vertical_size<=2800)
+        coding.PutBits(SLICE_MIN_START+slice_mb_y,32); /* slice_start_code */
     else
     {
-        coding->PutBits(SLICE_MIN_START+(slice_mb_y&127),32); /* slice_start_code */
-        coding->PutBits(slice_mb_y>>7,3); /* slice_vertical_position_extension */
+        coding.PutBits(SLICE_MIN_START+(slice_mb_y&127),32); /* slice_start_code */
+        coding.PutBits(slice_mb_y>>7,3); /* slice_vertical_position_extension */
     }
     
     /* quantiser_scale_code */
-    coding->PutBits(q_scale_type 
+    coding.PutBits(picture.q_scale_type 
             ? map_non_linear_mquant[mquant] 
             : mquant >> 1, 5);
     
-    coding->PutBits(0,1); /* extra_bit_slice */
+    coding.PutBits(0,1); /* extra_bit_slice */
     
 } 
 
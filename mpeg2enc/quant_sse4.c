@@ -0,0 +1,307 @@
+/*
+ *  quant_sse4.c:  SSE4.1 and AVX2 versions of the quantisation /
+ *  inverse quantisation routines of quantize_ref.c
+ *
+ *  Unlike the MMX versions these give results *identical* to the C
+ *  versions, for any quantisation matrices.  SSE4.1 is needed for the
+ *  32 bit multiplies and min/max that lets them work at full
+ *  precision.  The routines themselves are in quant_sse4_kernel.h
+ *  which is instantiated for both instruction sets.
+ *
+ *  As for dct_sse2.c the code is compiled with per-function target
+ *  attributes and is only ever called if cpu_accel() reports the CPU
+ *  supports it.
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include "mjpeg_types.h"
+#include "syntaxconsts.h"
+#include "quantize_precomp.h"
+#include "quantize_ref.h"
+#include "quant_sse4.h"
+
+#ifdef HAVE_QUANT_SSE4
+
+#include <immintrin.h>
+
+#define SSE41_FN __attribute__((target("sse4.1")))
+#define SSE41_INLINE static inline __attribute__((always_inline, target("sse4.1")))
+#define AVX2_FN __attribute__((target("avx2")))
+#define AVX2_INLINE static inline __attribute__((always_inline, target("avx2")))
+
+/* Masks out the DC coefficient's lane */
+
+static const int32_t quant_ac_lanes[8] = { 0, -1, -1, -1, -1, -1, -1, -1 };
+
+/*
+ * SSE4.1: 4 coefficients at a time
+ */
+
+SSE41_INLINE void store_s16_sse41( int16_t *p, __m128i v )
+{
+    _mm_storel_epi64( (__m128i *)p, _mm_packs_epi32( v, v ) );
+}
+
+SSE41_INLINE int hsum_sse41( __m128i v )
+{
+    v = _mm_add_epi32( v, _mm_shuffle_epi32( v, 0x4e ) );
+    v = _mm_add_epi32( v, _mm_shuffle_epi32( v, 0xb1 ) );
+    return _mm_cvtsi128_si32( v );
+}
+
+#define VEC __m128i
+#define VECF __m128
+#define LANES 4
+#define KFN(name) name##_k128
+#define KINLINE SSE41_INLINE
+#define V_ZERO _mm_setzero_si128
+#define V_SET1_32 _mm_set1_epi32
+#define V_SET1PS _mm_set1_ps
+#define V_LOAD_S16(p) _mm_cvtepi16_epi32( _mm_loadl_epi64( (const __m128i *)(p) ) )
+#define V_LOAD_U16(p) _mm_cvtepu16_epi32( _mm_loadl_epi64( (const __m128i *)(p) ) )
+#define V_LOAD32(p) _mm_loadu_si128( (const __m128i *)(p) )
+#define V_LOADPS _mm_loadu_ps
+#define V_STORE_S16 store_s16_sse41
+#define V_HSUM32 hsum_sse41
+#define V_ADD32 _mm_add_epi32
+#define V_SUB32 _mm_sub_epi32
+#define V_MULLO32 _mm_mullo_epi32
+#define V_ABS32 _mm_abs_epi32
+#define V_SIGN32 _mm_sign_epi32
+#define V_SLLI32 _mm_slli_epi32
+#define V_SRLI32 _mm_srli_epi32
+#define V_CMPGT32 _mm_cmpgt_epi32
+#define V_CMPEQ32 _mm_cmpeq_epi32
+#define V_MIN32 _mm_min_epi32
+#define V_MAX32 _mm_max_epi32
+#define V_AND _mm_and_si128
+#define V_OR _mm_or_si128
+#define V_ANDNOT _mm_andnot_si128
+#define V_CVTPS _mm_cvtepi32_ps
+#define V_CVTTPS _mm_cvttps_epi32
+#define V_MULPS _mm_mul_ps
+#define V_TESTZ(v) _mm_testz_si128( (v), (v) )
+
+#include "quant_sse4_kernel.h"
+
+#undef VEC
+#undef VECF
+#undef LANES
+#undef KFN
+#undef KINLINE
+#undef V_ZERO
+#undef V_SET1_32
+#undef V_SET1PS
+#undef V_LOAD_S16
+#undef V_LOAD_U16
+#undef V_LOAD32
+#undef V_LOADPS
+#undef V_STORE_S16
+#undef V_HSUM32
+#undef V_ADD32
+#undef V_SUB32
+#undef V_MULLO32
+#undef V_ABS32
+#undef V_SIGN32
+#undef V_SLLI32
+#undef V_SRLI32
+#undef V_CMPGT32
+#undef V_CMPEQ32
+#undef V_MIN32
+#undef V_MAX32
+#undef V_AND
+#undef V_OR
+#undef V_ANDNOT
+#undef V_CVTPS
+#undef V_CVTTPS
+#undef V_MULPS
+#undef V_TESTZ
+
+SSE41_FN void quant_intra_sse41( struct QuantizerWorkSpace *wsp,
+                                 int16_t *src, int16_t *dst,
+                                 int q_scale_type, int dc_prec,
+                                 int clipvalue, int *nonsat_mquant )
+{
+    quant_intra_k128( wsp, src, dst, q_scale_type, dc_prec,
+                      clipvalue, nonsat_mquant );
+}
+
+SSE41_FN int quant_non_intra_sse41( struct QuantizerWorkSpace *wsp,
+                                    int16_t *src, int16_t *dst,
+                                    int q_scale_type,
+                                    int clipvalue, int *nonsat_mquant )
+{
+    return quant_non_intra_k128( wsp, src, dst, q_scale_type,
+                                 clipvalue, nonsat_mquant );
+}
+
+SSE41_FN int quant_weight_coeff_intra_sse41( struct QuantizerWorkSpace *wsp,
+                                             int16_t *blk )
+{
+    return weight_coeff_sum_k128( blk, wsp->i_intra_q_mat );
+}
+
+SSE41_FN int quant_weight_coeff_inter_sse41( struct QuantizerWorkSpace *wsp,
+                                             int16_t *blk )
+{
+    return weight_coeff_sum_k128( blk, wsp->i_inter_q_mat );
+}
+
+SSE41_FN void iquant_intra_m1_sse41( struct QuantizerWorkSpace *wsp,
+                                     int16_t *src, int16_t *dst,
+                                     int dc_prec, int mquant )
+{
+    iquant_intra_k128( wsp, src, dst, dc_prec, mquant, 1 );
+}
+
+SSE41_FN void iquant_intra_m2_sse41( struct QuantizerWorkSpace *wsp,
+                                     int16_t *src, int16_t *dst,
+                                     int dc_prec, int mquant )
+{
+    iquant_intra_k128( wsp, src, dst, dc_prec, mquant, 0 );
+}
+
+SSE41_FN void iquant_non_intra_m1_sse41( struct QuantizerWorkSpace *wsp,
+                                         int16_t *src, int16_t *dst,
+                                         int mquant )
+{
+    iquant_non_intra_k128( wsp, src, dst, mquant, 1 );
+}
+
+SSE41_FN void iquant_non_intra_m2_sse41( struct QuantizerWorkSpace *wsp,
+                                         int16_t *src, int16_t *dst,
+                                         int mquant )
+{
+    iquant_non_intra_k128( wsp, src, dst, mquant, 0 );
+}
+
+/*
+ * AVX2: 8 coefficients at a time
+ */
+
+AVX2_INLINE void store_s16_avx2( int16_t *p, __m256i v )
+{
+    _mm_storeu_si128( (__m128i *)p,
+                      _mm_packs_epi32( _mm256_castsi256_si128( v ),
+                                       _mm256_extracti128_si256( v, 1 ) ) );
+}
+
+AVX2_INLINE int hsum_avx2( __m256i v )
+{
+    __m128i s = _mm_add_epi32( _mm256_castsi256_si128( v ),
+                               _mm256_extracti128_si256( v, 1 ) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32( s, 0x4e ) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32( s, 0xb1 ) );
+    return _mm_cvtsi128_si32( s );
+}
+
+#define VEC __m256i
+#define VECF __m256
+#define LANES 8
+#define KFN(name) name##_k256
+#define KINLINE AVX2_INLINE
+#define V_ZERO _mm256_setzero_si256
+#define V_SET1_32 _mm256_set1_epi32
+#define V_SET1PS _mm256_set1_ps
+#define V_LOAD_S16(p) _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i *)(p) ) )
+#define V_LOAD_U16(p) _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)(p) ) )
+#define V_LOAD32(p) _mm256_loadu_si256( (const __m256i *)(p) )
+#define V_LOADPS _mm256_loadu_ps
+#define V_STORE_S16 store_s16_avx2
+#define V_HSUM32 hsum_avx2
+#define V_ADD32 _mm256_add_epi32
+#define V_SUB32 _mm256_sub_epi32
+#define V_MULLO32 _mm256_mullo_epi32
+#define V_ABS32 _mm256_abs_epi32
+#define V_SIGN32 _mm256_sign_epi32
+#define V_SLLI32 _mm256_slli_epi32
+#define V_SRLI32 _mm256_srli_epi32
+#define V_CMPGT32 _mm256_cmpgt_epi32
+#define V_CMPEQ32 _mm256_cmpeq_epi32
+#define V_MIN32 _mm256_min_epi32
+#define V_MAX32 _mm256_max_epi32
+#define V_AND _mm256_and_si256
+#define V_OR _mm256_or_si256
+#define V_ANDNOT _mm256_andnot_si256
+#define V_CVTPS _mm256_cvtepi32_ps
+#define V_CVTTPS _mm256_cvttps_epi32
+#define V_MULPS _mm256_mul_ps
+#define V_TESTZ(v) _mm256_testz_si256( (v), (v) )
+
+#include "quant_sse4_kernel.h"
+
+AVX2_FN void quant_intra_avx2( struct QuantizerWorkSpace *wsp,
+                               int16_t *src, int16_t *dst,
+                               int q_scale_type, int dc_prec,
+                               int clipvalue, int *nonsat_mquant )
+{
+    quant_intra_k256( wsp, src, dst, q_scale_type, dc_prec,
+                      clipvalue, nonsat_mquant );
+}
+
+AVX2_FN int quant_non_intra_avx2( struct QuantizerWorkSpace *wsp,
+                                  int16_t *src, int16_t *dst,
+                                  int q_scale_type,
+                                  int clipvalue, int *nonsat_mquant )
+{
+    return quant_non_intra_k256( wsp, src, dst, q_scale_type,
+                                 clipvalue, nonsat_mquant );
+}
+
+AVX2_FN int quant_weight_coeff_intra_avx2( struct QuantizerWorkSpace *wsp,
+                                           int16_t *blk )
+{
+    return weight_coeff_sum_k256( blk, wsp->i_intra_q_mat );
+}
+
+AVX2_FN int quant_weight_coeff_inter_avx2( struct QuantizerWorkSpace *wsp,
+                                           int16_t *blk )
+{
+    return weight_coeff_sum_k256( blk, wsp->i_inter_q_mat );
+}
+
+AVX2_FN void iquant_intra_m1_avx2( struct QuantizerWorkSpace *wsp,
+                                   int16_t *src, int16_t *dst,
+                                   int dc_prec, int mquant )
+{
+    iquant_intra_k256( wsp, src, dst, dc_prec, mquant, 1 );
+}
+
+AVX2_FN void iquant_intra_m2_avx2( struct QuantizerWorkSpace *wsp,
+                                   int16_t *src, int16_t *dst,
+                                   int dc_prec, int mquant )
+{
+    iquant_intra_k256( wsp, src, dst, dc_prec, mquant, 0 );
+}
+
+AVX2_FN void iquant_non_intra_m1_avx2( struct QuantizerWorkSpace *wsp,
+                                       int16_t *src, int16_t *dst,
+                                       int mquant )
+{
+    iquant_non_intra_k256( wsp, src, dst, mquant, 1 );
+}
+
+AVX2_FN void iquant_non_intra_m2_avx2( struct QuantizerWorkSpace *wsp,
+                                       int16_t *src, int16_t *dst,
+                                       int mquant )
+{
+    iquant_non_intra_k256( wsp, src, dst, mquant, 0 );
+}
+
+#endif /* HAVE_QUANT_SSE4 */
@@ -0,0 +1,92 @@
+#ifndef _QUANT_SSE4_H
+#define _QUANT_SSE4_H
+
+/*
+ *  quant_sse4.h:  SSE4.1 and AVX2 versions of the quantisation /
+ *  inverse quantisation routines of quantize_ref.c
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "mjpeg_types.h"
+
+/* As for dct_sse2.h: built using function target attributes */
+
+#if (defined(__i386__) || defined(__x86_64__)) && \
+    ((defined(__GNUC__) && !defined(__clang__) \
+     && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) \
+     || (defined(__clang__) && __clang_major__ >= 4))
+#define HAVE_QUANT_SSE4 1
+#endif
+
+#ifdef HAVE_QUANT_SSE4
+
+#ifdef  __cplusplus
+extern "C" {
+#endif
+
+struct QuantizerWorkSpace;
+
+void quant_intra_sse41( struct QuantizerWorkSpace *wsp,
+                        int16_t *src, int16_t *dst,
+                        int q_scale_type, int dc_prec,
+                        int clipvalue, int *nonsat_mquant );
+int quant_non_intra_sse41( struct QuantizerWorkSpace *wsp,
+                           int16_t *src, int16_t *dst,
+                           int q_scale_type,
+                           int clipvalue, int *nonsat_mquant );
+int quant_weight_coeff_intra_sse41( struct QuantizerWorkSpace *wsp,
+                                    int16_t *blk );
+int quant_weight_coeff_inter_sse41( struct QuantizerWorkSpace *wsp,
+                                    int16_t *blk );
+void iquant_intra_m1_sse41( struct QuantizerWorkSpace *wsp,
+                            int16_t *src, int16_t *dst, int dc_prec, int mquant );
+void iquant_intra_m2_sse41( struct QuantizerWorkSpace *wsp,
+                            int16_t *src, int16_t *dst, int dc_prec, int mquant );
+void iquant_non_intra_m1_sse41( struct QuantizerWorkSpace *wsp,
+                                int16_t *src, int16_t *dst, int mquant );
+void iquant_non_intra_m2_sse41( struct QuantizerWorkSpace *wsp,
+                                int16_t *src, int16_t *dst, int mquant );
+
+void quant_intra_avx2( struct QuantizerWorkSpace *wsp,
+                       int16_t *src, int16_t *dst,
+                       int q_scale_type, int dc_prec,
+                       int clipvalue, int *nonsat_mquant );
+int quant_non_intra_avx2( struct QuantizerWorkSpace *wsp,
+                          int16_t *src, int16_t *dst,
+                          int q_scale_type,
+                          int clipvalue, int *nonsat_mquant );
+int quant_weight_coeff_intra_avx2( struct QuantizerWorkSpace *wsp,
+                                   int16_t *blk );
+int quant_weight_coeff_inter_avx2( struct QuantizerWorkSpace *wsp,
+                                   int16_t *blk );
+void iquant_intra_m1_avx2( struct QuantizerWorkSpace *wsp,
+                           int16_t *src, int16_t *dst, int dc_prec, int mquant );
+void iquant_intra_m2_avx2( struct QuantizerWorkSpace *wsp,
+                           int16_t *src, int16_t *dst, int dc_prec, int mquant );
+void iquant_non_intra_m1_avx2( struct QuantizerWorkSpace *wsp,
+                               int16_t *src, int16_t *dst, int mquant );
+void iquant_non_intra_m2_avx2( struct QuantizerWorkSpace *wsp,
+                               int16_t *src, int16_t *dst, int mquant );
+
+#ifdef  __cplusplus
+}
+#endif
+
+#endif /* HAVE_QUANT_SSE4 */
+
+#endif /* _QUANT_SSE4_H */
@@ -0,0 +1,257 @@
+/*
+ *  quant_sse4_kernel.h:  The quantisation / inverse quantisation
+ *  routines of quant_sse4.c.  Included once for SSE4.1 and once for
+ *  AVX2 with the following defined:
+ *
+ *  VEC, VECF   the 32 bit integer and float vector types
+ *  LANES       the number of 32 bit lanes in a VEC
+ *  KFN(name)   name of the instance's version of name
+ *  KINLINE     qualifiers (including the target) for its functions
+ *  V_xxx       each of the vector operations used below
+ *
+ *  Coefficients are widened to 32 bits so all the arithmetic of
+ *  quantize_ref.c can be done exactly, LANES coefficients at a time.
+ *  The results are identical to quantize_ref.c's for any input.
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+/*
+ * a / d for 0 <= a < 2^22 and 0 < d < 2^16 given r = 1.0f/d.  The
+ * quotient from the float multiply is off by at most one either way
+ * so checking the remainder is enough to make it exact.
+ */
+
+KINLINE VEC KFN(divide)( VEC a, VEC d, VECF r )
+{
+    VEC q = V_CVTTPS( V_MULPS( V_CVTPS( a ), r ) );
+    VEC rem = V_SUB32( a, V_MULLO32( q, d ) );
+    q = V_SUB32( q, V_CMPGT32( rem, V_SUB32( d, V_SET1_32( 1 ) ) ) );
+    return V_ADD32( q, V_CMPGT32( V_ZERO(), rem ) );
+}
+
+/* x - 1 where x is even and non-zero: MPEG-1 mismatch control for x >= 0 */
+
+KINLINE VEC KFN(make_odd)( VEC x )
+{
+    const VEC zero = V_ZERO();
+    return V_ADD32( x, V_ANDNOT( V_CMPEQ32( x, zero ),
+                                 V_CMPEQ32( V_AND( x, V_SET1_32( 1 ) ), zero ) ) );
+}
+
+KINLINE VEC KFN(saturate)( VEC x )
+{
+    return V_MAX32( V_MIN32( x, V_SET1_32( 2047 ) ), V_SET1_32( -2048 ) );
+}
+
+/*
+ * Intra quantisation (quant_intra).  The blocks are done two at a
+ * time so each quantisation matrix vector loaded serves both.
+ */
+
+KINLINE void KFN(quant_intra)( struct QuantizerWorkSpace *wsp,
+                               int16_t *src, int16_t *dst,
+                               int q_scale_type, int dc_prec,
+                               int clipvalue, int *nonsat_mquant )
+{
+    const VEC clip = V_SET1_32( clipvalue );
+    const VECF half = V_SET1PS( 0.5f );
+    int mquant = *nonsat_mquant;
+    int comp, b, i, pair, d;
+
+restart:
+    for( comp = 0; comp < BLOCK_COUNT; comp += 2 )
+    {
+        const uint16_t *qmat = wsp->intra_q_tbl[mquant];
+        const float *iqmat = wsp->i_intra_q_tblf[mquant];
+        VEC clipped = V_ZERO();
+        pair = BLOCK_COUNT-comp < 2 ? 1 : 2;
+        for( i = 0; i < 64; i += LANES )
+        {
+            VEC qm = V_LOAD_U16( qmat+i );
+            VEC qm2 = V_ADD32( qm, qm );
+            VECF r = V_MULPS( V_LOADPS( iqmat+i ), half );
+            for( b = 0; b < pair; ++b )
+            {
+                int16_t *psrc = src+64*(comp+b)+i;
+                VEC x = V_LOAD_S16( psrc );
+                VEC y = KFN(divide)( V_ADD32( V_SLLI32( V_ABS32( x ), 5 ), qm ),
+                                     qm2, r );
+                VEC over = V_CMPGT32( y, clip );
+                /* The DC coefficient is quantised separately */
+                if( i == 0 )
+                    over = V_AND( over, V_LOAD32( quant_ac_lanes ) );
+                clipped = V_OR( clipped, over );
+                V_STORE_S16( dst+64*(comp+b)+i, V_SIGN32( y, x ) );
+            }
+        }
+        if( !V_TESTZ( clipped ) )
+        {
+            mquant = next_larger_quant( q_scale_type, mquant );
+            goto restart;
+        }
+    }
+
+    d = 8>>dc_prec; /* intra_dc_mult */
+    for( comp = 0; comp < BLOCK_COUNT; ++comp )
+    {
+        int x = src[64*comp];
+        dst[64*comp] = (x>=0) ? (x+(d>>1))/d : -((-x+(d>>1))/d);
+    }
+    *nonsat_mquant = mquant;
+}
+
+/*
+ * Non-intra quantisation (quant_non_intra).  Again two blocks at a
+ * time.  If the coefficients saturate even at the coarsest
+ * quantisation the (rare) clipping case is left to the C version.
+ */
+
+KINLINE int KFN(quant_non_intra)( struct QuantizerWorkSpace *wsp,
+                                  int16_t *src, int16_t *dst,
+                                  int q_scale_type,
+                                  int clipvalue, int *nonsat_mquant )
+{
+    const VEC clip = V_SET1_32( clipvalue );
+    int mquant = *nonsat_mquant;
+    int nzflag;
+    int comp, b, i, pair;
+
+restart:
+    nzflag = 0;
+    for( comp = 0; comp < BLOCK_COUNT; comp += 2 )
+    {
+        const uint16_t *qmat = wsp->inter_q_tbl[mquant];
+        const float *iqmat = wsp->i_inter_q_tblf[mquant];
+        VEC clipped = V_ZERO();
+        VEC nz[2];
+        pair = BLOCK_COUNT-comp < 2 ? 1 : 2;
+        nz[0] = nz[1] = V_ZERO();
+        for( i = 0; i < 64; i += LANES )
+        {
+            VEC qm = V_LOAD_U16( qmat+i );
+            VECF r = V_LOADPS( iqmat+i );
+            for( b = 0; b < pair; ++b )
+            {
+                int16_t *psrc = src+64*(comp+b)+i;
+                VEC x = V_LOAD_S16( psrc );
+                VEC y = KFN(divide)( V_SLLI32( V_ABS32( x ), 4 ), qm, r );
+                clipped = V_OR( clipped, V_CMPGT32( y, clip ) );
+                nz[b] = V_OR( nz[b], y );
+                V_STORE_S16( dst+64*(comp+b)+i, V_SIGN32( y, x ) );
+            }
+        }
+        if( !V_TESTZ( clipped ) )
+        {
+            int new_mquant = next_larger_quant( q_scale_type, mquant );
+            if( new_mquant != mquant )
+            {
+                mquant = new_mquant;
+                goto restart;
+            }
+            return quant_non_intra( wsp, src, dst, q_scale_type,
+                                    clipvalue, nonsat_mquant );
+        }
+        for( b = 0; b < pair; ++b )
+            nzflag = (nzflag<<1) | !V_TESTZ( nz[b] );
+    }
+
+    *nonsat_mquant = mquant;
+    return nzflag;
+}
+
+/*
+ * Quantisation matrix weighted coefficient sum (quant_weight_coeff_*)
+ */
+
+KINLINE int KFN(weight_coeff_sum)( const int16_t *blk, const uint16_t *i_quant_mat )
+{
+    VEC sum = V_ZERO();
+    int i;
+    for( i = 0; i < 64; i += LANES )
+        sum = V_ADD32( sum, V_MULLO32( V_ABS32( V_LOAD_S16( blk+i ) ),
+                                       V_LOAD_U16( i_quant_mat+i ) ) );
+    return V_HSUM32( sum );
+}
+
+/*
+ * Intra inverse quantisation, MPEG-1 (iquant_intra_m1) or MPEG-2
+ * (iquant_intra_m2) mismatch control.  src and dst may be the same.
+ */
+
+KINLINE void KFN(iquant_intra)( struct QuantizerWorkSpace *wsp,
+                                int16_t *src, int16_t *dst,
+                                int dc_prec, int mquant, const int mpeg1 )
+{
+    const uint16_t *qmat = wsp->intra_q_tbl[mquant];
+    int dc = src[0] << (3-dc_prec);
+    VEC sum = V_ZERO();
+    int i;
+
+    for( i = 0; i < 64; i += LANES )
+    {
+        VEC p = V_MULLO32( V_LOAD_S16( src+i ), V_LOAD_U16( qmat+i ) );
+        VEC val = V_SRLI32( V_ABS32( p ), 4 );
+        if( mpeg1 )
+            val = KFN(make_odd)( val );
+        val = KFN(saturate)( V_SIGN32( val, p ) );
+        if( !mpeg1 )
+            sum = V_ADD32( sum, i == 0
+                                ? V_AND( val, V_LOAD32( quant_ac_lanes ) )
+                                : val );
+        V_STORE_S16( dst+i, val );
+    }
+    dst[0] = dc;
+
+    if( !mpeg1 && ((dst[0]+V_HSUM32( sum ))&1) == 0 )
+        dst[63] ^= 1;
+}
+
+/*
+ * Non-intra inverse quantisation, MPEG-1 (iquant_non_intra_m1) or
+ * MPEG-2 (iquant_non_intra_m2).  src and dst may be the same.
+ */
+
+KINLINE void KFN(iquant_non_intra)( struct QuantizerWorkSpace *wsp,
+                                    int16_t *src, int16_t *dst,
+                                    int mquant, const int mpeg1 )
+{
+    const uint16_t *qmat = wsp->inter_q_tbl[mquant];
+    VEC sum = V_ZERO();
+    int i;
+
+    for( i = 0; i < 64; i += LANES )
+    {
+        VEC x = V_LOAD_S16( src+i );
+        VEC val = V_SRLI32(
+            V_MULLO32( V_ADD32( V_SLLI32( V_ABS32( x ), 1 ), V_SET1_32( 1 ) ),
+                       V_LOAD_U16( qmat+i ) ), 5 );
+        if( mpeg1 )
+            val = KFN(saturate)( V_SIGN32( KFN(make_odd)( val ), x ) );
+        else
+        {
+            val = V_ANDNOT( V_CMPEQ32( x, V_ZERO() ),
+                            V_MIN32( val, V_SET1_32( 2047 ) ) );
+            sum = V_ADD32( sum, val );
+            val = V_SIGN32( val, x );
+        }
+        V_STORE_S16( dst+i, val );
+    }
+
+    if( !mpeg1 && (V_HSUM32( sum )&1) == 0 )
+        dst[63] ^= 1;
+}
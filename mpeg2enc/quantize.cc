@@ -51,9 +51,13 @@
 #include "mpeg2syntaxcodes.h"
 #include "picture.hh"
 #include "macroblock.hh"
+#include "mpeg2coder.hh"
+#include "ratectl.hh"
 #include "quantize.hh"
+#include "quantize_precomp.h"
 
 #include <stdlib.h>
+#include <math.h>
 
 /********************
  * 
@@ -140,12 +144,123 @@ static int unit_coeff_elimination(DCTblock &block,
     return (block[0] == 0);
 }
 
+/********************
+ *
+ * Rate-distortion optimised (trellis) quantisation of a block.
+ *
+ * Starting from the ordinary quantisation of the block each non-zero
+ * coefficient may be coded as is, one level smaller, or dropped.
+ * The choice minimising D + lambda * R for the whole block is found
+ * by dynamic programming along the scan.  The states are the scan
+ * position of the last coded coefficient, R is the length of the
+ * (run, level) VLC's and D the squared error of the reconstructed
+ * coefficient relative to dropping it (so that zeros cost nothing).
+ * A state costing more than the state after it is pruned: the
+ * longer runs that follow from it are hardly ever cheaper.
+ *
+ * RETURN: 1 if the (non-intra) block is best not coded at all, 0 otherwise
+ *
+ *******************/
+
+static inline int rd_recon( int level, int qmat, bool intra, bool mpeg1, int sat )
+{
+    int val = intra ? level*qmat/16 : ((2*level+1)*qmat)/32;
+    /* MPEG-1 mismatch control */
+    if( mpeg1 && val != 0 && (val&1) == 0 )
+        val -= 1;
+    return val > sat ? sat : val;
+}
+
+static int rd_quant_block( const int16_t *src, int16_t *dst,
+                           const uint16_t *qmat, const uint8_t *scan_pattern,
+                           bool intra, bool mpeg1, int vlcformat,
+                           double lambda, MPEG2CodingBuf &coding )
+{
+    const int start_coeff = intra ? 1 : 0;
+    const int eob_bits = (intra && vlcformat) ? 4 : 2;
+    double score[65];
+    int16_t level[65];
+    uint8_t prev[65];
+    uint8_t survivors[65];
+    int num_survivors = 1;
+    int i, k, s, l;
+
+    score[start_coeff] = 0.0;
+    survivors[0] = start_coeff;
+
+    for( i = start_coeff; i < 64; ++i )
+    {
+        const int j = scan_pattern[i];
+        const int l0 = abs(dst[j]);
+        score[i+1] = HUGE_VAL;
+        if( l0 == 0 )
+            continue;
+
+        const int x = abs(src[j]);
+        const int sat = src[j] < 0 ? 2048 : 2047;
+        for( l = l0; l > 0 && l >= l0-1; --l )
+        {
+            const double err = x - rd_recon( l, qmat[j], intra, mpeg1, sat );
+            const double dist = err*err - static_cast<double>(x*x);
+            for( k = 0; k < num_survivors; ++k )
+            {
+                s = survivors[k];
+                // N.b. the first coefficient of a non-intra block
+                // has a short code for run 0 level 1
+                const int bits = (!intra && i == 0 && l == 1)
+                    ? 2
+                    : coding.AC_bits( i-s, l, vlcformat );
+                const double cost = score[s] + lambda * bits + dist;
+                if( cost < score[i+1] )
+                {
+                    score[i+1] = cost;
+                    prev[i+1] = s;
+                    level[i+1] = l;
+                }
+            }
+        }
+
+        int kept = 0;
+        for( k = 0; k < num_survivors; ++k )
+            if( score[survivors[k]] < score[i+1] )
+                survivors[kept++] = survivors[k];
+        survivors[kept++] = i+1;
+        num_survivors = kept;
+    }
+
+    // A block with no coefficients needs no EOB if it isn't coded
+    // at all (non-intra)
+    int last = start_coeff;
+    double best = intra ? lambda * eob_bits : 0.0;
+    for( k = 0; k < num_survivors; ++k )
+    {
+        s = survivors[k];
+        if( s != start_coeff && score[s] + lambda * eob_bits < best )
+        {
+            best = score[s] + lambda * eob_bits;
+            last = s;
+        }
+    }
+
+    for( i = start_coeff; i < 64; ++i )
+        dst[scan_pattern[i]] = 0;
+    for( s = last; s != start_coeff; s = prev[s] )
+    {
+        const int j = scan_pattern[s-1];
+        dst[j] = src[j] < 0 ? -level[s] : level[s];
+    }
+
+    return !intra && last == start_coeff;
+}
+
 //
 // TODO for efficiency the qdctblocks should be an external buffer managed by the calling slice/picture
 // coder.
 //
 void MacroBlock::Quantize( Quantizer &quant  )
 {
+    int &mquant = MQuant();
+    int &cbp = CBP();
     if (best_me->mb_type & MB_INTRA)
     {
         quant.QuantIntra( dctblocks[0],
@@ -180,8 +295,40 @@ void MacroBlock::Quantize( Quantizer &quant  )
     }
 }
 
+/*
+ * Quantize followed by RD optimisation of the quantised blocks using
+ * the VLC code lengths of coding and the lambda matching the
+ * macroblock's quantisation.
+ */
+
+void MacroBlock::QuantizeRD( Quantizer &quant, MPEG2CodingBuf &coding )
+{
+    Quantize( quant );
+
+    const int mquant = MQuant();
+    int &cbp = CBP();
+    const bool intra = (best_me->mb_type & MB_INTRA) != 0;
+    const uint16_t *qmat = intra ? quant.IntraQuantTbl( mquant )
+                                 : quant.InterQuantTbl( mquant );
+    const double lambda = RateCtl::QuantLambda( mquant );
+    int block;
+    for( block = 0; block < BLOCK_COUNT; ++block )
+    {
+        const int cbp_bit = 1<<(BLOCK_COUNT-1-block);
+        if( !(cbp & cbp_bit) )
+            continue;
+        if( rd_quant_block( dctblocks[block], qdctblocks[block],
+                            qmat, picture->scan_pattern,
+                            intra, picture->encparams.mpeg1,
+                            intra ? picture->intravlc : 0,
+                            lambda, coding ) )
+            cbp &= ~cbp_bit;
+    }
+}
+
 void MacroBlock::IQuantize( Quantizer &quant)
 {
+    const int mquant = MQuant();
     int j;
     if (best_me->mb_type & MB_INTRA)
     {
@@ -211,6 +358,16 @@ void Quantizer::Init()
                     encparams.inter_q );
 }
 
+const uint16_t *Quantizer::IntraQuantTbl( int mquant ) const
+{
+    return workspace->intra_q_tbl[mquant];
+}
+
+const uint16_t *Quantizer::InterQuantTbl( int mquant ) const
+{
+    return workspace->inter_q_tbl[mquant];
+}
+
 Quantizer::~Quantizer()
 {
     shutdown_quantizer( workspace );
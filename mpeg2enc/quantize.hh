@@ -38,9 +38,9 @@ public:
 				int dctsatlim,
 				int *nonsat_mquant)
 		{
-			quant_intra( workspace, src, dst, 
-						 q_scale_type, dcprec, 
-						 dctsatlim, nonsat_mquant );
+			(*pquant_intra)( workspace, src, dst, 
+							 q_scale_type, dcprec, 
+							 dctsatlim, nonsat_mquant );
 		}
 
 	inline
@@ -80,6 +80,10 @@ public:
 			(*piquant_non_intra)(workspace, src, dst, mquant );
 		}
 
+	// Quantisation matrices pre-multiplied by mquant
+	const uint16_t *IntraQuantTbl( int mquant ) const;
+	const uint16_t *InterQuantTbl( int mquant ) const;
+
 private:
 	QuantizerWorkSpace *workspace;
 	EncoderParams &encparams;
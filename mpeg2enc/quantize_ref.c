@@ -304,6 +304,7 @@ restart:
 				}
 				i=0;
 				nzflag =0;
+				flags = 0;
 				goto restart;
 			}
 		}
@@ -499,6 +500,7 @@ void init_quantizer( struct QuantizerCalls *calls,
         calls->piquant_intra = iquant_intra_m2;
         calls->piquant_non_intra = iquant_non_intra_m2;
     }
+    calls->pquant_intra = quant_intra;
     calls->pquant_non_intra = quant_non_intra;	  
     calls->pquant_weight_coeff_intra = quant_weight_coeff_intra;
     calls->pquant_weight_coeff_inter = quant_weight_coeff_inter;
@@ -29,6 +29,12 @@ struct QuantizerWorkSpace;
 
 struct QuantizerCalls
 {
+    void (*pquant_intra)( struct QuantizerWorkSpace *wsp,
+                          int16_t *src, int16_t *dst,
+                          int q_scale_type,
+                          int dc_prec,
+                          int dctsatlim,
+                          int *nonsat_mquant);
     int (*pquant_non_intra)( struct QuantizerWorkSpace *wsp,
                              int16_t *src, int16_t *dst,
                              int q_scale_type, 
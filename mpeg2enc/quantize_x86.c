@@ -40,6 +40,7 @@
 #include "tables.h"
 #include "quantize_precomp.h"
 #include "quantize_ref.h"
+#include "quant_sse4.h"
 					
 int quant_weight_coeff_sum_mmx (int16_t *blk, uint16_t *i_quant_mat );
 
@@ -403,12 +404,13 @@ void init_x86_quantization( struct QuantizerCalls *qcalls,
                             int mpeg1)
 {
     int flags = cpu_accel();
-    int d_quant_nonintra, d_weight_intra, d_weight_nonintra, d_iquant_intra;
-    int d_iquant_nonintra;
+    int d_quant_intra, d_quant_nonintra, d_weight_intra, d_weight_nonintra;
+    int d_iquant_intra, d_iquant_nonintra;
     const char *opt_type1 = "", *opt_type2 = "";
 
     if  ((flags & ACCEL_X86_MMX) != 0 ) /* MMX CPU */
     {
+	d_quant_intra = disable_simd("quant_intra");
 	d_quant_nonintra = disable_simd("quant_nonintra");
 	d_weight_intra = disable_simd("quant_weight_intra");
 	d_weight_nonintra = disable_simd("quant_weight_nonintra");
@@ -419,7 +421,7 @@ void init_x86_quantization( struct QuantizerCalls *qcalls,
         {
             if( quant_non_intra_can_use_mmx(wsp) )
             {
-	        opt_type1 = "MMX and";
+	        opt_type1 = "MMX and ";
 	        qcalls->pquant_non_intra = quant_non_intra_mmx;
             } else {
                 mjpeg_warn("Non-intra quantization table out of range; disabling MMX");
@@ -442,7 +444,55 @@ void init_x86_quantization( struct QuantizerCalls *qcalls,
             if (d_iquant_nonintra == 0)
                 qcalls->piquant_non_intra = iquant_non_intra_m2_mmx;
         }
-        
+
+#ifdef HAVE_QUANT_SSE4
+        /* Exact for any quantisation matrices (so no range check)
+           and covering intra quantisation and inverse quantisation
+           too.  */
+        if( flags & ACCEL_X86_SSE41 )
+        {
+            int avx2 = (flags & ACCEL_X86_AVX2) != 0;
+            opt_type1 = "";
+            opt_type2 = avx2 ? "AVX2" : "SSE4.1";
+            if (d_quant_intra == 0)
+                qcalls->pquant_intra = 
+                    avx2 ? quant_intra_avx2 : quant_intra_sse41;
+            if (d_quant_nonintra == 0)
+                qcalls->pquant_non_intra = 
+                    avx2 ? quant_non_intra_avx2 : quant_non_intra_sse41;
+            if (d_weight_intra == 0)
+                qcalls->pquant_weight_coeff_intra = 
+                    avx2 ? quant_weight_coeff_intra_avx2 
+                         : quant_weight_coeff_intra_sse41;
+            if (d_weight_nonintra == 0)
+                qcalls->pquant_weight_coeff_inter = 
+                    avx2 ? quant_weight_coeff_inter_avx2 
+                         : quant_weight_coeff_inter_sse41;
+            if (d_iquant_intra == 0)
+            {
+                if (mpeg1)
+                    qcalls->piquant_intra = 
+                        avx2 ? iquant_intra_m1_avx2 : iquant_intra_m1_sse41;
+                else
+                    qcalls->piquant_intra = 
+                        avx2 ? iquant_intra_m2_avx2 : iquant_intra_m2_sse41;
+            }
+            if (d_iquant_nonintra == 0)
+            {
+                if (mpeg1)
+                    qcalls->piquant_non_intra = 
+                        avx2 ? iquant_non_intra_m1_avx2 
+                             : iquant_non_intra_m1_sse41;
+                else
+                    qcalls->piquant_non_intra = 
+                        avx2 ? iquant_non_intra_m2_avx2 
+                             : iquant_non_intra_m2_sse41;
+            }
+        }
+#endif
+
+        if  (d_quant_intra)
+            mjpeg_info(" Disabling quant_intra");
         if  (d_quant_nonintra)
             mjpeg_info(" Disabling quant_non_intra");
         if  (d_iquant_intra)
@@ -454,6 +504,6 @@ void init_x86_quantization( struct QuantizerCalls *qcalls,
         if (d_weight_nonintra)
             mjpeg_info(" Disabling quant_weight_nonintra");
 
-	mjpeg_info( "SETTING %s %s for QUANTIZER!", opt_type1, opt_type2);
+	mjpeg_info( "SETTING %s%s for QUANTIZER!", opt_type1, opt_type2);
     }
 }
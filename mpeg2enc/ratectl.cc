@@ -83,6 +83,9 @@ void RateCtl::PictSetup( Picture &picture)
 
     InitPict( picture );
 
+    /* Coding mode decisions made as the picture is transformed
+       assume the quantisation rate control starts the picture with */
+    picture.rd_mquant = InitialMacroBlockQuant();
 }
 
 double RateCtl::ClipQuant( int q_scale_type, double quant )
@@ -187,6 +190,23 @@ double RateCtl::InvScaleQuant( int q_scale_type, int raw_code )
 		return ((double)raw_code);
 }
 
+/*
+ * The Lagrange multiplier trading squared DCT coefficient error
+ * against bits that matches rate control's choice of quantisation
+ * mquant. Used by the rate-distortion optimised coding decisions.
+ * For a uniform quantiser the slope of the distortion / rate curve
+ * goes as the square of the quantiser step size.  The scale was
+ * chosen so that spending bits by lowering lambda is about as
+ * efficient as spending them by lowering mquant.
+ */
+
+static const double RD_LAMBDA_SCALE = 0.25;
+
+double RateCtl::QuantLambda( int mquant )
+{
+    return RD_LAMBDA_SCALE * mquant * mquant;
+}
+
 Pass1RateCtl::Pass1RateCtl( EncoderParams &_encparams, RateCtlState &_state ) :
         RateCtl( _encparams, _state )
 {
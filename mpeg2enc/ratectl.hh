@@ -95,6 +95,7 @@ public:
     static double ClipQuant( int q_scale_type, double quant );
     static double InvScaleQuant(  int q_scale_type, int raw_code );
     static int ScaleQuant( int q_scale_type, double quant );
+    static double QuantLambda( int mquant );
 protected:
 
     /*********************
@@ -55,259 +55,8 @@
 #include "seqencoder.hh"
 #include "ratectl.hh"
 #include "tables.h"
-#include "channel.hh"
-
-
-// --------------------------------------------------------------------------------
-//  Striped Encoding Job parallel despatch classes
-//
-
-// Selection of the way macro blocks are distributed between
-// threads.
-//
-// STRIPED ensures each job processes macroblocks in encoding order 
-// This is useful for parallelising threads generating output.
-// INTERLEAVED ensures shared caches enjoy reasonable locality of reference.
-//
-
-
-
-struct EncoderJob
-{
-    enum JobPattern { ENCODE_ORDER, INTERLEAVED };
-    
-    EncoderJob() : shutdown( false ),working(false) {}
-    void (MacroBlock::*encodingFunc)(); 
-    Picture         *picture;
-    JobPattern      pattern; 
-    unsigned int    stripe;
-    bool            shutdown;
-    volatile bool   working;
-};
-
-class ShutdownJob : public EncoderJob
-{
-public:
-    ShutdownJob()
-        {
-            shutdown = true;
-        }
-};
-
-
-
-class Despatcher
-{
-public:
-    Despatcher();
-    ~Despatcher();
-    void Init( unsigned int parallelism );
-    void Despatch( Picture &picture, void (MacroBlock::*encodingFunc)(),
-                   EncoderJob::JobPattern pattern = EncoderJob::INTERLEAVED );
-    void ParallelWorker();
-    void WaitForCompletion();
-private:
-    static void *ParallelPerformWrapper(void *despatcher);
-
-    unsigned int parallelism;
-    
-    Channel<EncoderJob *> jobstodo;	
-    vector<EncoderJob>    jobpool;
-    pthread_t *worker_threads;
-};
-
-Despatcher::Despatcher() :
-    worker_threads(0)
-{}
-
-void Despatcher::Init( unsigned int _parallelism )
-
-{
-    parallelism = _parallelism;
-    mjpeg_debug( "PAR = %d\n", parallelism );
-    if( parallelism > 0 )
-    {
-        jobpool.resize(parallelism);
-        pthread_attr_t *pattr = 0;
-        EncoderJob job;
-        /* For some Unixen we get a ridiculously small default stack size.
-           Hence we need to beef this up if we can.
-        */
-#ifdef HAVE_PTHREADSTACKSIZE
-#define MINSTACKSIZE 200000
-
-        pthread_attr_t attr;
-        size_t stacksize;
-
-        pthread_attr_init(&attr);
-        pthread_attr_getstacksize(&attr, &stacksize);
-
-        if (stacksize < MINSTACKSIZE)
-        {
-            pthread_attr_setstacksize(&attr, MINSTACKSIZE);
-        }
-
-        pattr = &attr;
-#endif
-        worker_threads = new pthread_t[parallelism];
-        for( unsigned int i = 0; i < parallelism; ++i )
-        {
-            jobpool[i].working = false;
-            jobpool[i].stripe = i;
-            mjpeg_debug("Creating worker thread %d", i );
-            if( pthread_create( &worker_threads[i], pattr,
-                                &Despatcher::ParallelPerformWrapper,
-                                this ) != 0 )
-            {
-                mjpeg_error_exit1( "worker thread creation failed: %s", strerror(errno) );
-            }
-        }
-    }
-}
-
-Despatcher::~Despatcher()
-{
-    if( worker_threads != 0 )
-    {
-        WaitForCompletion();
-        unsigned int i;
-        ShutdownJob shutdownjob;
-
-        for( i = 0; i < parallelism; ++i )
-        {
-            jobstodo.Put( &shutdownjob );
-        }
-        for( i = 0; i < parallelism; ++i )
-        {
-            pthread_join( worker_threads[i], NULL );
-        }
-        delete [] worker_threads;
-    }
-}
-
-void *Despatcher::ParallelPerformWrapper(void *despatcher)
-{
-    static_cast<Despatcher *>(despatcher)->ParallelWorker();
-    return 0;
-}
-
-void Despatcher::ParallelWorker()
-{
-	EncoderJob *job;
-	mjpeg_debug( "Worker thread started" );
-    pthread_setcanceltype( PTHREAD_CANCEL_ASYNCHRONOUS, NULL );
-
-	for(;;)
-	{
-        // Get Job to do and do it!!
-     mjpeg_debug( "Worker: getting" );
-      
-        jobstodo.Get( job );
-        if( job->shutdown )
-        {
-            mjpeg_debug("SHUTDOWN worker" );
-            pthread_exit( 0 );
-        }
-        mjpeg_debug( "Working: stripe %d/%d %d", job->stripe, parallelism, job->pattern );
-        Picture *picture = job->picture;
-        vector<MacroBlock>::iterator macroblocks_begin;
-        vector<MacroBlock>::iterator macroblocks_end;
-        switch( picture->pict_struct )
-        {
-            case FRAME_PICTURE :
-                macroblocks_begin = picture->mbinfo.begin();
-                macroblocks_end = picture->mbinfo.end();
-                break;
-            case TOP_FIELD :
-                macroblocks_begin = picture->mbinfo.begin();
-                macroblocks_end = picture->mbinfo.begin() + picture->mbinfo.size()/2;
-                break;
-            case BOTTOM_FIELD :
-                macroblocks_begin = picture->mbinfo.begin() + picture->mbinfo.size()/2;
-                macroblocks_end = picture->mbinfo.end();
-                break;
-        }
-        
-        int macroblocks = macroblocks_end-macroblocks_begin;
-
-        vector<MacroBlock>::iterator stripe_begin;
-        vector<MacroBlock>::iterator stripe_end;
-        vector<MacroBlock>::iterator mbi;
-        int                          stripe_step;
-        
-        switch( job->pattern )
-        {
-            case EncoderJob::ENCODE_ORDER :
-                stripe_step = 1;
-                stripe_begin = macroblocks_begin + job->stripe* macroblocks/parallelism;
-                stripe_end = macroblocks_begin + (job->stripe+1)* macroblocks/parallelism;
-                break;
-            default :
-            case EncoderJob::INTERLEAVED :
-                stripe_step = parallelism;
-                stripe_begin = macroblocks_begin+job->stripe;
-                stripe_end = macroblocks_end;
-                break;
-        }
-        
-        for( mbi = stripe_begin; mbi < stripe_end; mbi += stripe_step )
-        {
-            (*mbi.*job->encodingFunc)();
-        }
-        mjpeg_debug( "Worker: stripe %d done", job->stripe );
-        job->working = false;
-    }
-}
-
-void Despatcher::Despatch(  Picture &picture,
-                            void (MacroBlock::*encodingFunc)(),
-                            EncoderJob::JobPattern pattern 
-                         )
-{
-    if( parallelism > 0 )
-    {
-        for( unsigned int stripe = 0; stripe < parallelism; ++stripe )
-        {
-            EncoderJob *job = &jobpool[stripe];
-            // We guanratee a previously despatched stripe has completed before it is redespatched
-            while( job->working )
-            {
-                jobstodo.WaitForNewConsumers();
-            }
-
-            job->working = true;
-            job->pattern = pattern;
-            job->encodingFunc = encodingFunc;
-            job->picture = &picture;
-            jobstodo.Put( job );
-        }
-    }
-    else
-    {
-        vector<MacroBlock>::iterator mbi;
-        for( mbi = picture.mbinfo.begin(); mbi < picture.mbinfo.end(); ++mbi )
-        {
-            (*mbi.*encodingFunc)();
-        }
-    }
-}
-
-void Despatcher::WaitForCompletion()
-{
-    //
-    // We know all despatched jobs have completed if the entire
-    // pool of worker threads is waiting on the job despatch
-    // channel
-    //
-    if( parallelism > 0 )
-    {
-        jobstodo.WaitUntilConsumersWaitingAtLeast( parallelism );
-    }
-}
-
-
-
-
+#include "despatcher.hh"
+#include "instrumentation.hh"
 
 
 // --------------------------------------------------------------------------------
@@ -321,7 +70,8 @@ SeqEncoder::SeqEncoder( EncoderParams &_encparams,
                         Quantizer &_quantizer,
                         ElemStrmWriter &_writer,
                         Pass1RateCtl    &_p1ratectl,
-                        Pass2RateCtl   &_p2ratectl
+                        Pass2RateCtl   &_p2ratectl,
+                        TransformBufferPool *_transform_pool
                        ) :
     encparams( _encparams ),
     reader( _reader ),
@@ -331,12 +81,19 @@ SeqEncoder::SeqEncoder( EncoderParams &_encparams,
     pass2ratectl( _p2ratectl ),
     p1_despatcher( *new Despatcher ),
     pass1_rcstate( pass1ratectl.NewState() ),
+    picture_pool( _encparams, _writer, _quantizer, _reader ),
+    transform_pool( _transform_pool != 0 
+                    ? *_transform_pool 
+                    : *new TransformBufferPool( _encparams ) ),
+    own_transform_pool( _transform_pool == 0 ),
     pass1_ss( _encparams, _reader )
 {
 }
 
 SeqEncoder::~SeqEncoder()
 {
+    if( own_transform_pool )
+        delete &transform_pool;
     delete &p1_despatcher;
 }
 
@@ -358,15 +115,14 @@ void SeqEncoder::Init()
     pass1ratectl.Init();
     pass2ratectl.Init();
     pass1_ss.Init(  );
+    pass1_ss_ahead = false;
+    pipelined_picture = 0;
     old_ref_picture = 0;
 
     // Lots of routines assume (for speed) that
     // a dummy ref picture is provided even if it is not needed
     // because the picture being encoded is  INTRA
-    new_ref_picture = GetFreshPicture();
-    free_pictures.push_back( new_ref_picture );
-
-    released_ref_frames = 0;
+    new_ref_picture = picture_pool.Get();
 }
 
 
@@ -383,7 +139,8 @@ void SeqEncoder::Init()
 
 
 void SeqEncoder::EncodePicture( Picture &picture,
-                                RateCtl &ratecontrol)
+                                RateCtl &ratecontrol,
+                                bool select_modes )
 {
     mjpeg_debug("Start  %d %c(%s) %d %d",
                 picture.decode, 
@@ -394,18 +151,48 @@ void SeqEncoder::EncodePicture( Picture &picture,
                 picture.temp_ref,
                 picture.present);
 
+    TransformPicture( picture, select_modes );
+    CodePicture( picture, ratecontrol );
+}
+
+/*
+ *
+ * The two halves of EncodePicture: the (parallel) motion compensated
+ * DCT of the picture's macroblocks and the (sequential) rate-controlled
+ * quantisation / coding and reconstruction.  They are split so that
+ * pass-1 can slip work on the next picture in between.
+ *
+ * Rate-distortion coding mode selection needs the prediction buffers
+ * and the rate control set up for the picture so it is done here,
+ * before the transform.  Only pass-1 encodings 'select_modes':
+ * re-encodings keep the modes pass-1 chose.
+ *
+ */
+
+void SeqEncoder::TransformPicture( Picture &picture, bool select_modes )
+{
+    picture.AttachTransformBuffers( transform_pool.Get() );
+    if( select_modes && encparams.rd_mode_cands > 1 
+        && picture.pict_type != I_TYPE )
+    {
+        p1_despatcher.Despatch( picture, &MacroBlock::SelectCodingModeRD );
+        p1_despatcher.WaitForCompletion();
+    }
     p1_despatcher.Despatch( picture, &MacroBlock::Encode );
     p1_despatcher.WaitForCompletion();
+}
 
+void SeqEncoder::CodePicture( Picture &picture, RateCtl &ratecontrol )
+{
     int padding_needed;
     picture.PutHeaders();
 
-    picture.QuantiseAndCode(ratecontrol);
+    picture.QuantiseAndCode(ratecontrol, p1_despatcher);
     ratecontrol.PictUpdate( picture, padding_needed);
     picture.PutTrailers(padding_needed);
 
     picture.Reconstruct();
-
+    transform_pool.Release( picture.DetachTransformBuffers() );
 }
 
 
@@ -449,7 +236,12 @@ void SeqEncoder::EncodeStreamOneStep()
 		// TODO Sequence splitting really needs to be done in pass-2
 		//  HOwever, the would entail changing GOP structure :-(
 		//  in <pass2-ratectl>::GopSetup....
-		pass1_ss.Next( BitsAfterMux() );
+        // N.b. if the next picture was pipelined the stream state
+        // has already been advanced.
+        if( pass1_ss_ahead )
+            pass1_ss_ahead = false;
+        else
+            pass1_ss.Next( BitsAfterMux() );
 	}
     
 	if( pass2queue.size() > 0 )
@@ -508,55 +300,6 @@ void SeqEncoder::EncodeStream()
 }
 
 
-Picture *SeqEncoder::GetFreshPicture()
-{
-    Picture *fresh;
-    if( free_pictures.size() == 0 )
-        fresh = new Picture(encparams,  writer , quantizer);
-    else
-    {
-        fresh = free_pictures.back();
-        free_pictures.pop_back();
-    }
-    return fresh;
-}
-
-
-void SeqEncoder::ReleasePicture( Picture *picture )
-{
-    // We don't want to free up Picture objects for re-use
-    // until we're sure the encoded picture can no longer
-    // be used as a referenced image when encoding later
-    // pictures.  So we queue possibly referenced Picture's
-    // until at least *2* newer reference Frame's have been
-    // released.
-
-    if( picture->FinalFieldOfRefFrame() )
-    {
-        ++released_ref_frames;
-        released_pictures.push_back( picture );
-        if( released_ref_frames > 2 )
-        {
-            Picture *nolonger_refd;
-            do
-            {
-                nolonger_refd = released_pictures.front();
-                released_pictures.pop_front();
-                if( nolonger_refd->finalfield )
-                    reader.ReleaseFrame( nolonger_refd->present );
-                free_pictures.push_back( nolonger_refd );
-            }
-            while( !nolonger_refd->FinalFieldOfRefFrame() );
-        }
-    }
-    else
-    {
-        released_pictures.push_back( picture );
-    }
-}
-
-
-
 /*
     Encode a picture from scratch: motion estimate relative to the reference
     frames (if any), encode the resulting macro  block image data
@@ -569,13 +312,13 @@ void SeqEncoder::Pass1EncodePicture(Picture &picture, int field)
     // requires a re-encoding.
     pass1_rcstate->Set( pass1ratectl.GetState() );
 
-    // Set up picture parameters
-    picture.SetFrameParams( pass1_ss, field );
-
-    // Motion estimation 
-    picture.MotionSubSampledLum();
+    // Set up picture parameters and start motion estimation unless
+    // this was already done while the previous picture was being coded.
+    if( &picture == pipelined_picture )
+        pipelined_picture = 0;
+    else
+        Pass1StartPicture( picture, field );
 
-    p1_despatcher.Despatch( picture, &MacroBlock::MotionEstimateAndModeSelect );
     p1_despatcher.WaitForCompletion();
 
 
@@ -586,15 +329,19 @@ void SeqEncoder::Pass1EncodePicture(Picture &picture, int field)
     // Setup rate control
     pass1ratectl.PictSetup(picture);
 
-    // Reconstruct, transform, and encode
-    EncodePicture( picture, pass1ratectl);
+    // Reconstruct, transform, and encode.  The worker threads would
+    // idle while we quantise and code so, where dependencies allow,
+    // we give them the next picture's motion estimation to do.
+    TransformPicture( picture, true );
+    Pass1PipelineNext( picture );
+    CodePicture( picture, pass1ratectl );
 
 
     mjpeg_info("Enc1  %5d %5d(%2d) %c q=%3.2f %s [%.0f%% Intra]",
                picture.decode, 
                picture.present,
                picture.temp_ref,
-               pict_type_char[pass1_ss.frame_type],
+               pict_type_char[picture.pict_type],
                picture.ABQ,
                picture.pad ? "PAD" : "   ",
                picture.IntraCodedBlocks() * 100.0
@@ -602,6 +349,55 @@ void SeqEncoder::Pass1EncodePicture(Picture &picture, int field)
             
 }
 
+/*
+    Set up a picture for pass-1 encoding and despatch its motion
+    estimation to the worker threads.  N.b. completion is *not*
+    waited for.
+*/
+
+void SeqEncoder::Pass1StartPicture( Picture &picture, int field )
+{
+    picture.SetFrameParams( pass1_ss, field );
+
+    // Motion estimation (N.b. the reader has already prepared the
+    // sub-sampled luminance)
+    p1_despatcher.Despatch( picture, &MacroBlock::MotionEstimateAndModeSelect );
+}
+
+/*
+    Frame-level pipelining: start the next picture's motion estimation
+    running on the worker threads while the current picture is
+    quantised and coded.
+
+    This is only safe if the next picture cannot reference the current
+    one.  B pictures are never referenced so after a B frame the next
+    picture (another B or the next I/P) only needs reference frames
+    that are already reconstructed.  Anything pass-2 might re-encode in
+    the meantime precedes these references in decode order so it is
+    untouched too.  For the same reason we don't pipeline across
+    sequence ends (pass-2 flushes everything) or field pictures.
+
+    Because pass-1 never commits coded output the stream state advanced
+    here is exactly what EncodeStreamOneStep would have produced.
+*/
+
+void SeqEncoder::Pass1PipelineNext( Picture &picture )
+{
+    if( encparams.encoding_parallelism == 0 
+        || encparams.fieldpic 
+        || picture.pict_type != B_TYPE
+        || picture.end_seq )
+        return;
+
+    pass1_ss.Next( BitsAfterMux() );
+    pass1_ss_ahead = true;
+    if( pass1_ss.EndOfStream() )
+        return;
+
+    pipelined_picture = NextFramePicture0();
+    Pass1StartPicture( *pipelined_picture, 0 );
+}
+
 /*
     Re-Encode a picture after type or parameters have been revised
     from scratch.
@@ -639,7 +435,7 @@ void SeqEncoder::Pass1ReEncodePicture0(Picture &picture, void (MacroBlock::*mode
 
     // We need to re-run motion estimation here as we may have changed the
     // GOP structure
-    EncodePicture( picture, pass1ratectl);
+    EncodePicture( picture, pass1ratectl, true );
     mjpeg_info("Renc1 %5d %5d(%2d) %c q=%3.2f %s",
                picture.decode, 
                picture.present,
@@ -659,40 +455,42 @@ Picture *SeqEncoder::NextFramePicture0()
 
     if ( pass1_ss.b_idx == 0 ) // I or P Frame (First frame in B-group)
     {
+        if( old_ref_picture != 0 )
+            picture_pool.Release( old_ref_picture );
         old_ref_picture = new_ref_picture;
-        new_ref_picture = frame_pic = GetFreshPicture();
+        new_ref_picture = frame_pic = picture_pool.Get();
+        picture_pool.Retain( new_ref_picture );
         frame_pic->fwd_org = old_ref_picture->org_img;
         frame_pic->fwd_rec = old_ref_picture->rec_img;
-        frame_pic->fwd_ref_frame = old_ref_picture;
-        frame_pic->bwd_ref_frame = 0;
+        picture_pool.SetReferences( *frame_pic, old_ref_picture, 0 );
     }
     else // B Frame
     {
-        frame_pic = GetFreshPicture();
+        frame_pic = picture_pool.Get();
         frame_pic->fwd_org = old_ref_picture->org_img;
         frame_pic->fwd_rec = old_ref_picture->rec_img;
         frame_pic->bwd_org = new_ref_picture->org_img;
         frame_pic->bwd_rec = new_ref_picture->rec_img;
-        frame_pic->fwd_ref_frame = old_ref_picture;
-        frame_pic->bwd_ref_frame = new_ref_picture;
+        picture_pool.SetReferences( *frame_pic, old_ref_picture, new_ref_picture );
     }
 
    // Frames are presented at input in playback (presentation) order
-    frame_pic->org_img = reader.ReadFrame( pass1_ss.PresentationNum() );
+    picture_pool.SetOrgFrame( *frame_pic, pass1_ss.PresentationNum() );
     return frame_pic;
 }
 
 Picture *SeqEncoder::NextFramePicture1(Picture *frame_pic0)
 {
   Picture *frame_pic1;
-  frame_pic1 = GetFreshPicture();
+  frame_pic1 = picture_pool.Get();
   frame_pic1->fwd_org = frame_pic0->fwd_org;
   frame_pic1->fwd_rec = frame_pic0->fwd_rec;
   frame_pic1->bwd_org = frame_pic0->bwd_org;
   frame_pic1->bwd_rec = frame_pic0->bwd_rec;
-  frame_pic1->fwd_ref_frame = frame_pic0->fwd_ref_frame;
-  frame_pic1->bwd_ref_frame = frame_pic0->bwd_ref_frame;
-  frame_pic1->org_img = frame_pic0->org_img;
+  picture_pool.SetReferences( *frame_pic1, 
+                              frame_pic0->fwd_ref_frame,
+                              frame_pic0->bwd_ref_frame );
+  picture_pool.SetOrgFrame( *frame_pic1, frame_pic0->org_frame );
   return frame_pic1;
 }
 
@@ -724,7 +522,7 @@ void SeqEncoder::Pass1GopSplitting( Picture &picture)
             mjpeg_debug( "GOP split forces P-frames only... %.0f%% intra coded", 
                         picture.IntraCodedBlocks() * 100.0 );
             pass1_ss.SuppressBFrames();
-            picture.org_img = reader.ReadFrame( pass1_ss.PresentationNum() );
+            picture_pool.SetOrgFrame( picture, pass1_ss.PresentationNum() );
             Pass1ReEncodePicture0( picture,  &MacroBlock::MotionEstimateAndModeSelect );
         }
     }
@@ -751,9 +549,16 @@ void SeqEncoder::Pass1GopSplitting( Picture &picture)
 void SeqEncoder::Pass1Process()
 {
     Picture *frame_pic[2], *last_pic;
-    frame_pic[0] = NextFramePicture0();
+    if( pipelined_picture != 0 )
+        frame_pic[0] = pipelined_picture;
+    else
+        frame_pic[0] = NextFramePicture0();
     Pass1EncodePicture( *frame_pic[0], 0 );
-    Pass1GopSplitting( *frame_pic[0] );
+    // N.b. only B frames are pipelined and these can't be GOP split
+    // points.  Once pass1_ss has moved on it no longer describes this
+    // picture anyway.
+    if( !pass1_ss_ahead )
+        Pass1GopSplitting( *frame_pic[0] );
     pass1coded.push_back( frame_pic[0] );
 
     if( encparams.fieldpic )
@@ -779,7 +584,7 @@ void SeqEncoder::Pass1Process()
         // If end of sequence we flush everything as next GOP won't refer to this frame
         to_queue = pass1coded.size();
     }
-    else if( pass1_ss.b_idx == 0  )    // I or P Frame (First frame in B-group)
+    else if( !pass1_ss_ahead && pass1_ss.b_idx == 0  )    // I or P Frame (First frame in B-group)
     {
         // We have a new fwd reference picture: anything decoded before
         // will no longer be referenced and can be passed on.
@@ -851,7 +656,7 @@ bool SeqEncoder::Pass2EncodePicture(Picture &picture, bool force_reencode)
       // We retain the motion estimation / compensation from pass-1
       // N.b. prediction is still required as the reference images may
       // have been re-coded!
-      EncodePicture( picture, pass2ratectl);
+      EncodePicture( picture, pass2ratectl, false );
     }
     else
     {
@@ -916,9 +721,20 @@ void SeqEncoder::Pass2Process()
         Picture *pic = pass2queue.front();
         bool reencoded = Pass2EncodePicture( *pic, reference_reencoded );
         reference_reencoded |= reencoded && pic->pict_type != B_TYPE;
+        // N.b. the coding is gone once committed
+        if( encparams.instrumentation != 0 )
+            encparams.instrumentation->PictureCoded( *pic );
+        if( encparams.snr_totals != 0 )
+            encparams.snr_totals->Add( *pic );
         pic->CommitCoding();
+        if( encparams.instrumentation != 0
+            && encparams.instrumentation->FlushDue() )
+        {
+            p1_despatcher.ReportUtilisation( *encparams.instrumentation );
+            encparams.instrumentation->Flush();
+        }
 
-        ReleasePicture( pic );
+        picture_pool.Retire( pic );
         pass2queue.pop_front();
     }
 }
@@ -929,16 +745,24 @@ void SeqEncoder::StreamEnd()
     mjpeg_info( "Parameters for 2nd pass (stream frames, stream frames): -L %u -Z %.0f",
     		     pass2ratectl.getEncodedFrames(), pass2ratectl.getStreamComplexity() );
     mjpeg_info( "Guesstimated final muxed size = %lld\n", bits_after_mux/8 );
-    
-    unsigned int i;
-    for( i = 0; i < free_pictures.size(); ++i )
-    {
-        delete free_pictures[i];
-    }
-    for( i = 0; i < released_pictures.size(); ++i )
+    p1_despatcher.WaitForCompletion();
+    p1_despatcher.ReportUtilisation();
+    if( encparams.instrumentation != 0 )
     {
-        delete released_pictures[i];
+        p1_despatcher.ReportUtilisation( *encparams.instrumentation );
+        encparams.instrumentation->Flush();
     }
+    reader.ReportReadAhead();
+
+    // Drop pass-1's hold on its reference pictures: everything can
+    // now be recycled (the Picture's themselves go with the pool).
+    if( old_ref_picture != 0 )
+        picture_pool.Release( old_ref_picture );
+    picture_pool.Release( new_ref_picture );
+    old_ref_picture = new_ref_picture = 0;
+    picture_pool.Report( transform_pool );
+    if( own_transform_pool )
+        transform_pool.Report();
 }
 
 
@@ -24,6 +24,7 @@
 #include <deque>
 #include "mjpeg_types.h"
 #include "picture.hh"
+#include "picturepool.hh"
 #include "streamstate.h"
 
 class MPEG2Encoder;
@@ -43,7 +44,8 @@ public:
                 Quantizer &quantizer,
                 ElemStrmWriter &writer,
                 Pass1RateCtl   &pass1ratectl,
-                Pass2RateCtl   &pass2ratectl
+                Pass2RateCtl   &pass2ratectl,
+                TransformBufferPool *transform_pool = 0
         );
 	~SeqEncoder();
 
@@ -100,16 +102,6 @@ public:
         
 private:
 
-     /*********************************
-     *
-     * Manage Picture's - they're expensive-ish to allocate so
-     * we maintained a stack already allocated but unused objects.
-     *
-     *********************************/
-     
-    Picture *GetFreshPicture();
-    void ReleasePicture( Picture *);
-      
     /**********************************
      *
      * Pass1Process - Unit of pass-1 processing work
@@ -134,10 +126,14 @@ private:
 
     Picture *NextFramePicture0();
     Picture *NextFramePicture1(Picture *picture0);
-    void EncodePicture( Picture &picture, RateCtl &ratectl);
+    void EncodePicture( Picture &picture, RateCtl &ratectl, bool select_modes );
+    void TransformPicture( Picture &picture, bool select_modes );
+    void CodePicture( Picture &picture, RateCtl &ratectl );
     void RetainPicture( Picture &picture, RateCtl &ratectl);
 
     void Pass1GopSplitting( Picture &picture);
+    void Pass1StartPicture( Picture &picture, int field );
+    void Pass1PipelineNext( Picture &picture );
     void Pass1EncodePicture( Picture &picture, int field );
     void Pass1ReEncodePicture0( Picture &picture, void (MacroBlock::*modeMotionAdjustFunc)() );
     bool Pass2EncodePicture( Picture &picture, bool force_reencode );
@@ -169,27 +165,28 @@ private:
     // Queue of Picture's (in decode order) committed for pass2 encoding
     std::deque<Picture*> pass2queue;
 
-    // Picture objects no longer being encoded (signalled by
-    // a called to 'ReleasePicture') but potentially still
-    // referenced by other Picture's and hence not (yet) free
-    // for re-use or destruction.
-
-    std::deque<Picture*> released_pictures;
-
-    // Reference frames all of whose field Picture's have been released
-    // ... needed to maintain released_pictures queue.
-    int released_ref_frames;
-
-    // Picture objects free for re-use.
-    std::vector<Picture *> free_pictures;
-    
+    // Picture's are expensive-ish to allocate so they are recycled
+    // through a pool as soon as they are no longer referenced.  Their
+    // transform buffers are only needed while they are being encoded
+    // so these come from a pool of their own (which may be shared
+    // with other SeqEncoder's).
+    PicturePool picture_pool;
+    TransformBufferPool &transform_pool;
+    bool own_transform_pool;
     
 	// Internal state of encoding...
 	StreamState pass1_ss;
 
-    // Reference pictures in pass-1
+    // Reference pictures in pass-1 (we hold a reference to each)
 	Picture *new_ref_picture, *old_ref_picture;
 
+    // Frame pipelining: picture whose pass-1 motion estimation was
+    // started while its predecessor was being coded.  If
+    // pass1_ss_ahead is set pass1_ss already describes the
+    // following picture (even if there was none to start).
+    Picture *pipelined_picture;
+    bool pass1_ss_ahead;
+
 };
 
 
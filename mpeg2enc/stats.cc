@@ -50,83 +50,74 @@
 #include <stdio.h>
 #include <math.h>
 #include "picture.hh"
+#include "imageplanes.hh"
 
-#ifdef OUTPUT_STAT
-static void calcSNR1(org,rec,lx,w,h,pv,pe)
-unsigned char *org;
-unsigned char *rec;
-int lx,w,h;
-double *pv,*pe;
-{
-  int i, j;
-  double v1, s1, s2, e2;
+/*
+ * Sum of the squared differences of a w*h area of two images with
+ * rows lx apart.
+ */
 
-  s1 = s2 = e2 = 0.0;
+static double SqrError( const uint8_t *org, const uint8_t *rec,
+                        int lx, int w, int h )
+{
+    int i, j, d;
+    uint64_t e2 = 0;
 
-  for (j=0; j<h; j++)
-  {
-    for (i=0; i<w; i++)
+    for (j=0; j<h; j++)
     {
-      v1 = org[i];
-      s1+= v1;
-      s2+= v1*v1;
-      v1-= rec[i];
-      e2+= v1*v1;
+        for (i=0; i<w; i++)
+        {
+            d = org[i] - rec[i];
+            e2 += d*d;
+        }
+        org += lx;
+        rec += lx;
     }
-    org += lx;
-    rec += lx;
-  }
-
-  s1 /= w*h;
-  s2 /= w*h;
-  e2 /= w*h;
-
-  /* prevent division by zero in calcSNR() */
-  if(e2==0.0)
-    e2 = 0.00001;
-
-  *pv = s2 - s1*s1; /* variance */
-  *pe = e2;         /* MSE */
+    return static_cast<double>(e2);
 }
 
-#endif
+/*
+ * CalcSNR - Squared error of the reconstructed picture against the
+ * original for each component (the displayed area only).  Needed for
+ * encparams.snr_totals (or the statistics file).
+ */
 
 void Picture::CalcSNR()
 {
+#ifndef OUTPUT_STAT
+    if( encparams.snr_totals == 0 )
+        return;
+#endif
+    int w = encparams.horizontal_size;
+    int h = pict_struct == FRAME_PICTURE
+        ? encparams.vertical_size : encparams.vertical_size >> 1;
+    int lx = pict_struct == FRAME_PICTURE
+        ? encparams.phy_width : encparams.phy_width << 1;
+    int offs = pict_struct == BOTTOM_FIELD ? encparams.phy_width : 0;
+
+    for( int c = 0; c < 3; ++c )
+    {
+        if( c == 1 )            // 4:2:0 chrominance
+        {
+            w >>= 1;
+            h >>= 1;
+            lx = pict_struct == FRAME_PICTURE
+                ? encparams.phy_chrom_width : encparams.phy_chrom_width << 1;
+            offs = pict_struct == BOTTOM_FIELD ? encparams.phy_chrom_width : 0;
+        }
+        sqr_err[c] = SqrError( org_img->Plane(c) + offs,
+                               rec_img->Plane(c) + offs, lx, w, h );
+        snr_pels[c] = w * h;
+    }
 
 #ifdef OUTPUT_STAT
-	uint8_t **org = curorg;
-	uint8_t **rec = curref;
-	int w,h,offs;
-	double v,e;
-
-
-  w = horizontal_size;
-  h = (cur_picture.pict_struct==FRAME_PICTURE) ? vertical_size : (vertical_size>>1);
-  offs = (cur_picture.pict_struct==BOTTOM_FIELD) ? width : 0;
-
-  calcSNR1(org[0]+offs,rec[0]+offs,width2,w,h,&v,&e);
-  fprintf(statfile,"Y: variance=%4.4g, MSE=%3.3g (%3.3g dB), SNR=%3.3g dB\n",
-    v, e, 10.0*log10(255.0*255.0/e), 10.0*log10(v/e));
-    
-  if (chroma_format!=CHROMA444)
-  {
-    w >>= 1;
-    offs >>= 1;
-  }
-
-  if (chroma_format==CHROMA420)
-    h >>= 1;
-
-  calcSNR1(org[1]+offs,rec[1]+offs,chrom_width2,w,h,&v,&e);
-  fprintf(statfile,"U: variance=%4.4g, MSE=%3.3g (%3.3g dB), SNR=%3.3g dB\n",
-    v, e, 10.0*log10(255.0*255.0/e), 10.0*log10(v/e));
-
-  calcSNR1(org[2]+offs,rec[2]+offs,chrom_width2,w,h,&v,&e);
-  fprintf(statfile,"V: variance=%4.4g, MSE=%3.3g (%3.3g dB), SNR=%3.3g dB\n",
-    v, e, 10.0*log10(255.0*255.0/e), 10.0*log10(v/e));
-    
-  
+    static const char comp_names[3] = { 'Y', 'U', 'V' };
+    for( int c = 0; c < 3; ++c )
+    {
+        double e = sqr_err[c] / snr_pels[c];
+        fprintf(statfile,"%c: MSE=%3.3g (%3.3g dB)\n", comp_names[c],
+                e, 10.0*log10(255.0*255.0/(e > 0.0 ? e : 0.00001)));
+    }
 #endif
 }
 
@@ -34,7 +34,8 @@
 
 StreamState::StreamState( EncoderParams &_encparams, PictureReader &_reader ) :
     encparams(_encparams),
-    reader(_reader)
+    reader(_reader),
+    lookahead(_encparams, _reader)
 {
 }
 
@@ -43,6 +44,7 @@ void StreamState::Init(  )
     seq_split_length = ((int64_t)encparams.seq_length_limit)*(8*1024*1024);
     next_split_point = BITCOUNT_OFFSET + seq_split_length;
     mjpeg_debug( "Split len = %lld", seq_split_length );
+    lookahead.Init();
 
     frame_num = 0;          // All these counters in *encoding* order !!
     s_idx = 0;
@@ -62,7 +64,9 @@ void StreamState::Init(  )
 
 bool StreamState::NextGopClosed() const 
 { 
-    return gop_end_seq || encparams.closed_GOPs || gop_start_frame + gop_length == GetNextChapter();
+    return gop_end_seq || encparams.closed_GOPs
+        || gop_start_frame + gop_length == GetNextChapter()
+        || lookahead.SceneCut( gop_start_frame + gop_length );
 }
 
 int StreamState::GetNextChapter() const
@@ -92,14 +96,83 @@ bool StreamState::CanSplitHere(int offset) const
     if( nc_distance < 0 || g_idx+offset < encparams.N_min)
         return false;
 
-    // Check that legal GOP sizes allow the the next chapter point to
-    // be hit exactly.  If it is between x and x+1 minimum GOPs away
-    // it must be x or less maximum gops away as only then can a mixture
-    // of gops sized somewhere between minimum and maximum sizes reach it
-    // exactly.
+    return Reachable( nc_distance );
+}
+
+/*
+    Check that legal GOP sizes allow a frame distance away to be
+    hit exactly by a GOP start.  If it is between x and x+1 minimum
+    GOPs away it must be x or less maximum gops away as only then can
+    a mixture of gops sized somewhere between minimum and maximum
+    sizes reach it exactly.
+*/
+
+bool StreamState::Reachable( int distance ) const
+{
     // Division must occur first; rounding down is relied upon!
-    return nc_distance <= (nc_distance/encparams.N_min) * encparams.N_max;
+    int n_min = encparams.N_min;
+    int n_max = encparams.N_max;
+    return distance <= (distance/n_min) * n_max;
+}
+
+/*
+    Choose the length of the GOP being started so that a following
+    GOP can start exactly on the first upcoming scene cut the lookahead
+    has found that legal GOP sizes (and chapter points) let us hit.
+    That GOP is closed so the cut is its I frame.
+
+    RETURN: chosen GOP length, default_length if no cut can be hit.
+*/
+
+int StreamState::SceneCutGopLength( int default_length )
+{
+    int n_min = encparams.N_min;
+    int n_max = encparams.N_max;
+    int upto = frame_num+encparams.lookahead_frames;
+    lookahead.ScanUpto( upto );
+    int cut = frame_num+n_min;
+    while( (cut = lookahead.NextSceneCut( cut, upto )) >= 0 )
+    {
+        int distance = cut-frame_num;
+        int length;
+        for( length = std::min( distance, n_max ); length >= n_min; --length )
+        {
+            if( CanSplitHere(length) && Reachable(distance-length) )
+                return length;
+        }
+        ++cut;
+    }
+    return default_length;
+}
+
+
+/*
+    Choose the length of each B frame group of the GOP being started
+    from lookahead inter/intra cost estimates.  The groups of a
+    closed GOP follow its initial I frame.  The first group of an open
+    GOP ends with the I frame and follows the final I/P frame of the
+    previous GOP.
+*/
+
+void StreamState::PlanBGroups()
+{
+    int planned = closed_gop ? 1 : 0;
+    int ref = gop_start_frame+planned-1;
+    while( planned < gop_length )
+    {
+        int length = lookahead.BGroupLength( ref,
+                                             std::min( encparams.M, gop_length-planned ) );
+        bgroup_plan.push_back( length );
+        planned += length;
+        ref += length;
+    }
 
+    np = bgroup_plan.size() - (closed_gop ? 0 : 1);
+    nb = gop_length - np - 1;
+    bs_short = 0;
+    if( !closed_gop )
+        bigrp_length = bgroup_plan[next_bgroup++];
+    mjpeg_debug( "B groups planned: %d P %d B", np, nb );
 }
 
 
@@ -119,9 +192,12 @@ void StreamState::Next(  uint64_t bits_after_mux )   // Estimate of how much out
     if( b_idx >= bigrp_length )
     {
         b_idx = 0;
-        /* Does this need to be a short B group to make the GOP length
+        /* Use the planned B group length if there is one.  Otherwise
+           does this need to be a short B group to make the GOP length
            come out right ? */
-        if( bs_short != 0 && g_idx > (int)next_b_drop )
+        if( !suppress_b_frames && next_bgroup < bgroup_plan.size() )
+            bigrp_length = bgroup_plan[next_bgroup++];
+        else if( bs_short != 0 && g_idx > (int)next_b_drop )
         {
             if( bs_short )
                 next_b_drop += ((double)gop_length) / (double)(bs_short+1) ;
@@ -200,6 +276,8 @@ void StreamState::SetTempRef()
 
     int read_ahead_frame = frame_num+encparams.M;
     reader.FillBufferUpto( read_ahead_frame  );
+    if( encparams.lookahead_frames > 0 )
+        lookahead.ScanUpto( frame_num+encparams.lookahead_frames );
     int last_frame = reader.NumberOfFrames()-1;
     if( frame_type == B_TYPE )
         temp_ref =  g_idx - 1;
@@ -261,6 +339,13 @@ void StreamState::GopStart(  )
         if( CanSplitHere(gop_length) )
             break;
 
+    //
+    // ... and if we can see an upcoming scene cut aim for that too.
+    //
+
+    if( encparams.lookahead_frames > 0 )
+        gop_length = SceneCutGopLength( gop_length );
+
     mjpeg_info( "NEW GOP INIT length %d", gop_length );
     /* First figure out how many B frames we're short from
        being able to achieve an even M-1 B's per I/P frame.
@@ -300,6 +385,13 @@ void StreamState::GopStart(  )
     /* number of B frames */
     nb = gop_length - np - 1;
 
+    /* If the lookahead covers the GOP replace all this with B frame
+       groups chosen to suit the material */
+    bgroup_plan.clear();
+    next_bgroup = 0;
+    if( encparams.adaptive_bgroups && gop_length <= encparams.lookahead_frames )
+        PlanBGroups();
+
     //np = np;
     //nb = nb;
     if( np+nb+1 != gop_length )
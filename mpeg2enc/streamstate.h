@@ -21,7 +21,9 @@
  *
  */
  
+ #include <vector>
  #include "mjpeg_types.h"
+ #include "lookahead.hh"
  
 /************************************************
  *
@@ -60,6 +62,9 @@ protected:
     void SetTempRef();
 
     int GetNextChapter() const;
+    bool Reachable( int distance ) const;
+    int SceneCutGopLength( int default_length );
+    void PlanBGroups();
 
 public:
     // Conext of current frame in hierarchy of structures: sequence, GOP, B-group */
@@ -85,6 +90,9 @@ public:
     int np;                        /* P frames in current GOP */
     int nb;                        /* B frames in current GOP */
     double next_b_drop;         /* When next B frame drop is due in GOP */
+    std::vector<int> bgroup_plan;   /* Adaptive B frame group lengths of
+                                       current GOP (empty if not adaptive) */
+    unsigned int next_bgroup;   /* Index in bgroup_plan of next B group */
     bool closed_gop;            /* Current GOP is closed */
 
     // Sequence splitting state
@@ -98,6 +106,7 @@ private:
     uint64_t seq_split_length;
     EncoderParams &encparams;
     PictureReader &reader;
+    Lookahead lookahead;            // Scene cuts ahead of current frame
 };
 
 #endif
@@ -101,8 +101,8 @@ void MacroBlock::Transform()
 		}
 
 		psub_pred(pred[cc]+offs,cur[cc]+offs,lx, dctblocks[n]);
-		pfdct(dctblocks[n]);
 	}
+	pfdct_blocks(dctblocks[0], BLOCK_COUNT);
 		
 }
 
@@ -127,6 +127,7 @@ void MacroBlock::ITransform()
 	int i = TopleftX();
 	int j = TopleftY();
 			
+	pidct_blocks(qdctblocks[0], BLOCK_COUNT);
 	for (n=0; n<BLOCK_COUNT; n++)
 	{
 		cc = (n<4) ? 0 : (n&1)+1; /* color component index */
@@ -177,7 +178,6 @@ void MacroBlock::ITransform()
 			if (picture->pict_struct==BOTTOM_FIELD)
 				offs +=  picture->encparams.phy_chrom_width;
 		}
-		pidct(qdctblocks[n]);
 		padd_pred(pred[cc]+offs,cur[cc]+offs,lx,qdctblocks[n]);
 	}
 }
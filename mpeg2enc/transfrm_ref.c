@@ -82,6 +82,8 @@ void init_idct (void);
 
 void (*pfdct)( int16_t * blk );
 void (*pidct)( int16_t * blk );
+void (*pfdct_blocks)( int16_t * blks, int count );
+void (*pidct_blocks)( int16_t * blks, int count );
 void (*padd_pred) (uint8_t *pred, uint8_t *cur,
 				   int lx, int16_t *blk);
 void (*psub_pred) (uint8_t *pred, uint8_t *cur,
@@ -142,6 +144,23 @@ int field_dct_best( uint8_t *cur_lum_mb, uint8_t *pred_lum_mb,
 
 
 
+/* Transform consecutive blocks using the selected single block routines */
+
+void fdct_blocks( int16_t *blks, int count )
+{
+	int i;
+	for (i=0; i<count; i++)
+		pfdct(blks+64*i);
+}
+
+void idct_blocks( int16_t *blks, int count )
+{
+	int i;
+	for (i=0; i<count; i++)
+		pidct(blks+64*i);
+}
+
+
 /* add prediction and prediction error, saturate to 0...255 */
 
 void add_pred(uint8_t *pred, uint8_t *cur,
@@ -193,6 +212,8 @@ void init_transform(void)
 	flags = cpu_accel();
 	pfdct = fdct_ref;
 	pidct = idct_ref;
+	pfdct_blocks = fdct_blocks;
+	pidct_blocks = idct_blocks;
 	padd_pred = add_pred;
 	psub_pred = sub_pred;
 	pfield_dct_best = field_dct_best;
@@ -61,6 +61,9 @@ extern "C" {
 
 extern void (*pfdct)( int16_t * blk );
 extern void (*pidct)( int16_t * blk );
+/* Transform count consecutive blocks */
+extern void (*pfdct_blocks)( int16_t * blks, int count );
+extern void (*pidct_blocks)( int16_t * blks, int count );
 extern void (*padd_pred) (uint8_t *pred, uint8_t *cur,
 				   int lx, int16_t *blk);
 extern void (*psub_pred) (uint8_t *pred, uint8_t *cur,
@@ -80,9 +83,23 @@ void init_transform(void);
 
 void fdct( int16_t *blk );
 void idct( int16_t *blk );
+void fdct_blocks( int16_t *blks, int count );
+void idct_blocks( int16_t *blks, int count );
 void init_fdct (void);
 void init_idct (void);
 
+/*
+  Precision of the integer fdct (see fdct.c), which its SIMD versions
+  reproduce exactly.
+ */
+
+#define FDCT_ROW_BITS  15
+#define FDCT_FRAC_BITS 5
+#define FDCT_COL_BITS  14
+
+extern const int16_t fdct_row_coeffs[8][8];
+extern const int16_t fdct_col_coeffs[8][8];
+
 #ifdef  __cplusplus
 }
 #endif
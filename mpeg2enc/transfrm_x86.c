@@ -27,6 +27,7 @@
 #include "mjpeg_logging.h"
 #include "mmx.h"
 #include "simd.h"
+#include "dct_sse2.h"
 
 
 /* Routines written in assembler */
@@ -293,5 +294,29 @@ void init_x86_transform()
 
         }
 
+#ifdef HAVE_DCT_SSE2
+        /* More accurate (IEEE-1180 compliant) than the MMX/SSE
+           transforms and faster too */
+        if( flags & ACCEL_X86_SSE2 ) {
+            init_dct_sse2();
+            if( !d_quant_fdct ) {
+                pfdct = fdct_sse2;
+                pfdct_blocks = fdct_blocks_sse2;
+            }
+            if( !d_quant_idct ) {
+                pidct = idct_sse2;
+                pidct_blocks = idct_blocks_sse2;
+            }
+            opt_type1 = "SSE2, SSE and ";
+            if( flags & ACCEL_X86_AVX2 ) {
+                if( !d_quant_fdct )
+                    pfdct_blocks = fdct_blocks_avx2;
+                if( !d_quant_idct )
+                    pidct_blocks = idct_blocks_avx2;
+                opt_type1 = "AVX2, SSE2, SSE and ";
+            }
+        }
+#endif
+
 	mjpeg_info( "SETTING %sMMX for TRANSFORM!",opt_type1);
 }
@@ -0,0 +1,393 @@
+/*
+ *  verify_dct.c:  Check the integer fdct (fdct.c) and idct (idct.c)
+ *  meet the IEEE-1180 accuracy limits and that the SIMD versions the
+ *  CPU supports (dct_sse2.c) give results *identical* to them, on
+ *  random and worst case inputs.  Run by "make check".
+ *
+ *  The accuracy test follows IEEE Std 1180-1990: blocks of random
+ *  pels in [-L,H], their double precision fdct rounded and clipped
+ *  to 12 bits as the idct input and its double precision idct
+ *  rounded and clipped to 9 bits as the reference output.  The same
+ *  limits are applied to the fdct against the double precision fdct,
+ *  except that a coefficient whose exact value is a rounding tie may be
+ *  rounded either way (which way the reference goes is down to
+ *  floating point noise).
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "mjpeg_types.h"
+#include "mjpeg_logging.h"
+#include "cpu_accel.h"
+#include "transfrm_ref.h"
+#include "dct_sse2.h"
+
+#define ACCURACY_BLOCKS 10000
+#define EXACT_BLOCKS 100000
+
+/* IEEE-1180 limits */
+#define PEAK_ERROR      1
+#define PEL_MSE         0.06
+#define OVERALL_MSE     0.02
+#define PEL_MEAN        0.015
+#define OVERALL_MEAN    0.0015
+
+typedef void (*blocks_fn)( int16_t *blks, int count );
+
+/*
+ * The random number generator of the IEEE-1180 test (ieeetest.c by
+ * Tom Lane, released to public domain 11/22/93): uniform in [-L,H].
+ */
+
+static long randx;
+
+static long ieee_rand( long L, long H )
+{
+    static double z = (double) 0x7fffffff;
+    long i, j;
+    double x;
+
+    randx = (randx * 1103515245) + 12345;
+    i = randx & 0x7ffffffe;
+    x = ((double) i) / z;
+    x *= (L+H+1);
+    j = x;
+    return j-L;
+}
+
+/* coslu[a][b] = C(b)/2 * cos[(2a+1)b*pi/16] */
+
+static double coslu[8][8];
+
+static void init_coslu( void )
+{
+    int a, b;
+    for( a = 0; a < 8; ++a )
+        for( b = 0; b < 8; ++b )
+        {
+            double tmp = cos( (double)((a+a+1)*b) * (M_PI / 16.0) );
+            if( b == 0 )
+                tmp /= sqrt(2.0);
+            coslu[a][b] = tmp * 0.5;
+        }
+}
+
+static void fdct_double( const int16_t *blk, double *res )
+{
+    int x, y, u, v;
+    for( v = 0; v < 8; ++v )
+        for( u = 0; u < 8; ++u )
+        {
+            double tmp = 0.0;
+            for( y = 0; y < 8; ++y )
+            {
+                double tmp2 = 0.0;
+                for( x = 0; x < 8; ++x )
+                    tmp2 += blk[y*8+x] * coslu[x][u];
+                tmp += coslu[y][v] * tmp2;
+            }
+            res[v*8+u] = tmp;
+        }
+}
+
+static void idct_double( const int16_t *blk, double *res )
+{
+    int x, y, u, v;
+    for( y = 0; y < 8; ++y )
+        for( x = 0; x < 8; ++x )
+        {
+            double tmp = 0.0;
+            for( v = 0; v < 8; ++v )
+            {
+                double tmp2 = 0.0;
+                for( u = 0; u < 8; ++u )
+                    tmp2 += blk[v*8+u] * coslu[x][u];
+                tmp += coslu[y][v] * tmp2;
+            }
+            res[y*8+x] = tmp;
+        }
+}
+
+/* Round half away from zero and clip */
+
+static int16_t round_clip( double x, int lo, int hi )
+{
+    int r = x < 0.0 ? -(int)(0.5 - x) : (int)(x + 0.5);
+    return r < lo ? lo : (r > hi ? hi : r);
+}
+
+static int is_tie( double x )
+{
+    x = fabs(x);
+    return fabs( x - floor(x) - 0.5 ) < 1.0e-6;
+}
+
+/*
+ * IEEE-1180 accuracy of the (single block) transform tst.
+ */
+
+static int check_accuracy( const char *name, void (*tst)( int16_t *blk ),
+                           int forward )
+{
+    static const int ranges[3][2] = { {256, 255}, {5, 5}, {300, 300} };
+    int failed = 0;
+    int r, sign, n, i;
+
+    for( r = 0; r < 3; ++r )
+        for( sign = 1; sign >= -1; sign -= 2 )
+        {
+            long err_sum[64], err_sq[64];
+            int peak = 0;
+            double pel_mean = 0.0, pel_mse = 0.0;
+            double mean = 0.0, mse = 0.0;
+
+            memset( err_sum, 0, sizeof(err_sum) );
+            memset( err_sq, 0, sizeof(err_sq) );
+            randx = 1;
+            for( n = 0; n < ACCURACY_BLOCKS; ++n )
+            {
+                int16_t in[64], ref[64], out[64];
+                double res[64];
+                int ties[64];
+
+                for( i = 0; i < 64; ++i )
+                    in[i] = sign * ieee_rand( ranges[r][0], ranges[r][1] );
+                fdct_double( in, res );
+                if( forward )
+                {
+                    for( i = 0; i < 64; ++i )
+                    {
+                        ref[i] = round_clip( res[i], -32768, 32767 );
+                        ties[i] = is_tie( res[i] );
+                    }
+                }
+                else
+                {
+                    for( i = 0; i < 64; ++i )
+                        in[i] = round_clip( res[i], -2048, 2047 );
+                    idct_double( in, res );
+                    for( i = 0; i < 64; ++i )
+                    {
+                        ref[i] = round_clip( res[i], -256, 255 );
+                        ties[i] = 0;
+                    }
+                }
+                memcpy( out, in, sizeof(out) );
+                (*tst)( out );
+                for( i = 0; i < 64; ++i )
+                {
+                    int err = out[i] - ref[i];
+                    if( ties[i] && abs(err) == 1 )
+                        err = 0;
+                    if( abs(err) > peak )
+                        peak = abs(err);
+                    err_sum[i] += err;
+                    err_sq[i] += err*err;
+                }
+            }
+
+            for( i = 0; i < 64; ++i )
+            {
+                double m = (double)err_sum[i] / ACCURACY_BLOCKS;
+                double s = (double)err_sq[i] / ACCURACY_BLOCKS;
+                if( fabs(m) > pel_mean )
+                    pel_mean = fabs(m);
+                if( s > pel_mse )
+                    pel_mse = s;
+                mean += m / 64.0;
+                mse += s / 64.0;
+            }
+            mjpeg_info( "%s [%d,%d]%s: peak %d, pel mse %.4f, mse %.4f, pel mean %.4f, mean %.5f",
+                        name, -ranges[r][0], ranges[r][1], sign < 0 ? " negated" : "",
+                        peak, pel_mse, mse, pel_mean, mean );
+            if( peak > PEAK_ERROR || pel_mse > PEL_MSE || mse > OVERALL_MSE
+                || pel_mean > PEL_MEAN || fabs(mean) > OVERALL_MEAN )
+            {
+                mjpeg_error( "%s is outside the IEEE-1180 accuracy limits", name );
+                failed = 1;
+            }
+        }
+
+    {
+        int16_t zero[64];
+        memset( zero, 0, sizeof(zero) );
+        (*tst)( zero );
+        for( i = 0; i < 64; ++i )
+            if( zero[i] != 0 )
+            {
+                mjpeg_error( "%s of zero input isn't zero", name );
+                failed = 1;
+                break;
+            }
+    }
+    return failed;
+}
+
+/*
+ * Test inputs.  Random fdct inputs are prediction errors (-255..255),
+ * random idct inputs are any 12 bit coefficients.  Worst cases are
+ * the extreme values in patterns that maximise individual
+ * coefficients / pels and every intermediate result along the way.
+ */
+
+#define INPUT_KINDS 6
+
+static void make_input( int16_t *blk, int kind, int forward )
+{
+    int lo = forward ? -255 : -2048;
+    int hi = forward ? 255 : 2047;
+    int i;
+
+    switch( kind )
+    {
+    case 0 :                    /* Uniformly random */
+        for( i = 0; i < 64; ++i )
+            blk[i] = ieee_rand( -lo, hi );
+        break;
+    case 1 :                    /* Random extremes */
+        for( i = 0; i < 64; ++i )
+            blk[i] = ieee_rand( 0, 1 ) ? hi : lo;
+        break;
+    case 2 :                    /* Sparse: a few random values in zeros */
+        memset( blk, 0, 64*sizeof(int16_t) );
+        for( i = 1 + ieee_rand( 0, 3 ); i > 0; --i )
+            blk[ieee_rand(0,63)] = ieee_rand( -lo, hi );
+        break;
+    case 3 :                    /* Extremes (mostly) matching the sign of a basis function */
+    {
+        double res[64];
+        int16_t impulse[64];
+        memset( impulse, 0, sizeof(impulse) );
+        impulse[ieee_rand(0,63)] = 1024;
+        if( forward )
+            idct_double( impulse, res );
+        else
+            fdct_double( impulse, res );
+        for( i = 0; i < 64; ++i )
+            blk[i] = (res[i] >= 0.0) == !ieee_rand( 0, 3 ) ? lo : hi;
+        break;
+    }
+    case 4 :                    /* Small values */
+        for( i = 0; i < 64; ++i )
+            blk[i] = ieee_rand( 2, 2 );
+        break;
+    default :                   /* Constant */
+        blk[0] = ieee_rand( -lo, hi );
+        for( i = 1; i < 64; ++i )
+            blk[i] = blk[0];
+        break;
+    }
+}
+
+/*
+ * Check the multi-block transform tst gives results identical to the
+ * C version ref.  Block counts cycle so that odd blocks at the end
+ * get exercised.
+ */
+
+static int check_exact( const char *name, void (*ref)( int16_t *blk ),
+                        blocks_fn tst, int forward )
+{
+    int16_t in[7*64], out[7*64], expect[64];
+    int mismatches = 0;
+    int n, i, b, count;
+
+    randx = 1;
+    for( n = 0; n < EXACT_BLOCKS; n += count )
+    {
+        count = 1 + (n/7) % 7;
+        for( b = 0; b < count; ++b )
+            make_input( in+64*b, (n+b) % INPUT_KINDS, forward );
+        memcpy( out, in, count*64*sizeof(int16_t) );
+        (*tst)( out, count );
+        for( b = 0; b < count; ++b )
+        {
+            memcpy( expect, in+64*b, sizeof(expect) );
+            (*ref)( expect );
+            for( i = 0; i < 64; ++i )
+                if( out[64*b+i] != expect[i] )
+                {
+                    if( mismatches++ < 10 )
+                        mjpeg_error( "%s: block %d kind %d coeff %d: %d != %d",
+                                     name, n+b, (n+b) % INPUT_KINDS, i,
+                                     out[64*b+i], expect[i] );
+                }
+        }
+    }
+    if( mismatches > 0 )
+        mjpeg_error( "%s: %d mismatches with the C version", name, mismatches );
+    else
+        mjpeg_info( "%s: identical to the C version", name );
+    return mismatches > 0;
+}
+
+#ifdef HAVE_DCT_SSE2
+static void fdct_single_sse2( int16_t *blks, int count )
+{
+    for( ; count > 0; --count, blks += 64 )
+        fdct_sse2( blks );
+}
+
+static void idct_single_sse2( int16_t *blks, int count )
+{
+    for( ; count > 0; --count, blks += 64 )
+        idct_sse2( blks );
+}
+#endif
+
+int main( int argc, char *argv[] )
+{
+    int failed = 0;
+
+    mjpeg_default_handler_verbosity( 1 );
+    init_coslu();
+    init_fdct();
+    init_idct();
+
+    failed |= check_accuracy( "fdct", fdct, 1 );
+    failed |= check_accuracy( "idct", idct, 0 );
+
+#ifdef HAVE_DCT_SSE2
+    {
+        int flags = cpu_accel();
+        init_dct_sse2();
+        if( flags & ACCEL_X86_SSE2 )
+        {
+            failed |= check_exact( "fdct_sse2", fdct, fdct_single_sse2, 1 );
+            failed |= check_exact( "idct_sse2", idct, idct_single_sse2, 0 );
+            failed |= check_exact( "fdct_blocks_sse2", fdct, fdct_blocks_sse2, 1 );
+            failed |= check_exact( "idct_blocks_sse2", idct, idct_blocks_sse2, 0 );
+        }
+        else
+            mjpeg_info( "No SSE2: SIMD versions not checked" );
+        if( flags & ACCEL_X86_AVX2 )
+        {
+            failed |= check_exact( "fdct_blocks_avx2", fdct, fdct_blocks_avx2, 1 );
+            failed |= check_exact( "idct_blocks_avx2", idct, idct_blocks_avx2, 0 );
+        }
+        else
+            mjpeg_info( "No AVX2: AVX2 versions not checked" );
+    }
+#endif
+
+    return failed ? 1 : 0;
+}
@@ -65,6 +65,7 @@ extern int altivec_copy_v0();
 		"build_sub44_mests",
 		"subsample_image",
 		"find_best_one_pel",
+		"quant_intra",
 		"quant_nonintra",
 		"quant_weight_intra",
 		"quant_weight_nonintra",
@@ -115,6 +116,17 @@ static int testsseill()
 	return illegal;
 }
 
+/* Read XCR0 (xgetbv is spelt out for the benefit of old assemblers) */
+
+static uint32_t x86_xcr0(void)
+{
+	uint32_t eax, edx;
+	asm ( ".byte 0x0f, 0x01, 0xd0"
+		  : "=a" (eax), "=d" (edx)
+		  : "c" (0) );
+	return eax;
+}
+
 static int x86_accel (void)
 {
     long eax, ebx, ecx, edx;
@@ -144,6 +156,18 @@ static int x86_accel (void)
 	 : "a" (op)			\
 	 : "cc", "edi")
 
+#define cpuid_count(op,count,eax,ebx,ecx,edx)	\
+    asm ( "push %%"REG_b"\n" \
+	      "cpuid\n" \
+	      "mov   %%"REG_b", %%"REG_S"\n" \
+	      "pop   %%"REG_b"\n"  \
+	 : "=a" (eax),			\
+	   "=S" (ebx),			\
+	   "=c" (ecx),			\
+	   "=d" (edx)			\
+	 : "a" (op), "c" (count)	\
+	 : "cc", "edi")
+
     asm ("pushf\n\t"
 	 "pop %0\n\t"
 	 "mov %0,%1\n\t"
@@ -186,7 +210,33 @@ static int x86_accel (void)
 		   in a reg that is only accesible in ring 0... doh! 
 		*/
 		if( !testsseill() )
+		{
 			caps |= ACCEL_X86_SSE;
+			if( edx & 0x04000000 )
+				caps |= ACCEL_X86_SSE2;
+			if( (edx & 0x04000000) && (ecx & 0x00080000) )
+				caps |= ACCEL_X86_SSE41;
+		}
+	}
+
+	/* AVX2 and AVX-512 need the O.S. to save the wider registers: it
+	   says so via XCR0 which we can read iff OSXSAVE (ecx bit 27) is set.
+	   Both also need SSE for the rest of our SIMD support to be active.
+	*/
+	if( (caps & ACCEL_X86_SSE) && (ecx & 0x18000000) == 0x18000000 )
+	{
+		uint32_t xcr0 = x86_xcr0();
+		int32_t maxleaf;
+		cpuid (0x00000000, eax, ebx, ecx, edx);
+		maxleaf = eax;
+		if( (xcr0 & 0x06) == 0x06 && maxleaf >= 7 )
+		{
+			cpuid_count (0x00000007, 0, eax, ebx, ecx, edx);
+			if( ebx & 0x00000020 )
+				caps |= ACCEL_X86_AVX2;
+			if( (xcr0 & 0xe6) == 0xe6 && (ebx & 0x40010000) == 0x40010000 )
+				caps |= ACCEL_X86_AVX512BW;
+		}
 	}
 
     cpuid (0x80000000, eax, ebx, ecx, edx);
@@ -22,6 +22,19 @@
 #include "motionsearch.h"
 #include "mblock_sub44_sads_x86.h"
 
+/* The AVX2 / AVX-512BW routines are built using function target
+   attributes rather than special compiler flags.  These need a
+   reasonably recent compiler. */
+
+#if (defined(__GNUC__) && !defined(__clang__) \
+     && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) \
+    || (defined(__clang__) && __clang_major__ >= 4)
+#define HAVE_MOTION_AVX2 1
+#if (__GNUC__ >= 5 && !defined(__clang__)) || defined(__clang__)
+#define HAVE_MOTION_AVX512BW 1
+#endif
+#endif
+
 void enable_mmxsse_motion(int);
 
 void sub_mean_reduction( me_result_set *matchset, 
@@ -105,3 +118,53 @@ int build_sub22_mests_mmxe( me_result_set *sub44set,
 							int frowstride, int fh,
 							int reduction);
 
+#ifdef HAVE_MOTION_AVX2
+int sad_00_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h, int distlim);
+int sad_01_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h);
+int sad_10_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h);
+int sad_11_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h);
+int sad_sub22_avx2(uint8_t *blk1, uint8_t *blk2, int frowstride, int fh);
+int sad_sub44_avx2(uint8_t *blk1, uint8_t *blk2, int qrowstride, int qh);
+int bsad_avx2(uint8_t *pf, uint8_t *pb,
+              uint8_t *p2, int rowstride,
+              int hxf, int hyf, int hxb, int hyb, int h);
+int bsumsq_avx2(uint8_t *pf, uint8_t *pb,
+                uint8_t *p2, int rowstride,
+                int hxf, int hyf, int hxb, int hyb, int h);
+int sumsq_avx2(uint8_t *blk1, uint8_t *blk2,
+               int rowstride, int hx, int hy, int h);
+int sumsq_sub22_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h);
+int bsumsq_sub22_avx2(uint8_t *blk1f, uint8_t *blk1b,
+                      uint8_t *blk2, int rowstride, int h);
+void variance_avx2(uint8_t *p, int size, int rowstride,
+                   uint32_t *p_variance, uint32_t *p_mean);
+void find_best_one_pel_avx2( me_result_set *sub22set,
+                             uint8_t *org, uint8_t *blk,
+                             int i0, int j0,
+                             int ihigh, int jhigh,
+                             int rowstride, int h,
+                             me_result_s *best_so_far );
+int build_sub22_mests_avx2( me_result_set *sub44set,
+                            me_result_set *sub22set,
+                            int i0,  int j0, int ihigh, int jhigh,
+                            int null_ctl_sad,
+                            uint8_t *s22org,  uint8_t *s22blk,
+                            int frowstride, int fh,
+                            int reduction );
+int mblocks_sub44_mests_avx2( uint8_t *blk,  uint8_t *ref,
+                              int ilow, int jlow,
+                              int ihigh, int jhigh,
+                              int h, int rowstride,
+                              int threshold,
+                              me_result_s *resvec );
+#endif
+
+#ifdef HAVE_MOTION_AVX512BW
+int sad_00_avx512bw(uint8_t *blk1, uint8_t *blk2, int rowstride, int h, int distlim);
+void find_best_one_pel_avx512bw( me_result_set *sub22set,
+                                 uint8_t *org, uint8_t *blk,
+                                 int i0, int j0,
+                                 int ihigh, int jhigh,
+                                 int rowstride, int h,
+                                 me_result_s *best_so_far );
+#endif
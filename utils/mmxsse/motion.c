@@ -10,6 +10,8 @@
 
 #define SIMD_MMX(x) SIMD_DO(x,mmx)
 #define SIMD_MMXE(x) SIMD_DO(x,mmxe)
+#define SIMD_AVX2(x) SIMD_DO(x,avx2)
+#define SIMD_AVX512BW(x) SIMD_DO(x,avx512bw)
 
 void enable_mmxsse_motion(int cpucap)
 {
@@ -84,4 +86,54 @@ void enable_mmxsse_motion(int cpucap)
 
         SIMD_MMX(mblocks_sub44_mests);
     }
+
+    /* AVX2 / AVX-512 CPUs all have SSE so this just replaces the
+       routines where the wider registers help */
+#ifdef HAVE_MOTION_AVX2
+    if(cpucap & ACCEL_X86_AVX2)
+    {
+        mjpeg_info( "SETTING AVX2 for MOTION!");
+
+        SIMD_AVX2(sad_00);
+
+        SIMD_AVX2(sad_01);
+
+        SIMD_AVX2(sad_10);
+
+        SIMD_AVX2(sad_11);
+
+        SIMD_AVX2(sad_sub22);
+
+        SIMD_AVX2(sad_sub44);
+
+        SIMD_AVX2(find_best_one_pel);
+
+        SIMD_AVX2(sumsq);
+
+        SIMD_AVX2(sumsq_sub22);
+
+        SIMD_AVX2(bsumsq);
+
+        SIMD_AVX2(bsumsq_sub22);
+
+        SIMD_AVX2(variance);
+
+        SIMD_AVX2(bsad);
+
+        SIMD_AVX2(build_sub22_mests);
+
+        // build_sub44_mests_mmx is kept: just its core is replaced
+        SIMD_AVX2(mblocks_sub44_mests);
+    }
+#endif
+#ifdef HAVE_MOTION_AVX512BW
+    if(cpucap & ACCEL_X86_AVX512BW)
+    {
+        mjpeg_info( "SETTING AVX-512 for MOTION!");
+
+        SIMD_AVX512BW(sad_00);
+
+        SIMD_AVX512BW(find_best_one_pel);
+    }
+#endif
 }
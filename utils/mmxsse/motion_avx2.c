@@ -0,0 +1,897 @@
+/*
+ *  motion_avx2.c:  AVX2 and AVX-512BW versions of the motion
+ *  estimation sum absolute / squared difference routines, the
+ *  variance and the 2*2 and 4*4 sub-sampled match builders.
+ *
+ *  The MMX routines handle 8 pels at a time, so a 16 pel wide
+ *  macroblock row needs a pair of everything.  Here a whole row fits
+ *  in half a YMM register so two rows (or the same row at two
+ *  offsets) are done at once.  All the routines give results
+ *  *identical* to the C reference versions (and hence the MMX/SSE
+ *  versions they replace) so switching routines never changes the
+ *  encoded stream.
+ *
+ *  The code is compiled with per-function target attributes so no
+ *  special compiler flags are needed: the routines are only ever
+ *  called if cpu_accel() reports the CPU (and O.S.) supports them.
+ *
+ *  (C) 2026 mjpegtools contributors
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License
+ *  as published by the Free Software Foundation; either version 2
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "mjpeg_types.h"
+#include "fastintfns.h"
+#include "mmxsse_motion.h"
+
+#ifdef HAVE_MOTION_AVX2
+
+#include <immintrin.h>
+
+#define AVX2_FN __attribute__((target("avx2")))
+#define AVX2_INLINE static inline __attribute__((always_inline, target("avx2")))
+
+/*
+ * Helpers.  N.b. unaligned loads throughout: blocks start at
+ * arbitrary pel positions.
+ */
+
+AVX2_INLINE __m128i load16(const uint8_t *p)
+{
+    return _mm_loadu_si128( (const __m128i *)p );
+}
+
+AVX2_INLINE __m128i load8(const uint8_t *p)
+{
+    return _mm_loadl_epi64( (const __m128i *)p );
+}
+
+AVX2_INLINE __m128i load4(const uint8_t *p)
+{
+    int32_t v;
+    memcpy( &v, p, sizeof(v) );
+    return _mm_cvtsi32_si128( v );
+}
+
+/* Two 16 pel rows: lo in the low lane, hi in the high lane */
+AVX2_INLINE __m256i load2x16(const uint8_t *lo, const uint8_t *hi)
+{
+    return _mm256_inserti128_si256( _mm256_castsi128_si256( load16(lo) ),
+                                    load16(hi), 1 );
+}
+
+/* Two 8 pel rows packed into 16 bytes */
+AVX2_INLINE __m128i load2x8(const uint8_t *lo, const uint8_t *hi)
+{
+    return _mm_unpacklo_epi64( load8(lo), load8(hi) );
+}
+
+/* 16 pels widened to 16 bit words */
+AVX2_INLINE __m256i widen16(const uint8_t *p)
+{
+    return _mm256_cvtepu8_epi16( load16(p) );
+}
+
+/* Sum of the 64 bit partial sums of _mm256_sad_epu8 */
+AVX2_INLINE int hsum_sad(__m256i acc)
+{
+    __m128i s = _mm_add_epi64( _mm256_castsi256_si128(acc),
+                               _mm256_extracti128_si256(acc, 1) );
+    s = _mm_add_epi64( s, _mm_unpackhi_epi64(s, s) );
+    return _mm_cvtsi128_si32( s );
+}
+
+AVX2_INLINE int hsum_epi32(__m256i acc)
+{
+    __m128i s = _mm_add_epi32( _mm256_castsi256_si128(acc),
+                               _mm256_extracti128_si256(acc, 1) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32(s, 0x4e) );
+    s = _mm_add_epi32( s, _mm_shuffle_epi32(s, 0xb1) );
+    return _mm_cvtsi128_si32( s );
+}
+
+/*
+ * 16 words of (p[0]+p[hx]+p[hy*rowstride]+p[hy*rowstride+hx]+2)>>2
+ * I.e. the (possibly) half-pel interpolated prediction exactly as the
+ * C reference computes it for any combination of hx, hy.
+ */
+
+AVX2_INLINE __m256i pred_row(const uint8_t *p, int rowstride, int hx, int hy)
+{
+    const uint8_t *pb = p + rowstride*hy;
+    __m256i s = _mm256_add_epi16( widen16(p), widen16(p+hx) );
+    s = _mm256_add_epi16( s, _mm256_add_epi16( widen16(pb), widen16(pb+hx) ) );
+    s = _mm256_add_epi16( s, _mm256_set1_epi16(2) );
+    return _mm256_srli_epi16( s, 2 );
+}
+
+
+/*
+ * Sum absolute differences of 16*h blocks.  As with the MMX/SSE
+ * versions distlim is ignored: the full sum is always computed as
+ * early exit costs more than it saves.
+ */
+
+AVX2_FN int sad_00_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h, int distlim)
+{
+    __m256i acc = _mm256_setzero_si256();
+    int s;
+
+    for( ; h >= 2; h -= 2 )
+    {
+        __m256i a = load2x16( blk1, blk1+rowstride );
+        __m256i b = load2x16( blk2, blk2+rowstride );
+        acc = _mm256_add_epi64( acc, _mm256_sad_epu8( a, b ) );
+        blk1 += 2*rowstride;
+        blk2 += 2*rowstride;
+    }
+    s = hsum_sad( acc );
+    if( h )
+    {
+        __m128i t = _mm_sad_epu8( load16(blk1), load16(blk2) );
+        s += _mm_cvtsi128_si32( _mm_add_epi64( t, _mm_unpackhi_epi64(t,t) ) );
+    }
+    return s;
+}
+
+AVX2_FN int sad_01_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h)
+{
+    __m256i acc = _mm256_setzero_si256();
+    int s;
+
+    for( ; h >= 2; h -= 2 )
+    {
+        __m256i a = _mm256_avg_epu8( load2x16( blk1, blk1+rowstride ),
+                                     load2x16( blk1+1, blk1+rowstride+1 ) );
+        __m256i b = load2x16( blk2, blk2+rowstride );
+        acc = _mm256_add_epi64( acc, _mm256_sad_epu8( a, b ) );
+        blk1 += 2*rowstride;
+        blk2 += 2*rowstride;
+    }
+    s = hsum_sad( acc );
+    if( h )
+    {
+        __m128i t = _mm_sad_epu8( _mm_avg_epu8( load16(blk1), load16(blk1+1) ),
+                                  load16(blk2) );
+        s += _mm_cvtsi128_si32( _mm_add_epi64( t, _mm_unpackhi_epi64(t,t) ) );
+    }
+    return s;
+}
+
+AVX2_FN int sad_10_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h)
+{
+    __m256i acc = _mm256_setzero_si256();
+    int s;
+
+    for( ; h >= 2; h -= 2 )
+    {
+        __m256i a = _mm256_avg_epu8( load2x16( blk1, blk1+rowstride ),
+                                     load2x16( blk1+rowstride, blk1+2*rowstride ) );
+        __m256i b = load2x16( blk2, blk2+rowstride );
+        acc = _mm256_add_epi64( acc, _mm256_sad_epu8( a, b ) );
+        blk1 += 2*rowstride;
+        blk2 += 2*rowstride;
+    }
+    s = hsum_sad( acc );
+    if( h )
+    {
+        __m128i t = _mm_sad_epu8( _mm_avg_epu8( load16(blk1), load16(blk1+rowstride) ),
+                                  load16(blk2) );
+        s += _mm_cvtsi128_si32( _mm_add_epi64( t, _mm_unpackhi_epi64(t,t) ) );
+    }
+    return s;
+}
+
+/*
+ * N.b. averaging pairwise averages (pavgb) is *not* the same as the
+ * exact (a+b+c+d+2)>>2 so this is done in 16 bit words.
+ */
+
+AVX2_FN int sad_11_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h)
+{
+    __m256i acc = _mm256_setzero_si256();
+    __m256i ones = _mm256_set1_epi16(1);
+    __m256i two = _mm256_set1_epi16(2);
+    __m256i prev = _mm256_add_epi16( widen16(blk1), widen16(blk1+1) );
+
+    while( h-- )
+    {
+        __m256i cur, v;
+        blk1 += rowstride;
+        cur = _mm256_add_epi16( widen16(blk1), widen16(blk1+1) );
+        v = _mm256_srli_epi16( _mm256_add_epi16( _mm256_add_epi16(prev, cur), two ), 2 );
+        v = _mm256_abs_epi16( _mm256_sub_epi16( v, widen16(blk2) ) );
+        acc = _mm256_add_epi32( acc, _mm256_madd_epi16( v, ones ) );
+        prev = cur;
+        blk2 += rowstride;
+    }
+    return hsum_epi32( acc );
+}
+
+/*
+ * 2*2 sub-sampled SAD: 8 wide so four rows fill a YMM register
+ */
+
+AVX2_FN int sad_sub22_avx2(uint8_t *blk1, uint8_t *blk2, int frowstride, int fh)
+{
+    __m256i acc = _mm256_setzero_si256();
+    int s;
+
+    for( ; fh >= 4; fh -= 4 )
+    {
+        __m256i a = _mm256_inserti128_si256(
+            _mm256_castsi128_si256( load2x8( blk1, blk1+frowstride ) ),
+            load2x8( blk1+2*frowstride, blk1+3*frowstride ), 1 );
+        __m256i b = _mm256_inserti128_si256(
+            _mm256_castsi128_si256( load2x8( blk2, blk2+frowstride ) ),
+            load2x8( blk2+2*frowstride, blk2+3*frowstride ), 1 );
+        acc = _mm256_add_epi64( acc, _mm256_sad_epu8( a, b ) );
+        blk1 += 4*frowstride;
+        blk2 += 4*frowstride;
+    }
+    s = hsum_sad( acc );
+    for( ; fh > 0; --fh )
+    {
+        s += _mm_cvtsi128_si32( _mm_sad_epu8( load8(blk1), load8(blk2) ) );
+        blk1 += frowstride;
+        blk2 += frowstride;
+    }
+    return s;
+}
+
+/*
+ * 4*4 sub-sampled SAD.  qh is 1, 2 or 4 (see the C reference)
+ */
+
+AVX2_FN int sad_sub44_avx2(uint8_t *blk1, uint8_t *blk2, int qrowstride, int qh)
+{
+    __m128i a = load4( blk1 );
+    __m128i b = load4( blk2 );
+    __m128i t;
+    if( qh > 1 )
+    {
+        a = _mm_unpacklo_epi32( a, load4( blk1+qrowstride ) );
+        b = _mm_unpacklo_epi32( b, load4( blk2+qrowstride ) );
+        if( qh > 2 )
+        {
+            a = _mm_unpacklo_epi64( a,
+                                    _mm_unpacklo_epi32( load4( blk1+2*qrowstride ),
+                                                        load4( blk1+3*qrowstride ) ) );
+            b = _mm_unpacklo_epi64( b,
+                                    _mm_unpacklo_epi32( load4( blk2+2*qrowstride ),
+                                                        load4( blk2+3*qrowstride ) ) );
+        }
+    }
+    t = _mm_sad_epu8( a, b );
+    return _mm_cvtsi128_si32( _mm_add_epi64( t, _mm_unpackhi_epi64(t,t) ) );
+}
+
+/*
+ * Bi-directional SAD / squared difference: the forward and backward
+ * predictions are interpolated and averaged in 16 bit words.
+ */
+
+AVX2_FN int bsad_avx2(uint8_t *pf, uint8_t *pb, uint8_t *p2, int rowstride,
+                      int hxf, int hyf, int hxb, int hyb, int h)
+{
+    __m256i acc = _mm256_setzero_si256();
+    __m256i ones = _mm256_set1_epi16(1);
+
+    while( h-- )
+    {
+        __m256i v = _mm256_avg_epu16( pred_row( pf, rowstride, hxf, hyf ),
+                                      pred_row( pb, rowstride, hxb, hyb ) );
+        v = _mm256_abs_epi16( _mm256_sub_epi16( v, widen16(p2) ) );
+        acc = _mm256_add_epi32( acc, _mm256_madd_epi16( v, ones ) );
+        pf += rowstride;
+        pb += rowstride;
+        p2 += rowstride;
+    }
+    return hsum_epi32( acc );
+}
+
+AVX2_FN int bsumsq_avx2(uint8_t *pf, uint8_t *pb, uint8_t *p2, int rowstride,
+                        int hxf, int hyf, int hxb, int hyb, int h)
+{
+    __m256i acc = _mm256_setzero_si256();
+
+    while( h-- )
+    {
+        __m256i v = _mm256_avg_epu16( pred_row( pf, rowstride, hxf, hyf ),
+                                      pred_row( pb, rowstride, hxb, hyb ) );
+        v = _mm256_sub_epi16( v, widen16(p2) );
+        acc = _mm256_add_epi32( acc, _mm256_madd_epi16( v, v ) );
+        pf += rowstride;
+        pb += rowstride;
+        p2 += rowstride;
+    }
+    return hsum_epi32( acc );
+}
+
+AVX2_FN int sumsq_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride,
+                       int hx, int hy, int h)
+{
+    __m256i acc = _mm256_setzero_si256();
+
+    if( !hx && !hy )
+    {
+        while( h-- )
+        {
+            __m256i v = _mm256_sub_epi16( widen16(blk1), widen16(blk2) );
+            acc = _mm256_add_epi32( acc, _mm256_madd_epi16( v, v ) );
+            blk1 += rowstride;
+            blk2 += rowstride;
+        }
+    }
+    else
+    {
+        while( h-- )
+        {
+            __m256i v = _mm256_sub_epi16( pred_row( blk1, rowstride, hx, hy ),
+                                          widen16(blk2) );
+            acc = _mm256_add_epi32( acc, _mm256_madd_epi16( v, v ) );
+            blk1 += rowstride;
+            blk2 += rowstride;
+        }
+    }
+    return hsum_epi32( acc );
+}
+
+/*
+ * 2*2 sub-sampled squared differences: two 8 pel rows per register.
+ * An odd last row is paired with zeros in both blocks.
+ */
+
+AVX2_FN int sumsq_sub22_avx2(uint8_t *blk1, uint8_t *blk2, int rowstride, int h)
+{
+    __m256i acc = _mm256_setzero_si256();
+
+    for( ; h > 0; h -= 2 )
+    {
+        __m128i a, b;
+        __m256i v;
+        if( h > 1 )
+        {
+            a = load2x8( blk1, blk1+rowstride );
+            b = load2x8( blk2, blk2+rowstride );
+        }
+        else
+        {
+            a = load8( blk1 );
+            b = load8( blk2 );
+        }
+        v = _mm256_sub_epi16( _mm256_cvtepu8_epi16(a), _mm256_cvtepu8_epi16(b) );
+        acc = _mm256_add_epi32( acc, _mm256_madd_epi16( v, v ) );
+        blk1 += 2*rowstride;
+        blk2 += 2*rowstride;
+    }
+    return hsum_epi32( acc );
+}
+
+AVX2_FN int bsumsq_sub22_avx2(uint8_t *blk1f, uint8_t *blk1b, uint8_t *blk2,
+                              int rowstride, int h)
+{
+    __m256i acc = _mm256_setzero_si256();
+
+    for( ; h > 0; h -= 2 )
+    {
+        __m128i a, b;
+        __m256i v;
+        if( h > 1 )
+        {
+            a = _mm_avg_epu8( load2x8( blk1f, blk1f+rowstride ),
+                              load2x8( blk1b, blk1b+rowstride ) );
+            b = load2x8( blk2, blk2+rowstride );
+        }
+        else
+        {
+            a = _mm_avg_epu8( load8( blk1f ), load8( blk1b ) );
+            b = load8( blk2 );
+        }
+        v = _mm256_sub_epi16( _mm256_cvtepu8_epi16(a), _mm256_cvtepu8_epi16(b) );
+        acc = _mm256_add_epi32( acc, _mm256_madd_epi16( v, v ) );
+        blk1f += 2*rowstride;
+        blk1b += 2*rowstride;
+        blk2 += 2*rowstride;
+    }
+    return hsum_epi32( acc );
+}
+
+/*
+ * Variance (times size*size) and mean of a size*size block.  size is
+ * 16 for luminance and usually 8 for chrominance but field
+ * macroblocks may ask for other sizes: those are rare enough to
+ * simply be done a pel at a time.
+ */
+
+AVX2_FN void variance_avx2(uint8_t *p, int size, int rowstride,
+                           uint32_t *p_var, uint32_t *p_mean)
+{
+    __m256i sum = _mm256_setzero_si256();
+    __m256i sumsq = _mm256_setzero_si256();
+    __m256i zero = _mm256_setzero_si256();
+    unsigned int s, s2;
+    int j;
+
+    if( size == 16 || size == 8 )
+    {
+        for( j = 0; j < size; j += 32/size )
+        {
+            __m256i x, lo, hi;
+            if( size == 16 )
+                x = load2x16( p, p+rowstride );
+            else
+                x = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256( load2x8( p, p+rowstride ) ),
+                    load2x8( p+2*rowstride, p+3*rowstride ), 1 );
+            lo = _mm256_unpacklo_epi8( x, zero );
+            hi = _mm256_unpackhi_epi8( x, zero );
+            sum = _mm256_add_epi64( sum, _mm256_sad_epu8( x, zero ) );
+            sumsq = _mm256_add_epi32( sumsq, _mm256_madd_epi16( lo, lo ) );
+            sumsq = _mm256_add_epi32( sumsq, _mm256_madd_epi16( hi, hi ) );
+            p += (32/size)*rowstride;
+        }
+        s = hsum_sad( sum );
+        s2 = hsum_epi32( sumsq );
+    }
+    else
+    {
+        int i;
+        s = s2 = 0;
+        for( j = 0; j < size; ++j )
+        {
+            for( i = 0; i < size; ++i )
+            {
+                unsigned int v = p[i];
+                s += v;
+                s2 += v*v;
+            }
+            p += rowstride;
+        }
+    }
+    *p_mean = s/(size*size);
+    *p_var = s2 - (s*s)/(size*size);
+}
+
+/*
+ * SADs of the 16*h block blk2 against blk1, blk1(+1,0), blk1(0,+1)
+ * and blk1(+1,+1) (in that order in resvec).  Each row of blk1 is
+ * loaded (at both offsets) once and compared against two rows of
+ * blk2.  Gives up once all four partial sums exceed peakerror.
+ *
+ * RETURN: The smallest of the four SADs (or a partial SAD > peakerror)
+ */
+
+AVX2_INLINE int min4_epi32(__m128i s)
+{
+    s = _mm_min_epi32( s, _mm_shuffle_epi32( s, 0x4e ) );
+    s = _mm_min_epi32( s, _mm_shuffle_epi32( s, 0xb1 ) );
+    return _mm_cvtsi128_si32( s );
+}
+
+/* The four SADs of a pair of 2-lane _mm256_sad_epu8 accumulators */
+AVX2_INLINE __m128i nearest4_sums(__m256i acc0, __m256i acc1)
+{
+    __m256i s0 = _mm256_add_epi64( acc0, _mm256_shuffle_epi32( acc0, 0x4e ) );
+    __m256i s1 = _mm256_add_epi64( acc1, _mm256_shuffle_epi32( acc1, 0x4e ) );
+    __m256i u = _mm256_unpacklo_epi64( s0, s1 );
+    u = _mm256_permutevar8x32_epi32( u, _mm256_setr_epi32( 0, 4, 2, 6, 1, 3, 5, 7 ) );
+    return _mm256_castsi256_si128( u );
+}
+
+AVX2_INLINE int nearest4_sads_avx2(uint8_t *blk1, uint8_t *blk2,
+                                   int rowstride, int h, int32_t *resvec,
+                                   int peakerror)
+{
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    __m256i cur = load2x16( blk1, blk1+1 );
+    __m128i sums;
+    int j;
+
+    for( j = 1; j <= h; ++j )
+    {
+        __m256i b = _mm256_broadcastsi128_si256( load16(blk2) );
+        __m256i next;
+        blk1 += rowstride;
+        next = load2x16( blk1, blk1+1 );
+        acc0 = _mm256_add_epi64( acc0, _mm256_sad_epu8( cur, b ) );
+        acc1 = _mm256_add_epi64( acc1, _mm256_sad_epu8( next, b ) );
+        cur = next;
+        blk2 += rowstride;
+        if( (j & 3) == 0 && j < h )
+        {
+            int partial = min4_epi32( nearest4_sums( acc0, acc1 ) );
+            if( partial > peakerror )
+                return partial;
+        }
+    }
+    sums = nearest4_sums( acc0, acc1 );
+    _mm_storeu_si128( (__m128i *)resvec, sums );
+    return min4_epi32( sums );
+}
+
+/*
+ * As above for 2*2 sub-sampled (8 wide) blocks: all four SADs
+ * accumulate in a single register.  Never gives up early.
+ */
+
+AVX2_INLINE void sub22_nearest4_sads_avx2(uint8_t *blk1, uint8_t *blk2,
+                                          int frowstride, int fh, int32_t *resvec)
+{
+    __m256i acc = _mm256_setzero_si256();
+    __m128i cur = load2x8( blk1, blk1+1 );
+
+    while( fh-- )
+    {
+        __m128i b = load8( blk2 );
+        __m128i next;
+        blk1 += frowstride;
+        next = load2x8( blk1, blk1+1 );
+        b = _mm_unpacklo_epi64( b, b );
+        acc = _mm256_add_epi64(
+            acc,
+            _mm256_sad_epu8( _mm256_inserti128_si256( _mm256_castsi128_si256(cur), next, 1 ),
+                             _mm256_broadcastsi128_si256( b ) ) );
+        cur = next;
+        blk2 += frowstride;
+    }
+    acc = _mm256_permutevar8x32_epi32( acc, _mm256_setr_epi32( 0, 2, 4, 6, 1, 3, 5, 7 ) );
+    _mm_storeu_si128( (__m128i *)resvec, _mm256_castsi256_si128( acc ) );
+}
+
+/*
+ * Search for the best 1-pel match within 1-pel of a good 2*2-pel
+ * match.  Identical to find_best_one_pel_mmxe except for the routine
+ * computing each candidate's nearest 4 SADs.
+ */
+
+AVX2_FN void find_best_one_pel_avx2( me_result_set *sub22set,
+                                     uint8_t *org, uint8_t *blk,
+                                     int i0, int j0,
+                                     int ihigh, int jhigh,
+                                     int rowstride, int h,
+                                     me_result_s *best_so_far )
+{
+    int i,k;
+    int d;
+    me_result_s minpos = *best_so_far;
+    int ilim = ihigh-i0;
+    int jlim = jhigh-j0;
+    int dmin = INT_MAX;
+    uint8_t *orgblk;
+    int penalty;
+    me_result_s matchrec;
+    int32_t resvec[4];
+
+    for( k = 0; k < sub22set->len; ++k )
+    {
+        matchrec = sub22set->mests[k];
+        orgblk = org + (i0+matchrec.x)+rowstride*(j0+matchrec.y);
+        penalty = (abs(matchrec.x) + abs(matchrec.y))<<3;
+        if( penalty >= dmin )
+            continue;
+        if( nearest4_sads_avx2( orgblk, blk, rowstride, h, resvec, dmin-penalty )
+            + penalty >= dmin )
+            continue;
+        for( i = 0; i < 4; ++i )
+        {
+            if( matchrec.x <= ilim && matchrec.y <= jlim )
+            {
+                d = penalty+resvec[i];
+                if (d<dmin)
+                {
+                    dmin = d;
+                    minpos = matchrec;
+                }
+            }
+            if( i == 1 )
+            {
+                matchrec.x -= 1;
+                matchrec.y += 1;
+            }
+            else
+            {
+                matchrec.x += 1;
+            }
+        }
+    }
+
+    minpos.weight = (uint16_t)intmin(255*255, dmin);
+    *best_so_far = minpos;
+}
+
+AVX2_FN int build_sub22_mests_avx2( me_result_set *sub44set,
+                                    me_result_set *sub22set,
+                                    int i0,  int j0, int ihigh, int jhigh,
+                                    int null_ctl_sad,
+                                    uint8_t *s22org,  uint8_t *s22blk,
+                                    int frowstride, int fh,
+                                    int reduction )
+{
+    int i,k,s;
+    int threshold = 6*null_ctl_sad / (2 * 2*reduction);
+    int min_weight;
+    int ilim = ihigh-i0;
+    int jlim = jhigh-j0;
+    int x,y;
+    uint8_t *s22orgblk;
+    int32_t resvec[4];
+    me_result_s *mc = sub22set->mests;
+
+    for( k = 0; k < sub44set->len; ++k )
+    {
+        x = sub44set->mests[k].x;
+        y = sub44set->mests[k].y;
+
+        s22orgblk =  s22org +((y+j0)>>1)*frowstride +((x+i0)>>1);
+        sub22_nearest4_sads_avx2( s22orgblk, s22blk, frowstride, fh, resvec );
+        for( i = 0; i < 4; ++i )
+        {
+            if( x <= ilim && y <= jlim )
+            {
+                s = resvec[i]+(intmax(abs(x), abs(y))<<3);
+                if( s < threshold )
+                {
+                    mc->x = (int8_t)x;
+                    mc->y = (int8_t)y;
+                    mc->weight = s;
+                    mc++;
+                }
+            }
+            if( i == 1 )
+            {
+                x -= 2;
+                y += 2;
+            }
+            else
+            {
+                x += 2;
+            }
+        }
+    }
+
+    sub22set->len = mc - sub22set->mests;
+    sub_mean_reduction( sub22set, reduction, &min_weight );
+    return sub22set->len;
+}
+
+/*
+ * 4*4 sub-sampled matches for build_sub44_mests_mmx.  mpsadbw
+ * computes the SADs of a 4 qpel row against 8 successive positions
+ * so a row of (up to) 16 candidate matches takes one instruction per
+ * qpel row.  Candidates are then thresholded exactly as by
+ * mblocks_sub44_mests_mmxe (which must remain the case or the
+ * encoding would depend on the CPU it was done on).
+ *
+ * N.b. the 4*4 sub-sampled data is at the very end of its buffer so
+ * the last qpel row compared is loaded without straying beyond the
+ * qpels actually needed.  Other rows may safely over-run into the
+ * row below.
+ */
+
+AVX2_INLINE __m256i load_qrow_exact(const uint8_t *p, int len)
+{
+    uint8_t buf[32] = { 0 };
+    memcpy( buf, p, len );
+    return load2x16( buf, buf+8 );
+}
+
+AVX2_FN int mblocks_sub44_mests_avx2( uint8_t *blk,  uint8_t *ref,
+                                      int ilow, int jlow,
+                                      int ihigh, int jhigh,
+                                      int h, int rowstride,
+                                      int threshold,
+                                      me_result_s *resvec )
+{
+    me_result_s *cres = resvec;
+    int ncands = (ihigh-ilow)/4+1;
+    __m256i refrow[4];
+    __m256i index = _mm256_setr_epi16( 0, 1, 2, 3, 4, 5, 6, 7,
+                                       8, 9, 10, 11, 12, 13, 14, 15 );
+    int x, y, c, i, k;
+
+    for( k = 0; k < h; ++k )
+        refrow[k] = _mm256_broadcastsi128_si256( load4(ref+k*rowstride) );
+
+    for( y = jlow; y <= jhigh; y += 4 )
+    {
+        for( c = 0; c < ncands; c += 16 )
+        {
+            int n = intmin( 16, ncands-c );
+            uint8_t *curblk = blk + c;
+            __m256i sads = _mm256_setzero_si256();
+            __m128i minsad;
+            uint16_t weights[16];
+
+            for( k = 0; k < h; ++k )
+            {
+                __m256i row;
+                if( y+4 > jhigh && k == h-1 )
+                    row = load_qrow_exact( curblk, n+3 );
+                else
+                    row = load2x16( curblk, curblk+8 );
+                sads = _mm256_add_epi16( sads, _mm256_mpsadbw_epu8( row, refrow[k], 0 ) );
+                curblk += rowstride;
+            }
+
+            /* Most runs of candidates have none below threshold.
+               Positions beyond the last candidate don't count. */
+            sads = _mm256_or_si256(
+                sads, _mm256_cmpgt_epi16( index, _mm256_set1_epi16( n-1 ) ) );
+            minsad = _mm_minpos_epu16(
+                _mm_min_epu16( _mm256_castsi256_si128( sads ),
+                               _mm256_extracti128_si256( sads, 1 ) ) );
+            if( _mm_extract_epi16( minsad, 0 ) > threshold )
+                continue;
+
+            _mm256_storeu_si256( (__m256i *)weights, sads );
+            for( i = 0, x = ilow+4*c; i < n; ++i, x += 4 )
+            {
+                int weight = weights[i];
+                if( weight <= threshold )
+                {
+                    threshold = intmin(weight<<2,threshold);
+                    cres->weight = (uint16_t)(weight+(intmax(abs(x),abs(y))<<2));
+                    cres->x = (uint8_t)x;
+                    cres->y = (uint8_t)y;
+                    ++cres;
+                }
+            }
+        }
+        blk += rowstride;
+    }
+    return cres - resvec;
+}
+
+
+#ifdef HAVE_MOTION_AVX512BW
+
+/*
+ * AVX-512BW: a ZMM register holds four 16 pel rows.  Only worthwhile
+ * where four rows' worth of work are naturally available: plain SADs
+ * and the nearest 4 SADs of the 1-pel search (where each blk2 row
+ * is compared with 4 blk1 rows / offsets).
+ */
+
+#define AVX512_FN __attribute__((target("avx512bw")))
+
+AVX512_FN int sad_00_avx512bw(uint8_t *blk1, uint8_t *blk2, int rowstride, int h, int distlim)
+{
+    __m512i acc = _mm512_setzero_si512();
+    __m256i acc256;
+    int s;
+
+    for( ; h >= 4; h -= 4 )
+    {
+        __m512i a = _mm512_inserti64x4(
+            _mm512_castsi256_si512( load2x16( blk1, blk1+rowstride ) ),
+            load2x16( blk1+2*rowstride, blk1+3*rowstride ), 1 );
+        __m512i b = _mm512_inserti64x4(
+            _mm512_castsi256_si512( load2x16( blk2, blk2+rowstride ) ),
+            load2x16( blk2+2*rowstride, blk2+3*rowstride ), 1 );
+        acc = _mm512_add_epi64( acc, _mm512_sad_epu8( a, b ) );
+        blk1 += 4*rowstride;
+        blk2 += 4*rowstride;
+    }
+    acc256 = _mm256_add_epi64( _mm512_castsi512_si256( acc ),
+                               _mm512_extracti64x4_epi64( acc, 1 ) );
+    s = hsum_sad( acc256 );
+    if( h )
+        s += sad_00_avx2( blk1, blk2, rowstride, h, distlim );
+    return s;
+}
+
+static inline __attribute__((always_inline, target("avx512bw")))
+int nearest4_sads_avx512bw(uint8_t *blk1, uint8_t *blk2,
+                           int rowstride, int h, int32_t *resvec,
+                           int peakerror)
+{
+    __m512i acc = _mm512_setzero_si512();
+    __m512i perm = _mm512_setr_epi32( 0, 4, 8, 12, 1, 2, 3, 5,
+                                      6, 7, 9, 10, 11, 13, 14, 15 );
+    __m256i cur = load2x16( blk1, blk1+1 );
+    __m128i sums;
+    int j;
+
+    for( j = 1; j <= h; ++j )
+    {
+        __m512i b = _mm512_broadcast_i32x4( load16(blk2) );
+        __m256i next;
+        blk1 += rowstride;
+        next = load2x16( blk1, blk1+1 );
+        acc = _mm512_add_epi64(
+            acc,
+            _mm512_sad_epu8( _mm512_inserti64x4( _mm512_castsi256_si512( cur ), next, 1 ),
+                             b ) );
+        cur = next;
+        blk2 += rowstride;
+        if( (j & 3) == 0 && j < h )
+        {
+            __m512i s = _mm512_add_epi64( acc, _mm512_shuffle_epi32( acc, 0x4e ) );
+            int partial =
+                min4_epi32( _mm512_castsi512_si128( _mm512_permutexvar_epi32( perm, s ) ) );
+            if( partial > peakerror )
+                return partial;
+        }
+    }
+    acc = _mm512_add_epi64( acc, _mm512_shuffle_epi32( acc, 0x4e ) );
+    sums = _mm512_castsi512_si128( _mm512_permutexvar_epi32( perm, acc ) );
+    _mm_storeu_si128( (__m128i *)resvec, sums );
+    return min4_epi32( sums );
+}
+
+AVX512_FN void find_best_one_pel_avx512bw( me_result_set *sub22set,
+                                           uint8_t *org, uint8_t *blk,
+                                           int i0, int j0,
+                                           int ihigh, int jhigh,
+                                           int rowstride, int h,
+                                           me_result_s *best_so_far )
+{
+    int i,k;
+    int d;
+    me_result_s minpos = *best_so_far;
+    int ilim = ihigh-i0;
+    int jlim = jhigh-j0;
+    int dmin = INT_MAX;
+    uint8_t *orgblk;
+    int penalty;
+    me_result_s matchrec;
+    int32_t resvec[4];
+
+    for( k = 0; k < sub22set->len; ++k )
+    {
+        matchrec = sub22set->mests[k];
+        orgblk = org + (i0+matchrec.x)+rowstride*(j0+matchrec.y);
+        penalty = (abs(matchrec.x) + abs(matchrec.y))<<3;
+        if( penalty >= dmin )
+            continue;
+        if( nearest4_sads_avx512bw( orgblk, blk, rowstride, h, resvec, dmin-penalty )
+            + penalty >= dmin )
+            continue;
+        for( i = 0; i < 4; ++i )
+        {
+            if( matchrec.x <= ilim && matchrec.y <= jlim )
+            {
+                d = penalty+resvec[i];
+                if (d<dmin)
+                {
+                    dmin = d;
+                    minpos = matchrec;
+                }
+            }
+            if( i == 1 )
+            {
+                matchrec.x -= 1;
+                matchrec.y += 1;
+            }
+            else
+            {
+                matchrec.x += 1;
+            }
+        }
+    }
+
+    minpos.weight = (uint16_t)intmin(255*255, dmin);
+    *best_so_far = minpos;
+}
+
+#endif /* HAVE_MOTION_AVX512BW */
+
+#endif /* HAVE_MOTION_AVX2 */